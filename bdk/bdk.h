@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2022 CTCaer
+ * Copyright (c) 2022-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -60,9 +60,13 @@
 #include <storage/mbr_gpt.h>
 #include <storage/mmc_def.h>
 #include <storage/nx_emmc_bis.h>
+#include <storage/nx_emmc_cz.h>
+#include <storage/nx_emmc_jrnl.h>
+#include <storage/nx_emmc_layout.h>
 #include <storage/ramdisk.h>
 #include <storage/sd.h>
 #include <storage/sdmmc.h>
+#include <storage/sdmmc_bench.h>
 #include <thermal/fan.h>
 #include <thermal/tmp451.h>
 #include <usb/usbd.h>
@@ -63,6 +63,12 @@ int touch_get_event_count()
 	return (buf[1] >> 1);
 }
 
+// Interrupt line is low while events are pending.
+bool touch_event_pending()
+{
+	return !gpio_read(GPIO_PORT_X, GPIO_PIN_1);
+}
+
 static int _touch_wait_event(u8 event, u8 status, u32 timeout, u8 *buf)
 {
 	u32 timer = get_tmr_ms() + timeout;
@@ -418,6 +424,10 @@ int touch_power_on()
 	gpio_direction_output(GPIO_PORT_J, GPIO_PIN_7, GPIO_LOW);
 	usleep(20);
 
+	// Configure touchscreen Touch Interrupt pin.
+	PINMUX_AUX(PINMUX_AUX_TOUCH_INT) = PINMUX_INPUT_ENABLE | PINMUX_PULL_UP;
+	gpio_direction_input(GPIO_PORT_X, GPIO_PIN_1);
+
 	// Enable LDO6 for touchscreen AVDD and DVDD supply.
 	max7762x_regulator_set_voltage(REGULATOR_LDO6, 2900000);
 	max7762x_regulator_enable(REGULATOR_LDO6, true);
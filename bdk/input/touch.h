@@ -174,6 +174,7 @@ touch_info_t *touch_get_chip_info();
 touch_panel_info_t *touch_get_panel_vendor();
 int touch_get_fw_info(touch_fw_info_t *fw);
 int touch_get_event_count();
+bool touch_event_pending();
 int touch_panel_ito_test(u8 *err);
 int touch_execute_autotune();
 int touch_switch_sense_mode(u8 mode, bool gis_6_2);
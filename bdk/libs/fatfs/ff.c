@@ -1666,6 +1666,45 @@ static DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 
 
 
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Get contiguous sectors for a direct transfer           */
+/*-----------------------------------------------------------------------*/
+
+static UINT clst_span (	/* Number of sectors that can be transferred in one go */
+	FIL* fp,		/* Pointer to the file object (fp->clust is moved to the last cluster of the span) */
+	UINT csect,		/* Sector offset in the current cluster */
+	UINT cc			/* Number of sectors requested */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	DWORD clst = fp->clust, ncl;
+	UINT span = fs->csize - csect;	/* Sectors left in the current cluster */
+#if FF_USE_FASTSEEK
+	FSIZE_t nofs = fp->fptr + (FSIZE_t)span * SS(fs);	/* Offset of the next cluster */
+#endif
+
+
+	while (span < cc) {	/* Merge following clusters while they are physically contiguous */
+#if FF_USE_FASTSEEK
+		if (fp->cltbl) {
+			ncl = clmt_clust(fp, nofs);
+			nofs += (FSIZE_t)fs->csize * SS(fs);
+		} else
+#endif
+		{
+			ncl = get_fat(&fp->obj, clst);	/* exFAT contiguous (NoFatChain) files do not access the FAT */
+		}
+		if (ncl != clst + 1) break;	/* Fragmented, end of chain or error (left to the normal path) */
+		clst = ncl;
+		span += fs->csize;
+	}
+	fp->clust = clst;
+
+	return (span < cc) ? span : cc;
+}
+
+
+
 
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Fill a cluster with zeros                        */
@@ -3054,14 +3093,19 @@ static FRESULT create_name (	/* FR_OK: successful, FR_INVALID_NAME: could not cr
 /* Follow a file path                                                    */
 /*-----------------------------------------------------------------------*/
 
+static FRESULT follow_segs (DIR* dp, const TCHAR* path);
+
 static FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 	DIR* dp,					/* Directory object to return last directory and found object */
 	const TCHAR* path			/* Full-path string to find a file or directory */
 )
 {
+#if FF_FS_RPATH != 0
+#if FF_FS_EXFAT
 	FRESULT res;
-	BYTE ns;
+#endif
 	FATFS *fs = dp->obj.fs;
+#endif
 
 
 #if FF_FS_RPATH != 0
@@ -3090,6 +3134,26 @@ static FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 #endif
 #endif
 
+	return follow_segs(dp, path);
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Follow a path from the current directory of the object                */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT follow_segs (	/* FR_OK(0): successful, !=0: error code */
+	DIR* dp,					/* Directory object to start from and return last directory and found object */
+	const TCHAR* path			/* Path string relative to the directory */
+)
+{
+	FRESULT res;
+	BYTE ns;
+	FATFS *fs = dp->obj.fs;
+
+
 	if ((UINT)*path < ' ') {				/* Null path name is the origin directory itself */
 		dp->fn[NSFLAG] = NS_NONAME;
 		res = dir_sdi(dp, 0);
@@ -3864,8 +3928,8 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
 			if (cc > 0) {						/* Read maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
+				if (csect + cc > fs->csize) {	/* Clip at cluster boundary or at the end of a contiguous run */
+					cc = clst_span(fp, csect, cc);
 				}
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) {
 					EFSPRINTF("RLIO");
@@ -4093,8 +4157,8 @@ FRESULT f_write (
 			sect += csect;
 			cc = btw / SS(fs);				/* When remaining bytes >= sector size, */
 			if (cc > 0) {					/* Write maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
+				if (csect + cc > fs->csize) {	/* Clip at cluster boundary or at the end of an allocated contiguous run */
+					cc = clst_span(fp, csect, cc);
 				}
 				if (disk_write(fs->pdrv, wbuff, sect, cc) != RES_OK) {
 					EFSPRINTF("WLIO");
@@ -4651,6 +4715,15 @@ FRESULT f_lseek (
 				fp->clust = clst;
 			}
 			if (clst != 0) {
+#if FF_FS_EXFAT
+				if (fs->fs_type == FS_EXFAT && fp->obj.stat == 2 && ofs > bcs && fp->fptr + ofs <= fp->obj.objsize) {
+					nsect = (DWORD)((ofs - 1) / bcs);	/* Contiguous (NoFatChain) file, jump to the target cluster */
+					clst += nsect;
+					ofs -= (FSIZE_t)nsect * bcs; fp->fptr += (FSIZE_t)nsect * bcs;
+					fp->clust = clst;
+					nsect = 0;
+				}
+#endif
 				while (ofs > bcs) {						/* Cluster following loop */
 					ofs -= bcs; fp->fptr += bcs;
 #if !FF_FS_READONLY
@@ -4736,6 +4809,34 @@ DWORD *f_expand_cltbl (
 
 	return fp->cltbl;
 }
+
+DWORD *f_alloc_cltbl (
+	FIL* fp,		/* Pointer to the file object */
+	UINT tblsz,		/* Size of table (2 DWORDs + 2 DWORDs per fragment) */
+	FSIZE_t fsz		/* File size to be allocated */
+)
+{
+#if FF_USE_EXPAND
+	/* Try a single contiguous block first. Falls back to chained allocation */
+	if (fp->obj.objsize == 0) f_expand(fp, fsz, 1);
+#endif
+	if (!f_expand_cltbl(fp, tblsz, fsz)) return (void *)0;
+	if (fp->obj.objsize != fsz) {	/* Not enough free clusters */
+		ff_memfree(fp->cltbl);
+		fp->cltbl = (void *)0;
+		return (void *)0;
+	}
+
+	return fp->cltbl;
+}
+
+DWORD f_clst2sect (
+	FIL* fp,		/* Pointer to the file object */
+	DWORD clst		/* Cluster# to be converted */
+)
+{
+	return clst2sect(fp->obj.fs, clst);
+}
 #endif
 
 
@@ -4873,6 +4974,57 @@ FRESULT f_readdir (
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Read Multiple Directory Entries in Sequence                           */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_readdir_batch (
+	DIR* dp,			/* Pointer to the open directory object */
+	DIRENT* ent,		/* Pointer to the entry array to fill */
+	UINT max,			/* Number of entries in the array */
+	UINT* cnt			/* Pointer to number of entries read (0:end of directory) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	FILINFO fno;
+	UINT n = 0, i;
+	DEF_NAMBUF
+
+
+	*cnt = 0;
+	res = validate(&dp->obj, &fs);	/* Check validity of the directory object */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);			/* LFN working buffer is shared by the whole batch */
+		while (n < max) {
+			res = DIR_READ_FILE(dp);		/* Read an item */
+			if (res != FR_OK) break;
+			get_fileinfo(dp, &fno);			/* Get the object information */
+#if FF_FS_EXFAT
+			if (fs->fs_type == FS_EXFAT) {
+				ent->sclust = ld_dword(fs->dirbuf + XDIR_FstClus);
+			} else
+#endif
+			{
+				ent->sclust = ld_clust(fs, dp->dir);
+			}
+			ent->fsize = fno.fsize;
+			ent->fattrib = fno.fattrib;
+			for (i = 0; (ent->fname[i] = fno.fname[i]) != 0; i++) ;
+			ent++; n++;
+			res = dir_next(dp, 0);			/* Increment index for next */
+			if (res != FR_OK) break;
+		}
+		if (res == FR_NO_FILE) res = FR_OK;	/* Ignore end of directory */
+		FREE_NAMBUF();
+	}
+	*cnt = n;
+
+	LEAVE_FF(fs, res);
+}
+
+
+
 #if FF_USE_FIND
 /*-----------------------------------------------------------------------*/
 /* Find Next File                                                        */
@@ -4960,6 +5112,47 @@ FRESULT f_stat (
 
 
 
+
+/*-----------------------------------------------------------------------*/
+/* Get File Status Relative to an Open Directory                         */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_stat_at (
+	DIR* dp,			/* Pointer to the open directory to search from */
+	const TCHAR* path,	/* Pointer to the path relative to the directory */
+	FILINFO* fno		/* Pointer to file information to return */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DIR dj;
+	DEF_NAMBUF
+
+
+	res = validate(&dp->obj, &fs);	/* Check validity of the directory object */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);
+		dj.obj = dp->obj;			/* Start from the given directory without following its path */
+#if FF_FS_EXFAT
+		dj.obj.n_frag = 0;
+#endif
+		while (*path == '/' || *path == '\\') path++;	/* Strip heading separator */
+		res = follow_segs(&dj, path);	/* Follow the relative path */
+		if (res == FR_OK) {				/* Follow completed */
+			if (dj.fn[NSFLAG] & NS_NONAME) {	/* It is origin directory */
+				res = FR_INVALID_NAME;
+			} else {							/* Found an object */
+				if (fno) get_fileinfo(&dj, fno);
+			}
+		}
+		FREE_NAMBUF();
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Get Number of Free Clusters                                           */
@@ -225,6 +225,21 @@ typedef struct {
 
 
 
+/* Compact directory entry (DIRENT) */
+
+typedef struct {
+	FSIZE_t	fsize;			/* File size */
+	DWORD	sclust;			/* Object start cluster (0:no cluster) */
+	BYTE	fattrib;		/* File attribute */
+#if FF_USE_LFN
+	TCHAR	fname[FF_LFN_BUF + 1];	/* Primary file name */
+#else
+	TCHAR	fname[12 + 1];	/* File name */
+#endif
+} DIRENT;
+
+
+
 /* File function return code (FRESULT) */
 
 typedef enum {
@@ -274,12 +289,14 @@ FRESULT f_sync (FIL* fp);											/* Flush cached data of the writing file */
 FRESULT f_opendir (DIR* dp, const TCHAR* path);						/* Open a directory */
 FRESULT f_closedir (DIR* dp);										/* Close an open directory */
 FRESULT f_readdir (DIR* dp, FILINFO* fno);							/* Read a directory item */
+FRESULT f_readdir_batch (DIR* dp, DIRENT* ent, UINT max, UINT* cnt);	/* Read multiple directory items */
 FRESULT f_findfirst (DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern);	/* Find first file */
 FRESULT f_findnext (DIR* dp, FILINFO* fno);							/* Find next file */
 FRESULT f_mkdir (const TCHAR* path);								/* Create a sub directory */
 FRESULT f_unlink (const TCHAR* path);								/* Delete an existing file or directory */
 FRESULT f_rename (const TCHAR* path_old, const TCHAR* path_new);	/* Rename/Move a file or directory */
 FRESULT f_stat (const TCHAR* path, FILINFO* fno);					/* Get file status */
+FRESULT f_stat_at (DIR* dp, const TCHAR* path, FILINFO* fno);		/* Get file status relative to an open directory */
 FRESULT f_chmod (const TCHAR* path, BYTE attr, BYTE mask);			/* Change attribute of a file/dir */
 FRESULT f_utime (const TCHAR* path, const FILINFO* fno);			/* Change timestamp of a file/dir */
 FRESULT f_chdir (const TCHAR* path);								/* Change current directory */
@@ -291,6 +308,8 @@ FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_forward (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Forward data to the stream */
 #if FF_FASTFS
 DWORD  *f_expand_cltbl (FIL* fp, UINT tblsz, FSIZE_t ofs);			/* Expand file and populate cluster table */
+DWORD  *f_alloc_cltbl (FIL* fp, UINT tblsz, FSIZE_t fsz);			/* Allocate file, contiguous if possible, and populate cluster table */
+DWORD   f_clst2sect (FIL* fp, DWORD clst);							/* Get first sector of a cluster */
 #endif
 FRESULT f_expand (FIL* fp, FSIZE_t fsz, BYTE opt);					/* Allocate a contiguous block to the file */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
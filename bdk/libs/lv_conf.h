@@ -283,7 +283,7 @@
 #define USE_LV_GAUGE    0
 
 /*Chart (dependencies: -)*/
-#define USE_LV_CHART    0
+#define USE_LV_CHART    1
 
 /*Table (dependencies: lv_label)*/
 #define USE_LV_TABLE    1
@@ -74,7 +74,11 @@
 
 // SDMMC DMA buffer. Used for unaligned DMA buffer address.
 #define SDMMC_ALT_DMA_BUFFER 0xE5000000
-#define  SDMMC_ALT_DMA_BUF_SZ   SZ_128M
+#define  SDMMC_ALT_DMA_BUF_SZ  (SZ_128M - SZ_64K)
+
+// SDMMC ADMA2 descriptor table. Used by background transfers.
+#define SDMMC_ADMA_DESC_ADDR 0xECFF0000
+#define  SDMMC_ADMA_DESC_SZ       SZ_64K
 
 // Nyx buffers. !Do not change!
 #define NYX_STORAGE_ADDR 0xED000000
@@ -2,7 +2,7 @@
  * eMMC BIS driver for Nintendo Switch
  *
  * Copyright (c) 2019-2020 shchmue
- * Copyright (c) 2019-2022 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -24,6 +24,7 @@
 #include <mem/heap.h>
 #include <sec/se.h>
 #include <storage/emmc.h>
+#include <storage/nx_emmc_bis.h>
 #include <storage/sd.h>
 #include <storage/sdmmc.h>
 #include <utils/types.h>
@@ -50,6 +51,21 @@ typedef struct _bis_cache_t
 	cluster_cache_t clusters[];
 } bis_cache_t;
 
+typedef struct _bis_part_t
+{
+	const char *name;
+	u8 ks_crypt; // Tweak key is in the next keyslot.
+} bis_part_t;
+
+static const bis_part_t bis_parts[NX_BIS_PART_MAX] = {
+	{ NULL,        0 },
+	{ "PRODINFO",  0 },
+	{ "PRODINFOF", 0 },
+	{ "SAFE",      2 },
+	{ "SYSTEM",    4 },
+	{ "USER",      4 }
+};
+
 static u8  ks_crypt = 0;
 static u8  ks_tweak = 0;
 static u32 emu_offset = 0;
@@ -292,6 +308,52 @@ int nx_emmc_bis_write(u32 sector, u32 count, void *buff)
 	return 0;
 }
 
+u32 nx_emmc_bis_part_id(const char *name)
+{
+	for (u32 i = NX_BIS_PRODINFO; i < NX_BIS_PART_MAX; i++)
+		if (!strcmp(name, bis_parts[i].name))
+			return i;
+
+	return NX_BIS_NONE;
+}
+
+const char *nx_emmc_bis_part_name(u32 id)
+{
+	return id < NX_BIS_PART_MAX ? bis_parts[id].name : NULL;
+}
+
+/*
+ * Encrypts or decrypts whole sectors of a BIS partition in place or to dst.
+ * For users that do the raw access themselves. BIS keys must be in place.
+ */
+int nx_emmc_bis_crypt(u32 id, int enc, u32 sector, u32 count, void *dst, void *src)
+{
+	u8  tweak[SE_KEY_128_SIZE] __attribute__((aligned(4)));
+	u8 *pdst = (u8 *)dst;
+	u8 *psrc = (u8 *)src;
+
+	if (id == NX_BIS_NONE || id >= NX_BIS_PART_MAX)
+		return 1;
+
+	u32 ks = bis_parts[id].ks_crypt;
+	while (count)
+	{
+		u32 sector_in_cluster = sector % BIS_CLUSTER_SECTORS;
+		u32 sct_cnt = MIN(count, BIS_CLUSTER_SECTORS - sector_in_cluster);
+
+		if (se_aes_crypt_xts_sec_nx(ks + 1, ks, enc, sector / BIS_CLUSTER_SECTORS, tweak, true, sector_in_cluster,
+			pdst, psrc, sct_cnt * EMMC_BLOCKSIZE))
+			return 1;
+
+		count  -= sct_cnt;
+		sector += sct_cnt;
+		pdst   += sct_cnt * EMMC_BLOCKSIZE;
+		psrc   += sct_cnt * EMMC_BLOCKSIZE;
+	}
+
+	return 0;
+}
+
 void nx_emmc_bis_init(emmc_part_t *part, bool enable_cache, u32 emummc_offset)
 {
 	system_part = part;
@@ -299,20 +361,11 @@ void nx_emmc_bis_init(emmc_part_t *part, bool enable_cache, u32 emummc_offset)
 
 	_nx_emmc_bis_cluster_cache_init(enable_cache);
 
-	if (!strcmp(part->name, "PRODINFO") || !strcmp(part->name, "PRODINFOF"))
-	{
-		ks_crypt = 0;
-		ks_tweak = 1;
-	}
-	else if (!strcmp(part->name, "SAFE"))
-	{
-		ks_crypt = 2;
-		ks_tweak = 3;
-	}
-	else if (!strcmp(part->name, "SYSTEM") || !strcmp(part->name, "USER"))
+	u32 id = nx_emmc_bis_part_id(part->name);
+	if (id != NX_BIS_NONE)
 	{
-		ks_crypt = 4;
-		ks_tweak = 5;
+		ks_crypt = bis_parts[id].ks_crypt;
+		ks_tweak = ks_crypt + 1;
 	}
 	else
 		system_part = NULL;
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2019 shchmue
- * Copyright (c) 2019 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -23,6 +23,17 @@
 
 #define NAND_PATROL_SECTOR   0xC20
 
+enum
+{
+	NX_BIS_NONE      = 0,
+	NX_BIS_PRODINFO  = 1,
+	NX_BIS_PRODINFOF = 2,
+	NX_BIS_SAFE      = 3,
+	NX_BIS_SYSTEM    = 4,
+	NX_BIS_USER      = 5,
+	NX_BIS_PART_MAX
+};
+
 typedef struct _nx_emmc_cal0_spk_t
 {
 	u16 unk0;
@@ -235,6 +246,9 @@ typedef struct _nx_emmc_cal0_t
 	u8   crc16_pad61[0xF];
 } __attribute__((packed)) nx_emmc_cal0_t;
 
+u32  nx_emmc_bis_part_id(const char *name);
+const char *nx_emmc_bis_part_name(u32 id);
+int  nx_emmc_bis_crypt(u32 id, int enc, u32 sector, u32 count, void *dst, void *src);
 int  nx_emmc_bis_read(u32 sector, u32 count, void *buff);
 int  nx_emmc_bis_write(u32 sector, u32 count, void *buff);
 void nx_emmc_bis_init(emmc_part_t *part, bool enable_cache, u32 emummc_offset);
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NX_EMMC_CZ_H
+#define NX_EMMC_CZ_H
+
+#include <utils/types.h>
+
+/*
+ * Compressed eMMC backup container.
+ *
+ * <name>.nxcz     Header followed by the chunk index.
+ * <name>.nxcz.XX  Chunk data. A new file is started when a chunk does not fit
+ *                 the FAT32 file size limit. Chunks never span files.
+ *
+ * Each chunk holds chunk_size bytes of the image (last one can be smaller) and
+ * is stored either raw or as a single LZ4 block. All-zero chunks are not stored.
+ * The hash is always over the uncompressed data, so any chunk can be restored
+ * and checked on its own.
+ *
+ * Incremental backups form a chain. Level N is named <name>.dNN.nxcz and only
+ * stores chunks that changed since level N - 1. Unchanged chunks are marked as
+ * parent and are read from the previous level. The index still has the hash of
+ * every chunk, so the next level only needs the last index to find changes.
+ * A full backup gets a new random chain id and its levels keep it. Levels left
+ * on SD from an older full backup have another id. They are stale and ignored.
+ * Version 1 has no chain id and its index starts at NX_EMMC_CZ_HDR_V1_SIZE.
+ *
+ * Chunk store backups keep their chunks in a content addressed store that is
+ * shared by all consoles. Each chunk is saved once as <store>/XX/<hash>, where
+ * XX are the first 2 hex digits of its SHA-256. It is raw if its size is the
+ * chunk length, otherwise a single LZ4 block. The index of each backup is then
+ * its manifest. Chunks that already exist in the store are not written again.
+ * Objects are written to <hash>.tmp and renamed when complete.
+ */
+
+#define NX_EMMC_CZ_MAGIC      0x5A43584E // "NXCZ".
+#define NX_EMMC_CZ_VERSION    2
+#define NX_EMMC_CZ_CHUNK_SIZE SZ_4M
+#define NX_EMMC_CZ_HASH_SIZE  32 // SHA-256.
+#define NX_EMMC_CZ_EXT        ".nxcz"
+#define NX_EMMC_CZ_LEVEL_MAX  99
+#define NX_EMMC_CZ_STORE_DIR  "backup/store" // On SD.
+
+#define NX_EMMC_CZ_PART_SIZE_MAX 0xFFFFFFFF
+#define NX_EMMC_CZ_HDR_V1_SIZE   0x60
+
+enum
+{
+	NX_EMMC_CZ_CHUNK_RAW    = 0,
+	NX_EMMC_CZ_CHUNK_LZ4    = 1,
+	NX_EMMC_CZ_CHUNK_ZERO   = 2, // Not stored. Size and offset are 0.
+	NX_EMMC_CZ_CHUNK_PARENT = 3, // Unchanged. Stored in the previous level.
+	NX_EMMC_CZ_CHUNK_STORE  = 4  // Stored in the chunk store. Part and offset are 0.
+};
+
+typedef struct _nx_emmc_cz_hdr_t
+{
+	u32 magic;
+	u32 version;
+	u32 chunk_size;
+	u32 chunk_cnt;
+	u64 image_size;
+	u32 part_cnt;   // Data files.
+	u32 level;      // Incremental level. 0 for a full backup.
+	u8  idx_hash[NX_EMMC_CZ_HASH_SIZE];    // SHA-256 of the chunk index.
+	u8  parent_hash[NX_EMMC_CZ_HASH_SIZE]; // idx_hash of the previous level.
+	u32 chain_id;   // Set by the full backup. 0 in version 1.
+	u32 rsvd[3];
+} __attribute__((packed)) nx_emmc_cz_hdr_t;
+
+typedef struct _nx_emmc_cz_chunk_t
+{
+	u8  type;
+	u8  part;   // Data file.
+	u16 rsvd;
+	u32 size;   // Stored size.
+	u64 offset; // Offset in data file.
+	u8  hash[NX_EMMC_CZ_HASH_SIZE]; // SHA-256 of uncompressed data.
+} __attribute__((packed)) nx_emmc_cz_chunk_t;
+
+#endif
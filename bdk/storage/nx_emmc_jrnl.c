@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "nx_emmc_jrnl.h"
+#include <sec/se.h>
+
+#define JRNL_REC_HASHED offsetof(nx_emmc_jrnl_rec_t, rec_hash)
+
+static bool _jrnl_rec_valid(const nx_emmc_jrnl_rec_t *rec)
+{
+	u8 hash[SE_SHA_256_SIZE];
+
+	if (rec->magic != NX_EMMC_JRNL_MAGIC)
+		return false;
+
+	se_sha_hash_256_oneshot(hash, rec, JRNL_REC_HASHED);
+
+	return !memcmp(hash, rec->rec_hash, SE_SHA_256_SIZE);
+}
+
+static int _jrnl_write_slot(nx_emmc_jrnl_t *jrnl, u32 slot, const nx_emmc_jrnl_rec_t *rec)
+{
+	UINT bw;
+	u8 sector[NX_EMMC_JRNL_SLOT_SZ] __attribute__((aligned(8))) = {0};
+
+	if (rec)
+		memcpy(sector, rec, sizeof(nx_emmc_jrnl_rec_t));
+
+	int res = f_lseek(&jrnl->fp, slot * NX_EMMC_JRNL_SLOT_SZ);
+	if (!res)
+		res = f_write(&jrnl->fp, sector, NX_EMMC_JRNL_SLOT_SZ, &bw);
+	if (!res && bw != NX_EMMC_JRNL_SLOT_SZ)
+		res = FR_DENIED;
+	if (!res)
+		res = f_sync(&jrnl->fp);
+
+	return res;
+}
+
+// Returns 0 if a valid record of the same backup was found. Journal is then kept open.
+int nx_emmc_jrnl_load(nx_emmc_jrnl_t *jrnl, const char *path, u32 lba_start, u32 sct_total)
+{
+	UINT br;
+	nx_emmc_jrnl_rec_t rec;
+
+	memset(jrnl, 0, sizeof(nx_emmc_jrnl_t));
+	strncpy(jrnl->path, path, NX_EMMC_JRNL_PATH_SZ - 1);
+
+	int res = f_open(&jrnl->fp, jrnl->path, FA_READ | FA_WRITE | FA_OPEN_EXISTING);
+	if (res)
+		return res;
+	jrnl->opened = true;
+
+	// Use the newest valid slot.
+	for (u32 slot = 0; slot < 2; slot++)
+	{
+		if (f_lseek(&jrnl->fp, slot * NX_EMMC_JRNL_SLOT_SZ) ||
+			f_read(&jrnl->fp, &rec, sizeof(nx_emmc_jrnl_rec_t), &br) || br != sizeof(nx_emmc_jrnl_rec_t))
+			continue;
+
+		if (_jrnl_rec_valid(&rec) && rec.seq > jrnl->rec.seq)
+			memcpy(&jrnl->rec, &rec, sizeof(nx_emmc_jrnl_rec_t));
+	}
+
+	if (!jrnl->rec.seq || jrnl->rec.lba_start != lba_start || jrnl->rec.sct_total != sct_total ||
+		jrnl->rec.sct_done > sct_total)
+	{
+		nx_emmc_jrnl_close(jrnl);
+
+		return FR_INT_ERR;
+	}
+
+	return FR_OK;
+}
+
+int nx_emmc_jrnl_create(nx_emmc_jrnl_t *jrnl, const char *path, u32 lba_start, u32 sct_total, u32 split_size, u32 flags)
+{
+	memset(jrnl, 0, sizeof(nx_emmc_jrnl_t));
+	strncpy(jrnl->path, path, NX_EMMC_JRNL_PATH_SZ - 1);
+
+	int res = f_open(&jrnl->fp, jrnl->path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+	if (res)
+		return res;
+	jrnl->opened = true;
+
+	jrnl->rec.magic      = NX_EMMC_JRNL_MAGIC;
+	jrnl->rec.lba_start  = lba_start;
+	jrnl->rec.sct_total  = sct_total;
+	jrnl->rec.split_size = split_size;
+	jrnl->rec.flags      = flags | NX_EMMC_JRNL_RUN_HASH;
+
+	// Allocate both slots before any data is written.
+	res = _jrnl_write_slot(jrnl, 1, NULL);
+	if (!res)
+		res = nx_emmc_jrnl_commit(jrnl, NULL, 0, 0, 0);
+
+	return res;
+}
+
+// Checks that the last durable chunk in the data file is the one recorded.
+int nx_emmc_jrnl_check(nx_emmc_jrnl_t *jrnl, FIL *data, void *buf, u32 size)
+{
+	UINT br;
+	u8 hash[SE_SHA_256_SIZE];
+
+	if (!jrnl->rec.part_off)
+		return FR_OK;
+
+	if (size > jrnl->rec.part_off || f_size(data) < jrnl->rec.part_off)
+		return FR_INT_ERR;
+
+	int res = f_lseek(data, jrnl->rec.part_off - size);
+	if (!res)
+		res = f_read(data, buf, size, &br);
+	if (!res && br != size)
+		res = FR_INT_ERR;
+	if (res)
+		return res;
+
+	se_sha_hash_256_oneshot(hash, buf, size);
+
+	return memcmp(hash, jrnl->rec.last_hash, SE_SHA_256_SIZE) ? FR_INT_ERR : FR_OK;
+}
+
+// Keeps the hash of the last written chunk and adds it to the running hash.
+void nx_emmc_jrnl_chunk(nx_emmc_jrnl_t *jrnl, const void *chunk_hash)
+{
+	u8 chain[SE_SHA_256_SIZE * 2];
+
+	memcpy(chain, jrnl->rec.run_hash, SE_SHA_256_SIZE);
+	memcpy(chain + SE_SHA_256_SIZE, chunk_hash, SE_SHA_256_SIZE);
+	se_sha_hash_256_oneshot(jrnl->rec.run_hash, chain, sizeof(chain));
+
+	memcpy(jrnl->rec.last_hash, chunk_hash, SE_SHA_256_SIZE);
+}
+
+// Syncs the data file if any and then records the new durable position.
+int nx_emmc_jrnl_commit(nx_emmc_jrnl_t *jrnl, FIL *data, u32 sct_done, u32 part_idx, u64 part_off)
+{
+	if (data)
+	{
+		int res = f_sync(data);
+		if (res)
+			return res;
+	}
+
+	// A new part starts a new running hash.
+	if (!part_off)
+		memset(jrnl->rec.run_hash, 0, SE_SHA_256_SIZE);
+
+	jrnl->rec.seq++;
+	jrnl->rec.sct_done = sct_done;
+	jrnl->rec.part_idx = part_idx;
+	jrnl->rec.part_off = part_off;
+	se_sha_hash_256_oneshot(jrnl->rec.rec_hash, &jrnl->rec, JRNL_REC_HASHED);
+
+	return _jrnl_write_slot(jrnl, jrnl->rec.seq & 1, &jrnl->rec);
+}
+
+void nx_emmc_jrnl_close(nx_emmc_jrnl_t *jrnl)
+{
+	if (jrnl->opened)
+		f_close(&jrnl->fp);
+	jrnl->opened = false;
+}
+
+void nx_emmc_jrnl_remove(nx_emmc_jrnl_t *jrnl)
+{
+	nx_emmc_jrnl_close(jrnl);
+	f_unlink(jrnl->path);
+}
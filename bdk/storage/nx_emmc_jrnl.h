@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NX_EMMC_JRNL_H
+#define NX_EMMC_JRNL_H
+
+#include <libs/fatfs/ff.h>
+#include <utils/types.h>
+
+/*
+ * Backup journal. Lets an interrupted raw backup continue from the last durable chunk.
+ *
+ * The file has two record slots that are written alternately. A record is only
+ * written after the data it describes is synced, so a torn write always leaves
+ * the previous record valid.
+ *
+ * Each record also carries the running hash of the part in progress, so that it
+ * continues across resume. It is a chain over its chunks, starting from zero:
+ * run_hash = SHA256(run_hash || SHA256(chunk)). Chunks are the 4MB writes from
+ * the start of the part, so it matches the chain of a verification manifest.
+ */
+
+#define NX_EMMC_JRNL_MAGIC    0x4C4E524A // "JRNL".
+#define NX_EMMC_JRNL_EXT      ".jnl"
+#define NX_EMMC_JRNL_SLOT_SZ  512
+#define NX_EMMC_JRNL_INTERVAL SZ_128M // Data between records.
+#define NX_EMMC_JRNL_PATH_SZ  160
+
+#define NX_EMMC_JRNL_PARTIAL  BIT(0) // Parts are moved off the SD card while dumping.
+#define NX_EMMC_JRNL_RUN_HASH BIT(1) // run_hash is kept. Not set by older versions.
+
+typedef struct _nx_emmc_jrnl_rec_t
+{
+	u32 magic;
+	u32 seq;
+	u32 lba_start;  // First sector of the backup.
+	u32 sct_total;  // Sectors of the backup.
+	u32 split_size; // Part size in bytes. 0 if single file.
+	u32 flags;
+	u32 sct_done;   // Durable sectors.
+	u32 part_idx;   // Part in progress.
+	u64 part_off;   // Durable bytes in that part.
+	u8  last_hash[32]; // SHA-256 of the last chunk.
+	u8  run_hash[32];  // Running hash of the part in progress.
+	u8  rec_hash[32];  // SHA-256 of the record up to here.
+} __attribute__((packed)) nx_emmc_jrnl_rec_t;
+
+typedef struct _nx_emmc_jrnl_t
+{
+	FIL fp;
+	nx_emmc_jrnl_rec_t rec;
+	bool opened;
+	char path[NX_EMMC_JRNL_PATH_SZ];
+} nx_emmc_jrnl_t;
+
+int  nx_emmc_jrnl_load(nx_emmc_jrnl_t *jrnl, const char *path, u32 lba_start, u32 sct_total);
+int  nx_emmc_jrnl_create(nx_emmc_jrnl_t *jrnl, const char *path, u32 lba_start, u32 sct_total, u32 split_size, u32 flags);
+int  nx_emmc_jrnl_check(nx_emmc_jrnl_t *jrnl, FIL *data, void *buf, u32 size);
+void nx_emmc_jrnl_chunk(nx_emmc_jrnl_t *jrnl, const void *chunk_hash);
+int  nx_emmc_jrnl_commit(nx_emmc_jrnl_t *jrnl, FIL *data, u32 sct_done, u32 part_idx, u64 part_off);
+void nx_emmc_jrnl_close(nx_emmc_jrnl_t *jrnl);
+void nx_emmc_jrnl_remove(nx_emmc_jrnl_t *jrnl);
+
+#endif
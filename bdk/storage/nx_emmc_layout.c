@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "nx_emmc_layout.h"
+
+#define LAYOUT_RUNS_OFF offsetof(nx_emmc_layout_t, runs)
+
+void nx_emmc_layout_init(nx_emmc_layout_t *lt, u32 part_sectors)
+{
+	memset(&lt->hdr, 0, sizeof(nx_emmc_layout_hdr_t));
+	lt->hdr.magic        = NX_EMMC_LAYOUT_MAGIC;
+	lt->hdr.version      = NX_EMMC_LAYOUT_VERSION;
+	lt->hdr.part_sectors = part_sectors;
+}
+
+void nx_emmc_layout_file_path(char *path, const char *emmc_path, u32 file_idx)
+{
+	strcpy(path, emmc_path);
+
+	switch (file_idx)
+	{
+	case 0:
+		strcat(path, "/BOOT0");
+		break;
+	case 1:
+		strcat(path, "/BOOT1");
+		break;
+	default:
+		file_idx -= 2;
+		u32 len = strlen(path);
+		path[len]     = '/';
+		path[len + 1] = '0' + (file_idx / 10);
+		path[len + 2] = '0' + (file_idx % 10);
+		path[len + 3] = 0;
+		break;
+	}
+}
+
+#if FF_FASTFS
+// Adds the next file. Its cluster table must be created and cover the whole file.
+int nx_emmc_layout_add(nx_emmc_layout_t *lt, FIL *fp)
+{
+	nx_emmc_layout_hdr_t *hdr = &lt->hdr;
+
+	if (!fp->cltbl || hdr->file_cnt >= NX_EMMC_LAYOUT_FILES_MAX)
+		return FR_INVALID_PARAMETER;
+
+	nx_emmc_layout_file_t *file = &lt->files[hdr->file_cnt];
+	file->sclust  = fp->obj.sclust;
+	file->sectors = f_size(fp) >> 9;
+	file->run_idx = hdr->run_cnt;
+	file->run_cnt = 0;
+
+	u32 csize = fp->obj.fs->csize;
+	u32 left = file->sectors;
+	DWORD *tbl = fp->cltbl + 1;
+
+	// Table items are cluster count and start cluster of each fragment.
+	while (tbl[0] && left)
+	{
+		u32 count = MIN((u64)tbl[0] * csize, left);
+		u32 sector = f_clst2sect(fp, tbl[1]);
+		if (!sector)
+			return FR_INT_ERR;
+
+		// Merge with the previous run if adjacent.
+		nx_emmc_layout_run_t *run = file->run_cnt ? &lt->runs[hdr->run_cnt - 1] : NULL;
+		if (run && (run->sector + run->count) == sector)
+			run->count += count;
+		else
+		{
+			if (hdr->run_cnt >= NX_EMMC_LAYOUT_RUNS_MAX)
+				return FR_NOT_ENOUGH_CORE;
+
+			run = &lt->runs[hdr->run_cnt];
+			run->sector = sector;
+			run->count  = count;
+			file->run_cnt++;
+			hdr->run_cnt++;
+		}
+
+		left -= count;
+		tbl += 2;
+	}
+
+	if (left)
+		return FR_INT_ERR;
+
+	hdr->file_cnt++;
+
+	return FR_OK;
+}
+
+/*
+ * Builds the layout from the cluster tables of the files in emmc_path.
+ * Used for file based emuMMC that has no valid saved layout.
+ */
+int nx_emmc_layout_build(nx_emmc_layout_t *lt, const char *emmc_path)
+{
+	FIL fp;
+	char path[NX_EMMC_LAYOUT_PATH_SZ];
+	int res = FR_OK;
+
+	nx_emmc_layout_init(lt, 0);
+
+	for (u32 i = 0; i < NX_EMMC_LAYOUT_FILES_MAX; i++)
+	{
+		nx_emmc_layout_file_path(path, emmc_path, i);
+
+		res = f_open(&fp, path, FA_READ);
+		if (res)
+		{
+			// GPP parts end at the first missing one.
+			if (i > 2 && res == FR_NO_FILE)
+				res = FR_OK;
+			break;
+		}
+
+		if (i == 2)
+			lt->hdr.part_sectors = f_size(&fp) >> 9;
+
+		DWORD *clmt = f_expand_cltbl(&fp, SZ_4M, 0);
+		res = clmt ? nx_emmc_layout_add(lt, &fp) : FR_NOT_ENOUGH_CORE;
+
+		f_close(&fp);
+		ff_memfree(clmt);
+
+		if (res)
+			break;
+	}
+
+	// All GPP parts but the last have the same size.
+	for (u32 i = 3; !res && i < lt->hdr.file_cnt - 1; i++)
+		if (lt->files[i].sectors != lt->hdr.part_sectors)
+			res = FR_INT_ERR;
+
+	if (!res && !lt->hdr.part_sectors)
+		res = FR_INT_ERR;
+
+	if (res)
+		lt->hdr.magic = 0;
+
+	return res;
+}
+#endif
+
+int nx_emmc_layout_save(nx_emmc_layout_t *lt, const char *path)
+{
+	FIL fp;
+	UINT bw;
+	u32 size = LAYOUT_RUNS_OFF + lt->hdr.run_cnt * sizeof(nx_emmc_layout_run_t);
+
+	int res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res)
+		return res;
+
+	res = f_write(&fp, lt, size, &bw);
+	if (!res && bw != size)
+		res = FR_DENIED;
+
+	res |= f_close(&fp);
+
+	return res;
+}
+
+// Follows the FAT chain of the file once and checks that every cluster is where its run says.
+static int _layout_chain_check(nx_emmc_layout_t *lt, nx_emmc_layout_file_t *file, FIL *fp)
+{
+	FATFS *fs = fp->obj.fs;
+	u32 csize = fs->csize;
+	u32 file_sct = 0;
+
+	nx_emmc_layout_run_t *run = &lt->runs[file->run_idx];
+	for (u32 i = 0; i < file->run_cnt; i++, run++)
+	{
+		// Runs start on a cluster.
+		if (file_sct & (csize - 1))
+			return 1;
+
+		for (u32 sct = 0; sct < run->count; sct += csize)
+		{
+			// Sector aligned forward seeks only follow the chain and read no data.
+			if (f_lseek(fp, (u64)(file_sct + sct + 1) << 9) || fp->clust < 2)
+				return 1;
+
+			if ((fs->database + (fp->clust - 2) * csize) != (run->sector + sct))
+				return 1;
+		}
+
+		file_sct += run->count;
+	}
+
+	return 0;
+}
+
+static int _layout_check(nx_emmc_layout_t *lt, u32 size, const char *emmc_path)
+{
+	FIL fp;
+	char path[NX_EMMC_LAYOUT_PATH_SZ];
+	nx_emmc_layout_hdr_t *hdr = &lt->hdr;
+
+	if (size < LAYOUT_RUNS_OFF || hdr->magic != NX_EMMC_LAYOUT_MAGIC || hdr->version != NX_EMMC_LAYOUT_VERSION ||
+		hdr->file_cnt < 3 || hdr->file_cnt > NX_EMMC_LAYOUT_FILES_MAX || hdr->run_cnt > NX_EMMC_LAYOUT_RUNS_MAX ||
+		size != LAYOUT_RUNS_OFF + hdr->run_cnt * sizeof(nx_emmc_layout_run_t) || !hdr->part_sectors)
+		return 1;
+
+	for (u32 i = 0; i < hdr->file_cnt; i++)
+	{
+		nx_emmc_layout_file_t *file = &lt->files[i];
+
+		if (file->run_idx > hdr->run_cnt || file->run_cnt > (hdr->run_cnt - file->run_idx))
+			return 1;
+
+		// All GPP parts but the last have the same size.
+		if (i >= 2 && i < (hdr->file_cnt - 1) && file->sectors != hdr->part_sectors)
+			return 1;
+
+		u32 sectors = 0;
+		for (u32 j = 0; j < file->run_cnt; j++)
+			sectors += lt->runs[file->run_idx + j].count;
+		if (sectors != file->sectors)
+			return 1;
+
+		// Check that the file is still the one described.
+		nx_emmc_layout_file_path(path, emmc_path, i);
+		if (f_open(&fp, path, FA_READ))
+			return 1;
+
+		bool same = fp.obj.sclust == file->sclust && f_size(&fp) == ((u64)file->sectors << 9) &&
+					!_layout_chain_check(lt, file, &fp);
+		f_close(&fp);
+
+		if (!same)
+			return 1;
+	}
+
+	return 0;
+}
+
+// Returns 0 if the layout is valid and matches the files in emmc_path.
+int nx_emmc_layout_load(nx_emmc_layout_t *lt, const char *path, const char *emmc_path)
+{
+	FIL fp;
+	UINT br = 0;
+
+	memset(&lt->hdr, 0, sizeof(nx_emmc_layout_hdr_t));
+
+	int res = f_open(&fp, path, FA_READ);
+	if (res)
+		return res;
+
+	res = f_read(&fp, lt, sizeof(nx_emmc_layout_t), &br);
+	f_close(&fp);
+
+	if (!res && _layout_check(lt, br, emmc_path))
+		res = FR_INT_ERR;
+
+	if (res)
+		lt->hdr.magic = 0;
+
+	return res;
+}
+
+/*
+ * Maps a sector of an eMMC partition (0: GPP, 1: BOOT0, 2: BOOT1) to an SD sector.
+ * Returns how many sectors are contiguous from there or 0 if out of range.
+ */
+u32 nx_emmc_layout_map(nx_emmc_layout_t *lt, u32 mmc_part, u32 sector, u32 *sd_sector)
+{
+	u32 file_idx;
+
+	switch (mmc_part)
+	{
+	case 0:
+		file_idx = 2 + sector / lt->hdr.part_sectors;
+		sector %= lt->hdr.part_sectors;
+		break;
+	case 1:
+	case 2:
+		file_idx = mmc_part - 1;
+		break;
+	default:
+		return 0;
+	}
+
+	if (file_idx >= lt->hdr.file_cnt)
+		return 0;
+
+	nx_emmc_layout_file_t *file = &lt->files[file_idx];
+	nx_emmc_layout_run_t *run = &lt->runs[file->run_idx];
+	for (u32 i = 0; i < file->run_cnt; i++, run++)
+	{
+		if (sector < run->count)
+		{
+			*sd_sector = run->sector + sector;
+			return run->count - sector;
+		}
+		sector -= run->count;
+	}
+
+	return 0;
+}
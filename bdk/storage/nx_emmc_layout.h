@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NX_EMMC_LAYOUT_H
+#define NX_EMMC_LAYOUT_H
+
+#include <libs/fatfs/ff.h>
+#include <utils/types.h>
+
+/*
+ * File based emuMMC layout.
+ *
+ * Lists the SD sector runs of every emuMMC file, so that the files can be
+ * accessed as raw sectors. Stored as <emuMMC>/file_layout next to file_based.
+ * Files are BOOT0, BOOT1 and then the GPP parts in order.
+ *
+ * The start cluster and size of each file are kept and checked on load, and the
+ * FAT chain of each file is walked to check every run, so a layout is ignored if
+ * the files were copied, recreated or moved. Without a valid one, it can be
+ * built again from the cluster tables of the files.
+ */
+
+#define NX_EMMC_LAYOUT_MAGIC     0x544C4D45 // "EMLT".
+#define NX_EMMC_LAYOUT_VERSION   1
+#define NX_EMMC_LAYOUT_NAME      "file_layout"
+#define NX_EMMC_LAYOUT_FILES_MAX 34   // BOOT0, BOOT1 and up to 32 GPP parts.
+#define NX_EMMC_LAYOUT_RUNS_MAX  4096 // Fragments of all files.
+#define NX_EMMC_LAYOUT_PATH_SZ   160
+
+typedef struct _nx_emmc_layout_hdr_t
+{
+	u32 magic;
+	u32 version;
+	u32 file_cnt;
+	u32 run_cnt;
+	u32 part_sectors; // Sectors per GPP part.
+	u32 rsvd[3];
+} nx_emmc_layout_hdr_t;
+
+typedef struct _nx_emmc_layout_file_t
+{
+	u32 sclust;  // Start cluster.
+	u32 sectors;
+	u32 run_idx; // First run.
+	u32 run_cnt;
+} nx_emmc_layout_file_t;
+
+typedef struct _nx_emmc_layout_run_t
+{
+	u32 sector; // SD sector.
+	u32 count;
+} nx_emmc_layout_run_t;
+
+// Runs are only saved up to run_cnt.
+typedef struct _nx_emmc_layout_t
+{
+	nx_emmc_layout_hdr_t  hdr;
+	nx_emmc_layout_file_t files[NX_EMMC_LAYOUT_FILES_MAX];
+	nx_emmc_layout_run_t  runs[NX_EMMC_LAYOUT_RUNS_MAX];
+} nx_emmc_layout_t;
+
+void nx_emmc_layout_init(nx_emmc_layout_t *lt, u32 part_sectors);
+void nx_emmc_layout_file_path(char *path, const char *emmc_path, u32 file_idx);
+#if FF_FASTFS
+int  nx_emmc_layout_add(nx_emmc_layout_t *lt, FIL *fp);
+int  nx_emmc_layout_build(nx_emmc_layout_t *lt, const char *emmc_path);
+#endif
+int  nx_emmc_layout_save(nx_emmc_layout_t *lt, const char *path);
+int  nx_emmc_layout_load(nx_emmc_layout_t *lt, const char *path, const char *emmc_path);
+u32  nx_emmc_layout_map(nx_emmc_layout_t *lt, u32 mmc_part, u32 sector, u32 *sd_sector);
+
+#endif
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2023 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -246,6 +246,93 @@ bool sd_is_gpt()
 	return sd_fs.part_type;
 }
 
+static int _sd_file_read_direct(FIL *fp, void *dst, u32 size)
+{
+#if FF_FASTFS && FF_USE_FASTSEEK
+	// Read sector aligned part with merged multi-cluster reads. Needs a DMA capable destination.
+	u32 size_aligned = ALIGN_DOWN(size, SD_BLOCKSIZE);
+	if (size_aligned > SD_BLOCKSIZE && !((u32)dst % SDMMC_ADMA_ADDR_ALIGN))
+	{
+		DWORD *clmt = (DWORD *)malloc(SZ_4K);
+		clmt[0] = SZ_4K / sizeof(DWORD);
+		fp->cltbl = clmt;
+
+		int res = f_lseek(fp, CREATE_LINKMAP);
+		if (!res)
+			res = f_read_fast(fp, dst, size_aligned);
+
+		if (!res)
+		{
+			// Read the remaining partial sector via the cache.
+			if (size > size_aligned)
+				res = f_read(fp, (u8 *)dst + size_aligned, size - size_aligned, NULL);
+
+			fp->cltbl = NULL;
+			free(clmt);
+
+			return res;
+		}
+
+		// Fragmented past table size. Fallback to normal read.
+		fp->cltbl = NULL;
+		free(clmt);
+		f_lseek(fp, 0);
+	}
+#endif
+
+	return f_read(fp, dst, size, NULL);
+}
+
+u32 sd_file_read_into(const char *path, void *dst, u32 max)
+{
+	FIL fp;
+	if (!sd_get_card_mounted())
+		return 0;
+
+	if (f_open(&fp, path, FA_READ) != FR_OK)
+		return 0;
+
+	u32 size = f_size(&fp);
+	if (!size || size > max || _sd_file_read_direct(&fp, dst, size) != FR_OK)
+		size = 0;
+
+	f_close(&fp);
+
+	return size;
+}
+
+int sd_file_read_chunked(const char *path, void *buf, u32 chunk_size, sd_file_chunk_cb_t cb, void *priv)
+{
+	FIL fp;
+	UINT br;
+	int res = 0;
+
+	if (!sd_get_card_mounted())
+		return 1;
+
+	if (f_open(&fp, path, FA_READ) != FR_OK)
+		return 1;
+
+	u32 size = f_size(&fp);
+	for (u32 offset = 0; offset < size; offset += chunk_size)
+	{
+		u32 len = MIN(size - offset, chunk_size);
+		if (f_read(&fp, buf, len, &br) != FR_OK || br != len)
+		{
+			res = 1;
+			break;
+		}
+
+		res = cb(buf, len, offset, priv);
+		if (res)
+			break;
+	}
+
+	f_close(&fp);
+
+	return res;
+}
+
 void *sd_file_read(const char *path, u32 *fsize)
 {
 	FIL fp;
@@ -261,7 +348,7 @@ void *sd_file_read(const char *path, u32 *fsize)
 
 	void *buf = malloc(size);
 
-	if (f_read(&fp, buf, size, NULL) != FR_OK)
+	if (_sd_file_read_direct(&fp, buf, size) != FR_OK)
 	{
 		free(buf);
 		f_close(&fp);
@@ -44,6 +44,9 @@ enum
 	SD_ERROR_RW_RETRY  = 2
 };
 
+// Returns non zero to stop streaming.
+typedef int (*sd_file_chunk_cb_t)(void *buf, u32 size, u32 offset, void *priv);
+
 extern sdmmc_t sd_sdmmc;
 extern sdmmc_storage_t sd_storage;
 extern FATFS sd_fs;
@@ -61,6 +64,8 @@ void sd_unmount();
 void sd_end();
 bool sd_is_gpt();
 void *sd_file_read(const char *path, u32 *fsize);
+u32  sd_file_read_into(const char *path, void *dst, u32 max);
+int  sd_file_read_chunked(const char *path, void *buf, u32 chunk_size, sd_file_chunk_cb_t cb, void *priv);
 int  sd_save_to_file(const void *buf, u32 size, const char *filename);
 
 #endif
\ No newline at end of file
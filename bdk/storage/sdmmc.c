@@ -397,6 +397,75 @@ int sdmmc_storage_write(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, v
 	return _sdmmc_storage_readwrite(storage, sector, num_sectors, tmp_buf, 1);
 }
 
+static int _sdmmc_storage_readwrite_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf, u32 is_write)
+{
+	u32 tmp = 0;
+	sdmmc_cmd_t cmdbuf;
+	sdmmc_req_t reqbuf;
+
+	// Exit if not initialized.
+	if (!storage->initialized)
+		return 1;
+
+	// Check if out of bounds or not a single DMA run.
+	if (((u64)sector + num_sectors) > storage->sec_cnt || !num_sectors || num_sectors > SDMMC_AMAX_BLOCKNUM)
+		return 1;
+
+	// No bounce buffer in async mode.
+	if (!mc_client_has_access(buf) || ((u32)buf % SDMMC_ADMA_ADDR_ALIGN))
+		return 1;
+
+	// If SDSC convert block address to byte address.
+	if (!storage->has_sector_access)
+		sector <<= 9;
+
+	sdmmc_init_cmd(&cmdbuf, is_write ? MMC_WRITE_MULTIPLE_BLOCK : MMC_READ_MULTIPLE_BLOCK, sector, SDMMC_RSP_TYPE_1, 0);
+
+	reqbuf.buf              = buf;
+	reqbuf.num_sectors      = num_sectors;
+	reqbuf.blksize          = SDMMC_DAT_BLOCKSIZE;
+	reqbuf.is_write         = is_write;
+	reqbuf.is_multi_block   = 1;
+	reqbuf.is_auto_stop_trn = 1;
+
+	if (sdmmc_execute_cmd_async(storage->sdmmc, &cmdbuf, &reqbuf))
+	{
+		sdmmc_stop_transmission(storage->sdmmc, &tmp);
+		_sdmmc_storage_get_status(storage, &tmp, 0);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+int sdmmc_storage_read_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _sdmmc_storage_readwrite_async(storage, sector, num_sectors, buf, 0);
+}
+
+int sdmmc_storage_write_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _sdmmc_storage_readwrite_async(storage, sector, num_sectors, buf, 1);
+}
+
+int sdmmc_storage_async_end(sdmmc_storage_t *storage)
+{
+	u32 tmp = 0;
+
+	if (sdmmc_execute_cmd_async_end(storage->sdmmc, NULL))
+	{
+		sdmmc_stop_transmission(storage->sdmmc, &tmp);
+		_sdmmc_storage_get_status(storage, &tmp, 0);
+
+		return 1;
+	}
+
+	sdmmc_get_cached_rsp(storage->sdmmc, &tmp, SDMMC_RSP_TYPE_1);
+
+	return _sdmmc_storage_check_card_status(tmp);
+}
+
 /*
 * MMC specific functions.
 */
@@ -528,6 +597,10 @@ static void _mmc_storage_parse_ext_csd(sdmmc_storage_t *storage)
 	storage->ext_csd.rpmb_mult    = ext_csd[EXT_CSD_RPMB_MULT];
 	storage->ext_csd.bkops        = ext_csd[EXT_CSD_BKOPS_SUPPORT];
 	storage->ext_csd.bkops_en     = ext_csd[EXT_CSD_BKOPS_EN];
+	storage->ext_csd.sec_feature  = ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT];
+	storage->ext_csd.trim_mult    = ext_csd[EXT_CSD_TRIM_MULT];
+	storage->ext_csd.erase_grp    = ext_csd[EXT_CSD_HC_ERASE_GRP_SIZE];
+	storage->ext_csd.erased_val   = ext_csd[EXT_CSD_ERASED_MEM_CONT];
 
 	storage->ext_csd.pre_eol_info   = ext_csd[EXT_CSD_PRE_EOL_INFO];
 	storage->ext_csd.dev_life_est_a = ext_csd[EXT_CSD_DEVICE_LIFE_TIME_EST_TYP_A];
@@ -821,6 +894,82 @@ int sdmmc_storage_set_mmc_partition(sdmmc_storage_t *storage, u32 partition)
 	return 0;
 }
 
+bool sdmmc_storage_can_discard(sdmmc_storage_t *storage)
+{
+	// eMMC trim.
+	if (storage->sdmmc->id == SDMMC_4)
+		return (storage->ext_csd.sec_feature & EXT_CSD_SEC_GB_CL_EN) && !storage->ext_csd.erased_val;
+
+	// SD erase.
+	if (storage->sdmmc->id == SDMMC_1)
+		return (storage->csd.cmdclass & CCC_ERASE) && !storage->scr.erased_val;
+
+	return false;
+}
+
+static u32 _sd_storage_erase_timeout(sdmmc_storage_t *storage, u32 num_sectors)
+{
+	u32 au_sct = MAX(sd_storage_get_ssr_au(storage), 16) * 2;
+	u32 aus = num_sectors / au_sct + 2;
+
+	// Use the SSR erase timing if reported, otherwise 250ms per AU.
+	if (storage->ssr.erase_size && storage->ssr.erase_timeout)
+		return storage->ssr.erase_timeout * 1000 * aus / storage->ssr.erase_size + storage->ssr.erase_offset * 1000;
+
+	return 250 * aus;
+}
+
+/*
+ * Trims the range on eMMC or erases it on SD.
+ * Only done if discarded sectors read back as zeroes.
+ * Returns 1 if not supported, so the caller can write zeroes instead.
+ */
+int sdmmc_storage_discard(sdmmc_storage_t *storage, u32 sector, u32 num_sectors)
+{
+	if (!num_sectors || !sdmmc_storage_can_discard(storage))
+		return 1;
+
+	bool is_mmc = storage->sdmmc->id == SDMMC_4;
+
+	u32 sct_end = sector + num_sectors - 1;
+	if (!storage->has_sector_access)
+	{
+		sector  <<= 9;
+		sct_end <<= 9;
+	}
+
+	if (_sdmmc_storage_execute_cmd_type1(storage, is_mmc ? MMC_ERASE_GROUP_START : SD_ERASE_WR_BLK_START, sector, 0, R1_STATE_TRAN))
+		return 1;
+
+	if (_sdmmc_storage_execute_cmd_type1(storage, is_mmc ? MMC_ERASE_GROUP_END : SD_ERASE_WR_BLK_END, sct_end, 0, R1_STATE_TRAN))
+		return 1;
+
+	// Busy time can exceed the driver's limit. Poll status instead.
+	if (_sdmmc_storage_execute_cmd_type1(storage, MMC_ERASE, is_mmc ? MMC_TRIM_ARG : MMC_ERASE_ARG, 0, R1_SKIP_STATE_CHECK))
+		return 1;
+
+	u32 timeout;
+	if (is_mmc)
+	{
+		// 300ms per erase group.
+		u32 grp_sct = MAX(storage->ext_csd.erase_grp, 1) * 1024;
+		u32 groups  = num_sectors / grp_sct + 2;
+		timeout = 300 * MAX(storage->ext_csd.trim_mult, 1) * groups;
+	}
+	else
+		timeout = _sd_storage_erase_timeout(storage, num_sectors);
+
+	timeout = get_tmr_ms() + MAX(timeout, 1000);
+	while (_sdmmc_storage_check_status(storage))
+	{
+		if (get_tmr_ms() > timeout)
+			return 1;
+		usleep(100);
+	}
+
+	return 0;
+}
+
 /*
  * SD specific functions.
  */
@@ -1110,6 +1259,7 @@ static void _sd_storage_parse_scr(sdmmc_storage_t *storage)
 #endif
 
 	storage->scr.sda_vsn = unstuff_bits(resp, 56, 4);
+	storage->scr.erased_val = unstuff_bits(resp, 55, 1);
 	storage->scr.bus_widths = unstuff_bits(resp, 48, 4);
 
 	// If v2.0 is supported, check if Physical Layer Spec v3.0 is supported.
@@ -1599,6 +1749,10 @@ static void _sd_storage_parse_ssr(sdmmc_storage_t *storage)
 	storage->ssr.au_size     = unstuff_bits(raw_ssr1, 428, 4);
 	storage->ssr.uhs_au_size = unstuff_bits(raw_ssr1, 392, 4);
 
+	storage->ssr.erase_size    = unstuff_bits(raw_ssr1, 408, 16);
+	storage->ssr.erase_timeout = unstuff_bits(raw_ssr1, 402, 6);
+	storage->ssr.erase_offset  = unstuff_bits(raw_ssr1, 400, 2);
+
 	storage->ssr.perf_enhance = unstuff_bits(raw_ssr2, 328, 8);
 }
 
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2025 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -154,6 +154,10 @@ typedef struct _mmc_ext_csd
 	u8  boot_mult;
 	u8  rpmb_mult;
 	u16 dev_version;
+	u8  sec_feature;  /* 231 */
+	u8  trim_mult;    /* 232 */
+	u8  erase_grp;    /* 224 */
+	u8  erased_val;   /* 181 */
 	u32 cache_size;
 	u32 max_enh_mult;
 } mmc_ext_csd_t;
@@ -162,6 +166,7 @@ typedef struct _sd_scr
 {
 	u8 sda_vsn;
 	u8 sda_spec3;
+	u8 erased_val; // Data after erase. 0: zeroes, 1: ones.
 	u8 bus_widths;
 	u8 cmds;
 } sd_scr_t;
@@ -176,6 +181,9 @@ typedef struct _sd_ssr
 	u8  au_size;
 	u8  uhs_au_size;
 	u8  perf_enhance;
+	u8  erase_timeout; // Seconds per erase_size AUs.
+	u8  erase_offset;  // Seconds.
+	u16 erase_size;    // AUs.
 	u32 protected_size;
 } sd_ssr_t;
 
@@ -224,6 +232,11 @@ typedef struct _sd_func_modes_t
 int  sdmmc_storage_end(sdmmc_storage_t *storage);
 int  sdmmc_storage_read(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf);
 int  sdmmc_storage_write(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf);
+int  sdmmc_storage_read_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf);
+int  sdmmc_storage_write_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf);
+int  sdmmc_storage_async_end(sdmmc_storage_t *storage);
+bool sdmmc_storage_can_discard(sdmmc_storage_t *storage);
+int  sdmmc_storage_discard(sdmmc_storage_t *storage, u32 sector, u32 num_sectors);
 int  sdmmc_storage_init_mmc(sdmmc_storage_t *storage, sdmmc_t *sdmmc, u32 bus_width, u32 type);
 int  sdmmc_storage_set_mmc_partition(sdmmc_storage_t *storage, u32 partition);
 void sdmmc_storage_init_wait_sd();
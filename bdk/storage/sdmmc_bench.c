@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdmmc_bench.h"
+#include <soc/timer.h>
+#include <utils/sprintf.h>
+
+#define SCT(x) ((x) / SDMMC_DAT_BLOCKSIZE)
+
+const sdmmc_bench_test_t sdmmc_bench_suite[] = {
+	// Block size sweep.
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, 1,            SCT(SZ_2M)  },
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, SCT(SZ_32K),  SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, SCT(SZ_128K), SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, SCT(SZ_512K), SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ,   0, 0, 0, SCT(SZ_4M),   SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, 1,            SCT(SZ_2M)  },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, SCT(SZ_32K),  SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, SCT(SZ_128K), SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, SCT(SZ_512K), SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ, 100, 0, 0, SCT(SZ_4M),   SCT(SZ_64M) },
+
+	// QD1 versus pipelined.
+	{ SDMMC_BENCH_SEQ,   0, 1, 0, SCT(SZ_4M),   SCT(SZ_64M) },
+	{ SDMMC_BENCH_SEQ, 100, 1, 0, SCT(SZ_4M),   SCT(SZ_64M) },
+	{ SDMMC_BENCH_RND,   0, 0, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_RND,   0, 1, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_RND, 100, 0, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_RND, 100, 1, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+
+	// Mixed 70/30.
+	{ SDMMC_BENCH_RND,  30, 0, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+	{ SDMMC_BENCH_RND,  30, 1, 0, SCT(SZ_4K),   SCT(SZ_16M) },
+};
+
+const u32 sdmmc_bench_suite_cnt = ARRAY_SIZE(sdmmc_bench_suite);
+
+static u32 _bench_rand(u32 *state)
+{
+	// Xorshift32. Same sequence on every run.
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+static void _bench_fill(u32 *buf, u32 words, u32 *state)
+{
+	// Random data, so that nothing can be compressed.
+	for (u32 i = 0; i < words; i++)
+		buf[i] = _bench_rand(state);
+}
+
+static int _bench_compare(const void *a, const void *b)
+{
+	u32 x = *(u32 *)a;
+	u32 y = *(u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int _bench_progress(sdmmc_bench_t *bench, u32 done, u32 ops, u32 *prev_pct, u32 *paused)
+{
+	u32 pct = done * 100 / ops;
+	if (!bench->progress || pct == *prev_pct)
+		return 0;
+
+	// Time spent outside of I/O is not counted.
+	u32 timer = get_tmr_us();
+	int res = bench->progress(bench->data, pct);
+	*paused += get_tmr_us() - timer;
+	*prev_pct = pct;
+
+	return res ? -1 : 0;
+}
+
+// Returns 0 on success, -1 if aborted and 1 on error or unsupported test.
+int sdmmc_bench_run(sdmmc_bench_t *bench, const sdmmc_bench_test_t *test, sdmmc_bench_res_t *res)
+{
+	u32 blk = test->blk_sct;
+	u32 ops = blk ? MIN(test->size_sct / blk, SDMMC_BENCH_OPS_MAX) : 0;
+	u32 slots = blk ? bench->count / blk : 0;
+	u32 state = bench->seed ? bench->seed : 0x2545F491;
+
+	memset(res, 0, sizeof(sdmmc_bench_res_t));
+
+	if (!ops || !slots || blk > SDMMC_BENCH_BLK_MAX || (test->write_pct && !bench->writable))
+		return 1;
+
+	// Prepare write data for both buffers, so that it is not timed.
+	if (test->write_pct)
+		_bench_fill((u32 *)bench->buf, 2 * blk * (SDMMC_DAT_BLOCKSIZE / sizeof(u32)), &state);
+
+	int error = 0;
+	bool pending = false;
+	u32 prev_pct = 200;
+	u32 paused = 0;
+	u32 submitted = 0;
+	u32 timer = get_tmr_us();
+
+	for (u32 i = 0; i < ops; i++)
+	{
+		u32 slot = test->pattern == SDMMC_BENCH_SEQ ? i % slots : _bench_rand(&state) % slots;
+		u32 sector = bench->sector + slot * blk;
+		bool write = test->write_pct && (_bench_rand(&state) % 100) < test->write_pct;
+		u8 *buf = bench->buf + (i & 1) * blk * SDMMC_DAT_BLOCKSIZE;
+
+		if (test->pipelined)
+		{
+			if (pending)
+			{
+				pending = false;
+				error = sdmmc_storage_async_end(bench->storage);
+				bench->lat[i - 1] = get_tmr_us() - submitted;
+				if (!error)
+					error = _bench_progress(bench, i, ops, &prev_pct, &paused);
+				if (error)
+					break;
+			}
+
+			submitted = get_tmr_us();
+			if (write)
+				error = sdmmc_storage_write_async(bench->storage, sector, blk, buf);
+			else
+				error = sdmmc_storage_read_async(bench->storage, sector, blk, buf);
+			pending = !error;
+		}
+		else
+		{
+			submitted = get_tmr_us();
+			if (write)
+				error = sdmmc_storage_write(bench->storage, sector, blk, buf);
+			else
+				error = sdmmc_storage_read(bench->storage, sector, blk, buf);
+			bench->lat[i] = get_tmr_us() - submitted;
+
+			if (!error)
+				error = _bench_progress(bench, i + 1, ops, &prev_pct, &paused);
+		}
+
+		if (error)
+			break;
+	}
+
+	if (pending)
+	{
+		int res_end = sdmmc_storage_async_end(bench->storage);
+		bench->lat[ops - 1] = get_tmr_us() - submitted;
+		if (!error)
+			error = res_end;
+	}
+
+	timer = get_tmr_us() - timer - paused;
+
+	if (error)
+		return error;
+
+	if (!timer)
+		timer = 1;
+
+	qsort(bench->lat, ops, sizeof(u32), _bench_compare);
+
+	res->ops      = ops;
+	res->time_us  = timer;
+	res->rate_kbs = (u64)ops * blk * SDMMC_DAT_BLOCKSIZE * 1000 / timer;
+	res->iops     = (u64)ops * 1000000 / timer;
+	res->lat_p50  = bench->lat[(ops - 1) * 50 / 100];
+	res->lat_p99  = bench->lat[(ops - 1) * 99 / 100];
+	res->lat_max  = bench->lat[ops - 1];
+
+	return 0;
+}
+
+static void _bench_size_str(char *str, u32 bytes)
+{
+	if (bytes < SZ_1K)
+		s_printf(str, "%dB", bytes);
+	else if (bytes < SZ_1M)
+		s_printf(str, "%dK", bytes / SZ_1K);
+	else
+		s_printf(str, "%dM", bytes / SZ_1M);
+}
+
+void sdmmc_bench_name(char *name, const sdmmc_bench_test_t *test)
+{
+	char size[8];
+	char mode[8];
+
+	_bench_size_str(size, test->blk_sct * SDMMC_DAT_BLOCKSIZE);
+
+	if (!test->write_pct)
+		strcpy(mode, "R");
+	else if (test->write_pct == 100)
+		strcpy(mode, "W");
+	else
+		s_printf(mode, "%d/%d", 100 - test->write_pct, test->write_pct);
+
+	s_printf(name, "%s %s %s %s", test->pattern == SDMMC_BENCH_SEQ ? "SEQ" : "RND",
+		size, mode, test->pipelined ? "PIPE" : "QD1");
+}
+
+void sdmmc_bench_csv(char *line, const char *device, const sdmmc_bench_test_t *test, const sdmmc_bench_res_t *res)
+{
+	char name[SDMMC_BENCH_NAME_SZ];
+
+	sdmmc_bench_name(name, test);
+	s_printf(line, "%s,%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d\n", device, name,
+		test->pattern == SDMMC_BENCH_SEQ ? "seq" : "rnd", test->blk_sct * SDMMC_DAT_BLOCKSIZE,
+		test->write_pct, test->pipelined, res->ops, res->time_us, res->rate_kbs, res->iops,
+		res->lat_p50, res->lat_p99, res->lat_max);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SDMMC_BENCH_H
+#define SDMMC_BENCH_H
+
+#include <storage/sdmmc.h>
+#include <utils/types.h>
+
+/*
+ * Raw storage benchmark.
+ *
+ * Each test issues fixed size commands over a region, sequentially or at random
+ * block aligned offsets, and records the latency of every command.
+ * Pipelined tests start each command asynchronously and only wait for it when
+ * the next one is issued. Write data is random and prepared before timing.
+ * Writes are only done if the region is writable.
+ */
+
+#define SDMMC_BENCH_OPS_MAX  4096
+#define SDMMC_BENCH_BLK_MAX  (SZ_4M / SDMMC_DAT_BLOCKSIZE)
+#define SDMMC_BENCH_BUF_SIZE (SZ_4M * 2) // Two blocks for pipelined tests.
+#define SDMMC_BENCH_NAME_SZ  24
+
+#define SDMMC_BENCH_CSV_HDR  "device,test,pattern,block,write_pct,pipelined,ops,time_us,rate_kbs,iops,lat_p50_us,lat_p99_us,lat_max_us\n"
+
+enum
+{
+	SDMMC_BENCH_SEQ = 0,
+	SDMMC_BENCH_RND = 1
+};
+
+typedef struct _sdmmc_bench_test_t
+{
+	u8  pattern;
+	u8  write_pct; // Share of writes. 0: reads only, 100: writes only.
+	u8  pipelined;
+	u8  rsvd;
+	u32 blk_sct;   // Command size.
+	u32 size_sct;  // Total data. Clamped to SDMMC_BENCH_OPS_MAX commands.
+} sdmmc_bench_test_t;
+
+typedef struct _sdmmc_bench_res_t
+{
+	u32 ops;
+	u32 time_us;
+	u32 rate_kbs; // 1000 based.
+	u32 iops;
+	u32 lat_p50;  // Command latency in us.
+	u32 lat_p99;
+	u32 lat_max;
+} sdmmc_bench_res_t;
+
+typedef struct _sdmmc_bench_t
+{
+	sdmmc_storage_t *storage;
+	u32  sector;   // Test region.
+	u32  count;
+	bool writable; // Region contents can be destroyed.
+	u8  *buf;      // DMA buffer of SDMMC_BENCH_BUF_SIZE.
+	u32 *lat;      // SDMMC_BENCH_OPS_MAX entries.
+	u32  seed;
+	int (*progress)(void *data, u32 pct); // Returns non zero to abort.
+	void *data;
+} sdmmc_bench_t;
+
+extern const sdmmc_bench_test_t sdmmc_bench_suite[];
+extern const u32 sdmmc_bench_suite_cnt;
+
+int  sdmmc_bench_run(sdmmc_bench_t *bench, const sdmmc_bench_test_t *test, sdmmc_bench_res_t *res);
+void sdmmc_bench_name(char *name, const sdmmc_bench_test_t *test);
+void sdmmc_bench_csv(char *line, const char *device, const sdmmc_bench_test_t *test, const sdmmc_bench_res_t *res);
+
+#endif
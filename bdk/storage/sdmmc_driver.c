@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2025 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -20,6 +20,7 @@
 #include <storage/mmc_def.h>
 #include <storage/sdmmc.h>
 #include <gfx_utils.h>
+#include <memory_map.h>
 #include <power/max7762x.h>
 #include <soc/bpmp.h>
 #include <soc/clock.h>
@@ -41,6 +42,21 @@
 /*! SCMMC controller base addresses. */
 static const u16 _sdmmc_base_offsets[4] = { 0x0, 0x200, 0x400, 0x600 };
 
+/*! Controller with a data transfer running in the background. */
+static sdmmc_t *_sdmmc_async = NULL;
+
+/*! ADMA2 descriptor. 128bit since Host V4 and 64bit addressing are enabled. */
+typedef struct _sdmmc_adma2_desc_t
+{
+	u16 attr;
+	u16 len;
+	u32 addr;
+	u32 addr_hi;
+	u32 rsvd;
+} sdmmc_adma2_desc_t;
+
+#define SDMMC_ADMA2_DESC_LEN SZ_32K
+
 int sdmmc_get_io_power(sdmmc_t *sdmmc)
 {
 	u32 p = sdmmc->regs->pwrcon;
@@ -489,6 +505,16 @@ int sdmmc_get_cached_rsp(sdmmc_t *sdmmc, u32 *rsp, u32 type)
 	return 0;
 }
 
+// Returns true if the data phase of the background transfer ended.
+bool sdmmc_async_done()
+{
+	sdmmc_t *bg = _sdmmc_async;
+	if (!bg)
+		return true;
+
+	return !!(bg->regs->norintsts & (SDHCI_INT_ERROR | SDHCI_INT_DATA_END));
+}
+
 static int _sdmmc_wait_cmd_data_inhibit(sdmmc_t *sdmmc, bool wait_dat)
 {
 	_sdmmc_commit_changes(sdmmc);
@@ -521,11 +547,13 @@ static int _sdmmc_wait_card_busy(sdmmc_t *sdmmc)
 
 	u32 timeout = get_tmr_ms() + 2000;
 	while (!(sdmmc->regs->prnsts & SDHCI_DATA_0_LVL))
+	{
 		if (get_tmr_ms() > timeout)
 		{
 			_sdmmc_reset_cmd_data(sdmmc);
 			return 1;
 		}
+	}
 
 	return 0;
 }
@@ -899,7 +927,7 @@ static void _sdmmc_enable_interrupts(sdmmc_t *sdmmc)
 
 static void _sdmmc_mask_interrupts(sdmmc_t *sdmmc)
 {
-	sdmmc->regs->errintstsen &= ~SDHCI_ERR_INT_ALL_EXCEPT_ADMA_BUSPWR;
+	sdmmc->regs->errintstsen &= ~(SDHCI_ERR_INT_ALL_EXCEPT_ADMA_BUSPWR | SDHCI_ERR_INT_ADMA);
 	sdmmc->regs->norintstsen &= ~(SDHCI_INT_DMA_END | SDHCI_INT_DATA_END | SDHCI_INT_RESPONSE);
 }
 
@@ -1006,7 +1034,50 @@ int sdmmc_stop_transmission(sdmmc_t *sdmmc, u32 *rsp)
 	return res;
 }
 
-static int _sdmmc_config_sdma(sdmmc_t *sdmmc, u32 *blkcnt_out, const sdmmc_req_t *request)
+/*
+ * Builds the ADMA2 descriptor table for a background transfer.
+ * ADMA2 walks the whole buffer by itself. Unlike SDMA, it doesn't stop
+ * on 512KB boundaries, so it keeps going while the CPU does other work.
+ */
+static int _sdmmc_config_adma2(sdmmc_t *sdmmc, u32 addr, u32 size)
+{
+	sdmmc_adma2_desc_t *desc = (sdmmc_adma2_desc_t *)SDMMC_ADMA_DESC_ADDR;
+	u32 descs = (size + SDMMC_ADMA2_DESC_LEN - 1) / SDMMC_ADMA2_DESC_LEN;
+
+	if (descs > SDMMC_ADMA_DESC_SZ / sizeof(sdmmc_adma2_desc_t))
+		return 1;
+
+	for (u32 i = 0; i < descs; i++)
+	{
+		u32 len = MIN(size, SDMMC_ADMA2_DESC_LEN);
+
+		desc[i].attr    = SDHCI_ADMA2_ACT_TRAN | SDHCI_ADMA2_VALID;
+		desc[i].len     = len;
+		desc[i].addr    = addr;
+		desc[i].addr_hi = 0;
+		desc[i].rsvd    = 0;
+
+		addr += len;
+		size -= len;
+	}
+	desc[descs - 1].attr |= SDHCI_ADMA2_END;
+
+	sdmmc->regs->admaaddr    = (u32)desc;
+	sdmmc->regs->admaaddr_hi = 0;
+
+	// Select ADMA2. Host V4 uses the 64bit addressing enable for its descriptor size.
+	sdmmc->regs->hostctl = (sdmmc->regs->hostctl & ~SDHCI_CTRL_DMA_MASK) | SDHCI_CTRL_ADMA32;
+	sdmmc->regs->errintstsen |= SDHCI_ERR_INT_ADMA;
+
+	return 0;
+}
+
+static void _sdmmc_config_sdma_mode(sdmmc_t *sdmmc)
+{
+	sdmmc->regs->hostctl &= ~SDHCI_CTRL_DMA_MASK;
+}
+
+static int _sdmmc_config_dma(sdmmc_t *sdmmc, u32 *blkcnt_out, const sdmmc_req_t *request, bool adma)
 {
 	if (!request->blksize || !request->num_sectors)
 		return 1;
@@ -1020,10 +1091,18 @@ static int _sdmmc_config_sdma(sdmmc_t *sdmmc, u32 *blkcnt_out, const sdmmc_req_t
 	if (admaaddr & 7)
 		return 1;
 
-	sdmmc->regs->admaaddr = admaaddr;
-	sdmmc->regs->admaaddr_hi = 0;
+	if (adma)
+	{
+		if (_sdmmc_config_adma2(sdmmc, admaaddr, blkcnt * request->blksize))
+			return 1;
+	}
+	else
+	{
+		sdmmc->regs->admaaddr = admaaddr;
+		sdmmc->regs->admaaddr_hi = 0;
 
-	sdmmc->dma_addr_next = ALIGN_DOWN((admaaddr + SZ_512K), SZ_512K);
+		sdmmc->dma_addr_next = ALIGN_DOWN((admaaddr + SZ_512K), SZ_512K);
+	}
 
 	sdmmc->regs->blksize = request->blksize | (7u << 12); // SDMA DMA 512KB Boundary (Detects A18 carry out).
 	sdmmc->regs->blkcnt  = blkcnt;
@@ -1099,17 +1178,16 @@ static int _sdmmc_update_sdma(sdmmc_t *sdmmc)
 	return 1;
 }
 
-static int _sdmmc_execute_cmd_inner(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u32 *blkcnt_out)
+static int _sdmmc_execute_cmd_begin(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u32 *blkcnt, bool adma)
 {
 	bool has_req_or_check_busy = request || cmd->check_busy;
 	if (_sdmmc_wait_cmd_data_inhibit(sdmmc, has_req_or_check_busy))
 		return 1;
 
-	u32 blkcnt = 0;
 	bool is_data_present = false;
 	if (request)
 	{
-		if (_sdmmc_config_sdma(sdmmc, &blkcnt, request))
+		if (_sdmmc_config_dma(sdmmc, blkcnt, request, adma))
 		{
 #ifdef ERROR_EXTRA_PRINTING
 			EPRINTFARGS("SDMMC%d: DMA Wrong cfg!", sdmmc->id + 1);
@@ -1141,28 +1219,36 @@ static int _sdmmc_execute_cmd_inner(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_
 	DPRINTF("rsp(%d): %08X, %08X, %08X, %08X\n", res,
 		sdmmc->regs->rspreg[0], sdmmc->regs->rspreg[1], sdmmc->regs->rspreg[2], sdmmc->regs->rspreg[3]);
 
-	if (!res)
+	if (!res && cmd->rsp_type)
 	{
-		if (cmd->rsp_type)
-		{
-			sdmmc->expected_rsp_type = cmd->rsp_type;
-			res = _sdmmc_cache_rsp(sdmmc, sdmmc->rsp, cmd->rsp_type);
-		}
-		if (request && !res)
-		{
-			res = _sdmmc_update_sdma(sdmmc);
+		sdmmc->expected_rsp_type = cmd->rsp_type;
+		res = _sdmmc_cache_rsp(sdmmc, sdmmc->rsp, cmd->rsp_type);
+	}
+
+	if (res)
+		_sdmmc_mask_interrupts(sdmmc);
+
+	return res;
+}
+
+static int _sdmmc_execute_cmd_end(sdmmc_t *sdmmc, bool has_data, bool auto_stop, u32 blkcnt, u32 *blkcnt_out, bool check_busy)
+{
+	int res = 0;
+
+	if (has_data)
+	{
+		res = _sdmmc_update_sdma(sdmmc);
 #ifdef ERROR_EXTRA_PRINTING
-			if (res)
-				EPRINTFARGS("SDMMC%d: DMA Update failed!", sdmmc->id + 1);
+		if (res)
+			EPRINTFARGS("SDMMC%d: DMA Update failed!", sdmmc->id + 1);
 #endif
-		}
 	}
 
 	_sdmmc_mask_interrupts(sdmmc);
 
 	if (!res)
 	{
-		if (request)
+		if (has_data)
 		{
 			// Invalidate cache after transfer.
 			bpmp_mmu_maintenance(BPMP_MMU_MAINT_INVALID_WAY, false);
@@ -1170,11 +1256,11 @@ static int _sdmmc_execute_cmd_inner(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_
 			if (blkcnt_out)
 				*blkcnt_out = blkcnt;
 
-			if (request->is_auto_stop_trn)
+			if (auto_stop)
 				sdmmc->stop_trn_rsp = sdmmc->regs->rspreg[3];
 		}
 
-		if (has_req_or_check_busy)
+		if (check_busy)
 		{
 			res = _sdmmc_wait_card_busy(sdmmc);
 #ifdef ERROR_EXTRA_PRINTING
@@ -1187,6 +1273,16 @@ static int _sdmmc_execute_cmd_inner(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_
 	return res;
 }
 
+static int _sdmmc_execute_cmd_inner(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u32 *blkcnt_out)
+{
+	u32 blkcnt = 0;
+	if (_sdmmc_execute_cmd_begin(sdmmc, cmd, request, &blkcnt, false))
+		return 1;
+
+	return _sdmmc_execute_cmd_end(sdmmc, !!request, request && request->is_auto_stop_trn, blkcnt, blkcnt_out,
+		request || cmd->check_busy);
+}
+
 bool sdmmc_get_sd_inserted()
 {
 	return (!gpio_read(GPIO_PORT_Z, GPIO_PIN_1));
@@ -1457,6 +1553,10 @@ void sdmmc1_disable_power()
 
 void sdmmc_end(sdmmc_t *sdmmc)
 {
+	// Drop any background transfer.
+	if (_sdmmc_async == sdmmc)
+		_sdmmc_async = NULL;
+
 	if (!sdmmc->clock_stopped)
 	{
 		_sdmmc_card_clock_disable(sdmmc);
@@ -1486,6 +1586,10 @@ int sdmmc_execute_cmd(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u3
 	if (!sdmmc->card_clock_enabled)
 		return 1;
 
+	// Finish any background transfer first.
+	if (_sdmmc_async == sdmmc)
+		sdmmc_execute_cmd_async_end(sdmmc, NULL);
+
 	// Recalibrate periodically if needed.
 	if (sdmmc->periodic_calibration && sdmmc->powersave_enabled)
 		_sdmmc_autocal_execute(sdmmc, sdmmc_get_io_power(sdmmc));
@@ -1508,6 +1612,60 @@ int sdmmc_execute_cmd(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u3
 	return res;
 }
 
+int sdmmc_execute_cmd_async(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request)
+{
+	// Only one data transfer can run in the background.
+	if (!sdmmc->card_clock_enabled || !request || _sdmmc_async)
+		return 1;
+
+	// Recalibrate periodically if needed.
+	if (sdmmc->periodic_calibration && sdmmc->powersave_enabled)
+		_sdmmc_autocal_execute(sdmmc, sdmmc_get_io_power(sdmmc));
+
+	sdmmc->async_clk_disable = 0;
+	if (!(sdmmc->regs->clkcon & SDHCI_CLOCK_CARD_EN))
+	{
+		sdmmc->async_clk_disable = 1;
+		sdmmc->regs->clkcon |= SDHCI_CLOCK_CARD_EN;
+		_sdmmc_commit_changes(sdmmc);
+		usleep((8 * 1000 + sdmmc->card_clock - 1) / sdmmc->card_clock); // Wait 8 cycles.
+	}
+
+	if (_sdmmc_execute_cmd_begin(sdmmc, cmd, request, &sdmmc->async_blkcnt, true))
+	{
+		_sdmmc_config_sdma_mode(sdmmc);
+		usleep((8 * 1000 + sdmmc->card_clock - 1) / sdmmc->card_clock); // Wait 8 cycles.
+
+		if (sdmmc->async_clk_disable)
+			sdmmc->regs->clkcon &= ~SDHCI_CLOCK_CARD_EN;
+
+		return 1;
+	}
+
+	// Data phase continues in the background. ADMA2 needs no service until it ends.
+	sdmmc->async_auto_stop = request->is_auto_stop_trn;
+	_sdmmc_async = sdmmc;
+
+	return 0;
+}
+
+int sdmmc_execute_cmd_async_end(sdmmc_t *sdmmc, u32 *blkcnt_out)
+{
+	if (_sdmmc_async != sdmmc)
+		return 1;
+
+	_sdmmc_async = NULL;
+
+	int res = _sdmmc_execute_cmd_end(sdmmc, true, sdmmc->async_auto_stop, sdmmc->async_blkcnt, blkcnt_out, true);
+	_sdmmc_config_sdma_mode(sdmmc);
+	usleep((8 * 1000 + sdmmc->card_clock - 1) / sdmmc->card_clock); // Wait 8 cycles.
+
+	if (sdmmc->async_clk_disable)
+		sdmmc->regs->clkcon &= ~SDHCI_CLOCK_CARD_EN;
+
+	return res;
+}
+
 int sdmmc_enable_low_voltage(sdmmc_t *sdmmc)
 {
 	if (sdmmc->id != SDMMC_1)
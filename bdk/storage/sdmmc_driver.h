@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2025 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -118,6 +118,12 @@
 #define SDHCI_CTRL_CDTEST_INS BIT(6)
 #define SDHCI_CTRL_CDTEST_EN  BIT(7)
 
+/*! SDMMC ADMA2 descriptor attributes. */
+#define SDHCI_ADMA2_VALID     BIT(0)
+#define SDHCI_ADMA2_END       BIT(1)
+#define SDHCI_ADMA2_INT       BIT(2)
+#define SDHCI_ADMA2_ACT_TRAN  (2U << 4)
+
 /*! SDMMC host control 2. 0x3E. */
 #define SDHCI_CTRL_UHS_MASK        0x7
 #define SDHCI_CTRL_VDD_180         BIT(3)
@@ -298,6 +304,9 @@ typedef struct _sdmmc_t
 	u32 stop_trn_rsp;
 	u32 error_sts;
 	int t210b01;
+	int async_clk_disable;
+	int async_auto_stop;
+	u32 async_blkcnt;
 } sdmmc_t;
 
 /*! SDMMC command. */
@@ -335,6 +344,9 @@ int  sdmmc_init(sdmmc_t *sdmmc, u32 id, u32 power, u32 bus_width, u32 type);
 void sdmmc_end(sdmmc_t *sdmmc);
 void sdmmc_init_cmd(sdmmc_cmd_t *cmdbuf, u16 cmd, u32 arg, u32 rsp_type, u32 check_busy);
 int  sdmmc_execute_cmd(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request, u32 *blkcnt_out);
+int  sdmmc_execute_cmd_async(sdmmc_t *sdmmc, sdmmc_cmd_t *cmd, sdmmc_req_t *request);
+int  sdmmc_execute_cmd_async_end(sdmmc_t *sdmmc, u32 *blkcnt_out);
+bool sdmmc_async_done();
 int  sdmmc_enable_low_voltage(sdmmc_t *sdmmc);
 
 #endif
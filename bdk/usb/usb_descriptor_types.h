@@ -1,7 +1,7 @@
 /*
  * USB driver for Tegra X1
  *
- * Copyright (c) 2019-2020 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -34,7 +34,8 @@ typedef enum {
 	USB_DESCRIPTOR_DEVICE_BINARY_OBJECT      = 15,
 	USB_DESCRIPTOR_DEVICE_BINARY_OBJECT_CAP  = 16,
 	USB_DESCRIPTOR_HID                       = 33,
-	USB_DESCRIPTOR_HID_REPORT                = 34
+	USB_DESCRIPTOR_HID_REPORT                = 34,
+	USB_DESCRIPTOR_PIPE_USAGE                = 36
 } usb_desc_type_t;
 
 typedef enum {
@@ -139,6 +140,21 @@ typedef struct _usb_ep_descr_t
 	u8  bInterval;        // Polling interval in frames. For Interrupt and Isochronous data transfer only.
 } __attribute__((packed)) usb_ep_descr_t;
 
+/* UAS Pipe Usage descriptor structure */
+typedef struct _usb_pipe_usage_descr_t
+{
+	u8 bLength;         // Length of this descriptor.
+	u8 bDescriptorType; // PIPE USAGE descriptor type (USB_DESCRIPTOR_PIPE_USAGE).
+	u8 bPipeID;         // 1: Command, 2: Status, 3: Data In, 4: Data Out.
+	u8 bReserved;
+} __attribute__((packed)) usb_pipe_usage_descr_t;
+
+typedef struct _usb_uas_ep_descr_t
+{
+	usb_ep_descr_t         endpoint;
+	usb_pipe_usage_descr_t pipe;
+} __attribute__((packed)) usb_uas_ep_descr_t;
+
 typedef struct _usb_cfg_simple_descr_t
 {
 	usb_cfg_descr_t   config;
@@ -154,6 +170,16 @@ typedef struct _usb_cfg_hid_descr_t
 	usb_ep_descr_t    endpoint[1];
 } __attribute__((packed)) usb_cfg_hid_descr_t;
 
+// Bulk-Only Transport on alternate setting 0 and UAS on 1.
+typedef struct _usb_cfg_uas_descr_t
+{
+	usb_cfg_descr_t    config;
+	usb_inter_descr_t  interface;
+	usb_ep_descr_t     endpoint[2];
+	usb_inter_descr_t  uas_interface;
+	usb_uas_ep_descr_t uas_endpoint[4];
+} __attribute__((packed)) usb_cfg_uas_descr_t;
+
 typedef struct _usb_dev_bot_t
 {
 	u8  bLength;                // Size of this descriptor in bytes.
@@ -1,7 +1,7 @@
 /*
  * USB driver for Tegra X1
  *
- * Copyright (c) 2019-2025 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -130,6 +130,102 @@ static usb_cfg_simple_descr_t usb_other_speed_config_descriptor_ums =
 	.endpoint[1].bInterval        = 0
 };
 
+// XUSB only. Hosts without a UAS driver stay on the Bulk-Only alternate setting.
+static usb_cfg_uas_descr_t usb_configuration_descriptor_ums_uas =
+{
+	/* Configuration descriptor structure */
+	.config.bLength               = 9,
+	.config.bDescriptorType       = USB_DESCRIPTOR_CONFIGURATION,
+	.config.wTotalLength          = 0x55,
+	.config.bNumInterfaces        = 0x01,
+	.config.bConfigurationValue   = 0x01,
+	.config.iConfiguration        = 0x00,
+	.config.bmAttributes          = USB_ATTR_SELF_POWERED | USB_ATTR_BUS_POWERED_RSVD,
+	.config.bMaxPower             = 32 / 2,
+
+	/* Interface descriptor structure */
+	.interface.bLength            = 9,
+	.interface.bDescriptorType    = USB_DESCRIPTOR_INTERFACE,
+	.interface.bInterfaceNumber   = 0,
+	.interface.bAlternateSetting  = 0,
+	.interface.bNumEndpoints      = 2,
+	.interface.bInterfaceClass    = 0x08, // Mass Storage Class.
+	.interface.bInterfaceSubClass = 0x06, // SCSI Transparent Command Set.
+	.interface.bInterfaceProtocol = 0x50, // Bulk-Only Transport.
+	.interface.iInterface         = 0x00,
+
+	/* Endpoint descriptor structure EP1 IN */
+	.endpoint[0].bLength          = 7,
+	.endpoint[0].bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.endpoint[0].bEndpointAddress = 0x81, // USB_EP_ADDR_BULK_IN.
+	.endpoint[0].bmAttributes     = USB_EP_TYPE_BULK,
+	.endpoint[0].wMaxPacketSize   = 0x200,
+	.endpoint[0].bInterval        = 0x00,
+
+	/* Endpoint descriptor structure EP1 OUT */
+	.endpoint[1].bLength          = 7,
+	.endpoint[1].bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.endpoint[1].bEndpointAddress = 0x01, // USB_EP_ADDR_BULK_OUT.
+	.endpoint[1].bmAttributes     = USB_EP_TYPE_BULK,
+	.endpoint[1].wMaxPacketSize   = 0x200,
+	.endpoint[1].bInterval        = 0x00,
+
+	/* Interface descriptor structure. Alternate setting 1 */
+	.uas_interface.bLength            = 9,
+	.uas_interface.bDescriptorType    = USB_DESCRIPTOR_INTERFACE,
+	.uas_interface.bInterfaceNumber   = 0,
+	.uas_interface.bAlternateSetting  = 1,
+	.uas_interface.bNumEndpoints      = 4,
+	.uas_interface.bInterfaceClass    = 0x08, // Mass Storage Class.
+	.uas_interface.bInterfaceSubClass = 0x06, // SCSI Transparent Command Set.
+	.uas_interface.bInterfaceProtocol = 0x62, // USB Attached SCSI.
+	.uas_interface.iInterface         = 0x00,
+
+	/* Endpoint descriptor structure EP2 OUT. Command pipe */
+	.uas_endpoint[0].endpoint.bLength          = 7,
+	.uas_endpoint[0].endpoint.bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.uas_endpoint[0].endpoint.bEndpointAddress = 0x02, // USB_EP_ADDR_BULK2_OUT.
+	.uas_endpoint[0].endpoint.bmAttributes     = USB_EP_TYPE_BULK,
+	.uas_endpoint[0].endpoint.wMaxPacketSize   = 0x200,
+	.uas_endpoint[0].endpoint.bInterval        = 0x00,
+	.uas_endpoint[0].pipe.bLength              = 4,
+	.uas_endpoint[0].pipe.bDescriptorType      = USB_DESCRIPTOR_PIPE_USAGE,
+	.uas_endpoint[0].pipe.bPipeID              = 1,
+
+	/* Endpoint descriptor structure EP2 IN. Status pipe */
+	.uas_endpoint[1].endpoint.bLength          = 7,
+	.uas_endpoint[1].endpoint.bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.uas_endpoint[1].endpoint.bEndpointAddress = 0x82, // USB_EP_ADDR_BULK2_IN.
+	.uas_endpoint[1].endpoint.bmAttributes     = USB_EP_TYPE_BULK,
+	.uas_endpoint[1].endpoint.wMaxPacketSize   = 0x200,
+	.uas_endpoint[1].endpoint.bInterval        = 0x00,
+	.uas_endpoint[1].pipe.bLength              = 4,
+	.uas_endpoint[1].pipe.bDescriptorType      = USB_DESCRIPTOR_PIPE_USAGE,
+	.uas_endpoint[1].pipe.bPipeID              = 2,
+
+	/* Endpoint descriptor structure EP1 IN. Data In pipe */
+	.uas_endpoint[2].endpoint.bLength          = 7,
+	.uas_endpoint[2].endpoint.bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.uas_endpoint[2].endpoint.bEndpointAddress = 0x81, // USB_EP_ADDR_BULK_IN.
+	.uas_endpoint[2].endpoint.bmAttributes     = USB_EP_TYPE_BULK,
+	.uas_endpoint[2].endpoint.wMaxPacketSize   = 0x200,
+	.uas_endpoint[2].endpoint.bInterval        = 0x00,
+	.uas_endpoint[2].pipe.bLength              = 4,
+	.uas_endpoint[2].pipe.bDescriptorType      = USB_DESCRIPTOR_PIPE_USAGE,
+	.uas_endpoint[2].pipe.bPipeID              = 3,
+
+	/* Endpoint descriptor structure EP1 OUT. Data Out pipe */
+	.uas_endpoint[3].endpoint.bLength          = 7,
+	.uas_endpoint[3].endpoint.bDescriptorType  = USB_DESCRIPTOR_ENDPOINT,
+	.uas_endpoint[3].endpoint.bEndpointAddress = 0x01, // USB_EP_ADDR_BULK_OUT.
+	.uas_endpoint[3].endpoint.bmAttributes     = USB_EP_TYPE_BULK,
+	.uas_endpoint[3].endpoint.wMaxPacketSize   = 0x200,
+	.uas_endpoint[3].endpoint.bInterval        = 0x00,
+	.uas_endpoint[3].pipe.bLength              = 4,
+	.uas_endpoint[3].pipe.bDescriptorType      = USB_DESCRIPTOR_PIPE_USAGE,
+	.uas_endpoint[3].pipe.bPipeID              = 4
+};
+
 static usb_dev_bot_t usb_device_binary_object_descriptor =
 {
 	.bLength                = 5,
@@ -429,7 +525,7 @@ static usb_cfg_hid_descr_t usb_configuration_descriptor_hid_jc =
 	.endpoint[0].bEndpointAddress = 0x81, // USB_EP_ADDR_BULK_IN.
 	.endpoint[0].bmAttributes     = USB_EP_TYPE_INTR,
 	.endpoint[0].wMaxPacketSize   = 0x200,
-	.endpoint[0].bInterval        = 4,   // 8ms on HS.
+	.endpoint[0].bInterval        = 4,   // 1ms on HS.
 };
 
 static u8 usb_vendor_string_descriptor_hid[22] =
@@ -490,7 +586,7 @@ static usb_cfg_hid_descr_t usb_configuration_descriptor_hid_touch =
 	.endpoint[0].bEndpointAddress = 0x81, // USB_EP_ADDR_BULK_IN.
 	.endpoint[0].bmAttributes     = USB_EP_TYPE_INTR,
 	.endpoint[0].wMaxPacketSize   = 0x200,
-	.endpoint[0].bInterval        = 3,   // 4ms on HS.
+	.endpoint[0].bInterval        = 4,   // 1ms on HS.
 };
 
 usb_desc_t usb_gadget_ums_descriptors =
@@ -509,6 +605,22 @@ usb_desc_t usb_gadget_ums_descriptors =
 	.mx_ext    = &usb_ms_ext_prop_descriptor_ums
 };
 
+usb_desc_t usb_gadget_ums_uas_descriptors =
+{
+	.dev       = &usb_device_descriptor_ums,
+	.dev_qual  = &usb_device_qualifier_descriptor,
+	.cfg       = (usb_cfg_simple_descr_t *)&usb_configuration_descriptor_ums_uas,
+	.cfg_other = &usb_other_speed_config_descriptor_ums,
+	.dev_bot   = &usb_device_binary_object_descriptor,
+	.vendor    = usb_vendor_string_descriptor_ums,
+	.product   = usb_product_string_descriptor_ums,
+	.serial    = usb_serial_string_descriptor,
+	.lang_id   = usb_lang_id_string_descriptor,
+	.ms_os     = &usb_ms_os_descriptor,
+	.ms_cid    = &usb_ms_cid_descriptor,
+	.mx_ext    = &usb_ms_ext_prop_descriptor_ums
+};
+
 usb_desc_t usb_gadget_hid_jc_descriptors =
 {
 	.dev       = &usb_device_descriptor_hid_jc,
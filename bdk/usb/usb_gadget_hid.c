@@ -25,12 +25,19 @@
 #include <soc/hw_init.h>
 #include <soc/timer.h>
 #include <soc/t210.h>
+#include <utils/sprintf.h>
 
 #include <memory_map.h>
 
 //#define DPRINTF(...) gfx_printf(__VA_ARGS__)
 #define DPRINTF(...)
 
+#define HID_FRAME_US      1000 // Report rate. Matches the 1ms EP interval.
+#define HID_SAMPLE_US     100  // Input sampling period between frames.
+#define HID_TOUCH_POLL_US 4000 // Touch poll if interrupt line is not asserted.
+#define HID_RPT_QUEUE_MAX 8    // Power of 2.
+#define HID_RPT_SIZE_MAX  8
+
 typedef struct _gamepad_report_t
 {
 	u8 x;
@@ -58,6 +65,8 @@ typedef struct _jc_cal_t
 {
 // 15ms * JC_CAL_MAX_STEPS = 240 ms.
 #define JC_CAL_MAX_STEPS 16
+#define JC_CAL_STEP_MS   15
+	u32 step_timer;
 	u32 cl_step;
 	u32 cr_step;
 
@@ -77,7 +86,33 @@ enum {
 	INPUT_POLL_EXIT,
 };
 
+typedef struct _hid_rpt_queue_t
+{
+	u32  head;
+	u32  cnt;
+	bool sent; // Report buffer holds a valid report.
+	u32  time[HID_RPT_QUEUE_MAX]; // Input sample time in us.
+	u8   rpt[HID_RPT_QUEUE_MAX][HID_RPT_SIZE_MAX];
+} hid_rpt_queue_t;
+
+typedef struct _hid_ctxt_t
+{
+	hid_rpt_queue_t queue;
+
+	u32  frame_timer;
+	u32  touch_timer;
+	bool capture;
+
+	// Latency stats. Reset every second.
+	u32 lat_timer;
+	u32 lat_rpts;    // Reports sent.
+	u32 lat_samples; // Reports with new input.
+	u32 lat_total;
+	u32 lat_max;
+} hid_ctxt_t;
+
 static jc_cal_t jc_cal_ctx;
+static hid_ctxt_t hid_ctx;
 static usb_ops_t usb_ops;
 
 static void *rpt_buffer = (u8 *)USB_EP_BULK_IN_BUF_ADDR;
@@ -127,7 +162,7 @@ static bool _jc_calibration(const jc_gamepad_rpt_t *jc_pad)
 	return true;
 }
 
-static int _jc_poll(gamepad_report_t *rpt)
+static int _jc_poll(gamepad_report_t *rpt, bool *capture)
 {
 	static gamepad_report_t prev_rpt = {0};
 
@@ -137,12 +172,19 @@ static int _jc_poll(gamepad_report_t *rpt)
 	if (!jc_pad)
 		return INPUT_POLL_NO_PACKET;
 
+	*capture = jc_pad->cap;
+
 	// Exit emulation if Left stick and Home are pressed.
 	if (jc_pad->l3 && jc_pad->home)
 		return INPUT_POLL_EXIT;
 
 	if (jc_cal_ctx.cl_step != JC_CAL_MAX_STEPS || jc_cal_ctx.cr_step != JC_CAL_MAX_STEPS)
 	{
+		// Input is sampled faster than Joy-Con reports.
+		if (get_tmr_ms() < jc_cal_ctx.step_timer)
+			return INPUT_POLL_NO_PACKET;
+		jc_cal_ctx.step_timer = get_tmr_ms() + JC_CAL_STEP_MS;
+
 		if (!_jc_calibration(jc_pad))
 			return INPUT_POLL_NO_PACKET;
 	}
@@ -361,36 +403,121 @@ static u8 _hid_transfer_start(usb_ctxt_t *usbs, u32 len)
 	return status;
 }
 
-static bool _hid_poll_jc(usb_ctxt_t *usbs)
+static void _hid_rpt_push(const void *rpt, u32 size, u32 time)
+{
+	hid_rpt_queue_t *queue = &hid_ctx.queue;
+	u32 idx;
+
+	// Coalesce into the newest report if the host falls behind. Its input time is kept.
+	if (queue->cnt == HID_RPT_QUEUE_MAX)
+		idx = (queue->head + HID_RPT_QUEUE_MAX - 1) & (HID_RPT_QUEUE_MAX - 1);
+	else
+	{
+		idx = (queue->head + queue->cnt) & (HID_RPT_QUEUE_MAX - 1);
+		queue->time[idx] = time;
+		queue->cnt++;
+	}
+
+	memcpy(queue->rpt[idx], rpt, size);
+}
+
+static bool _hid_send_frame(usb_ctxt_t *usbs, u32 size)
 {
-	int res = _jc_poll(rpt_buffer);
+	hid_rpt_queue_t *queue = &hid_ctx.queue;
+	bool sampled = false;
+	u32 time = 0;
+
+	if (queue->cnt)
+	{
+		memcpy(rpt_buffer, queue->rpt[queue->head], size);
+		time = queue->time[queue->head];
+		queue->head = (queue->head + 1) & (HID_RPT_QUEUE_MAX - 1);
+		queue->cnt--;
+		queue->sent = true;
+		sampled = true;
+	}
+	else if (!usbs->idle || !queue->sent)
+		return false;
+
+	// Send HID report. Repeats the last one if there's no new input.
+	if (_hid_transfer_start(usbs, size))
+		return true; // EP Error.
+
+	hid_ctx.lat_rpts++;
+	if (sampled)
+	{
+		u32 latency = get_tmr_us() - time;
+		hid_ctx.lat_samples++;
+		hid_ctx.lat_total += latency;
+		hid_ctx.lat_max = MAX(hid_ctx.lat_max, latency);
+	}
+
+	return false;
+}
+
+static void _hid_latency_update(usb_ctxt_t *usbs)
+{
+	if ((get_tmr_us() - hid_ctx.lat_timer) < 1000000)
+		return;
+
+	if (usbs->latency)
+	{
+		char txt_buf[128];
+		u32 avg = hid_ctx.lat_samples ? hid_ctx.lat_total / hid_ctx.lat_samples : 0;
+		s_printf(txt_buf, "#C7EA46 Rate:# %d Hz, #C7EA46 Latency:# %d us avg, %d us max",
+			hid_ctx.lat_rpts, avg, hid_ctx.lat_max);
+		usbs->set_text(usbs->label, txt_buf);
+	}
+
+	hid_ctx.lat_rpts    = 0;
+	hid_ctx.lat_samples = 0;
+	hid_ctx.lat_total   = 0;
+	hid_ctx.lat_max     = 0;
+	hid_ctx.lat_timer   = get_tmr_us();
+}
+
+static bool _hid_sample_jc(usb_ctxt_t *usbs)
+{
+	gamepad_report_t rpt;
+	bool capture = hid_ctx.capture;
+
+	int res = _jc_poll(&rpt, &capture);
 	if (res == INPUT_POLL_EXIT)
 		return true;
 
-	// Send HID report.
-	if (res == INPUT_POLL_HAS_PACKET || usbs->idle)
-		if (_hid_transfer_start(usbs, sizeof(gamepad_report_t)))
-			return true; // EP Error.
+	if (res == INPUT_POLL_HAS_PACKET)
+		_hid_rpt_push(&rpt, sizeof(gamepad_report_t), get_tmr_us());
+
+	// Toggle latency stats with Capture.
+	if (capture && !hid_ctx.capture)
+	{
+		usbs->latency = !usbs->latency;
+		if (!usbs->latency)
+			usbs->set_text(usbs->label, "#C7EA46 Status:# Started HID emulation");
+	}
+	hid_ctx.capture = capture;
 
 	return false;
 }
 
-static bool _hid_poll_touch(usb_ctxt_t *usbs)
+static void _hid_sample_touch()
 {
-	_fts_touch_read(rpt_buffer);
+	touchpad_report_t rpt;
 
-	// Send HID report.
-	if (_hid_transfer_start(usbs, sizeof(touchpad_report_t)))
-		return true; // EP Error.
+	// Read on interrupt. Poll slowly otherwise, in case it's not asserted.
+	u32 time = get_tmr_us();
+	if (!touch_event_pending() && (time - hid_ctx.touch_timer) < HID_TOUCH_POLL_US)
+		return;
 
-	return false;
+	hid_ctx.touch_timer = time;
+	if (_fts_touch_read(&rpt))
+		_hid_rpt_push(&rpt, sizeof(touchpad_report_t), time);
 }
 
 int usb_device_gadget_hid(usb_ctxt_t *usbs)
 {
 	int res = 0;
 	u32 gadget_type;
-	u32 polling_time;
 
 	// Get USB Controller ops.
 	if (hw_get_chip_id() == GP_HIDREV_MAJOR_T210)
@@ -403,15 +530,9 @@ int usb_device_gadget_hid(usb_ctxt_t *usbs)
 	usbs->idle = 1;
 
 	if (usbs->type == USB_HID_GAMEPAD)
-	{
-		polling_time = 15000;
 		gadget_type = USB_GADGET_HID_GAMEPAD;
-	}
 	else
-	{
-		polling_time = 4000;
 		gadget_type = USB_GADGET_HID_TOUCHPAD;
-	}
 
 	usbs->set_text(usbs->label, "#C7EA46 Status:# Started USB");
 
@@ -435,11 +556,13 @@ int usb_device_gadget_hid(usb_ctxt_t *usbs)
 
 	usbs->set_text(usbs->label, "#C7EA46 Status:# Started HID emulation");
 
+	memset(&hid_ctx, 0, sizeof(hid_ctxt_t));
+	hid_ctx.frame_timer = get_tmr_us();
+	hid_ctx.lat_timer   = hid_ctx.frame_timer;
+
 	u32 timer_sys = get_tmr_ms() + 5000;
 	while (true)
 	{
-		u32 timer = get_tmr_us();
-
 		// Check for suspended USB in case the cable was pulled.
 		if (usb_ops.usb_device_get_suspended())
 			break; // Disconnected.
@@ -447,22 +570,26 @@ int usb_device_gadget_hid(usb_ctxt_t *usbs)
 		// Handle control endpoint.
 		usb_ops.usbd_handle_ep0_ctrl_setup(&usbs->idle);
 
-		// Parse input device.
+		// Sample input device. Changed reports are queued with their input time.
 		if (usbs->type == USB_HID_GAMEPAD)
 		{
-			if (_hid_poll_jc(usbs))
+			if (_hid_sample_jc(usbs))
 				break;
 		}
 		else
+			_hid_sample_touch();
+
+		// Send a report per frame. Synced transfer completes on host poll.
+		if ((get_tmr_us() - hid_ctx.frame_timer) >= HID_FRAME_US)
 		{
-			if (_hid_poll_touch(usbs))
-				break;
-		}
+			hid_ctx.frame_timer = get_tmr_us();
+			if (_hid_send_frame(usbs, rpt_size))
+				break; // EP Error.
 
-		// Wait max gadget timing.
-		timer = get_tmr_us() - timer;
-		if (timer < polling_time)
-			usleep(polling_time - timer);
+			_hid_latency_update(usbs);
+		}
+		else
+			usleep(HID_SAMPLE_US);
 
 		if (timer_sys < get_tmr_ms())
 		{
@@ -4,7 +4,7 @@
  * Copyright (c) 2003-2008 Alan Stern
  * Copyright (c) 2009 Samsung Electronics
  *                    Author: Michal Nazarewicz <m.nazarewicz@samsung.com>
- * Copyright (c) 2019-2024 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -26,6 +26,9 @@
 #include <soc/hw_init.h>
 #include <soc/timer.h>
 #include <soc/t210.h>
+#include <sec/se.h>
+#include <storage/nx_emmc_bis.h>
+#include <storage/nx_emmc_layout.h>
 #include <storage/sd.h>
 #include <storage/sdmmc.h>
 #include <storage/sdmmc_driver.h>
@@ -37,7 +40,7 @@
 //#define DPRINTF(...) gfx_printf(__VA_ARGS__)
 #define DPRINTF(...)
 
-#define UMS_MAX_LUN 1 // Only 1 disk/partition for now.
+#define UMS_MAX_LUN USB_UMS_LUN_MAX
 
 #define USB_BULK_CB_WRAP_LEN 31
 #define USB_BULK_CB_SIG      0x43425355 // USBC.
@@ -50,15 +53,69 @@
 #define USB_STATUS_FAIL        1
 #define USB_STATUS_PHASE_ERROR 2
 
+// USB Attached SCSI. Information Units are big endian.
+#define UAS_IU_COMMAND     0x01
+#define UAS_IU_SENSE       0x03
+#define UAS_IU_RESPONSE    0x04
+#define UAS_IU_TASK_MGMT   0x05
+#define UAS_IU_READ_READY  0x06
+#define UAS_IU_WRITE_READY 0x07
+
+#define UAS_CMD_IU_LEN       32
+#define UAS_TASK_MGMT_IU_LEN 16
+#define UAS_SENSE_IU_LEN     16 // Without sense data.
+#define UAS_RESPONSE_IU_LEN  8
+#define UAS_READY_IU_LEN     4
+#define UAS_IU_MAX_LEN       512
+
+#define UAS_TMF_ABORT_TASK         0x01
+#define UAS_TMF_ABORT_TASK_SET     0x02
+#define UAS_TMF_CLEAR_TASK_SET     0x04
+#define UAS_TMF_LOGICAL_UNIT_RESET 0x08
+#define UAS_TMF_I_T_NEXUS_RESET    0x10
+#define UAS_TMF_QUERY_TASK         0x80
+#define UAS_TMF_QUERY_TASK_SET     0x81
+
+#define UAS_RC_TMF_COMPLETE      0x00
+#define UAS_RC_INVALID_IU        0x02
+#define UAS_RC_TMF_NOT_SUPPORTED 0x04
+#define UAS_RC_TMF_SUCCEEDED     0x08
+#define UAS_RC_INCORRECT_LUN     0x09
+#define UAS_RC_OVERLAPPED_TAG    0x0A
+
+#define UAS_QUEUE_DEPTH 16
+
+#define SAM_STAT_GOOD            0x00
+#define SAM_STAT_CHECK_CONDITION 0x02
+
+// Status pipe IUs and the command pipe IU, which is received while data moves.
+#define UMS_UAS_IU_BUF_ADDR  (USB_EP_BULK_OUT_BUF_ADDR + USB_EP_BUFFER_MAX_SIZE)
+#define UMS_UAS_CMD_BUF_ADDR (UMS_UAS_IU_BUF_ADDR + USB_EP_BUFFER_ALIGN)
+
 #define UMS_DISK_LBA_SHIFT 9
 #define UMS_DISK_LBA_SIZE  (1 << UMS_DISK_LBA_SHIFT)
 
 #define UMS_DISK_MAX_IO_TRANSFER_64K (USB_EP_BUFFER_MAX_SIZE >> UMS_DISK_LBA_SHIFT)
 #define UMS_DISK_MAX_IO_TRANSFER_32K (UMS_DISK_MAX_IO_TRANSFER_64K / 2)
+#define UMS_DISK_MAX_IO_TRANSFER_CHAIN (USB_EP_CHAIN_MAX_SIZE >> UMS_DISK_LBA_SHIFT)
 
 #define UMS_SCSI_TRANSFER_512K (0x80000 >> UMS_DISK_LBA_SHIFT)
 
-#define UMS_EP_OUT_MAX_XFER (USB_EP_BULK_OUT_MAX_XFER)
+// Reads go in big chunks to a ring of buffers and are sent from there.
+#define UMS_READ_BUF_ADDR    SDXC_BUF_ALIGNED
+#define UMS_READ_CHUNK_MAX   SZ_2M
+#define UMS_READ_CHUNKS      4
+#define UMS_READ_BUFS        4
+
+// Writes alternate between two chunk buffers. CBWs still use the EP OUT buffer.
+#define UMS_WRITE_BUF_ADDR   SDXC_BUF_ALIGNED
+#define UMS_WRITE_CHUNK_MAX  SZ_4M
+#define UMS_WRITE_CHUNKS     4
+
+// Unmapped blocks are discarded and read back as zeroes. Limits per command.
+#define UMS_UNMAP_LBA_MAX    (SZ_1G >> UMS_DISK_LBA_SHIFT)
+#define UMS_UNMAP_DESC_MAX   32
+#define UMS_UNMAP_PARAM_MAX  (8 + UMS_UNMAP_DESC_MAX * 16)
 
 // Length of a SCSI Command Data Block.
 #define SCSI_MAX_CMD_SZ 16
@@ -83,22 +140,30 @@
 #define SC_READ_HEADER        0x44
 #define SC_READ_TOC           0x43
 #define SC_RELEASE            0x17
+#define SC_REPORT_LUNS        0xA0
 #define SC_REQUEST_SENSE      0x03
 #define SC_RESERVE            0x16
 #define SC_SEND_DIAGNOSTIC    0x1D
+#define SC_SERVICE_ACTION_IN_16 0x9E
 #define SC_START_STOP_UNIT    0x1B
 #define SC_SYNCHRONIZE_CACHE  0x35
 #define SC_TEST_UNIT_READY    0x00
+#define SC_UNMAP              0x42
 #define SC_VERIFY             0x2F
 #define SC_WRITE_6            0x0A
 #define SC_WRITE_10           0x2A
 #define SC_WRITE_12           0xAA
+#define SC_WRITE_SAME_16      0x93
+
+// SERVICE ACTION IN(16) actions.
+#define SAI_READ_CAPACITY_16  0x10
 
 // SCSI Sense Key/Additional Sense Code/ASC Qualifier values.
 #define SS_NO_SENSE                           0x0
 #define SS_COMMUNICATION_FAILURE              0x40800
 #define SS_INVALID_COMMAND                    0x52000
 #define SS_INVALID_FIELD_IN_CDB               0x52400
+#define SS_INVALID_FIELD_IN_PARAMETER_LIST    0x52600
 #define SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE 0x52100
 #define SS_MEDIUM_NOT_PRESENT                 0x23A00
 #define SS_MEDIUM_REMOVAL_PREVENTED           0x55302
@@ -160,6 +225,34 @@ typedef struct _bulk_send_pkt_t {
 	u8  Status;
 } bulk_send_pkt_t;
 
+typedef struct _uas_cmd_iu_t {
+	u8 iu_id;
+	u8 rsvd0;
+	u8 tag[2];
+	u8 prio_attr;
+	u8 rsvd1;
+	u8 add_cdb_len; // Bits 7:2, in dwords.
+	u8 rsvd2;
+	u8 lun[8];
+	u8 cdb[16];
+} uas_cmd_iu_t;
+
+typedef struct _uas_task_mgmt_iu_t {
+	u8 iu_id;
+	u8 rsvd0;
+	u8 tag[2];
+	u8 function;
+	u8 rsvd1;
+	u8 task_tag[2];
+	u8 lun[8];
+} uas_task_mgmt_iu_t;
+
+typedef struct _uas_task_t {
+	u16 tag;
+	u8  lun;
+	u8  cdb[16];
+} uas_task_t;
+
 typedef struct _logical_unit_t
 {
 	sdmmc_t *sdmmc;
@@ -173,6 +266,8 @@ typedef struct _logical_unit_t
 	u32 ro;
 	u32 type;
 	u32 partition;
+	u32 bis; // BIS partition id. Data are decrypted/encrypted on the fly.
+	nx_emmc_layout_t *layout; // File based emuMMC. Sectors are mapped through it.
 	u32 removable;
 	u32 prevent_medium_removal;
 
@@ -200,6 +295,18 @@ typedef struct _bulk_ctxt_t {
 	enum buffer_state bulk_out_buf_state;
 } bulk_ctxt_t;
 
+typedef struct _read_ring_t {
+	u32  lba;     // Next LBA to read.
+	u32  left;    // Sectors left to read.
+	u32  chunk;   // Sectors per read.
+	u32  rd_idx;  // Chunks read or in flight.
+	u32  tx_idx;  // Chunk that is sent.
+	u32  err_idx; // Chunk that failed.
+	u32  cnt[UMS_READ_BUFS];
+	int  res;
+	bool pending;
+} read_ring_t;
+
 typedef struct _usbd_gadget_ums_t {
 	bulk_ctxt_t bulk_ctxt;
 
@@ -207,7 +314,9 @@ typedef struct _usbd_gadget_ums_t {
 	u8   cmnd[SCSI_MAX_CMD_SZ];
 
 	u32  lun_idx; // lun index
-	logical_unit_t lun;
+	u32  lun_cnt;
+	logical_unit_t *lun; // Current LUN.
+	logical_unit_t luns[UMS_MAX_LUN];
 
 	enum ums_state state; // For exception handling.
 
@@ -227,10 +336,18 @@ typedef struct _usbd_gadget_ums_t {
 
 	u32 timeouts;
 	bool xusb;
+	bool uas;
+	bool uas_ready_sent;
+	bool uas_running; // Command in tag is running.
+	u32  uas_queued;
+	uas_task_t uas_queue[UAS_QUEUE_DEPTH]; // In arrival order.
 
 	void (*system_maintenance)(bool);
 	void *label;
 	void (*set_text)(void *, const char *);
+
+	usb_ums_stats_t *stats;
+	void (*stats_update)(usb_ums_stats_t *);
 } usbd_gadget_ums_t;
 
 static usb_ops_t usb_ops;
@@ -316,8 +433,254 @@ static void _flush_endpoint(u32 ep)
 		usb_ops.usbd_flush_endpoint(ep);
 }
 
+static void _uas_send_iu(usbd_gadget_ums_t *ums, u8 *iu, u32 len)
+{
+	int res = usb_ops.usb_device_ep2_in_write(iu, len, NULL, USB_XFER_SYNCED_CMD);
+	if (res == USB_ERROR_XFER_ERROR)
+		ums->set_text(ums->label, "#FFDD00 Error:# EP IN status transfer!");
+}
+
+static void _uas_send_response(usbd_gadget_ums_t *ums, u16 tag, u8 code)
+{
+	u8 *iu = (u8 *)UMS_UAS_IU_BUF_ADDR;
+
+	memset(iu, 0, UAS_RESPONSE_IU_LEN);
+	iu[0] = UAS_IU_RESPONSE;
+	put_array_le_to_be16(tag, &iu[2]);
+	iu[7] = code;
+
+	_uas_send_iu(ums, iu, UAS_RESPONSE_IU_LEN);
+}
+
+static int _uas_queue_find(usbd_gadget_ums_t *ums, u16 tag)
+{
+	for (u32 i = 0; i < ums->uas_queued; i++)
+		if (ums->uas_queue[i].tag == tag)
+			return i;
+
+	return -1;
+}
+
+static void _uas_queue_remove(usbd_gadget_ums_t *ums, u32 idx)
+{
+	ums->uas_queued--;
+	memmove(&ums->uas_queue[idx], &ums->uas_queue[idx + 1], (ums->uas_queued - idx) * sizeof(uas_task_t));
+}
+
+// Drops the queued commands of a LUN, or all of them if lun is -1. Aborted commands get no status.
+static void _uas_queue_abort(usbd_gadget_ums_t *ums, int lun)
+{
+	for (u32 i = 0; i < ums->uas_queued;)
+	{
+		if (lun < 0 || ums->uas_queue[i].lun == lun)
+			_uas_queue_remove(ums, i);
+		else
+			i++;
+	}
+}
+
+/*
+ * Queued commands are aborted or queried by tag.
+ * The running command always completes with its status, so it is only reported as present.
+ */
+static void _uas_task_mgmt(usbd_gadget_ums_t *ums, uas_task_mgmt_iu_t *tmf)
+{
+	u16 tag = get_array_be_to_le16(tmf->tag);
+	u16 task_tag = get_array_be_to_le16(tmf->task_tag);
+	u8 lun_idx = tmf->lun[1];
+	u8 code = UAS_RC_TMF_COMPLETE;
+	int idx;
+
+	if (tmf->function != UAS_TMF_I_T_NEXUS_RESET && (tmf->lun[0] || lun_idx >= ums->lun_cnt))
+	{
+		_uas_send_response(ums, tag, UAS_RC_INCORRECT_LUN);
+		return;
+	}
+
+	switch (tmf->function)
+	{
+	case UAS_TMF_ABORT_TASK:
+		idx = _uas_queue_find(ums, task_tag);
+		if (idx >= 0)
+			_uas_queue_remove(ums, idx);
+		break;
+
+	case UAS_TMF_ABORT_TASK_SET:
+	case UAS_TMF_CLEAR_TASK_SET:
+		_uas_queue_abort(ums, lun_idx);
+		break;
+
+	case UAS_TMF_QUERY_TASK:
+		if (_uas_queue_find(ums, task_tag) >= 0 || (ums->uas_running && ums->tag == task_tag))
+			code = UAS_RC_TMF_SUCCEEDED;
+		break;
+
+	case UAS_TMF_QUERY_TASK_SET:
+		if (ums->uas_running && ums->lun_idx == lun_idx)
+			code = UAS_RC_TMF_SUCCEEDED;
+		for (u32 i = 0; i < ums->uas_queued; i++)
+			if (ums->uas_queue[i].lun == lun_idx)
+				code = UAS_RC_TMF_SUCCEEDED;
+		break;
+
+	case UAS_TMF_LOGICAL_UNIT_RESET:
+	case UAS_TMF_I_T_NEXUS_RESET:
+		_uas_queue_abort(ums, tmf->function == UAS_TMF_LOGICAL_UNIT_RESET ? lun_idx : -1);
+
+		for (u32 i = 0; i < ums->lun_cnt; i++)
+		{
+			if (tmf->function == UAS_TMF_LOGICAL_UNIT_RESET && i != lun_idx)
+				continue;
+
+			logical_unit_t *lun = &ums->luns[i];
+
+			lun->prevent_medium_removal = 0;
+			lun->sense_data             = SS_NO_SENSE;
+			lun->sense_data_info        = 0;
+			lun->info_valid             = 0;
+			lun->unit_attention_data    = SS_RESET_OCCURRED;
+		}
+		break;
+
+	default:
+		code = UAS_RC_TMF_NOT_SUPPORTED;
+		break;
+	}
+
+	_uas_send_response(ums, tag, code);
+}
+
+// Task management runs right away. Commands are checked and queued by tag.
+static void _uas_receive_iu(usbd_gadget_ums_t *ums, u8 *buf, u32 len)
+{
+	if (buf[0] == UAS_IU_TASK_MGMT && len >= UAS_TASK_MGMT_IU_LEN)
+	{
+		_uas_task_mgmt(ums, (uas_task_mgmt_iu_t *)buf);
+		return;
+	}
+
+	uas_cmd_iu_t *cmd = (uas_cmd_iu_t *)buf;
+	u16 tag = get_array_be_to_le16(cmd->tag);
+
+	// Is the IU valid? Additional CDB bytes are not supported.
+	if (cmd->iu_id != UAS_IU_COMMAND || len < UAS_CMD_IU_LEN || (cmd->add_cdb_len >> 2))
+	{
+		gfx_printf("USB: invalid IU: id %X len %X\n", cmd->iu_id, len);
+		_uas_send_response(ums, tag, UAS_RC_INVALID_IU);
+		return;
+	}
+
+	if (cmd->lun[0] || cmd->lun[1] >= ums->lun_cnt)
+	{
+		_uas_send_response(ums, tag, UAS_RC_INCORRECT_LUN);
+		return;
+	}
+
+	// A tag can only be used by one command at a time.
+	if (_uas_queue_find(ums, tag) >= 0 || (ums->uas_running && ums->tag == tag))
+	{
+		_uas_send_response(ums, tag, UAS_RC_OVERLAPPED_TAG);
+		return;
+	}
+
+	uas_task_t *task = &ums->uas_queue[ums->uas_queued++];
+	task->tag = tag;
+	task->lun = cmd->lun[1];
+	memcpy(task->cdb, cmd->cdb, sizeof(task->cdb));
+}
+
+// Lets the host send the next IU. Only while there's room to queue a command, otherwise it waits.
+static void _uas_cmd_read_start(usbd_gadget_ums_t *ums)
+{
+	if (ums->cbw_req_queued || ums->uas_queued >= UAS_QUEUE_DEPTH)
+		return;
+
+	usb_ops.usb_device_ep2_out_read((u8 *)UMS_UAS_CMD_BUF_ADDR, UAS_IU_MAX_LEN, NULL, USB_XFER_START);
+	ums->cbw_req_queued = true;
+}
+
+/*
+ * Takes the IUs that arrived while a command runs, so the host can keep sending them.
+ * Only called while no data transfer is in flight, so no endpoint event is lost.
+ */
+static void _uas_cmd_poll(usbd_gadget_ums_t *ums)
+{
+	u32 len = 0;
+
+	if (!ums->uas)
+		return;
+
+	// Check once for each. Command pipe events are also handled by data transfers.
+	while (ums->cbw_req_queued && !usb_ops.usb_device_ep2_out_reading_finish(&len, 1))
+	{
+		ums->cbw_req_queued = false;
+		_uas_receive_iu(ums, (u8 *)UMS_UAS_CMD_BUF_ADDR, len);
+		_uas_cmd_read_start(ums);
+	}
+}
+
+// Without streams, the host starts a data transfer only after the device asks for it.
+static void _uas_send_ready(usbd_gadget_ums_t *ums)
+{
+	if (!ums->uas || ums->uas_ready_sent)
+		return;
+
+	u8 *iu = (u8 *)UMS_UAS_IU_BUF_ADDR;
+
+	memset(iu, 0, UAS_READY_IU_LEN);
+	iu[0] = ums->data_dir == DATA_DIR_TO_HOST ? UAS_IU_READ_READY : UAS_IU_WRITE_READY;
+	put_array_le_to_be16(ums->tag, &iu[2]);
+
+	_uas_send_iu(ums, iu, UAS_READY_IU_LEN);
+	ums->uas_ready_sent = true;
+
+	_uas_cmd_poll(ums);
+}
+
+static inline u32 _stats_start(usbd_gadget_ums_t *ums)
+{
+	return ums->stats ? get_tmr_us() : 0;
+}
+
+static inline void _stats_wait(usbd_gadget_ums_t *ums, u32 type, u32 start)
+{
+	if (ums->stats)
+		ums->stats->wait_us[type] += get_tmr_us() - start;
+}
+
+static void _stats_cmd(usbd_gadget_ums_t *ums, u32 start)
+{
+	usb_ums_stats_t *stats = ums->stats;
+	if (!stats)
+		return;
+
+	u32 lat = get_tmr_us() - start;
+	u32 bytes = ums->data_size > ums->residue ? ums->data_size - ums->residue : 0;
+
+	u32 bucket = 0;
+	while (bucket < (USB_UMS_LAT_BUCKETS - 1) && lat >= (64U << bucket))
+		bucket++;
+
+	stats->cmds++;
+	stats->op_cmds[ums->cmnd[0]]++;
+	stats->op_bytes[ums->cmnd[0]] += bytes;
+	if (ums->data_dir == DATA_DIR_TO_HOST)
+		stats->rd_bytes += bytes;
+	else if (ums->data_dir == DATA_DIR_FROM_HOST)
+		stats->wr_bytes += bytes;
+
+	stats->lat_hist[bucket]++;
+	stats->lat_max_us = MAX(stats->lat_max_us, lat);
+}
+
 static void _transfer_start(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u32 ep, u32 sync_timeout)
 {
+	// Waiting for a command is accounted as host time.
+	bool data_wait = sync_timeout && sync_timeout != USB_XFER_SYNCED_CMD;
+	u32 timer = _stats_start(ums);
+
+	_uas_send_ready(ums);
+
 	if (ep == bulk_ctxt->bulk_in)
 	{
 		bulk_ctxt->bulk_in_status = usb_ops.usb_device_ep1_in_write(
@@ -352,25 +715,16 @@ static void _transfer_start(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u32
 		if (sync_timeout)
 			bulk_ctxt->bulk_out_buf_state = BUF_STATE_FULL;
 	}
-}
 
-static void _transfer_out_big_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
-{
-		bulk_ctxt->bulk_out_status = usb_ops.usb_device_ep1_out_read_big(
-			bulk_ctxt->bulk_out_buf, bulk_ctxt->bulk_out_length,
-			&bulk_ctxt->bulk_out_length_actual);
-
-		if (bulk_ctxt->bulk_out_status == USB_ERROR_XFER_ERROR)
-		{
-			ums->set_text(ums->label, "#FFDD00 Error:# EP OUT transfer!");
-			_flush_endpoint(bulk_ctxt->bulk_out);
-		}
-
-		bulk_ctxt->bulk_out_buf_state = BUF_STATE_FULL;
+	if (data_wait)
+		_stats_wait(ums, USB_UMS_WAIT_USB, timer);
 }
 
 static void _transfer_finish(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u32 ep, u32 sync_timeout)
 {
+	bool data_wait = sync_timeout != USB_XFER_SYNCED_CMD;
+	u32 timer = _stats_start(ums);
+
 	if (ep == bulk_ctxt->bulk_in)
 	{
 		bulk_ctxt->bulk_in_status = usb_ops.usb_device_ep1_in_writing_finish(
@@ -397,6 +751,9 @@ static void _transfer_finish(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u32
 
 		bulk_ctxt->bulk_out_buf_state = BUF_STATE_FULL;
 	}
+
+	if (data_wait)
+		_stats_wait(ums, USB_UMS_WAIT_USB, timer);
 }
 
 static void _reset_buffer(bulk_ctxt_t *bulk_ctxt, u32 ep)
@@ -438,11 +795,98 @@ static void _reset_buffer(bulk_ctxt_t *bulk_ctxt, u32 ep)
  *  --.- --/-,  23.8 MB/s,  27.2 MB/s, 25.8 MB/s, 17.5 MB/s - SCSI  64KB, Concurrency.
  */
 
+// eMMC LUNs share the same storage. Switch to the partition of the current one.
+static int _lun_select_partition(usbd_gadget_ums_t *ums)
+{
+	logical_unit_t *lun = ums->lun;
+
+	if (lun->type != MMC_EMMC || lun->storage->partition == (lun->partition - 1))
+		return 0;
+
+	return emmc_set_partition(lun->partition - 1);
+}
+
+/*
+ * Maps an LBA to a storage sector. File based LUNs are split at fragment ends,
+ * so count is limited to the contiguous sectors. Returns 1 if out of the files.
+ */
+static int _lun_map(logical_unit_t *lun, u32 lba, u32 *sector, u32 *count)
+{
+	*sector = lun->offset + lba;
+	if (!lun->layout)
+		return 0;
+
+	u32 cnt = nx_emmc_layout_map(lun->layout, lun->partition - 1, *sector, sector);
+	if (!cnt)
+		return 1;
+
+	*count = MIN(*count, cnt);
+
+	return 0;
+}
+
+// Unmapped BIS blocks would decrypt to garbage, so only raw LUNs are thin provisioned.
+static bool _lun_can_unmap(logical_unit_t *lun)
+{
+	return !lun->ro && !lun->bis && sdmmc_storage_can_discard(lun->storage);
+}
+
+static u8 *_read_ring_buf(u32 idx)
+{
+	return (u8 *)UMS_READ_BUF_ADDR + (idx % UMS_READ_BUFS) * UMS_READ_CHUNK_MAX;
+}
+
+// Starts the next read, if none is running and a buffer is free.
+static void _read_ring_fill(usbd_gadget_ums_t *ums, read_ring_t *ring)
+{
+	// The buffer before the sent one can still be in the last USB transfer.
+	if (ring->pending || ring->res || !ring->left || (ring->rd_idx - ring->tx_idx) >= (UMS_READ_BUFS - 1))
+		return;
+
+	u32 sector;
+	u32 cnt = MIN(ring->left, ring->chunk);
+	u8 *buf = _read_ring_buf(ring->rd_idx);
+
+	if (_lun_map(ums->lun, ring->lba, &sector, &cnt))
+		ring->res = 1;
+	else
+	{
+		// Fallback to a normal read if it can't run in the background.
+		ring->pending = !sdmmc_storage_read_async(ums->lun->storage, sector, cnt, buf);
+		if (!ring->pending)
+		{
+			u32 timer = _stats_start(ums);
+			ring->res = sdmmc_storage_read(ums->lun->storage, sector, cnt, buf);
+			_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+		}
+	}
+
+	ring->cnt[ring->rd_idx % UMS_READ_BUFS] = cnt;
+	ring->err_idx = ring->rd_idx;
+	ring->rd_idx++;
+	ring->lba  += cnt;
+	ring->left -= cnt;
+}
+
+// Collects the background read if it's done or if asked to wait, and starts the next one.
+static void _read_ring_service(usbd_gadget_ums_t *ums, read_ring_t *ring, bool wait)
+{
+	if (ring->pending && (wait || sdmmc_async_done()))
+	{
+		u32 timer = _stats_start(ums);
+		ring->pending = false;
+		ring->res = sdmmc_storage_async_end(ums->lun->storage);
+		_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+	}
+
+	_read_ring_fill(ums, ring);
+}
+
 static int _scsi_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	u32 lba_offset;
-	bool first_read = true;
-	u8 *sdmmc_buf = (u8 *)SDXC_BUF_ALIGNED;
+	bool usb_pending = false;
+	read_ring_t ring = {0};
 
 	// Get the starting LBA and check that it's not too big.
 	if (ums->cmnd[0] == SC_READ_6)
@@ -454,15 +898,15 @@ static int _scsi_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		// We allow DPO and FUA bypass cache bits, but we don't use them.
 		if ((ums->cmnd[1] & ~0x18) != 0)
 		{
-			ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+			ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 			return UMS_RES_INVALID_ARG;
 		}
 	}
-	if (lba_offset >= ums->lun.num_sectors)
+	if (lba_offset >= ums->lun->num_sectors)
 	{
 		ums->set_text(ums->label, "#FF8000 Warn:# Read - Out of range! Host notified.");
-		ums->lun.sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+		ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -472,65 +916,104 @@ static int _scsi_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	if (!amount_left)
 		return UMS_RES_IO_ERROR; // No default reply.
 
-	// Limit IO transfers based on request for faster concurrent reads.
+	if (_lun_select_partition(ums))
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Read!");
+		ums->lun->sense_data = SS_UNRECOVERED_READ_ERROR;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	// Limit USB transfers based on request for faster concurrent reads.
 	u32 max_io_transfer = (amount_left >= UMS_SCSI_TRANSFER_512K) ?
 						  UMS_DISK_MAX_IO_TRANSFER_64K : UMS_DISK_MAX_IO_TRANSFER_32K;
 
-	while (true)
+	// Big requests are sent in chained transfers, so the link does not idle between parts.
+	u32 max_usb_transfer = (amount_left >= UMS_SCSI_TRANSFER_512K) ?
+						   UMS_DISK_MAX_IO_TRANSFER_CHAIN : max_io_transfer;
+
+	// Use at least a few reads, so that the first USB transfer starts early. A read past the end is reported last.
+	ring.lba   = lba_offset;
+	ring.left  = MIN(amount_left, ums->lun->num_sectors - lba_offset);
+	ring.chunk = ALIGN(MAX(amount_left / UMS_READ_CHUNKS, 1), max_io_transfer);
+	ring.chunk = MIN(ring.chunk, UMS_READ_CHUNK_MAX >> UMS_DISK_LBA_SHIFT);
+
+	_read_ring_fill(ums, &ring);
+
+	while (ring.tx_idx < ring.rd_idx)
 	{
-		// Max io size and end sector limits.
-		u32 amount = MIN(amount_left, max_io_transfer);
-		amount     = MIN(amount, ums->lun.num_sectors - lba_offset);
+		// Wait for the chunk if it is still read.
+		if (ring.tx_idx + 1 == ring.rd_idx)
+			_read_ring_service(ums, &ring, true);
 
-		// Check if it is a read past the end sector.
-		if (!amount)
-		{
-			ums->lun.sense_data      = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
-			ums->lun.sense_data_info = lba_offset;
-			ums->lun.info_valid      = 1;
+		u32 cnt = ring.cnt[ring.tx_idx % UMS_READ_BUFS];
+		u8 *buf = _read_ring_buf(ring.tx_idx);
 
-			bulk_ctxt->bulk_in_length = 0;
-			bulk_ctxt->bulk_in_buf_state = BUF_STATE_FULL;
+		if (ring.res && ring.err_idx == ring.tx_idx)
+			break;
+
+		if (ums->lun->bis && nx_emmc_bis_crypt(ums->lun->bis, DECRYPT, lba_offset, cnt, buf, buf))
+		{
+			ring.res = 1;
 			break;
 		}
 
-		// Do the SDMMC read.
-		if (sdmmc_storage_read(ums->lun.storage, ums->lun.offset + lba_offset, amount, sdmmc_buf))
-			amount = 0;
+		// Send it directly in USB transfer sized parts.
+		for (u32 sent = 0; sent < cnt;)
+		{
+			u32 amount = MIN(cnt - sent, max_usb_transfer);
 
-		// Wait for the async USB transfer to finish.
-		if (!first_read)
-			_transfer_finish(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_SYNCED);
+			// Wait for the async USB transfer to finish.
+			if (usb_pending)
+				_transfer_finish(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_SYNCED);
+			usb_pending = false;
 
-		lba_offset   += amount;
-		amount_left  -= amount;
-		ums->residue -= amount << UMS_DISK_LBA_SHIFT;
+			_uas_cmd_poll(ums);
 
-		bulk_ctxt->bulk_in_length    = amount << UMS_DISK_LBA_SHIFT;
-		bulk_ctxt->bulk_in_buf_state = BUF_STATE_FULL;
-		bulk_ctxt->bulk_in_buf       = sdmmc_buf;
+			lba_offset   += amount;
+			amount_left  -= amount;
+			ums->residue -= amount << UMS_DISK_LBA_SHIFT;
 
-		// If an error occurred, report it and its position.
-		if (!amount)
-		{
-			ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Read!");
-			ums->lun.sense_data      = SS_UNRECOVERED_READ_ERROR;
-			ums->lun.sense_data_info = lba_offset;
-			ums->lun.info_valid      = 1;
-			break;
+			bulk_ctxt->bulk_in_length    = amount << UMS_DISK_LBA_SHIFT;
+			bulk_ctxt->bulk_in_buf_state = BUF_STATE_FULL;
+			bulk_ctxt->bulk_in_buf       = buf + (sent << UMS_DISK_LBA_SHIFT);
+			sent += amount;
+
+			// Last part will be sent by the finish reply function.
+			if (!amount_left)
+				return UMS_RES_IO_ERROR; // No default reply.
+
+			// Start the USB transfer and keep the reads going.
+			_transfer_start(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_START);
+			usb_pending = true;
+
+			_read_ring_service(ums, &ring, false);
 		}
 
-		// Last SDMMC read. Last part will be sent by the finish reply function.
-		if (!amount_left)
-			break;
+		ring.tx_idx++;
+		_read_ring_fill(ums, &ring);
+	}
+
+	if (usb_pending)
+		_transfer_finish(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_SYNCED);
+
+	// Do not leave a background read running.
+	if (ring.pending)
+		sdmmc_storage_async_end(ums->lun->storage);
 
-		// Start the USB transfer.
-		_transfer_start(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_START);
-		first_read = false;
+	bulk_ctxt->bulk_in_length = 0;
+	bulk_ctxt->bulk_in_buf_state = BUF_STATE_FULL;
 
-		// Increment our buffer to read new data.
-		sdmmc_buf += amount << UMS_DISK_LBA_SHIFT;
+	// If an error occurred, report it and its position.
+	if (ring.res)
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Read!");
+		ums->lun->sense_data = SS_UNRECOVERED_READ_ERROR;
 	}
+	else
+		ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+	ums->lun->sense_data_info = lba_offset;
+	ums->lun->info_valid      = 1;
 
 	return UMS_RES_IO_ERROR; // No default reply.
 }
@@ -538,21 +1021,135 @@ static int _scsi_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 /*
  * Writes are another story.
  * Tests showed that big writes are faster than concurrent 32K usb reads + writes.
- * The only thing that can help here is caching the writes. But for the simplicity
- * of this implementation it will not be implemented yet.
+ * So transfers are split in a few big chunks, that alternate between two buffers.
+ * Each chunk is received in chained USB transfers.
+ * The next chunk is received while the previous one is written in the background
+ * and the command finishes when the last chunk is written. A failed write is
+ * reported with the LBA of its chunk, even if the next chunk was already received.
  */
 
+static void _transfer_out_chunk_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u8 *buf, u32 len)
+{
+	u32 bytes = 0;
+	u32 timer = _stats_start(ums);
+
+	bulk_ctxt->bulk_out_length = len;
+	bulk_ctxt->bulk_out_length_actual = 0;
+	bulk_ctxt->bulk_out_status = USB_RES_OK;
+
+	_uas_send_ready(ums);
+
+	while (len)
+	{
+		u32 len_ep = MIN(len, USB_EP_CHAIN_MAX_SIZE);
+
+		bulk_ctxt->bulk_out_status = usb_ops.usb_device_ep1_out_read(buf, len_ep, &bytes, USB_XFER_SYNCED_DATA);
+		_uas_cmd_poll(ums);
+
+		if (bulk_ctxt->bulk_out_status)
+		{
+			if (bulk_ctxt->bulk_out_status == USB_ERROR_XFER_ERROR)
+			{
+				ums->set_text(ums->label, "#FFDD00 Error:# EP OUT transfer!");
+				_flush_endpoint(bulk_ctxt->bulk_out);
+			}
+			break;
+		}
+
+		bulk_ctxt->bulk_out_length_actual += bytes;
+
+		// Host sent a short packet.
+		if (bytes < len_ep)
+			break;
+
+		len -= len_ep;
+		buf += len_ep;
+	}
+
+	bulk_ctxt->bulk_out_buf_state = BUF_STATE_FULL;
+
+	_stats_wait(ums, USB_UMS_WAIT_USB, timer);
+}
+
+static int _scsi_write_start(usbd_gadget_ums_t *ums, u32 lba_offset, u32 amount, u8 *buf, bool *pending)
+{
+	int res = 0;
+	u32 timer;
+	u32 sector, cnt;
+	u32 num_sectors = amount >> UMS_DISK_LBA_SHIFT;
+
+	*pending = false;
+
+	// Encrypt in place. The chunk buffer is not used again.
+	if (ums->lun->bis && nx_emmc_bis_crypt(ums->lun->bis, ENCRYPT, lba_offset, num_sectors, buf, buf))
+		return 1;
+
+	// Parts before a fragment end are written directly. Only the last one runs in the background.
+	timer = _stats_start(ums);
+	while (true)
+	{
+		cnt = num_sectors;
+		res = _lun_map(ums->lun, lba_offset, &sector, &cnt);
+		if (res || cnt == num_sectors)
+			break;
+
+		res = sdmmc_storage_write(ums->lun->storage, sector, cnt, buf);
+		if (res)
+			break;
+
+		lba_offset  += cnt;
+		num_sectors -= cnt;
+		buf += cnt << UMS_DISK_LBA_SHIFT;
+	}
+
+	// Fallback to a normal write if it can't run in the background.
+	if (!res)
+	{
+		*pending = !sdmmc_storage_write_async(ums->lun->storage, sector, num_sectors, buf);
+		if (!*pending)
+			res = sdmmc_storage_write(ums->lun->storage, sector, num_sectors, buf);
+	}
+	_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+
+	return res;
+}
+
+static int _scsi_write_end(usbd_gadget_ums_t *ums, bool pending, int res, u32 lba_offset)
+{
+	if (pending)
+	{
+		u32 timer = _stats_start(ums);
+		res = sdmmc_storage_async_end(ums->lun->storage);
+		_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+	}
+
+	// If an error occurred, report it and its position.
+	if (res)
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Write!");
+		ums->lun->sense_data      = SS_WRITE_ERROR;
+		ums->lun->sense_data_info = lba_offset;
+		ums->lun->info_valid      = 1;
+	}
+
+	return res;
+}
+
 static int _scsi_write(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	static char txt_buf[256];
 	u32 amount_left_to_req, amount_left_to_write;
 	u32 usb_lba_offset, lba_offset;
-	u32 amount;
+	u32 amount, chunk;
+	u32 write_amount = 0;
+	bool write_pending = false;
+	int write_res = 0;
+	u32 buf_idx = 0;
 
-	if (ums->lun.ro)
+	if (ums->lun->ro)
 	{
 		ums->set_text(ums->label, "#FF8000 Warn:# Write - Read only! Host notified.");
-		ums->lun.sense_data = SS_WRITE_PROTECTED;
+		ums->lun->sense_data = SS_WRITE_PROTECTED;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -563,20 +1160,28 @@ static int _scsi_write(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	{
 		lba_offset = get_array_be_to_le32(&ums->cmnd[2]);
 
-		// We allow DPO and FUA bypass cache bits. We only implement FUA by performing synchronous output.
+		// We allow DPO and FUA bypass cache bits. FUA is implied since writes finish before the status.
 		if (ums->cmnd[1] & ~0x18)
 		{
-			ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+			ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 			return UMS_RES_INVALID_ARG;
 		}
 	}
 
 	// Check that starting LBA is not past the end sector offset.
-	if (lba_offset >= ums->lun.num_sectors)
+	if (lba_offset >= ums->lun->num_sectors)
 	{
 		ums->set_text(ums->label, "#FF8000 Warn:# Write - Out of range! Host notified.");
-		ums->lun.sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+		ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	if (_lun_select_partition(ums))
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Write!");
+		ums->lun->sense_data = SS_WRITE_ERROR;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -586,21 +1191,25 @@ static int _scsi_write(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	amount_left_to_req   = ums->data_size_from_cmnd;
 	amount_left_to_write = ums->data_size_from_cmnd;
 
+	// Use at least 2 chunks, if the transfer is bigger than an EP transfer.
+	chunk = ALIGN(amount_left_to_req / UMS_WRITE_CHUNKS, USB_EP_BUFFER_MAX_SIZE);
+	chunk = MIN(chunk, UMS_WRITE_CHUNK_MAX);
+
 	while (amount_left_to_write > 0)
 	{
+		u8 *buf = (u8 *)UMS_WRITE_BUF_ADDR + buf_idx * UMS_WRITE_CHUNK_MAX;
+
 		// Queue a request for more data from the host.
 		if (amount_left_to_req > 0)
 		{
+			amount = MIN(amount_left_to_req, chunk);
 
-			// Limit write to max supported read from EP OUT.
-			amount = MIN(amount_left_to_req, UMS_EP_OUT_MAX_XFER);
-
-			if (usb_lba_offset >= ums->lun.num_sectors)
+			if (usb_lba_offset >= ums->lun->num_sectors)
 			{
 				ums->set_text(ums->label, "#FFDD00 Error:# Write - Past last sector!");
-				ums->lun.sense_data      = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
-				ums->lun.sense_data_info = usb_lba_offset;
-				ums->lun.info_valid      = 1;
+				ums->lun->sense_data      = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+				ums->lun->sense_data_info = usb_lba_offset;
+				ums->lun->info_valid      = 1;
 				break;
 			}
 
@@ -609,135 +1218,363 @@ static int _scsi_write(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 			ums->usb_amount_left -= amount;
 			amount_left_to_req   -= amount;
 
-			bulk_ctxt->bulk_out_length = amount;
+			_transfer_out_chunk_read(ums, bulk_ctxt, buf, amount);
+		}
+
+		// Wait for the previous chunk to be written.
+		if (write_amount)
+		{
+			if (_scsi_write_end(ums, write_pending, write_res, lba_offset))
+			{
+				// Already ended. Don't end it again below and overwrite its sense data.
+				write_amount = 0;
+				break;
+			}
+
+DPRINTF("file write %X @ %X\n", write_amount, lba_offset);
+
+			lba_offset           += write_amount >> UMS_DISK_LBA_SHIFT;
+			amount_left_to_write -= write_amount;
+			ums->residue         -= write_amount;
+			write_amount          = 0;
+		}
+
+		if (bulk_ctxt->bulk_out_buf_state != BUF_STATE_FULL)
+		{
+			// Nothing more will arrive. Happens only if the last chunk was limited.
+			if (!amount_left_to_req)
+				break;
+
+			continue;
+		}
+
+		bulk_ctxt->bulk_out_buf_state = BUF_STATE_EMPTY;
+
+		// Did something go wrong with the transfer?.
+		if (bulk_ctxt->bulk_out_status != 0)
+		{
+			ums->lun->sense_data      = SS_COMMUNICATION_FAILURE;
+			ums->lun->sense_data_info = lba_offset;
+			ums->lun->info_valid      = 1;
+
+			s_printf(txt_buf, "#FFDD00 Error:# Write - Comm failure %d!", bulk_ctxt->bulk_out_status);
+			ums->set_text(ums->label, txt_buf);
+			break;
+		}
+
+		amount = bulk_ctxt->bulk_out_length_actual;
+
+		if ((ums->lun->num_sectors - lba_offset) < (amount >> UMS_DISK_LBA_SHIFT))
+		{
+			DPRINTF("write %X @ %X beyond end %X\n", amount, lba_offset, ums->lun->num_sectors);
+			amount = (ums->lun->num_sectors - lba_offset) << UMS_DISK_LBA_SHIFT;
+		}
+
+		/*
+		 * Don't accept excess data.  The spec doesn't say
+		 * what to do in this case.  We'll ignore the error.
+		 */
+		amount = MIN(amount, bulk_ctxt->bulk_out_length);
+
+		// Don't write a partial block.
+		amount -= (amount & 511);
+		if (amount)
+		{
+			// Start the write and switch buffers for the next chunk.
+			write_res    = _scsi_write_start(ums, lba_offset, amount, buf, &write_pending);
+			write_amount = amount;
+			buf_idx ^= 1;
+		}
+
+		// Did the host decide to stop early?
+		if (bulk_ctxt->bulk_out_length_actual < bulk_ctxt->bulk_out_length)
+		{
+			ums->set_text(ums->label, "#FFDD00 Error:# Empty Write!");
+			ums->short_packet_received = 1;
+			break;
+		}
+	}
+
+	// Finish the last chunk if the loop ended early.
+	if (write_amount && !_scsi_write_end(ums, write_pending, write_res, lba_offset))
+		ums->residue -= write_amount;
+
+	return UMS_RES_IO_ERROR; // No default reply.
+}
+
+static int _scsi_verify(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	// Check that start LBA is past the end sector offset.
+	u32 lba_offset = get_array_be_to_le32(&ums->cmnd[2]);
+	if (lba_offset >= ums->lun->num_sectors)
+	{
+		ums->set_text(ums->label, "#FF8000 Warn:# Verif - Out of range! Host notified.");
+		ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	// We allow DPO but we don't implement it. Check that nothing else is enabled.
+	if (ums->cmnd[1] & ~0x10)
+	{
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	u32  verification_length = get_array_be_to_le16(&ums->cmnd[7]);
+	if (verification_length == 0)
+		return UMS_RES_IO_ERROR; // No default reply.
+
+	if (_lun_select_partition(ums))
+	{
+		ums->lun->sense_data = SS_UNRECOVERED_READ_ERROR;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	u32 amount;
+	while (verification_length > 0)
+	{
+
+		// Limit to EP buffer size and end sector offset.
+		amount = MIN(verification_length, USB_EP_BUFFER_MAX_SIZE >> UMS_DISK_LBA_SHIFT);
+		amount = MIN(amount, ums->lun->num_sectors - lba_offset);
+		if (amount == 0) {
+			ums->lun->sense_data      = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+			ums->lun->sense_data_info = lba_offset;
+			ums->lun->info_valid      = 1;
+			break;
+		}
+
+		u32 sector;
+		u32 timer = _stats_start(ums);
+		if (_lun_map(ums->lun, lba_offset, &sector, &amount) ||
+			sdmmc_storage_read(ums->lun->storage, sector, amount, bulk_ctxt->bulk_in_buf))
+			amount = 0;
+		_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+
+DPRINTF("File read %X @ %X\n", amount, lba_offset);
+
+		if (!amount)
+		{
+			ums->set_text(ums->label, "#FFDD00 Error:# File verify!");
+			ums->lun->sense_data      = SS_UNRECOVERED_READ_ERROR;
+			ums->lun->sense_data_info = lba_offset;
+			ums->lun->info_valid      = 1;
+			break;
+		}
+		lba_offset += amount;
+		verification_length -= amount;
+	}
+	return UMS_RES_OK;
+}
+
+// Receives a parameter list. Returns the received size or -1 on error.
+static int _scsi_param_list_read(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt, u8 *buf, u32 len)
+{
+	ums->usb_amount_left -= len;
+	_transfer_out_chunk_read(ums, bulk_ctxt, buf, len);
+	bulk_ctxt->bulk_out_buf_state = BUF_STATE_EMPTY;
+
+	if (bulk_ctxt->bulk_out_status)
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# Unmap - Comm failure!");
+		ums->lun->sense_data = SS_COMMUNICATION_FAILURE;
+
+		return -1;
+	}
+
+	u32 actual = MIN(bulk_ctxt->bulk_out_length_actual, len);
+	ums->residue -= actual;
+
+	// Did the host decide to stop early?
+	if (actual < len)
+		ums->short_packet_received = 1;
+
+	return actual;
+}
+
+static int _scsi_unmap_range(usbd_gadget_ums_t *ums, u32 lba_offset, u32 num_sectors)
+{
+	u32 timer = _stats_start(ums);
+	while (num_sectors)
+	{
+		u32 sector;
+		u32 cnt = num_sectors;
+		if (_lun_map(ums->lun, lba_offset, &sector, &cnt) ||
+			sdmmc_storage_discard(ums->lun->storage, sector, cnt))
+			break;
+
+		lba_offset  += cnt;
+		num_sectors -= cnt;
+	}
+	_stats_wait(ums, USB_UMS_WAIT_SDMMC, timer);
+
+	if (!num_sectors)
+		return 0;
+
+	ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Discard!");
+	ums->lun->sense_data      = SS_WRITE_ERROR;
+	ums->lun->sense_data_info = lba_offset;
+	ums->lun->info_valid      = 1;
+
+	return 1;
+}
+
+static int _scsi_unmap_check(usbd_gadget_ums_t *ums)
+{
+	if (ums->lun->ro)
+	{
+		ums->set_text(ums->label, "#FF8000 Warn:# Unmap - Read only! Host notified.");
+		ums->lun->sense_data = SS_WRITE_PROTECTED;
+
+		return 1;
+	}
+
+	// Not advertised for this LUN.
+	if (!_lun_can_unmap(ums->lun))
+	{
+		ums->lun->sense_data = SS_INVALID_COMMAND;
+
+		return 1;
+	}
+
+	return 0;
+}
 
-			_transfer_out_big_read(ums, bulk_ctxt);
-		}
+static int _scsi_unmap(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	u8 *buf = (u8 *)UMS_WRITE_BUF_ADDR;
+	u32 len = ums->data_size_from_cmnd;
 
-		if (bulk_ctxt->bulk_out_buf_state == BUF_STATE_FULL)
-		{
-			bulk_ctxt->bulk_out_buf_state = BUF_STATE_EMPTY;
+	if (_scsi_unmap_check(ums))
+		return UMS_RES_INVALID_ARG;
 
-			// Did something go wrong with the transfer?.
-			if (bulk_ctxt->bulk_out_status != 0)
-			{
-				ums->lun.sense_data      = SS_COMMUNICATION_FAILURE;
-				ums->lun.sense_data_info = lba_offset;
-				ums->lun.info_valid      = 1;
+	// No parameter list is not an error.
+	if (!len)
+		return UMS_RES_OK;
 
-				s_printf(txt_buf, "#FFDD00 Error:# Write - Comm failure %d!", bulk_ctxt->bulk_out_status);
-				ums->set_text(ums->label, txt_buf);
-				break;
-			}
+	if (len > UMS_UNMAP_PARAM_MAX)
+	{
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
-			amount = bulk_ctxt->bulk_out_length_actual;
+		return UMS_RES_INVALID_ARG;
+	}
 
-			if ((ums->lun.num_sectors - lba_offset) < (amount >> UMS_DISK_LBA_SHIFT))
-			{
-				DPRINTF("write %X @ %X beyond end %X\n", amount, lba_offset, ums->lun.num_sectors);
-				amount = (ums->lun.num_sectors - lba_offset) << UMS_DISK_LBA_SHIFT;
-			}
+	int actual = _scsi_param_list_read(ums, bulk_ctxt, buf, len);
+	if (actual < 0)
+		return UMS_RES_INVALID_ARG;
 
-			/*
-			 * Don't accept excess data.  The spec doesn't say
-			 * what to do in this case.  We'll ignore the error.
-			 */
-			amount = MIN(amount, bulk_ctxt->bulk_out_length);
+	// Header: data length, block descriptor data length, reserved.
+	if (actual < 8)
+		return UMS_RES_OK;
 
-			// Don't write a partial block.
-			amount -= (amount & 511);
-			if (amount == 0)
-				goto empty_write;
+	u32 desc_cnt = MIN(get_array_be_to_le16(&buf[2]), (u32)actual - 8) / 16;
+	u8 *desc = buf + 8;
 
-			// Perform the write.
-			if (sdmmc_storage_write(ums->lun.storage, ums->lun.offset + lba_offset,
-				amount >> UMS_DISK_LBA_SHIFT, (u8 *)bulk_ctxt->bulk_out_buf))
-				amount = 0;
+	// Check all descriptors before anything is discarded.
+	for (u32 i = 0; i < desc_cnt; i++)
+	{
+		u32 lba_hi = get_array_be_to_le32(&desc[i * 16]);
+		u32 lba    = get_array_be_to_le32(&desc[i * 16 + 4]);
+		u32 count  = get_array_be_to_le32(&desc[i * 16 + 8]);
 
-DPRINTF("file write %X @ %X\n", amount, lba_offset);
+		if (lba_hi || lba >= ums->lun->num_sectors || count > (ums->lun->num_sectors - lba))
+		{
+			ums->set_text(ums->label, "#FF8000 Warn:# Unmap - Out of range! Host notified.");
+			ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 
-			lba_offset           += amount >> UMS_DISK_LBA_SHIFT;
-			amount_left_to_write -= amount;
-			ums->residue         -= amount;
+			return UMS_RES_INVALID_ARG;
+		}
 
-			// If an error occurred, report it and its position.
-			if (!amount)
-			{
-				ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Write!");
-				ums->lun.sense_data      = SS_WRITE_ERROR;
-				ums->lun.sense_data_info = lba_offset;
-				ums->lun.info_valid      = 1;
-				break;
-			}
+		if (count > UMS_UNMAP_LBA_MAX)
+		{
+			ums->lun->sense_data = SS_INVALID_FIELD_IN_PARAMETER_LIST;
 
- empty_write:
-			// Did the host decide to stop early?
-			if (bulk_ctxt->bulk_out_length_actual < bulk_ctxt->bulk_out_length)
-			{
-				ums->set_text(ums->label, "#FFDD00 Error:# Empty Write!");
-				ums->short_packet_received = 1;
-				break;
-			}
+			return UMS_RES_INVALID_ARG;
 		}
 	}
 
-	return UMS_RES_IO_ERROR; // No default reply.
+	if (_lun_select_partition(ums))
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Discard!");
+		ums->lun->sense_data = SS_WRITE_ERROR;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	for (u32 i = 0; i < desc_cnt; i++)
+	{
+		u32 lba   = get_array_be_to_le32(&desc[i * 16 + 4]);
+		u32 count = get_array_be_to_le32(&desc[i * 16 + 8]);
+
+		if (count && _scsi_unmap_range(ums, lba, count))
+			return UMS_RES_INVALID_ARG;
+	}
+
+	return UMS_RES_OK;
 }
 
-static int _scsi_verify(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+// Only the unmap variant is supported. Data must be zeroes, since unmapped blocks read as such.
+static int _scsi_write_same(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
-	// Check that start LBA is past the end sector offset.
-	u32 lba_offset = get_array_be_to_le32(&ums->cmnd[2]);
-	if (lba_offset >= ums->lun.num_sectors)
+	u8 *buf = (u8 *)UMS_WRITE_BUF_ADDR;
+	u32 lba_hi = get_array_be_to_le32(&ums->cmnd[2]);
+	u32 lba    = get_array_be_to_le32(&ums->cmnd[6]);
+	u32 count  = get_array_be_to_le32(&ums->cmnd[10]);
+
+	if (_scsi_unmap_check(ums))
+		return UMS_RES_INVALID_ARG;
+
+	// UNMAP bit is required. NDOB (no data-out buffer) means zeroes.
+	if (!(ums->cmnd[1] & 0x08) || (ums->cmnd[1] & ~0x09) || !count || count > UMS_UNMAP_LBA_MAX)
 	{
-		ums->set_text(ums->label, "#FF8000 Warn:# Verif - Out of range! Host notified.");
-		ums->lun.sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
-	// We allow DPO but we don't implement it. Check that nothing else is enabled.
-	if (ums->cmnd[1] & ~0x10)
+	if (lba_hi || lba >= ums->lun->num_sectors || count > (ums->lun->num_sectors - lba))
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->set_text(ums->label, "#FF8000 Warn:# Unmap - Out of range! Host notified.");
+		ums->lun->sense_data = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
-	u32  verification_length = get_array_be_to_le16(&ums->cmnd[7]);
-	if (verification_length == 0)
-		return UMS_RES_IO_ERROR; // No default reply.
-
-	u32 amount;
-	while (verification_length > 0)
+	if (!(ums->cmnd[1] & 0x01))
 	{
+		if (_scsi_param_list_read(ums, bulk_ctxt, buf, UMS_DISK_LBA_SIZE) != UMS_DISK_LBA_SIZE)
+		{
+			if (ums->lun->sense_data == SS_NO_SENSE)
+				ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
-		// Limit to EP buffer size and end sector offset.
-		amount = MIN(verification_length, USB_EP_BUFFER_MAX_SIZE >> UMS_DISK_LBA_SHIFT);
-		amount = MIN(amount, ums->lun.num_sectors - lba_offset);
-		if (amount == 0) {
-			ums->lun.sense_data      = SS_LOGICAL_BLOCK_ADDRESS_OUT_OF_RANGE;
-			ums->lun.sense_data_info = lba_offset;
-			ums->lun.info_valid      = 1;
-			break;
+			return UMS_RES_INVALID_ARG;
 		}
 
-		if (sdmmc_storage_read(ums->lun.storage, ums->lun.offset + lba_offset, amount, bulk_ctxt->bulk_in_buf))
-			amount = 0;
-
-DPRINTF("File read %X @ %X\n", amount, lba_offset);
-
-		if (!amount)
+		for (u32 i = 0; i < UMS_DISK_LBA_SIZE; i++)
 		{
-			ums->set_text(ums->label, "#FFDD00 Error:# File verify!");
-			ums->lun.sense_data      = SS_UNRECOVERED_READ_ERROR;
-			ums->lun.sense_data_info = lba_offset;
-			ums->lun.info_valid      = 1;
-			break;
+			if (buf[i])
+			{
+				ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
+
+				return UMS_RES_INVALID_ARG;
+			}
 		}
-		lba_offset += amount;
-		verification_length -= amount;
 	}
+
+	if (_lun_select_partition(ums))
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# SDMMC Discard!");
+		ums->lun->sense_data = SS_WRITE_ERROR;
+
+		return UMS_RES_INVALID_ARG;
+	}
+
+	if (_scsi_unmap_range(ums, lba, count))
+		return UMS_RES_INVALID_ARG;
+
 	return UMS_RES_OK;
 }
 
@@ -747,8 +1584,20 @@ static int _scsi_inquiry(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 	memset(buf, 0, 36);
 
+	// Enable Vital Product Data (EVPD) and Supported VPD Pages.
+	if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0x00)
+	{
+		buf[1] = ums->cmnd[2];
+		buf[3] = 4;  // Additional length.
+		buf[4] = 0x00;
+		buf[5] = 0x80;
+		buf[6] = 0xB0;
+		buf[7] = 0xB2;
+
+		return 8;
+	}
 	// Enable Vital Product Data (EVPD) and Unit Serial Number.
-	if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0x80)
+	else if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0x80)
 	{
 		buf[0] = 0;
 		buf[1] = ums->cmnd[2];
@@ -757,9 +1606,9 @@ static int _scsi_inquiry(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 		buf += 4;
 		s_printf((char *)buf, "%04X%s",
-			ums->lun.storage->cid.serial, ums->lun.type == MMC_SD ? " SD " : " eMMC ");
+			ums->lun->storage->cid.serial, ums->lun->type == MMC_SD ? " SD " : " eMMC ");
 
-		switch (ums->lun.partition)
+		switch (ums->lun->partition)
 		{
 		case 0:
 			strcpy((char *)buf + strlen((char *)buf), "RAW");
@@ -780,10 +1629,42 @@ static int _scsi_inquiry(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 		return 24;
 	}
+	// Enable Vital Product Data (EVPD) and Block Limits.
+	else if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0xB0)
+	{
+		memset(buf, 0, 64);
+		buf[1] = ums->cmnd[2];
+		buf[3] = 60; // Additional length.
+		buf[4] = 1;  // WSNZ. WRITE SAME needs a block count.
+
+		if (_lun_can_unmap(ums->lun))
+		{
+			put_array_le_to_be32(UMS_UNMAP_LBA_MAX,  &buf[20]); // Max unmap LBA count.
+			put_array_le_to_be32(UMS_UNMAP_DESC_MAX, &buf[24]); // Max unmap descriptors.
+			put_array_le_to_be32(UMS_UNMAP_LBA_MAX,  &buf[40]); // Max write same length.
+		}
+
+		return 64;
+	}
+	// Enable Vital Product Data (EVPD) and Logical Block Provisioning.
+	else if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0xB2)
+	{
+		buf[1] = ums->cmnd[2];
+		buf[3] = 4;  // Additional length.
+
+		// UNMAP and WRITE SAME(16) unmap, reads back zeroes and thin provisioned.
+		if (_lun_can_unmap(ums->lun))
+		{
+			buf[5] = 0x80 | 0x40 | 0x04;
+			buf[6] = 2;
+		}
+
+		return 8;
+	}
 	else /* if (ums->cmnd[1] == 0 && ums->cmnd[2] == 0) */ // Standard inquiry.
 	{
 		buf[0] = SCSI_TYPE_DISK;
-		buf[1] = ums->lun.removable ? 0x80 : 0;
+		buf[1] = ums->lun->removable ? 0x80 : 0;
 		buf[2] = 6;  // ANSI INCITS 351-2001 (SPC-2).////////SPC2: 4, SPC4: 6
 		buf[3] = 2;  // SCSI-2 INQUIRY data format.
 		buf[4] = 31; // Additional length.
@@ -795,22 +1676,22 @@ static int _scsi_inquiry(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 		// Product ID. Max 16 chars.
 		buf += 8;
-		switch (ums->lun.partition)
+		switch (ums->lun->partition)
 		{
 		case 0:
 			s_printf((char *)buf, "%s", "SD RAW");
 			break;
 		case EMMC_GPP + 1:
 			s_printf((char *)buf, "%s%s",
-				ums->lun.type == MMC_SD ? "SD " : "eMMC ", "GPP");
+				ums->lun->type == MMC_SD ? "SD " : "eMMC ", "GPP");
 			break;
 		case EMMC_BOOT0 + 1:
 			s_printf((char *)buf, "%s%s",
-				ums->lun.type == MMC_SD ? "SD " : "eMMC ", "BOOT0");
+				ums->lun->type == MMC_SD ? "SD " : "eMMC ", "BOOT0");
 			break;
 		case EMMC_BOOT1 + 1:
 			s_printf((char *)buf, "%s%s",
-				ums->lun.type == MMC_SD ? "SD " : "eMMC ", "BOOT1");
+				ums->lun->type == MMC_SD ? "SD " : "eMMC ", "BOOT1");
 			break;
 		}
 
@@ -822,18 +1703,18 @@ static int _scsi_inquiry(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	}
 }
 
-static int _scsi_request_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+// Fixed format sense data. Clears the sense of the current LUN.
+static int _scsi_sense_fill(usbd_gadget_ums_t *ums, u8 *buf)
 {
-	u8 *buf = (u8 *)bulk_ctxt->bulk_in_buf;
 	u32 sd, sdinfo;
 	int valid;
 
-	sd = ums->lun.sense_data;
-	sdinfo = ums->lun.sense_data_info;
-	valid = ums->lun.info_valid << 7;
-	ums->lun.sense_data = SS_NO_SENSE;
-	ums->lun.sense_data_info = 0;
-	ums->lun.info_valid = 0;
+	sd = ums->lun->sense_data;
+	sdinfo = ums->lun->sense_data_info;
+	valid = ums->lun->info_valid << 7;
+	ums->lun->sense_data = SS_NO_SENSE;
+	ums->lun->sense_data_info = 0;
+	ums->lun->info_valid = 0;
 
 	memset(buf, 0, 18);
 	buf[0]  = valid | 0x70; // Valid, current error.
@@ -846,6 +1727,26 @@ static int _scsi_request_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	return 18;
 }
 
+static int _scsi_request_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	return _scsi_sense_fill(ums, bulk_ctxt->bulk_in_buf);
+}
+
+static int _scsi_report_luns(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	u8 *buf = (u8 *)bulk_ctxt->bulk_in_buf;
+	u32 len = 8 + ums->lun_cnt * 8;
+
+	memset(buf, 0, len);
+	put_array_le_to_be32(ums->lun_cnt * 8, &buf[0]); // LUN list length.
+
+	// Peripheral device addressing.
+	for (u32 i = 0; i < ums->lun_cnt; i++)
+		buf[8 + i * 8 + 1] = i;
+
+	return len;
+}
+
 static int _scsi_read_capacity(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	u8 *buf = (u8 *)bulk_ctxt->bulk_in_buf;
@@ -855,17 +1756,32 @@ static int _scsi_read_capacity(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	// Check the PMI and LBA fields.
 	if (pmi > 1 || (pmi == 0 && lba != 0))
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
-	put_array_le_to_be32(ums->lun.num_sectors - 1, &buf[0]); // Max logical block.
+	put_array_le_to_be32(ums->lun->num_sectors - 1, &buf[0]); // Max logical block.
 	put_array_le_to_be32(UMS_DISK_LBA_SIZE, &buf[4]);        // Block length.
 
 	return 8;
 }
 
+static int _scsi_read_capacity_16(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	u8 *buf = (u8 *)bulk_ctxt->bulk_in_buf;
+
+	memset(buf, 0, 32);
+	put_array_le_to_be32(ums->lun->num_sectors - 1, &buf[4]); // Max logical block.
+	put_array_le_to_be32(UMS_DISK_LBA_SIZE, &buf[8]);         // Block length.
+
+	// Logical block provisioning enabled and unmapped blocks read as zeroes.
+	if (_lun_can_unmap(ums->lun))
+		buf[14] = 0x80 | 0x40;
+
+	return 32;
+}
+
 static int _scsi_log_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	u8  *buf = (u8 *)bulk_ctxt->bulk_in_buf;
@@ -878,14 +1794,14 @@ static int _scsi_log_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 	if (ums->cmnd[1] & 1)
 	{
-		ums->lun.sense_data = SS_SAVING_PARAMETERS_NOT_SUPPORTED;
+		ums->lun->sense_data = SS_SAVING_PARAMETERS_NOT_SUPPORTED;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
 	if (pc != 1) // Current cumulative values.
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -927,7 +1843,7 @@ static int _scsi_log_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	u32 len = buf - buf0;
 	if (!valid_page)
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -950,14 +1866,14 @@ static int _scsi_mode_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 	if ((ums->cmnd[1] & ~0x08) != 0) // Mask away DBD.
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
 	if (pc == 3)
 	{
-		ums->lun.sense_data = SS_SAVING_PARAMETERS_NOT_SUPPORTED;
+		ums->lun->sense_data = SS_SAVING_PARAMETERS_NOT_SUPPORTED;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -969,12 +1885,12 @@ static int _scsi_mode_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	memset(buf, 0, 8);
 	if (ums->cmnd[0] == SC_MODE_SENSE_6)
 	{
-		buf[2] = (ums->lun.ro ? 0x80 : 0x00); // WP, DPOFUA.
+		buf[2] = (ums->lun->ro ? 0x80 : 0x00); // WP, DPOFUA.
 		buf += 4;
 	}
 	else // SC_MODE_SENSE_10.
 	{
-		buf[3] = (ums->lun.ro ? 0x80 : 0x00); // WP, DPOFUA.
+		buf[3] = (ums->lun->ro ? 0x80 : 0x00); // WP, DPOFUA.
 		buf += 8;
 	}
 
@@ -1007,7 +1923,7 @@ static int _scsi_mode_sense(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	u32 len = buf - buf0;
 	if (!valid_page)
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1025,16 +1941,16 @@ static int _scsi_start_stop(usbd_gadget_ums_t *ums)
 {
 	int loej, start;
 
-	if (!ums->lun.removable)
+	if (!ums->lun->removable)
 	{
-		ums->lun.sense_data = SS_INVALID_COMMAND;
+		ums->lun->sense_data = SS_INVALID_COMMAND;
 
 		return UMS_RES_INVALID_ARG;
 	}
 	else if ((ums->cmnd[1] & ~0x01) != 0 || // Mask away Immed.
 		(ums->cmnd[4] & ~0x03) != 0)        // Mask LoEj, Start.
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1045,9 +1961,9 @@ static int _scsi_start_stop(usbd_gadget_ums_t *ums)
 	// We do not support re-mounting.
 	if (start)
 	{
-		if (ums->lun.unmounted)
+		if (ums->lun->unmounted)
 		{
-			ums->lun.sense_data = SS_MEDIUM_NOT_PRESENT;
+			ums->lun->sense_data = SS_MEDIUM_NOT_PRESENT;
 
 			return UMS_RES_INVALID_ARG;
 		}
@@ -1056,10 +1972,10 @@ static int _scsi_start_stop(usbd_gadget_ums_t *ums)
 	}
 
 	// Check if we are allowed to unload the media.
-	if (ums->lun.prevent_medium_removal)
+	if (ums->lun->prevent_medium_removal)
 	{
 		ums->set_text(ums->label, "#C7EA46 Status:# Unload attempt prevented");
-		ums->lun.sense_data = SS_MEDIUM_REMOVAL_PREVENTED;
+		ums->lun->sense_data = SS_MEDIUM_REMOVAL_PREVENTED;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1068,7 +1984,7 @@ static int _scsi_start_stop(usbd_gadget_ums_t *ums)
 		return UMS_RES_OK;
 
 	// Unmount means we exit UMS because of ejection.
-	ums->lun.unmounted = 1;
+	ums->lun->unmounted = 1;
 
 	return UMS_RES_OK;
 }
@@ -1077,9 +1993,9 @@ static int _scsi_prevent_allow_removal(usbd_gadget_ums_t *ums)
 {
 	int prevent;
 
-	if (!ums->lun.removable)
+	if (!ums->lun->removable)
 	{
-		ums->lun.sense_data = SS_INVALID_COMMAND;
+		ums->lun->sense_data = SS_INVALID_COMMAND;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1087,16 +2003,16 @@ static int _scsi_prevent_allow_removal(usbd_gadget_ums_t *ums)
 	prevent = ums->cmnd[4] & 0x01;
 	if ((ums->cmnd[4] & ~0x01) != 0) // Mask away Prevent.
 	{
-		ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+		ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 		return UMS_RES_INVALID_ARG;
 	}
 
 	// Notify for possible unmounting?
 	// Normally we sync here but we do synced writes to SDMMC.
-	if (ums->lun.prevent_medium_removal && !prevent) { /* Do nothing */ }
+	if (ums->lun->prevent_medium_removal && !prevent) { /* Do nothing */ }
 
-	ums->lun.prevent_medium_removal = prevent;
+	ums->lun->prevent_medium_removal = prevent;
 
 	return UMS_RES_OK;
 }
@@ -1109,7 +2025,7 @@ static int _scsi_read_format_capacities(usbd_gadget_ums_t *ums, bulk_ctxt_t *bul
 	buf[3] = 8; // Only the Current/Maximum Capacity Descriptor.
 	buf += 4;
 
-	put_array_le_to_be32(ums->lun.num_sectors, &buf[0]); // Number of blocks.
+	put_array_le_to_be32(ums->lun->num_sectors, &buf[0]); // Number of blocks.
 	put_array_le_to_be32(UMS_DISK_LBA_SIZE, &buf[4]);    // Block length.
 	buf[4] = 0x02; // Current capacity.
 
@@ -1132,6 +2048,13 @@ DPRINTF("SCSI command: %X;  Dc=%d, D%c=%X;  Hc=%d, H%c=%X\n",
 	if (ums->data_size_from_cmnd == 0)
 		data_dir = DATA_DIR_NONE;
 
+	// UAS commands have no data phase info. It comes from the CDB.
+	if (ums->uas)
+	{
+		ums->data_dir  = data_dir;
+		ums->data_size = ums->data_size_from_cmnd;
+	}
+
 	// This is a phase error but we continue and only transfer as much we can.
 	if (ums->data_size < ums->data_size_from_cmnd)
 	{
@@ -1164,22 +2087,22 @@ DPRINTF("SCSI command: %X;  Dc=%d, D%c=%X;  Hc=%d, H%c=%X\n",
 		}
 	}
 
-	// check that LUN ums->cmnd[1] >> 5 is 0 because of only one.
+	// LUN is selected by the CBW. Bits 7:5 of cmnd[1] are obsolete and ignored.
 
 	if (ums->cmnd[0] != SC_REQUEST_SENSE)
 	{
-		ums->lun.sense_data      = SS_NO_SENSE;
-		ums->lun.sense_data_info = 0;
-		ums->lun.info_valid      = 0;
+		ums->lun->sense_data      = SS_NO_SENSE;
+		ums->lun->sense_data_info = 0;
+		ums->lun->info_valid      = 0;
 	}
 
 	// If a unit attention condition exists, only INQUIRY and REQUEST SENSE
 	// commands are allowed.
-	if (ums->lun.unit_attention_data != SS_NO_SENSE && ums->cmnd[0] != SC_INQUIRY &&
+	if (ums->lun->unit_attention_data != SS_NO_SENSE && ums->cmnd[0] != SC_INQUIRY &&
 		ums->cmnd[0] != SC_REQUEST_SENSE)
 	{
-		ums->lun.sense_data = ums->lun.unit_attention_data;
-		ums->lun.unit_attention_data = SS_NO_SENSE;
+		ums->lun->sense_data = ums->lun->unit_attention_data;
+		ums->lun->unit_attention_data = SS_NO_SENSE;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1190,16 +2113,16 @@ DPRINTF("SCSI command: %X;  Dc=%d, D%c=%X;  Hc=%d, H%c=%X\n",
 	{
 		if (ums->cmnd[i] && !(mask & BIT(i)))
 		{
-			ums->lun.sense_data = SS_INVALID_FIELD_IN_CDB;
+			ums->lun->sense_data = SS_INVALID_FIELD_IN_CDB;
 
 			return UMS_RES_INVALID_ARG;
 		}
 	}
 
 	// If the medium isn't mounted and the command needs to access it, return an error.
-	if (ums->lun.unmounted && needs_medium)
+	if (ums->lun->unmounted && needs_medium)
 	{
-		ums->lun.sense_data = SS_MEDIUM_NOT_PRESENT;
+		ums->lun->sense_data = SS_MEDIUM_NOT_PRESENT;
 
 		return UMS_RES_INVALID_ARG;
 	}
@@ -1220,7 +2143,8 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	case SC_INQUIRY:
 		ums->data_size_from_cmnd = ums->cmnd[4];
 		u32 mask = (1<<4);
-		if (ums->cmnd[1] == 1 && ums->cmnd[2] == 0x80) // Inquiry S/N.
+		if (ums->cmnd[1] == 1 && (ums->cmnd[2] == 0x00 || ums->cmnd[2] == 0x80 ||
+			ums->cmnd[2] == 0xB0 || ums->cmnd[2] == 0xB2)) // Inquiry VPD pages.
 			mask = (1<<1) | (1<<2) | (1<<4);
 		reply = _check_scsi_cmd(ums, 6, DATA_DIR_TO_HOST, mask, 0);
 		if (reply == 0)
@@ -1240,7 +2164,7 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		if (reply == 0)
 		{
 			// We don't support MODE SELECT.
-			ums->lun.sense_data = SS_INVALID_COMMAND;
+			ums->lun->sense_data = SS_INVALID_COMMAND;
 			reply = UMS_RES_INVALID_ARG;
 		}
 		break;
@@ -1251,7 +2175,7 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		if (reply == 0)
 		{
 			// We don't support MODE SELECT.
-			ums->lun.sense_data = SS_INVALID_COMMAND;
+			ums->lun->sense_data = SS_INVALID_COMMAND;
 			reply = UMS_RES_INVALID_ARG;
 		}
 		break;
@@ -1305,6 +2229,24 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		if (reply == 0)
 			reply = _scsi_read_capacity(ums, bulk_ctxt);
 		break;
+	case SC_SERVICE_ACTION_IN_16:
+		ums->data_size_from_cmnd = get_array_be_to_le32(&ums->cmnd[10]);
+		if ((ums->cmnd[1] & 0x1F) != SAI_READ_CAPACITY_16)
+		{
+			ums->data_size_from_cmnd = 0;
+			reply = _check_scsi_cmd(ums, ums->cmnd_size, DATA_DIR_UNKNOWN, 0xFF, 0);
+			if (reply == 0)
+			{
+				ums->lun->sense_data = SS_INVALID_COMMAND;
+				reply = UMS_RES_INVALID_ARG;
+			}
+			break;
+		}
+		reply = _check_scsi_cmd(ums, 16, DATA_DIR_TO_HOST, (1<<1) | (0xff<<2) | (0xf<<10) | (1<<14), 1);
+		if (reply == 0)
+			reply = _scsi_read_capacity_16(ums, bulk_ctxt);
+		break;
+
 	case SC_READ_FORMAT_CAPACITIES:
 		ums->data_size_from_cmnd = get_array_be_to_le16(&ums->cmnd[7]);
 		reply = _check_scsi_cmd(ums, 10, DATA_DIR_TO_HOST, (3<<7), 1);
@@ -1333,6 +2275,13 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 			reply = 0; // Don't bother
 		break;
 
+	case SC_UNMAP:
+		ums->data_size_from_cmnd = get_array_be_to_le16(&ums->cmnd[7]);
+		reply = _check_scsi_cmd(ums, 10, DATA_DIR_FROM_HOST, (1<<6) | (3<<7), 1);
+		if (reply == 0)
+			reply = _scsi_unmap(ums, bulk_ctxt);
+		break;
+
 	case SC_TEST_UNIT_READY:
 		ums->data_size_from_cmnd = 0;
 		reply = _check_scsi_cmd(ums, 6, DATA_DIR_NONE, 0, 1);
@@ -1368,6 +2317,20 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 			reply = _scsi_write(ums, bulk_ctxt);
 		break;
 
+	case SC_WRITE_SAME_16:
+		ums->data_size_from_cmnd = (ums->cmnd[1] & 0x01) ? 0 : UMS_DISK_LBA_SIZE;
+		reply = _check_scsi_cmd(ums, 16, DATA_DIR_FROM_HOST, (1<<1) | (0xff<<2) | (0xf<<10) | (1<<14), 1);
+		if (reply == 0)
+			reply = _scsi_write_same(ums, bulk_ctxt);
+		break;
+
+	case SC_REPORT_LUNS:
+		ums->data_size_from_cmnd = get_array_be_to_le32(&ums->cmnd[6]);
+		reply = _check_scsi_cmd(ums, 12, DATA_DIR_TO_HOST, (1<<2) | (0xf<<6), 0);
+		if (reply == 0)
+			reply = _scsi_report_luns(ums, bulk_ctxt);
+		break;
+
 	// Mandatory commands that we don't implement. No need.
 	case SC_READ_HEADER:
 	case SC_READ_TOC:
@@ -1380,7 +2343,7 @@ static int _parse_scsi_cmd(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		reply = _check_scsi_cmd(ums, ums->cmnd_size, DATA_DIR_UNKNOWN, 0xFF, 0);
 		if (reply == 0)
 		{
-			ums->lun.sense_data = SS_INVALID_COMMAND;
+			ums->lun->sense_data = SS_INVALID_COMMAND;
 			reply = UMS_RES_INVALID_ARG;
 		}
 		break;
@@ -1451,10 +2414,29 @@ static int _throw_away_data(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	return UMS_RES_OK;
 }
 
+// UAS has no phase errors. Short data ends the transfer and the status explains it.
+static int _uas_finish_reply(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	if (ums->data_dir == DATA_DIR_TO_HOST)
+	{
+		// Send the last buffer.
+		if (bulk_ctxt->bulk_in_length)
+			_transfer_start(ums, bulk_ctxt, bulk_ctxt->bulk_in, USB_XFER_SYNCED_DATA);
+
+		// In case we used SDMMC transfer, reset the buffer address.
+		_reset_buffer(bulk_ctxt, bulk_ctxt->bulk_in);
+	}
+
+	return UMS_RES_OK;
+}
+
 static int _finish_reply(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	int rc = UMS_RES_OK;
 
+	if (ums->uas)
+		return _uas_finish_reply(ums, bulk_ctxt);
+
 	switch (ums->data_dir) {
 	case DATA_DIR_NONE:
 		break; // Nothing to send.
@@ -1543,18 +2525,38 @@ static int _finish_reply(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
  * Line always at SE0.
  */
 
-static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+// Media are only gone when all LUNs are ejected.
+static bool _ums_unmounted(usbd_gadget_ums_t *ums)
+{
+	for (u32 i = 0; i < ums->lun_cnt; i++)
+		if (!ums->luns[i].unmounted)
+			return false;
+
+	return true;
+}
+
+static bool _ums_removal_prevented(usbd_gadget_ums_t *ums)
+{
+	for (u32 i = 0; i < ums->lun_cnt; i++)
+		if (ums->luns[i].prevent_medium_removal)
+			return true;
+
+	return false;
+}
+
+static int _received_cmd_status(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	// Was this a real packet?  Should it be ignored?
-	if (bulk_ctxt->bulk_out_status || bulk_ctxt->bulk_out_ignore || ums->lun.unmounted)
+	bool unmounted = _ums_unmounted(ums);
+	if (bulk_ctxt->bulk_out_status || bulk_ctxt->bulk_out_ignore || unmounted)
 	{
-		if (bulk_ctxt->bulk_out_status || ums->lun.unmounted)
+		if (bulk_ctxt->bulk_out_status || unmounted)
 		{
 			DPRINTF("USB: EP timeout (%d)\n", bulk_ctxt->bulk_out_status);
 			// In case we disconnected, exit UMS.
 			// Raise timeout if removable and didn't got a unit ready command inside 4s.
 			if (bulk_ctxt->bulk_out_status == USB2_ERROR_XFER_EP_DISABLED ||
-				(bulk_ctxt->bulk_out_status == USB_ERROR_TIMEOUT && ums->lun.removable && !ums->lun.prevent_medium_removal))
+				(bulk_ctxt->bulk_out_status == USB_ERROR_TIMEOUT && ums->lun->removable && !_ums_removal_prevented(ums)))
 			{
 				if (bulk_ctxt->bulk_out_status == USB_ERROR_TIMEOUT)
 				{
@@ -1577,7 +2579,7 @@ static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 				}
 			}
 
-			if (ums->lun.unmounted)
+			if (unmounted)
 			{
 				ums->set_text(ums->label, "#C7EA46 Status:# Medium unmounted");
 				ums->timeouts++;
@@ -1593,6 +2595,14 @@ static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 			return UMS_RES_INVALID_ARG;
 	}
 
+	return UMS_RES_OK;
+}
+
+static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	if (_received_cmd_status(ums, bulk_ctxt))
+		return UMS_RES_INVALID_ARG;
+
 	// Clear request flag to allow a new one to be queued.
 	ums->cbw_req_queued = false;
 
@@ -1619,7 +2629,7 @@ static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	}
 
 	// Is the CBW meaningful?
-	if (cbw->Lun >= UMS_MAX_LUN || cbw->Flags & ~USB_BULK_IN_FLAG ||
+	if (cbw->Lun >= ums->lun_cnt || cbw->Flags & ~USB_BULK_IN_FLAG ||
 			cbw->Length == 0 || cbw->Length > SCSI_MAX_CMD_SZ)
 	{
 		gfx_printf("USB: non-meaningful CBW: lun = %X, flags = 0x%X, cmdlen %X\n",
@@ -1652,9 +2662,102 @@ static int _received_cbw(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		ums->data_dir = DATA_DIR_NONE;
 
 	ums->lun_idx = cbw->Lun;
+	ums->lun = &ums->luns[cbw->Lun];
 	ums->tag = cbw->Tag;
 
-	if (!ums->lun.unmounted)
+	if (!ums->lun->unmounted)
+		ums->timeouts = 0;
+
+	return UMS_RES_OK;
+}
+
+// Host selected the other alternate setting. Any queued command request is gone.
+static bool _uas_mode_changed(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	bool uas = usb_ops.usb_device_get_uas && usb_ops.usb_device_get_uas();
+	if (uas == ums->uas)
+		return false;
+
+	ums->uas = uas;
+	ums->cbw_req_queued = false;
+	ums->uas_running = false;
+	ums->uas_queued = 0;
+	bulk_ctxt->bulk_out_ignore = 0;
+
+	ums->set_text(ums->label, uas ? "#C7EA46 Status:# Started UAS" : "#C7EA46 Status:# Started UMS");
+
+	return true;
+}
+
+static int _uas_get_next_command(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
+{
+	u32 len = 0;
+
+	// Previous command is done.
+	ums->uas_running = false;
+
+	_uas_cmd_read_start(ums);
+	_uas_cmd_poll(ums);
+
+	// Wait for a command if none is queued.
+	bulk_ctxt->bulk_out_status = USB_RES_OK;
+	if (!ums->uas_queued)
+		bulk_ctxt->bulk_out_status = usb_ops.usb_device_ep2_out_reading_finish(&len, USB_XFER_SYNCED_CMD);
+	bulk_ctxt->bulk_out_length_actual = len;
+
+	if (_uas_mode_changed(ums, bulk_ctxt))
+		return UMS_RES_INVALID_ARG;
+
+	if (_received_cmd_status(ums, bulk_ctxt))
+		return UMS_RES_INVALID_ARG;
+
+	if (!ums->uas_queued)
+	{
+		ums->cbw_req_queued = false;
+		_uas_receive_iu(ums, (u8 *)UMS_UAS_CMD_BUF_ADDR, len);
+
+		// Task management or an invalid command.
+		if (!ums->uas_queued)
+			return UMS_RES_INVALID_ARG;
+	}
+
+	// Commands run in arrival order.
+	uas_task_t *task = &ums->uas_queue[0];
+
+	// CDB length from the group code.
+	switch (task->cdb[0] >> 5)
+	{
+	case 0:
+		ums->cmnd_size = 6;
+		break;
+	case 1:
+	case 2:
+		ums->cmnd_size = 10;
+		break;
+	case 5:
+		ums->cmnd_size = 12;
+		break;
+	default:
+		ums->cmnd_size = 16;
+		break;
+	}
+	memcpy(ums->cmnd, task->cdb, ums->cmnd_size);
+
+	// Data phase is set when the command is checked.
+	ums->data_dir  = DATA_DIR_NONE;
+	ums->data_size = 0;
+
+	ums->lun_idx = task->lun;
+	ums->lun = &ums->luns[ums->lun_idx];
+	ums->tag = task->tag;
+	ums->uas_ready_sent = false;
+	ums->uas_running = true;
+
+	// Room was made for the next command.
+	_uas_queue_remove(ums, 0);
+	_uas_cmd_read_start(ums);
+
+	if (!ums->lun->unmounted)
 		ums->timeouts = 0;
 
 	return UMS_RES_OK;
@@ -1664,6 +2767,11 @@ static int _get_next_command(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	int rc = UMS_RES_OK;
 
+	_uas_mode_changed(ums, bulk_ctxt);
+
+	if (ums->uas)
+		return _uas_get_next_command(ums, bulk_ctxt);
+
 	/* Wait for the next buffer to become available */
 	// while (bulk_ctxt->bulk_out_buf_state != BUF_STATE_EMPTY)
 	// {
@@ -1687,6 +2795,9 @@ static int _get_next_command(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	if (ums->xusb)
 		ums->cbw_req_queued = true;
 
+	if (_uas_mode_changed(ums, bulk_ctxt))
+		return UMS_RES_INVALID_ARG;
+
 	/* We will drain the buffer in software, which means we
 	 * can reuse it for the next filling.  No need to advance
 	 * next_buffhd_to_fill. */
@@ -1703,10 +2814,46 @@ static int _get_next_command(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 	return rc;
 }
 
+static void _uas_send_status(usbd_gadget_ums_t *ums)
+{
+	u8 *iu = (u8 *)UMS_UAS_IU_BUF_ADDR;
+	u32 len = UAS_SENSE_IU_LEN;
+
+	memset(iu, 0, UAS_SENSE_IU_LEN);
+	iu[0] = UAS_IU_SENSE;
+	put_array_le_to_be16(ums->tag, &iu[2]);
+
+	if (ums->phase_error)
+	{
+		ums->set_text(ums->label, "#FFDD00 Error:# Phase-error!");
+		ums->lun->sense_data = SS_INVALID_COMMAND;
+	}
+
+	// Sense data goes with the status. There is no Request Sense after it.
+	if (ums->lun->sense_data != SS_NO_SENSE)
+	{
+		DPRINTF("USB: CMD fail\n");
+		iu[6] = SAM_STAT_CHECK_CONDITION;
+		u32 sense_len = _scsi_sense_fill(ums, &iu[UAS_SENSE_IU_LEN]);
+		put_array_le_to_be16(sense_len, &iu[14]);
+		len += sense_len;
+	}
+	else
+		iu[6] = SAM_STAT_GOOD;
+
+	_uas_send_iu(ums, iu, len);
+}
+
 static void _send_status(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 {
 	u8  status = USB_STATUS_PASS;
-	u32 sd = ums->lun.sense_data;
+	u32 sd = ums->lun->sense_data;
+
+	if (ums->uas)
+	{
+		_uas_send_status(ums);
+		return;
+	}
 
 	if (ums->phase_error)
 	{
@@ -1719,7 +2866,7 @@ static void _send_status(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 		DPRINTF("USB: CMD fail\n");
 		status = USB_STATUS_FAIL;
 		DPRINTF("USB:   Sense: SK x%02X, ASC x%02X, ASCQ x%02X; info x%X\n",
-			SK(sd), ASC(sd), ASCQ(sd), ums->lun.sense_data_info);
+			SK(sd), ASC(sd), ASCQ(sd), ums->lun->sense_data_info);
 	}
 
 	// Store and send the Bulk-only CSW.
@@ -1752,11 +2899,16 @@ static void _handle_exception(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 
 	if (old_state != UMS_STATE_ABORT_BULK_OUT)
 	{
-		ums->lun.prevent_medium_removal = 0;
-		ums->lun.sense_data             = SS_NO_SENSE;
-		ums->lun.unit_attention_data    = SS_NO_SENSE;
-		ums->lun.sense_data_info        = 0;
-		ums->lun.info_valid             = 0;
+		for (u32 i = 0; i < ums->lun_cnt; i++)
+		{
+			logical_unit_t *lun = &ums->luns[i];
+
+			lun->prevent_medium_removal = 0;
+			lun->sense_data             = SS_NO_SENSE;
+			lun->unit_attention_data    = SS_NO_SENSE;
+			lun->sense_data_info        = 0;
+			lun->info_valid             = 0;
+		}
 	}
 
 	ums->state = UMS_STATE_NORMAL;
@@ -1779,7 +2931,8 @@ static void _handle_exception(usbd_gadget_ums_t *ums, bulk_ctxt_t *bulk_ctxt)
 			bulk_ctxt->bulk_out_ignore = 0;
 			_clear_ep_stall(bulk_ctxt->bulk_in);
 		}
-		ums->lun.unit_attention_data = SS_RESET_OCCURRED;
+		for (u32 i = 0; i < ums->lun_cnt; i++)
+			ums->luns[i].unit_attention_data = SS_RESET_OCCURRED;
 		break;
 
 	case UMS_STATE_EXIT:
@@ -1795,6 +2948,7 @@ static inline void _system_maintainance(usbd_gadget_ums_t *ums)
 {
 	static u32 timer_dram = 0;
 	static u32 timer_status_bar = 0;
+	static u32 timer_stats = 0;
 
 	u32 time = get_tmr_ms();
 
@@ -1803,6 +2957,12 @@ static inline void _system_maintainance(usbd_gadget_ums_t *ums)
 		ums->system_maintenance(true);
 		timer_status_bar = get_tmr_ms() + 30000;
 	}
+	else if (ums->stats_update && timer_stats < time)
+	{
+		ums->stats->time_ms = time - ums->stats->start_ms;
+		ums->stats_update(ums->stats);
+		timer_stats = get_tmr_ms() + 1000;
+	}
 	else if (timer_dram < time)
 	{
 		minerva_periodic_training();
@@ -1842,23 +3002,55 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 	ums.bulk_ctxt.bulk_out_buf = (u8 *)USB_EP_BULK_OUT_BUF_ADDR;
 
 	// Set LUN parameters.
-	ums.lun.ro          = usbs->ro;
-	ums.lun.type        = usbs->type;
-	ums.lun.partition   = usbs->partition;
-	ums.lun.num_sectors = usbs->sectors;
-	ums.lun.offset      = usbs->offset;
-	ums.lun.removable = 1; // Always removable to force OSes to use prevent media removal.
-	ums.lun.unit_attention_data = SS_RESET_OCCURRED;
+	bool has_sd = false;
+	bool has_emmc = false;
+	ums.lun_cnt = MIN(usbs->lun_cnt, UMS_MAX_LUN);
+	if (!ums.lun_cnt)
+	{
+		res = 1;
+		goto init_fail;
+	}
+
+	for (u32 i = 0; i < ums.lun_cnt; i++)
+	{
+		logical_unit_t *lun = &ums.luns[i];
+
+		lun->ro          = usbs->lun[i].ro;
+		lun->type        = usbs->lun[i].type;
+		lun->partition   = usbs->lun[i].partition;
+		lun->num_sectors = usbs->lun[i].sectors;
+		lun->offset      = usbs->lun[i].offset;
+		lun->bis         = usbs->lun[i].bis;
+		lun->layout      = usbs->lun[i].layout;
+		lun->removable = 1; // Always removable to force OSes to use prevent media removal.
+		lun->unit_attention_data = SS_RESET_OCCURRED;
+
+		if (lun->type == MMC_SD)
+		{
+			lun->sdmmc   = &sd_sdmmc;
+			lun->storage = &sd_storage;
+			has_sd = true;
+		}
+		else
+		{
+			lun->sdmmc   = &emmc_sdmmc;
+			lun->storage = &emmc_storage;
+			has_emmc = true;
+		}
+	}
+	ums.lun = &ums.luns[0];
 
 	// Set system functions
 	ums.label = usbs->label;
 	ums.set_text = usbs->set_text;
 	ums.system_maintenance = usbs->system_maintenance;
+	ums.stats = usbs->stats;
+	ums.stats_update = usbs->stats ? usbs->stats_update : NULL;
 
 	ums.set_text(ums.label, "#C7EA46 Status:# Mounting disk");
 
 	// Initialize sdmmc.
-	if (usbs->type == MMC_SD)
+	if (has_sd)
 	{
 		sd_end();
 		if (sd_mount())
@@ -1868,11 +3060,9 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 			goto init_fail;
 		}
 		sd_unmount();
-
-		ums.lun.sdmmc   = &sd_sdmmc;
-		ums.lun.storage = &sd_storage;
 	}
-	else
+
+	if (has_emmc)
 	{
 		if (emmc_initialize(false))
 		{
@@ -1880,10 +3070,6 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 			res = 1;
 			goto init_fail;
 		}
-		emmc_set_partition(ums.lun.partition - 1);
-
-		ums.lun.sdmmc   = &emmc_sdmmc;
-		ums.lun.storage = &emmc_storage;
 	}
 
 	ums.set_text(ums.label, "#C7EA46 Status:# Waiting for connection");
@@ -1894,18 +3080,26 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 
 	ums.set_text(ums.label, "#C7EA46 Status:# Waiting for LUN");
 
-	if (usb_ops.usb_device_class_send_max_lun(0)) // One device for now.
+	if (usb_ops.usb_device_class_send_max_lun(ums.lun_cnt - 1))
 		goto usb_enum_error;
 
 	ums.set_text(ums.label, "#C7EA46 Status:# Started UMS");
 
+	if (ums.stats)
+		ums.stats->start_ms = get_tmr_ms();
+
 	// If partition sectors are not set get them from hardware.
-	if (!ums.lun.num_sectors)
+	for (u32 i = 0; i < ums.lun_cnt; i++)
 	{
-		if (usbs->type == MMC_EMMC && (ums.lun.partition - 1)) // eMMC BOOT0/1.
-			ums.lun.num_sectors = emmc_storage.ext_csd.boot_mult << 8;
+		logical_unit_t *lun = &ums.luns[i];
+
+		if (lun->num_sectors)
+			continue;
+
+		if (lun->type == MMC_EMMC && (lun->partition - 1)) // eMMC BOOT0/1.
+			lun->num_sectors = emmc_storage.ext_csd.boot_mult << 8;
 		else
-			ums.lun.num_sectors = ums.lun.storage->sec_cnt;   // eMMC GPP or SD.
+			lun->num_sectors = lun->storage->sec_cnt;   // eMMC GPP or SD.
 	}
 
 	do
@@ -1917,7 +3111,7 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 		if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
 		{
 			// Check if we are allowed to unload the media.
-			if (ums.lun.prevent_medium_removal)
+			if (_ums_removal_prevented(&ums))
 				ums.set_text(ums.label, "#C7EA46 Status:# Unload attempt prevented");
 			else
 				break;
@@ -1931,9 +3125,15 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 
 		_handle_ep0_ctrl(&ums);
 
-		if (_get_next_command(&ums, &ums.bulk_ctxt) || (ums.state > UMS_STATE_NORMAL))
+		// Time until a command arrives is host side.
+		u32 cmd_timer = _stats_start(&ums);
+		int cmd_res = _get_next_command(&ums, &ums.bulk_ctxt);
+		_stats_wait(&ums, USB_UMS_WAIT_HOST, cmd_timer);
+		if (cmd_res || (ums.state > UMS_STATE_NORMAL))
 			continue;
 
+		cmd_timer = _stats_start(&ums);
+
 		_handle_ep0_ctrl(&ums);
 
 		_parse_scsi_cmd(&ums, &ums.bulk_ctxt);
@@ -1947,9 +3147,11 @@ int usb_device_gadget_ums(usb_ctxt_t *usbs)
 			continue;
 
 		_send_status(&ums, &ums.bulk_ctxt);
+
+		_stats_cmd(&ums, cmd_timer);
 	} while (ums.state != UMS_STATE_TERMINATED);
 
-	if (ums.lun.prevent_medium_removal)
+	if (_ums_removal_prevented(&ums))
 		ums.set_text(ums.label, "#FFDD00 Error:# Disk unsafely ejected");
 	else
 		ums.set_text(ums.label, "#C7EA46 Status:# Disk ejected");
@@ -1960,7 +3162,7 @@ usb_enum_error:
 	res = 1;
 
 exit:
-	if (ums.lun.type == MMC_EMMC)
+	if (has_emmc)
 		emmc_end();
 
 init_fail:
@@ -1,7 +1,7 @@
 /*
  * Enhanced USB Device (EDCI) driver for Tegra X1
  *
- * Copyright (c) 2019-2025 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -36,6 +36,8 @@
 
 #include <memory_map.h>
 
+#define USB_EP_DTD_MAX (USB_EP_CHAIN_MAX_SIZE / USB_TD_BUFFER_MAX_SIZE)
+
 typedef enum
 {
 	USB_HW_EP0 = 0,
@@ -81,7 +83,7 @@ typedef struct _dQH_t
 
 typedef struct _usbd_t
 {
-	volatile dTD_t dtds[4 * 4]; // 4 dTD per endpoint.
+	volatile dTD_t dtds[4 * USB_EP_DTD_MAX]; // A chain of dTDs per endpoint.
 	volatile dQH_t *qhs;
 	int ep_configured[4];
 	int ep_bytes_requested[4];
@@ -554,7 +556,7 @@ static void _usbd_initialize_ep_ctrl(u32 endpoint)
 static int _usbd_initialize_ep0()
 {
 	memset((void *)usbdaemon->qhs,  0, sizeof(dQH_t) * 4); // Clear all used EP queue heads.
-	memset((void *)usbdaemon->dtds, 0, sizeof(dTD_t) * 4); // Clear all used EP0 token heads.
+	memset((void *)usbdaemon->dtds, 0, sizeof(dTD_t) * USB_EP_DTD_MAX); // Clear all used EP0 token heads.
 
 	usbd_otg->regs->asynclistaddr = (u32)usbdaemon->qhs;
 
@@ -675,7 +677,7 @@ static void _usbd_mark_ep_complete(u32 endpoint)
 
 	usbd_flush_endpoint(endpoint);
 
-	memset((void *)&usbdaemon->dtds[endpoint * 4], 0, sizeof(dTD_t) * 4);
+	memset((void *)&usbdaemon->dtds[endpoint * USB_EP_DTD_MAX], 0, sizeof(dTD_t) * USB_EP_DTD_MAX);
 	memset((void *)&usbdaemon->qhs[endpoint],      0, sizeof(dQH_t));
 
 	usbdaemon->ep_configured[endpoint]      = 0;
@@ -750,7 +752,7 @@ static int _usbd_ep_operation(usb_ep_t endpoint, u8 *buf, u32 len, u32 sync_time
 	usb_hw_ep_t actual_ep = (endpoint & 2) >> 1;
 	usb_dir_t direction = endpoint & 1;
 	u32 length_left = len;
-	u32 dtd_ep_idx = endpoint * 4;
+	u32 dtd_ep_idx = endpoint * USB_EP_DTD_MAX;
 
 	_usbd_mark_ep_complete(endpoint);
 
@@ -765,7 +767,7 @@ static int _usbd_ep_operation(usb_ep_t endpoint, u8 *buf, u32 len, u32 sync_time
 	usbdaemon->ep_configured[endpoint] = 1;
 	usbdaemon->ep_bytes_requested[endpoint] = len;
 
-	// Configure dTD.
+	// Configure the dTD chain. A single prime starts all of it.
 	u32 dtd_idx = 0;
 	do
 	{
@@ -990,7 +992,7 @@ static void _usbd_handle_get_descriptor(bool *transmit_data, void **desc, int *s
 				for (u32 i = 0; i < tmp->interface.bNumEndpoints; i++)
 				{
 					tmp->endpoint[i].wMaxPacketSize = 0x200;
-					tmp->endpoint[i].bInterval = usbd_otg->gadget == USB_GADGET_HID_GAMEPAD ? 4 : 3; // 8ms : 4ms.
+					tmp->endpoint[i].bInterval = 4; // 8 microframes. 1ms.
 				}
 			}
 			else // Full speed. 64 bytes.
@@ -998,7 +1000,7 @@ static void _usbd_handle_get_descriptor(bool *transmit_data, void **desc, int *s
 				for (u32 i = 0; i < tmp->interface.bNumEndpoints; i++)
 				{
 					tmp->endpoint[i].wMaxPacketSize = 0x40;
-					tmp->endpoint[i].bInterval = usbd_otg->gadget == USB_GADGET_HID_GAMEPAD ? 8 : 4; // 8ms : 4ms.
+					tmp->endpoint[i].bInterval = 1; // 1ms.
 				}
 			}
 		}
@@ -1473,8 +1475,8 @@ int usb_device_ep1_out_read(u8 *buf, u32 len, u32 *bytes_read, u32 sync_timeout)
 	if ((u32)buf % USB_EP_BUFFER_ALIGN)
 		return USB2_ERROR_XFER_NOT_ALIGNED;
 
-	if (len > USB_EP_BUFFER_MAX_SIZE)
-		len = USB_EP_BUFFER_MAX_SIZE;
+	if (len > USB_EP_CHAIN_MAX_SIZE)
+		len = USB_EP_CHAIN_MAX_SIZE;
 
 	int res = _usbd_ep_operation(USB_EP_BULK_OUT, buf, len, sync_timeout);
 
@@ -1499,7 +1501,7 @@ int usb_device_ep1_out_read_big(u8 *buf, u32 len, u32 *bytes_read)
 
 	while (len)
 	{
-		u32 len_ep = MIN(len, USB_EP_BUFFER_MAX_SIZE);
+		u32 len_ep = MIN(len, USB_EP_CHAIN_MAX_SIZE);
 
 		res = usb_device_ep1_out_read(buf_curr, len_ep, &bytes, USB_XFER_SYNCED_DATA);
 		if (res)
@@ -1551,8 +1553,8 @@ int usb_device_ep1_in_write(u8 *buf, u32 len, u32 *bytes_written, u32 sync_timeo
 	if ((u32)buf % USB_EP_BUFFER_ALIGN)
 		return USB2_ERROR_XFER_NOT_ALIGNED;
 
-	if (len > USB_EP_BUFFER_MAX_SIZE)
-		len = USB_EP_BUFFER_MAX_SIZE;
+	if (len > USB_EP_CHAIN_MAX_SIZE)
+		len = USB_EP_CHAIN_MAX_SIZE;
 
 	int res = _usbd_ep_operation(USB_EP_BULK_IN, buf, len, sync_timeout);
 
@@ -1661,5 +1663,10 @@ void usb_device_get_ops(usb_ops_t *ops)
 	ops->usb_device_ep1_out_reading_finish = usb_device_ep1_out_reading_finish;
 	ops->usb_device_ep1_in_write           = usb_device_ep1_in_write;
 	ops->usb_device_ep1_in_writing_finish  = usb_device_ep1_in_writing_finish;
+
+	ops->usb_device_get_uas                = NULL;
+	ops->usb_device_ep2_out_read           = NULL;
+	ops->usb_device_ep2_out_reading_finish = NULL;
+	ops->usb_device_ep2_in_write           = NULL;
 }
 
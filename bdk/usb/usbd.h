@@ -1,7 +1,7 @@
 /*
  * Enhanced & eXtensible USB Device (EDCI & XDCI) driver for Tegra X1
  *
- * Copyright (c) 2019-2025 CTCaer
+ * Copyright (c) 2019-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -28,6 +28,7 @@
 #define USB_EP_BUFFER_2_TD      (USB_TD_BUFFER_MAX_SIZE * 2)
 #define USB_EP_BUFFER_4_TD      (USB_TD_BUFFER_MAX_SIZE * 4)
 #define USB_EP_BUFFER_MAX_SIZE  (USB_EP_BUFFER_4_TD)
+#define USB_EP_CHAIN_MAX_SIZE   (USB_EP_BUFFER_MAX_SIZE * 4) // EP1 transfers. Queued as chained dTDs/TRBs.
 #define USB_EP_BUFFER_ALIGN     (USB_TD_BUFFER_PAGE_SIZE)
 
 #define USB_XFER_START        0
@@ -37,6 +38,8 @@
 #define USB_XFER_SYNCED_CLASS 5000000 // ~10s.
 #define USB_XFER_SYNCED       -1      // Max.
 
+#define USB_UMS_LUN_MAX 7 // SD, eMMC GPP/BOOT0/BOOT1 and emuMMC GPP/BOOT0/BOOT1.
+
 typedef enum _usb_hid_type
 {
 	USB_HID_GAMEPAD,
@@ -65,6 +68,8 @@ typedef enum
 
 	USB_EP_BULK_OUT = 2,  // EP1.
 	USB_EP_BULK_IN  = 3,  // EP1.
+	USB_EP_BULK2_OUT = 4, // EP2. XUSB only.
+	USB_EP_BULK2_IN  = 5, // EP2. XUSB only.
 	USB_EP_ALL      = 0xFFFFFFFF
 } usb_ep_t;
 
@@ -74,6 +79,8 @@ typedef enum
 	USB_EP_ADDR_CTRL_IN  = 0x80,
 	USB_EP_ADDR_BULK_OUT = 0x01,
 	USB_EP_ADDR_BULK_IN  = 0x81,
+	USB_EP_ADDR_BULK2_OUT = 0x02,
+	USB_EP_ADDR_BULK2_IN  = 0x82,
 } usb_ep_addr_t;
 
 typedef enum
@@ -185,20 +192,64 @@ typedef struct _usb_ops_t
 	int  (*usb_device_ep1_in_writing_finish)(u32 *, u32);
 	bool (*usb_device_get_suspended)();
 	bool (*usb_device_get_port_in_sleep)();
+
+	// UAS. NULL if not supported.
+	bool (*usb_device_get_uas)();
+	int  (*usb_device_ep2_out_read)(u8 *, u32, u32 *, u32);
+	int  (*usb_device_ep2_out_reading_finish)(u32 *, u32);
+	int  (*usb_device_ep2_in_write)(u8 *, u32, u32 *, u32);
 } usb_ops_t;
 
+typedef struct _usb_ums_lun_t
+{
+	u32 type;      // MMC_SD or MMC_EMMC. emuMMC is on SD.
+	u32 partition; // 0 for SD, else eMMC partition + 1.
+	u32 offset;
+	u32 sectors;   // 0: Get them from the device.
+	u32 ro;
+	u32 bis;       // BIS partition id. Decrypted with the BIS keys in place.
+	struct _nx_emmc_layout_t *layout; // File based emuMMC. Offset is then in the eMMC partition.
+} usb_ums_lun_t;
+
+#define USB_UMS_LAT_BUCKETS 16 // Bucket i: under 64us << i. Last one gets the rest.
+
+enum
+{
+	USB_UMS_WAIT_HOST  = 0, // Waiting for the next command.
+	USB_UMS_WAIT_USB   = 1, // Waiting for data transfers.
+	USB_UMS_WAIT_SDMMC = 2, // Waiting for storage.
+	USB_UMS_WAIT_MAX
+};
+
+typedef struct _usb_ums_stats_t
+{
+	u32 start_ms;
+	u32 time_ms;     // Session time at the last update.
+	u32 cmds;
+	u64 rd_bytes;
+	u64 wr_bytes;
+	u32 op_cmds[256]; // Per SCSI opcode.
+	u64 op_bytes[256];
+	u64 wait_us[USB_UMS_WAIT_MAX];
+	u32 lat_hist[USB_UMS_LAT_BUCKETS]; // Command latency.
+	u32 lat_max_us;
+} usb_ums_stats_t;
+
 typedef struct _usb_ctxt_t
 {
 	u32 type;
 
 	// UMS.
-	u32 partition;
-	u32 offset;
-	u32 sectors;
-	u32 ro;
+	u32 lun_cnt;
+	usb_ums_lun_t lun[USB_UMS_LUN_MAX];
+
+	// UMS telemetry. Optional. Update is called about every second.
+	usb_ums_stats_t *stats;
+	void (*stats_update)(usb_ums_stats_t *);
 
 	// HID.
 	u32 idle;
+	u32 latency; // Show input to USB report latency.
 
 	// System.
 	void (*system_maintenance)(bool);
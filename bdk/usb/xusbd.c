@@ -1,7 +1,7 @@
 /*
  * eXtensible USB Device driver (XDCI) for Tegra X1
  *
- * Copyright (c) 2020-2025 CTCaer
+ * Copyright (c) 2020-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -34,7 +34,7 @@
 
 #include <memory_map.h>
 
-#define XUSB_TRB_SLOTS 16 //! TODO: Consider upping it.
+#define XUSB_TRB_SLOTS 32 // Fits a few chained TDs.
 #define XUSB_LINK_TRB_IDX (XUSB_TRB_SLOTS - 1)
 #define XUSB_LAST_TRB_IDX (XUSB_TRB_SLOTS - 1)
 
@@ -360,24 +360,35 @@ typedef struct _xusbd_controller_t
 	u32 cntrl_producer_cycle;
 	data_trb_t *bulkout_epenqueue_ptr;
 	data_trb_t *bulkout_epdequeue_ptr;
+	data_trb_t *bulkout_short_td_end; // Last TRB of a TD that ended early.
 	u32 bulkout_producer_cycle;
 	data_trb_t *bulkin_epenqueue_ptr;
 	data_trb_t *bulkin_epdequeue_ptr;
 	u32 bulkin_producer_cycle;
+	data_trb_t *bulk2out_epenqueue_ptr;
+	data_trb_t *bulk2out_epdequeue_ptr;
+	u32 bulk2out_producer_cycle;
+	data_trb_t *bulk2in_epenqueue_ptr;
+	data_trb_t *bulk2in_epdequeue_ptr;
+	u32 bulk2in_producer_cycle;
 	event_trb_t *event_enqueue_ptr;
 	event_trb_t *event_dequeue_ptr;
 	u32 event_ccs;
 	u32 device_state;
 	u32 tx_bytes[2];
 	u32 tx_count[2];
+	u32 ep2_tx_bytes[2];
+	u32 ep2_tx_count[2];
 	u32 ctrl_seq_num;
 	u32 config_num;
 	u32 interface_num;
+	u32 alt_setting;
 	u32 wait_for_event_trb;
 	u32 port_speed;
 
 	usb_desc_t *desc;
 	usb_gadget_type gadget;
+	bool uas; // UAS alternate setting is offered.
 
 	u8 max_lun;
 	bool max_lun_set;
@@ -395,6 +406,7 @@ extern u8 hid_report_descriptor_touch[];
 extern usb_desc_t usb_gadget_hid_jc_descriptors;
 extern usb_desc_t usb_gadget_hid_touch_descriptors;
 extern usb_desc_t usb_gadget_ums_descriptors;
+extern usb_desc_t usb_gadget_ums_uas_descriptors;
 
 // All rings and EP context must be aligned to 0x10.
 typedef struct _xusbd_event_queues_t
@@ -404,7 +416,9 @@ typedef struct _xusbd_event_queues_t
 	data_trb_t  xusb_cntrl_event_queue[XUSB_TRB_SLOTS];
 	data_trb_t  xusb_bulkin_event_queue[XUSB_TRB_SLOTS];
 	data_trb_t  xusb_bulkout_event_queue[XUSB_TRB_SLOTS];
-	volatile xusb_ep_ctx_t xusb_ep_ctxt[4];
+	data_trb_t  xusb_bulk2in_event_queue[XUSB_TRB_SLOTS];
+	data_trb_t  xusb_bulk2out_event_queue[XUSB_TRB_SLOTS];
+	volatile xusb_ep_ctx_t xusb_ep_ctxt[6];
 } xusbd_event_queues_t;
 
 // Set event queues context to a 0x10 aligned address.
@@ -461,10 +475,33 @@ static void _xusbd_ep_init_event_ring()
 	XUSB_DEV_XHCI(XUSB_DEV_XHCI_ERDPHI) = 0;
 }
 
+static usb_ep_descr_t *_xusb_get_ep_descr(u8 ep_addr)
+{
+	usb_ep_descr_t *endpoints = usbd_xotg->desc->cfg->endpoint;
+
+	// Check configuration descriptor.
+	if (usbd_xotg->desc->cfg->interface.bInterfaceClass == 0x3) // HID Class.
+		endpoints = (usb_ep_descr_t *)((void *)endpoints + sizeof(usb_hid_descr_t));
+
+	for (u32 i = 0; i < usbd_xotg->desc->cfg->interface.bNumEndpoints; i++)
+		if (endpoints[i].bEndpointAddress == ep_addr)
+			return &endpoints[i];
+
+	// EP2 only exists in the UAS alternate setting.
+	if (usbd_xotg->uas)
+	{
+		usb_cfg_uas_descr_t *cfg = (usb_cfg_uas_descr_t *)usbd_xotg->desc->cfg;
+		for (u32 i = 0; i < cfg->uas_interface.bNumEndpoints; i++)
+			if (cfg->uas_endpoint[i].endpoint.bEndpointAddress == ep_addr)
+				return &cfg->uas_endpoint[i].endpoint;
+	}
+
+	return NULL;
+}
+
 static void _xusb_ep_set_type_and_metrics(u32 ep_idx, volatile xusb_ep_ctx_t *ep_ctxt)
 {
 	usb_ep_descr_t *ep_desc = NULL;
-	usb_ep_descr_t *endpoints = usbd_xotg->desc->cfg->endpoint;
 
 	switch (ep_idx)
 	{
@@ -478,19 +515,12 @@ static void _xusb_ep_set_type_and_metrics(u32 ep_idx, volatile xusb_ep_ctx_t *ep
 		break;
 
 	case USB_EP_BULK_OUT:
+	case USB_EP_BULK2_OUT:
 		// Set default EP type.
 		ep_ctxt->ep_type = EP_TYPE_BULK_OUT;
 
 		// Check configuration descriptor.
-		if (usbd_xotg->desc->cfg->interface.bInterfaceClass == 0x3) // HID Class.
-			endpoints = (usb_ep_descr_t *)((void *)endpoints + sizeof(usb_hid_descr_t));
-
-		for (u32 i = 0; i < usbd_xotg->desc->cfg->interface.bNumEndpoints; i++)
-			if (endpoints[i].bEndpointAddress == USB_EP_ADDR_BULK_OUT)
-			{
-				ep_desc = &endpoints[i];
-				break;
-			}
+		ep_desc = _xusb_get_ep_descr(ep_idx == USB_EP_BULK_OUT ? USB_EP_ADDR_BULK_OUT : USB_EP_ADDR_BULK2_OUT);
 
 		// Set actual EP type.
 		if (ep_desc)
@@ -535,7 +565,8 @@ static void _xusb_ep_set_type_and_metrics(u32 ep_idx, volatile xusb_ep_ctx_t *ep
 		}
 
 		// Set max burst rate.
-		ep_ctxt->max_burst_size = (ep_desc->wMaxPacketSize >> 11) & 3;
+		if (ep_desc)
+			ep_ctxt->max_burst_size = (ep_desc->wMaxPacketSize >> 11) & 3;
 
 		// Set max packet size based on port speed.
 		if (usbd_xotg->port_speed == XUSB_SUPER_SPEED)
@@ -567,19 +598,12 @@ static void _xusb_ep_set_type_and_metrics(u32 ep_idx, volatile xusb_ep_ctx_t *ep
 		break;
 
 	case USB_EP_BULK_IN:
+	case USB_EP_BULK2_IN:
 		// Set default EP type.
 		ep_ctxt->ep_type = EP_TYPE_BULK_IN;
 
 		// Check configuration descriptor.
-		if (usbd_xotg->desc->cfg->interface.bInterfaceClass == 0x3) // HID Class.
-			endpoints = (usb_ep_descr_t *)((void *)endpoints + sizeof(usb_hid_descr_t));
-
-		for (u32 i = 0; i < usbd_xotg->desc->cfg->interface.bNumEndpoints; i++)
-			if (endpoints[i].bEndpointAddress == USB_EP_ADDR_BULK_IN)
-			{
-				ep_desc = &endpoints[i];
-				break;
-			}
+		ep_desc = _xusb_get_ep_descr(ep_idx == USB_EP_BULK_IN ? USB_EP_ADDR_BULK_IN : USB_EP_ADDR_BULK2_IN);
 
 		// Set actual EP type.
 		if (ep_desc)
@@ -624,7 +648,8 @@ static void _xusb_ep_set_type_and_metrics(u32 ep_idx, volatile xusb_ep_ctx_t *ep
 		}
 
 		// Set max burst rate.
-		ep_ctxt->max_burst_size = (ep_desc->wMaxPacketSize >> 11) & 3;
+		if (ep_desc)
+			ep_ctxt->max_burst_size = (ep_desc->wMaxPacketSize >> 11) & 3;
 
 		// Set max packet size based on port speed.
 		if (usbd_xotg->port_speed == XUSB_SUPER_SPEED)
@@ -661,7 +686,7 @@ static int _xusb_ep_init_context(u32 ep_idx)
 {
 	link_trb_t *link_trb;
 
-	if (ep_idx > USB_EP_BULK_IN)
+	if (ep_idx > USB_EP_BULK2_IN)
 		return USB_ERROR_INIT;
 
 	if (ep_idx == XUSB_EP_CTRL_OUT)
@@ -699,6 +724,7 @@ static int _xusb_ep_init_context(u32 ep_idx)
 		usbd_xotg->bulkout_producer_cycle = 1;
 		usbd_xotg->bulkout_epenqueue_ptr  = xusb_evtq->xusb_bulkout_event_queue;
 		usbd_xotg->bulkout_epdequeue_ptr  = xusb_evtq->xusb_bulkout_event_queue;
+		usbd_xotg->bulkout_short_td_end   = NULL;
 
 		_xusb_ep_set_type_and_metrics(ep_idx, ep_ctxt);
 
@@ -728,6 +754,40 @@ static int _xusb_ep_init_context(u32 ep_idx)
 		link_trb->ring_seg_ptrhi = 0;
 		link_trb->trb_type       = XUSB_TRB_LINK;
 		break;
+
+	case USB_EP_BULK2_OUT:
+		usbd_xotg->bulk2out_producer_cycle = 1;
+		usbd_xotg->bulk2out_epenqueue_ptr  = xusb_evtq->xusb_bulk2out_event_queue;
+		usbd_xotg->bulk2out_epdequeue_ptr  = xusb_evtq->xusb_bulk2out_event_queue;
+
+		_xusb_ep_set_type_and_metrics(ep_idx, ep_ctxt);
+
+		ep_ctxt->trd_dequeueptr_lo = (u32)xusb_evtq->xusb_bulk2out_event_queue >> 4;
+		ep_ctxt->trd_dequeueptr_hi = 0;
+
+		link_trb = (link_trb_t *)&xusb_evtq->xusb_bulk2out_event_queue[XUSB_LINK_TRB_IDX];
+		link_trb->toggle_cycle   = 1;
+		link_trb->ring_seg_ptrlo = (u32)xusb_evtq->xusb_bulk2out_event_queue >> 4;
+		link_trb->ring_seg_ptrhi = 0;
+		link_trb->trb_type       = XUSB_TRB_LINK;
+		break;
+
+	case USB_EP_BULK2_IN:
+		usbd_xotg->bulk2in_producer_cycle = 1;
+		usbd_xotg->bulk2in_epenqueue_ptr  = xusb_evtq->xusb_bulk2in_event_queue;
+		usbd_xotg->bulk2in_epdequeue_ptr  = xusb_evtq->xusb_bulk2in_event_queue;
+
+		_xusb_ep_set_type_and_metrics(ep_idx, ep_ctxt);
+
+		ep_ctxt->trd_dequeueptr_lo = (u32)xusb_evtq->xusb_bulk2in_event_queue >> 4;
+		ep_ctxt->trd_dequeueptr_hi = 0;
+
+		link_trb = (link_trb_t *)&xusb_evtq->xusb_bulk2in_event_queue[XUSB_LINK_TRB_IDX];
+		link_trb->toggle_cycle   = 1;
+		link_trb->ring_seg_ptrlo = (u32)xusb_evtq->xusb_bulk2in_event_queue >> 4;
+		link_trb->ring_seg_ptrhi = 0;
+		link_trb->trb_type       = XUSB_TRB_LINK;
+		break;
 	}
 
 	return USB_RES_OK;
@@ -742,6 +802,8 @@ static int _xusbd_ep_initialize(u32 ep_idx)
 		return _xusb_ep_init_context(XUSB_EP_CTRL_IN);
 	case USB_EP_BULK_OUT:
 	case USB_EP_BULK_IN:
+	case USB_EP_BULK2_OUT:
+	case USB_EP_BULK2_IN:
 		_xusb_ep_init_context(ep_idx);
 		XUSB_DEV_XHCI(XUSB_DEV_XHCI_EP_RELOAD) = BIT(ep_idx);
 		int res = _xusb_xhci_mask_wait(XUSB_DEV_XHCI_EP_RELOAD, BIT(ep_idx), 0, 1000);
@@ -756,7 +818,7 @@ static int _xusbd_ep_initialize(u32 ep_idx)
 	}
 }
 
-static void _xusbd_ep1_disable(u32 ep_idx)
+static void _xusbd_ep_disable(u32 ep_idx)
 {
 	volatile xusb_ep_ctx_t *ep_ctxt = &xusb_evtq->xusb_ep_ctxt[ep_idx];
 	u32 ep_mask = BIT(ep_idx);
@@ -765,6 +827,8 @@ static void _xusbd_ep1_disable(u32 ep_idx)
 	{
 	case USB_EP_BULK_OUT:
 	case USB_EP_BULK_IN:
+	case USB_EP_BULK2_OUT:
+	case USB_EP_BULK2_IN:
 		// Skip if already disabled.
 		if (!ep_ctxt->ep_state)
 			return;
@@ -785,8 +849,10 @@ static void _xusbd_ep1_disable(u32 ep_idx)
 
 static void _xusb_disable_ep1()
 {
-	_xusbd_ep1_disable(USB_EP_BULK_OUT);
-	_xusbd_ep1_disable(USB_EP_BULK_IN);
+	_xusbd_ep_disable(USB_EP_BULK_OUT);
+	_xusbd_ep_disable(USB_EP_BULK_IN);
+	_xusbd_ep_disable(USB_EP_BULK2_OUT);
+	_xusbd_ep_disable(USB_EP_BULK2_IN);
 
 	// Device mode stop.
 	XUSB_DEV_XHCI(XUSB_DEV_XHCI_CTRL) &= ~XHCI_CTRL_RUN;
@@ -794,6 +860,7 @@ static void _xusb_disable_ep1()
 
 	usbd_xotg->config_num = 0;
 	usbd_xotg->interface_num = 0;
+	usbd_xotg->alt_setting = 0;
 	usbd_xotg->max_lun_set = false;
 	usbd_xotg->device_state = XUSB_DEFAULT;
 }
@@ -960,6 +1027,9 @@ int xusb_device_init()
 	memset(xusb_evtq->xusb_cntrl_event_queue,   0, sizeof(xusb_evtq->xusb_cntrl_event_queue));
 	memset(xusb_evtq->xusb_bulkin_event_queue,  0, sizeof(xusb_evtq->xusb_bulkin_event_queue));
 	memset(xusb_evtq->xusb_bulkout_event_queue, 0, sizeof(xusb_evtq->xusb_bulkout_event_queue));
+	memset(xusb_evtq->xusb_bulk2in_event_queue,  0, sizeof(xusb_evtq->xusb_bulk2in_event_queue));
+	memset(xusb_evtq->xusb_bulk2out_event_queue, 0, sizeof(xusb_evtq->xusb_bulk2out_event_queue));
+	memset((void *)xusb_evtq->xusb_ep_ctxt,      0, sizeof(xusb_evtq->xusb_ep_ctxt));
 
 	// Initialize Control EP.
 	int res = _xusbd_ep_initialize(XUSB_EP_CTRL_IN);
@@ -1021,6 +1091,9 @@ static int _xusb_queue_trb(u32 ep_idx, const void *trb, bool ring_doorbell)
 	data_trb_t *next_trb;
 	link_trb_t *link_trb;
 
+	// A Link TRB inside a TD must be chained too.
+	u32 chain = ((const data_trb_t *)trb)->chain;
+
 	// Copy TRB and advance Enqueue list.
 	switch (ep_idx)
 	{
@@ -1034,6 +1107,7 @@ static int _xusb_queue_trb(u32 ep_idx, const void *trb, bool ring_doorbell)
 			link_trb = (link_trb_t *)next_trb;
 			link_trb->cycle = usbd_xotg->cntrl_producer_cycle & 1;
 			link_trb->toggle_cycle = 1;
+			link_trb->chain = chain;
 
 			next_trb = (data_trb_t *)(link_trb->ring_seg_ptrlo << 4);
 
@@ -1052,6 +1126,7 @@ static int _xusb_queue_trb(u32 ep_idx, const void *trb, bool ring_doorbell)
 			link_trb = (link_trb_t *)next_trb;
 			link_trb->cycle = usbd_xotg->bulkout_producer_cycle & 1;
 			link_trb->toggle_cycle = 1;
+			link_trb->chain = chain;
 
 			next_trb = (data_trb_t *)(link_trb->ring_seg_ptrlo << 4);
 
@@ -1070,6 +1145,7 @@ static int _xusb_queue_trb(u32 ep_idx, const void *trb, bool ring_doorbell)
 			link_trb = (link_trb_t *)next_trb;
 			link_trb->cycle = usbd_xotg->bulkin_producer_cycle & 1;
 			link_trb->toggle_cycle = 1;
+			link_trb->chain = chain;
 
 			next_trb = (data_trb_t *)(link_trb->ring_seg_ptrlo << 4);
 
@@ -1078,6 +1154,44 @@ static int _xusb_queue_trb(u32 ep_idx, const void *trb, bool ring_doorbell)
 		usbd_xotg->bulkin_epenqueue_ptr = next_trb;
 		break;
 
+	case USB_EP_BULK2_OUT:
+		memcpy(usbd_xotg->bulk2out_epenqueue_ptr, trb, sizeof(data_trb_t));
+
+		// Advance queue and if Link TRB set index to 0 and toggle cycle bit.
+		next_trb = &usbd_xotg->bulk2out_epenqueue_ptr[1];
+		if (next_trb->trb_type == XUSB_TRB_LINK)
+		{
+			link_trb = (link_trb_t *)next_trb;
+			link_trb->cycle = usbd_xotg->bulk2out_producer_cycle & 1;
+			link_trb->toggle_cycle = 1;
+			link_trb->chain = chain;
+
+			next_trb = (data_trb_t *)(link_trb->ring_seg_ptrlo << 4);
+
+			usbd_xotg->bulk2out_producer_cycle ^= 1;
+		}
+		usbd_xotg->bulk2out_epenqueue_ptr = next_trb;
+		break;
+
+	case USB_EP_BULK2_IN:
+		memcpy(usbd_xotg->bulk2in_epenqueue_ptr, trb, sizeof(data_trb_t));
+
+		// Advance queue and if Link TRB set index to 0 and toggle cycle bit.
+		next_trb = &usbd_xotg->bulk2in_epenqueue_ptr[1];
+		if (next_trb->trb_type == XUSB_TRB_LINK)
+		{
+			link_trb = (link_trb_t *)next_trb;
+			link_trb->cycle = usbd_xotg->bulk2in_producer_cycle & 1;
+			link_trb->toggle_cycle = 1;
+			link_trb->chain = chain;
+
+			next_trb = (data_trb_t *)(link_trb->ring_seg_ptrlo << 4);
+
+			usbd_xotg->bulk2in_producer_cycle ^= 1;
+		}
+		usbd_xotg->bulk2in_epenqueue_ptr = next_trb;
+		break;
+
 	case XUSB_EP_CTRL_OUT:
 	default:
 		res = XUSB_ERROR_INVALID_EP;
@@ -1108,7 +1222,7 @@ static void _xusb_create_status_trb(status_trb_t *trb, usb_dir_t direction)
 	trb->dir      = direction;
 }
 
-static void _xusb_create_normal_trb(normal_trb_t *trb, u8 *buf, u32 len, usb_dir_t direction)
+static void _xusb_create_normal_trb(normal_trb_t *trb, u8 *buf, u32 len, u32 ep_idx)
 {
 	u8 producer_cycle;
 
@@ -1117,14 +1231,26 @@ static void _xusb_create_normal_trb(normal_trb_t *trb, u8 *buf, u32 len, usb_dir
 
 	trb->trb_tx_len = len;
 
-	// Single TRB transfer.
+	// Single TRB transfer. Changed for chained TDs.
 	trb->td_size = 0;
 	trb->chain   = 0;
 
-	if (direction == USB_DIR_IN)
+	switch (ep_idx)
+	{
+	case USB_EP_BULK_IN:
 		producer_cycle = usbd_xotg->bulkin_producer_cycle & 1;
-	else
+		break;
+	case USB_EP_BULK2_OUT:
+		producer_cycle = usbd_xotg->bulk2out_producer_cycle & 1;
+		break;
+	case USB_EP_BULK2_IN:
+		producer_cycle = usbd_xotg->bulk2in_producer_cycle & 1;
+		break;
+	case USB_EP_BULK_OUT:
+	default:
 		producer_cycle = usbd_xotg->bulkout_producer_cycle & 1;
+		break;
+	}
 
 	trb->cycle    = producer_cycle;
 	trb->isp      = 1; // Enable interrupt on short packet.
@@ -1166,16 +1292,33 @@ static int _xusb_issue_status_trb(usb_dir_t direction)
 	return res;
 }
 
-static int _xusb_issue_normal_trb(u8 *buf, u32 len, usb_dir_t direction)
+// Queues a TD of chained TRBs and rings the doorbell once. Only its last TRB generates an event.
+static int _xusb_issue_normal_td(u8 *buf, u32 len, u32 ep_idx)
 {
-	normal_trb_t trb = {0};
+	int res;
+	u32 max_pkt_size = xusb_evtq->xusb_ep_ctxt[ep_idx].max_packet_size;
+
+	do
+	{
+		normal_trb_t trb = {0};
+
+		// TRB buffers must not cross a 64KB boundary.
+		u32 trb_len = MIN(len, SZ_64K - ((u32)buf & (SZ_64K - 1)));
+		len -= trb_len;
+
+		_xusb_create_normal_trb(&trb, buf, trb_len, ep_idx);
+		if (len)
+		{
+			// Packets left in the TD after this TRB.
+			trb.td_size = MIN((len + max_pkt_size - 1) / max_pkt_size, 31);
+			trb.chain   = 1;
+			trb.ioc     = 0;
+		}
 
-	_xusb_create_normal_trb(&trb, buf, len, direction);
-	u32 ep_idx = USB_EP_BULK_IN;
-	if (direction == USB_DIR_OUT)
-		ep_idx = USB_EP_BULK_OUT;
+		res = _xusb_queue_trb(ep_idx, &trb, len ? EP_DONT_RING : EP_RING_DOORBELL);
+		buf += trb_len;
+	} while (!res && len);
 
-	int res = _xusb_queue_trb(ep_idx, &trb, EP_RING_DOORBELL);
 	if (!res)
 		usbd_xotg->wait_for_event_trb = XUSB_TRB_NORMAL;
 
@@ -1230,29 +1373,55 @@ static int _xusb_wait_ep_stopped(u32 endpoint)
 	return USB_RES_OK;
 }
 
+static data_trb_t *_xusb_next_trb(data_trb_t *trb)
+{
+	data_trb_t *next_trb = &trb[1];
+	if (next_trb->trb_type == XUSB_TRB_LINK)
+		next_trb = (data_trb_t *)(next_trb->databufptr_lo & 0xFFFFFFF0);
+
+	return next_trb;
+}
+
 static int _xusb_handle_transfer_event(const transfer_event_trb_t *trb)
 {
-	// Advance dequeue list.
-	data_trb_t *next_trb;
+	u32 skipped_bytes = 0;
+	data_trb_t *event_trb = (data_trb_t *)(trb->trb_pointer_lo & 0xFFFFFFF0);
+
+	// Advance dequeue list. Bulk TDs are reaped at once, past the TRB of the event.
 	switch (trb->ep_id)
 	{
 	case XUSB_EP_CTRL_IN:
-		next_trb = &usbd_xotg->cntrl_epdequeue_ptr[1];
-		if (next_trb->trb_type == XUSB_TRB_LINK)
-			next_trb = (data_trb_t *)(next_trb->databufptr_lo & 0xFFFFFFF0);
-		usbd_xotg->cntrl_epdequeue_ptr = next_trb;
+		usbd_xotg->cntrl_epdequeue_ptr = _xusb_next_trb(usbd_xotg->cntrl_epdequeue_ptr);
 		break;
 	case USB_EP_BULK_OUT:
-		next_trb = &usbd_xotg->bulkout_epdequeue_ptr[1];
-		if (next_trb->trb_type == XUSB_TRB_LINK)
-			next_trb = (data_trb_t *)(next_trb->databufptr_lo & 0xFFFFFFF0);
-		usbd_xotg->bulkout_epdequeue_ptr = next_trb;
+		// The last TRB of a TD that ended early can still report its completion.
+		if (event_trb == usbd_xotg->bulkout_short_td_end)
+		{
+			usbd_xotg->bulkout_short_td_end = NULL;
+			return USB_RES_OK;
+		}
+		usbd_xotg->bulkout_short_td_end = NULL;
+
+		// Short packet inside a TD. Its remaining TRBs are skipped.
+		if (event_trb->chain)
+		{
+			while (event_trb->chain)
+			{
+				event_trb = _xusb_next_trb(event_trb);
+				skipped_bytes += event_trb->trb_tx_len;
+			}
+			usbd_xotg->bulkout_short_td_end = event_trb;
+		}
+		usbd_xotg->bulkout_epdequeue_ptr = _xusb_next_trb(event_trb);
 		break;
 	case USB_EP_BULK_IN:
-		next_trb = &usbd_xotg->bulkin_epdequeue_ptr[1];
-		if (next_trb->trb_type == XUSB_TRB_LINK)
-			next_trb = (data_trb_t *)(next_trb->databufptr_lo & 0xFFFFFFF0);
-		usbd_xotg->bulkin_epdequeue_ptr = next_trb;
+		usbd_xotg->bulkin_epdequeue_ptr = _xusb_next_trb(event_trb);
+		break;
+	case USB_EP_BULK2_OUT:
+		usbd_xotg->bulk2out_epdequeue_ptr = _xusb_next_trb(event_trb);
+		break;
+	case USB_EP_BULK2_IN:
+		usbd_xotg->bulk2in_epdequeue_ptr = _xusb_next_trb(event_trb);
 		break;
 	default:
 		// Should never happen.
@@ -1301,10 +1470,25 @@ static int _xusb_handle_transfer_event(const transfer_event_trb_t *trb)
 
 		case USB_EP_BULK_OUT:
 			// If short packet and Bulk OUT, it's not an error because we prime EP for 4KB.
-			usbd_xotg->tx_bytes[USB_DIR_OUT] -= trb->trb_tx_len;
+			usbd_xotg->tx_bytes[USB_DIR_OUT] -= trb->trb_tx_len + skipped_bytes;
 			if (usbd_xotg->tx_count[USB_DIR_OUT])
 				usbd_xotg->tx_count[USB_DIR_OUT]--;
 			break;
+
+		case USB_EP_BULK2_IN:
+			usbd_xotg->ep2_tx_bytes[USB_DIR_IN] -= trb->trb_tx_len;
+			if (usbd_xotg->ep2_tx_count[USB_DIR_IN])
+				usbd_xotg->ep2_tx_count[USB_DIR_IN]--;
+
+			if (trb->trb_tx_len)
+				return XUSB_ERROR_XFER_BULK_IN_RESIDUE;
+			break;
+
+		case USB_EP_BULK2_OUT:
+			usbd_xotg->ep2_tx_bytes[USB_DIR_OUT] -= trb->trb_tx_len;
+			if (usbd_xotg->ep2_tx_count[USB_DIR_OUT])
+				usbd_xotg->ep2_tx_count[USB_DIR_OUT]--;
+			break;
 		}
 		return USB_RES_OK;
 /*
@@ -1553,6 +1737,13 @@ static int _xusb_handle_get_descriptor(const usb_ctrl_setup_t *ctrl_setup)
 				for (u32 i = 0; i < usbd_xotg->desc->cfg->interface.bNumEndpoints; i++)
 					usbd_xotg->desc->cfg->endpoint[i].wMaxPacketSize = 0x40;
 			}
+
+			if (usbd_xotg->uas)
+			{
+				usb_cfg_uas_descr_t *tmp = (usb_cfg_uas_descr_t *)usbd_xotg->desc->cfg;
+				for (u32 i = 0; i < tmp->uas_interface.bNumEndpoints; i++)
+					tmp->uas_endpoint[i].endpoint.wMaxPacketSize = usbd_xotg->port_speed == XUSB_HIGH_SPEED ? 0x200 : 0x40;
+			}
 		}
 		else
 		{
@@ -1562,7 +1753,7 @@ static int _xusb_handle_get_descriptor(const usb_ctrl_setup_t *ctrl_setup)
 				for (u32 i = 0; i < tmp->interface.bNumEndpoints; i++)
 				{
 					tmp->endpoint[i].wMaxPacketSize = 0x200;
-					tmp->endpoint[i].bInterval = usbd_xotg->gadget == USB_GADGET_HID_GAMEPAD ? 4 : 3; // 8ms : 4ms.
+					tmp->endpoint[i].bInterval = 4; // 8 microframes. 1ms.
 				}
 			}
 			else // Full speed. 64 bytes.
@@ -1570,7 +1761,7 @@ static int _xusb_handle_get_descriptor(const usb_ctrl_setup_t *ctrl_setup)
 				for (u32 i = 0; i < tmp->interface.bNumEndpoints; i++)
 				{
 					tmp->endpoint[i].wMaxPacketSize = 0x40;
-					tmp->endpoint[i].bInterval = usbd_xotg->gadget == USB_GADGET_HID_GAMEPAD ? 8 : 4; // 8ms : 4ms.
+					tmp->endpoint[i].bInterval = 1; // 1ms.
 				}
 			}
 		}
@@ -1685,6 +1876,53 @@ static void _xusb_handle_set_request_configuration(const usb_ctrl_setup_t *ctrl_
 	usbd_xotg->device_state = XUSB_CONFIGURED_STS_WAIT;
 }
 
+static int _xusb_handle_set_request_interface(const usb_ctrl_setup_t *ctrl_setup)
+{
+	u32 alt_setting = ctrl_setup->wValue;
+
+	// Only the UMS interface has an alternate setting, UAS.
+	if (ctrl_setup->wIndex || alt_setting > (usbd_xotg->uas ? 1 : 0))
+	{
+		xusb_set_ep_stall(XUSB_EP_CTRL_IN, USB_EP_CFG_STALL);
+		return USB_RES_OK;
+	}
+
+	usbd_xotg->interface_num = ctrl_setup->wIndex;
+	usbd_xotg->alt_setting   = alt_setting;
+
+	// Endpoints of the interface are reset on every selection.
+	if (usbd_xotg->config_num)
+	{
+		_xusbd_ep_disable(USB_EP_BULK2_OUT);
+		_xusbd_ep_disable(USB_EP_BULK2_IN);
+		_xusbd_ep_disable(USB_EP_BULK_OUT);
+		_xusbd_ep_disable(USB_EP_BULK_IN);
+
+		usbd_xotg->tx_count[USB_DIR_OUT] = 0;
+		usbd_xotg->tx_count[USB_DIR_IN]  = 0;
+		usbd_xotg->tx_bytes[USB_DIR_OUT] = 0;
+		usbd_xotg->tx_bytes[USB_DIR_IN]  = 0;
+		usbd_xotg->ep2_tx_count[USB_DIR_OUT] = 0;
+		usbd_xotg->ep2_tx_count[USB_DIR_IN]  = 0;
+		usbd_xotg->ep2_tx_bytes[USB_DIR_OUT] = 0;
+		usbd_xotg->ep2_tx_bytes[USB_DIR_IN]  = 0;
+
+		_xusbd_ep_initialize(USB_EP_BULK_OUT);
+		_xusbd_ep_initialize(USB_EP_BULK_IN);
+		if (alt_setting)
+		{
+			_xusbd_ep_initialize(USB_EP_BULK2_OUT);
+			_xusbd_ep_initialize(USB_EP_BULK2_IN);
+		}
+	}
+
+	// UAS has no GET_MAX_LUN. LUNs are ready when it gets selected.
+	if (alt_setting && usbd_xotg->device_state == XUSB_CONFIGURED)
+		usbd_xotg->device_state = XUSB_LUN_CONFIGURED_STS_WAIT;
+
+	return _xusb_issue_status_trb(USB_DIR_IN);
+}
+
 static int _xusbd_handle_ep0_control_transfer(usb_ctrl_setup_t *ctrl_setup)
 {
 	u32 size;
@@ -1721,7 +1959,8 @@ static int _xusbd_handle_ep0_control_transfer(usb_ctrl_setup_t *ctrl_setup)
 		return USB_RES_OK; // What about others.
 
 	case (USB_SETUP_HOST_TO_DEVICE | USB_SETUP_TYPE_STANDARD | USB_SETUP_RECIPIENT_INTERFACE): // 0x01.
-		usbd_xotg->interface_num = _wValue;
+		if (_bRequest == USB_REQUEST_SET_INTERFACE)
+			return _xusb_handle_set_request_interface(ctrl_setup);
 		return _xusb_issue_status_trb(USB_DIR_IN);
 
 	case (USB_SETUP_HOST_TO_DEVICE | USB_SETUP_TYPE_STANDARD | USB_SETUP_RECIPIENT_ENDPOINT):  // 0x02.
@@ -1744,6 +1983,12 @@ static int _xusbd_handle_ep0_control_transfer(usb_ctrl_setup_t *ctrl_setup)
 				case USB_EP_ADDR_BULK_IN:
 					ep = USB_EP_BULK_IN;
 					break;
+				case USB_EP_ADDR_BULK2_OUT:
+					ep = USB_EP_BULK2_OUT;
+					break;
+				case USB_EP_ADDR_BULK2_IN:
+					ep = USB_EP_BULK2_IN;
+					break;
 				default:
 					xusb_set_ep_stall(XUSB_EP_CTRL_IN, USB_EP_CFG_STALL);
 					return USB_RES_OK;
@@ -1790,7 +2035,7 @@ static int _xusbd_handle_ep0_control_transfer(usb_ctrl_setup_t *ctrl_setup)
 		{
 			desc = xusb_interface_descriptor;
 			size = sizeof(xusb_interface_descriptor);
-			xusb_interface_descriptor[0] = usbd_xotg->interface_num;
+			xusb_interface_descriptor[0] = usbd_xotg->alt_setting;
 			transmit_data = true;
 		}
 		else if (_bRequest == USB_REQUEST_GET_STATUS)
@@ -1836,6 +2081,12 @@ static int _xusbd_handle_ep0_control_transfer(usb_ctrl_setup_t *ctrl_setup)
 			case USB_EP_ADDR_BULK_IN:
 				ep = USB_EP_BULK_IN;
 				break;
+			case USB_EP_ADDR_BULK2_OUT:
+				ep = USB_EP_BULK2_OUT;
+				break;
+			case USB_EP_ADDR_BULK2_IN:
+				ep = USB_EP_BULK2_IN;
+				break;
 			default:
 				xusb_set_ep_stall(XUSB_EP_CTRL_IN, USB_EP_CFG_STALL);
 				return USB_RES_OK;
@@ -1966,7 +2217,7 @@ int xusb_device_enumerate(usb_gadget_type gadget)
 	switch (gadget)
 	{
 	case USB_GADGET_UMS:
-		usbd_xotg->desc = &usb_gadget_ums_descriptors;
+		usbd_xotg->desc = &usb_gadget_ums_uas_descriptors;
 		break;
 	case USB_GADGET_HID_GAMEPAD:
 		usbd_xotg->desc = &usb_gadget_hid_jc_descriptors;
@@ -1977,6 +2228,7 @@ int xusb_device_enumerate(usb_gadget_type gadget)
 	}
 
 	usbd_xotg->gadget = gadget;
+	usbd_xotg->uas    = gadget == USB_GADGET_UMS;
 
 	/*
 	 * Set interrupt moderation to 0us.
@@ -2071,14 +2323,14 @@ int xusb_handle_ep0_ctrl_setup(u32 *data)
 
 int xusb_device_ep1_out_read(u8 *buf, u32 len, u32 *bytes_read, u32 sync_tries)
 {
-	if (len > USB_EP_BUFFER_MAX_SIZE)
-		len = USB_EP_BUFFER_MAX_SIZE;
+	if (len > USB_EP_CHAIN_MAX_SIZE)
+		len = USB_EP_CHAIN_MAX_SIZE;
 
 	int res = USB_RES_OK;
 	usbd_xotg->tx_count[USB_DIR_OUT] = 0;
 	usbd_xotg->tx_bytes[USB_DIR_OUT] = len;
 
-	_xusb_issue_normal_trb(buf, len, USB_DIR_OUT);
+	_xusb_issue_normal_td(buf, len, USB_EP_BULK_OUT);
 	usbd_xotg->tx_count[USB_DIR_OUT]++;
 
 	if (sync_tries)
@@ -2107,7 +2359,7 @@ int xusb_device_ep1_out_read_big(u8 *buf, u32 len, u32 *bytes_read)
 
 	while (len)
 	{
-		u32 len_ep = MIN(len, USB_EP_BUFFER_MAX_SIZE);
+		u32 len_ep = MIN(len, USB_EP_CHAIN_MAX_SIZE);
 
 		int res = xusb_device_ep1_out_read(buf_curr, len_ep, &bytes, USB_XFER_SYNCED_DATA);
 		if (res)
@@ -2138,8 +2390,8 @@ int xusb_device_ep1_out_reading_finish(u32 *pending_bytes, u32 sync_tries)
 
 int xusb_device_ep1_in_write(u8 *buf, u32 len, u32 *bytes_written, u32 sync_tries)
 {
-	if (len > USB_EP_BUFFER_MAX_SIZE)
-		len = USB_EP_BUFFER_MAX_SIZE;
+	if (len > USB_EP_CHAIN_MAX_SIZE)
+		len = USB_EP_CHAIN_MAX_SIZE;
 
 	// Flush data before transfer.
 	bpmp_mmu_maintenance(BPMP_MMU_MAINT_CLEAN_WAY, false);
@@ -2148,7 +2400,7 @@ int xusb_device_ep1_in_write(u8 *buf, u32 len, u32 *bytes_written, u32 sync_trie
 	usbd_xotg->tx_count[USB_DIR_IN] = 0;
 	usbd_xotg->tx_bytes[USB_DIR_IN] = len;
 
-	_xusb_issue_normal_trb(buf, len, USB_DIR_IN);
+	_xusb_issue_normal_td(buf, len, USB_EP_BULK_IN);
 	usbd_xotg->tx_count[USB_DIR_IN]++;
 
 	if (sync_tries)
@@ -2165,7 +2417,7 @@ int xusb_device_ep1_in_write(u8 *buf, u32 len, u32 *bytes_written, u32 sync_trie
 			(usbd_xotg->port_speed == XUSB_HIGH_SPEED  && len == 512) ||
 			(usbd_xotg->port_speed == XUSB_SUPER_SPEED && len == 1024))
 		{
-			_xusb_issue_normal_trb(buf, 0, USB_DIR_IN);
+			_xusb_issue_normal_td(buf, 0, USB_EP_BULK_IN);
 			usbd_xotg->tx_count[USB_DIR_IN]++;
 		}
 	}
@@ -2185,6 +2437,82 @@ int xusb_device_ep1_in_writing_finish(u32 *pending_bytes, u32 sync_tries)
 	return res;
 }
 
+bool xusb_device_get_uas()
+{
+	return usbd_xotg->alt_setting == 1;
+}
+
+// UAS command pipe.
+int xusb_device_ep2_out_read(u8 *buf, u32 len, u32 *bytes_read, u32 sync_tries)
+{
+	if (len > USB_EP_BUFFER_MAX_SIZE)
+		len = USB_EP_BUFFER_MAX_SIZE;
+
+	int res = USB_RES_OK;
+	usbd_xotg->ep2_tx_count[USB_DIR_OUT] = 0;
+	usbd_xotg->ep2_tx_bytes[USB_DIR_OUT] = len;
+
+	_xusb_issue_normal_td(buf, len, USB_EP_BULK2_OUT);
+	usbd_xotg->ep2_tx_count[USB_DIR_OUT]++;
+
+	if (sync_tries)
+	{
+		while (!res && usbd_xotg->ep2_tx_count[USB_DIR_OUT])
+			res = _xusb_ep_operation(sync_tries);
+
+		if (bytes_read)
+			*bytes_read = res ? 0 : usbd_xotg->ep2_tx_bytes[USB_DIR_OUT];
+	}
+
+	// Invalidate data after transfer.
+	bpmp_mmu_maintenance(BPMP_MMU_MAINT_INVALID_WAY, false);
+
+	return res;
+}
+
+int xusb_device_ep2_out_reading_finish(u32 *pending_bytes, u32 sync_tries)
+{
+	int res = USB_RES_OK;
+	while (!res && usbd_xotg->ep2_tx_count[USB_DIR_OUT])
+		res = _xusb_ep_operation(sync_tries);
+
+	if (pending_bytes)
+		*pending_bytes = res ? 0 : usbd_xotg->ep2_tx_bytes[USB_DIR_OUT];
+
+	// Invalidate data after transfer.
+	bpmp_mmu_maintenance(BPMP_MMU_MAINT_INVALID_WAY, false);
+
+	return res;
+}
+
+// UAS status pipe. IUs are always shorter than a packet, so no ZLP is needed.
+int xusb_device_ep2_in_write(u8 *buf, u32 len, u32 *bytes_written, u32 sync_tries)
+{
+	if (len > USB_EP_BUFFER_MAX_SIZE)
+		len = USB_EP_BUFFER_MAX_SIZE;
+
+	// Flush data before transfer.
+	bpmp_mmu_maintenance(BPMP_MMU_MAINT_CLEAN_WAY, false);
+
+	int res = USB_RES_OK;
+	usbd_xotg->ep2_tx_count[USB_DIR_IN] = 0;
+	usbd_xotg->ep2_tx_bytes[USB_DIR_IN] = len;
+
+	_xusb_issue_normal_td(buf, len, USB_EP_BULK2_IN);
+	usbd_xotg->ep2_tx_count[USB_DIR_IN]++;
+
+	if (sync_tries)
+	{
+		while (!res && usbd_xotg->ep2_tx_count[USB_DIR_IN])
+			res = _xusb_ep_operation(sync_tries);
+
+		if (bytes_written)
+			*bytes_written = res ? 0 : usbd_xotg->ep2_tx_bytes[USB_DIR_IN];
+	}
+
+	return res;
+}
+
 bool xusb_device_get_port_in_sleep()
 {
 	// Ejection heuristic.
@@ -2253,4 +2581,9 @@ void xusb_device_get_ops(usb_ops_t *ops)
 	ops->usb_device_ep1_out_reading_finish = xusb_device_ep1_out_reading_finish;
 	ops->usb_device_ep1_in_write           = xusb_device_ep1_in_write;
 	ops->usb_device_ep1_in_writing_finish  = xusb_device_ep1_in_writing_finish;
+
+	ops->usb_device_get_uas                = xusb_device_get_uas;
+	ops->usb_device_ep2_out_read           = xusb_device_ep2_out_read;
+	ops->usb_device_ep2_out_reading_finish = xusb_device_ep2_out_reading_finish;
+	ops->usb_device_ep2_in_write           = xusb_device_ep2_in_write;
 }
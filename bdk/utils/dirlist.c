@@ -21,86 +21,205 @@
 #include <libs/fatfs/ff.h>
 #include <mem/heap.h>
 #include <utils/types.h>
+#include <utils/util.h>
 
-dirlist_t *dirlist(const char *directory, const char *pattern, u32 flags)
+#define DIR_ARENA_BLK_SIZE SZ_16K
+
+typedef struct _dir_arena_blk_t
 {
-	int res = 0;
-	u32 k = 0;
-	DIR dir;
-	FILINFO fno;
-	bool show_hidden = !!(flags & DIR_SHOW_HIDDEN);
-	bool show_dirs   = !!(flags & DIR_SHOW_DIRS);
-	bool ascii_order = !!(flags & DIR_ASCII_ORDER);
+	struct _dir_arena_blk_t *next;
+	u32 used;
+	u32 count;
+	u8  data[DIR_ARENA_BLK_SIZE] __attribute__((aligned(8)));
+} dir_arena_blk_t;
+
+int dirlist_iter_open(dirlist_iter_t *iter, const char *directory, const char *pattern, u32 flags)
+{
+	int res;
+
+	iter->flags   = flags;
+	iter->pattern = !!pattern;
+	iter->pending = !!pattern;
+
+	if (pattern)
+		res = f_findfirst(&iter->dir, &iter->fno, directory, pattern);
+	else
+		res = f_opendir(&iter->dir, directory);
+
+	iter->opened = !res;
 
-	dirlist_t *dir_entries = (dirlist_t *)malloc(sizeof(dirlist_t));
+	return res;
+}
+
+FILINFO *dirlist_iter_next(dirlist_iter_t *iter)
+{
+	bool show_hidden = !!(iter->flags & DIR_SHOW_HIDDEN);
+	bool show_dirs   = !!(iter->flags & DIR_SHOW_DIRS);
+	FILINFO *fno = &iter->fno;
 
-	// Setup pointer tree.
-	for (u32 i = 0; i < DIR_MAX_ENTRIES; i++)
-		dir_entries->name[i] = &dir_entries->data[i * 256];
+	if (!iter->opened)
+		return NULL;
 
-	if (!pattern && !f_opendir(&dir, directory))
+	while (true)
 	{
-		for (;;)
+		if (iter->pattern)
 		{
-			res = f_readdir(&dir, &fno);
-			if (res || !fno.fname[0])
+			// First entry is already read by f_findfirst.
+			if (!iter->pending && f_findnext(&iter->dir, fno))
 				break;
-
-			bool curr_parse = show_dirs ? (fno.fattrib & AM_DIR) : !(fno.fattrib & AM_DIR);
-
-			if (curr_parse)
-			{
-				if ((fno.fname[0] != '.') && (show_hidden || !(fno.fattrib & AM_HID)))
-				{
-					strcpy(&dir_entries->data[k * 256], fno.fname);
-					if (++k >= DIR_MAX_ENTRIES)
-						break;
-				}
-			}
+			iter->pending = false;
 		}
-		f_closedir(&dir);
+		else if (f_readdir(&iter->dir, fno))
+			break;
+
+		if (!fno->fname[0])
+			break;
+
+		// Pattern mode only returns files.
+		bool curr_parse;
+		if (iter->pattern)
+			curr_parse = !(fno->fattrib & AM_DIR);
+		else
+			curr_parse = show_dirs ? (fno->fattrib & AM_DIR) : !(fno->fattrib & AM_DIR);
+
+		if (curr_parse && (fno->fname[0] != '.') && (show_hidden || !(fno->fattrib & AM_HID)))
+			return fno;
 	}
-	else if (pattern && !f_findfirst(&dir, &fno, directory, pattern) && fno.fname[0])
+
+	return NULL;
+}
+
+void dirlist_iter_close(dirlist_iter_t *iter)
+{
+	if (iter->opened)
+		f_closedir(&iter->dir);
+	iter->opened = false;
+}
+
+static char *_dirlist_arena_alloc(dir_arena_blk_t **curr, u32 size)
+{
+	dir_arena_blk_t *blk = *curr;
+
+	if (!blk || (blk->used + size) > DIR_ARENA_BLK_SIZE)
+	{
+		dir_arena_blk_t *new_blk = (dir_arena_blk_t *)malloc(sizeof(dir_arena_blk_t));
+		new_blk->next  = blk;
+		new_blk->used  = 0;
+		new_blk->count = 0;
+		blk = new_blk;
+		*curr = blk;
+	}
+
+	char *ptr = (char *)&blk->data[blk->used];
+	blk->used += size;
+	blk->count++;
+
+	return ptr;
+}
+
+static void _dirlist_arena_free(dir_arena_blk_t *blk)
+{
+	while (blk)
 	{
-		do
+		dir_arena_blk_t *next = blk->next;
+		free(blk);
+		blk = next;
+	}
+}
+
+dirlist_t *dirlist(const char *directory, const char *pattern, u32 flags)
+{
+	u32 k = 0;
+	u32 names_size = 0;
+	bool with_info = !!(flags & DIR_WITH_INFO);
+	u32  info_size = with_info ? sizeof(dirlist_info_t) : 0;
+	dir_arena_blk_t *arena = NULL;
+	dir_arena_blk_t *blk;
+	dirlist_iter_t iter;
+	FILINFO *fno;
+
+	// Gather entries in arena blocks. Each record is [info] + name.
+	if (dirlist_iter_open(&iter, directory, pattern, flags))
+		return NULL;
+
+	while ((fno = dirlist_iter_next(&iter)))
+	{
+		u32 len = strlen(fno->fname) + 1;
+		char *rec = _dirlist_arena_alloc(&arena, ALIGN(info_size + len, 8));
+
+		if (with_info)
 		{
-			if (!(fno.fattrib & AM_DIR) && (fno.fname[0] != '.') && (show_hidden || !(fno.fattrib & AM_HID)))
-			{
-				strcpy(&dir_entries->data[k * 256], fno.fname);
-				if (++k >= DIR_MAX_ENTRIES)
-					break;
-			}
-			res = f_findnext(&dir, &fno);
-		} while (fno.fname[0] && !res);
-		f_closedir(&dir);
+			dirlist_info_t *info = (dirlist_info_t *)rec;
+			info->size = fno->fsize;
+			info->date = fno->fdate;
+			info->time = fno->ftime;
+			info->attr = fno->fattrib;
+		}
+		memcpy(rec + info_size, fno->fname, len);
+
+		names_size += len;
+		k++;
 	}
+	dirlist_iter_close(&iter);
 
 	if (!k)
 	{
-		free(dir_entries);
+		_dirlist_arena_free(arena);
 
 		return NULL;
 	}
 
-	// Terminate name list.
-	dir_entries->name[k] = NULL;
+	// Create final list in a single allocation. Layout: header, info, name pointers, names.
+	u32 info_off  = ALIGN(sizeof(dirlist_t), 8);
+	u32 name_off  = info_off + k * info_size;
+	u32 names_off = name_off + (k + 1) * sizeof(char *);
+	dirlist_t *dir_entries = (dirlist_t *)malloc(names_off + names_size);
 
-	// Choose list ordering.
-	int (*strcmpex)(const char* str1, const char* str2) = ascii_order ? strcmp : strcasecmp;
+	dir_entries->count = k;
+	dir_entries->info  = with_info ? (dirlist_info_t *)((u8 *)dir_entries + info_off) : NULL;
+	dir_entries->name  = (char **)((u8 *)dir_entries + name_off);
 
-	// Reorder ini files Alphabetically.
-	for (u32 i = 0; i < k - 1 ; i++)
+	// Point to arena names. Blocks are in reverse order, so fill from the end.
+	u32 idx = k;
+	for (blk = arena; blk; blk = blk->next)
 	{
-		for (u32 j = i + 1; j < k; j++)
+		u32 pos = 0;
+
+		idx -= blk->count;
+		for (u32 i = 0; i < blk->count; i++)
 		{
-			if (strcmpex(dir_entries->name[i], dir_entries->name[j]) > 0)
-			{
-				char *tmp = dir_entries->name[i];
-				dir_entries->name[i] = dir_entries->name[j];
-				dir_entries->name[j] = tmp;
-			}
+			char *name = (char *)&blk->data[pos + info_size];
+			dir_entries->name[idx + i] = name;
+			pos += ALIGN(info_size + strlen(name) + 1, 8);
 		}
 	}
 
+	// Choose list ordering.
+	if (!(flags & DIR_NO_SORT))
+	{
+		int (*compare)(const void *, const void *) = (flags & DIR_ASCII_ORDER) ? qsort_compare_char : qsort_compare_char_case;
+		qsort(dir_entries->name, k, sizeof(char *), compare);
+	}
+
+	// Compact names and info to the final allocation.
+	char *names = (char *)dir_entries + names_off;
+	for (u32 i = 0; i < k; i++)
+	{
+		char *name = dir_entries->name[i];
+		u32 len = strlen(name) + 1;
+
+		if (with_info)
+			memcpy(&dir_entries->info[i], name - info_size, sizeof(dirlist_info_t));
+
+		memcpy(names, name, len);
+		dir_entries->name[i] = names;
+		names += len;
+	}
+
+	// Terminate name list.
+	dir_entries->name[k] = NULL;
+
+	_dirlist_arena_free(arena);
+
 	return dir_entries;
 }
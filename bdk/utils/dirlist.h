@@ -14,23 +14,49 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <libs/fatfs/ff.h>
 #include <utils/types.h>
 
 #ifndef _DIRLIST_H_
 #define _DIRLIST_H_
 
-#define DIR_MAX_ENTRIES 64
-
 #define DIR_SHOW_HIDDEN BIT(0)
 #define DIR_SHOW_DIRS   BIT(1)
 #define DIR_ASCII_ORDER BIT(2)
+#define DIR_WITH_INFO   BIT(3) // Also capture size, attributes and timestamps.
+#define DIR_NO_SORT     BIT(4)
+
+typedef struct _dirlist_info_t
+{
+	FSIZE_t size;
+	u16 date;
+	u16 time;
+	u8  attr;
+} dirlist_info_t;
 
+// Single allocation. Freeing the returned pointer frees everything.
 typedef struct _dirlist_t
 {
-	char *name[DIR_MAX_ENTRIES];
-	char  data[DIR_MAX_ENTRIES * 256];
+	u32 count;
+	char **name;          // NULL terminated.
+	dirlist_info_t *info; // Only valid with DIR_WITH_INFO. Same order as name.
 } dirlist_t;
 
+typedef struct _dirlist_iter_t
+{
+	DIR dir;
+	FILINFO fno;
+	u32 flags;
+	bool pattern;
+	bool pending;
+	bool opened;
+} dirlist_iter_t;
+
 dirlist_t *dirlist(const char *directory, const char *pattern, u32 flags);
 
+// Streaming mode. Entries are filtered as in dirlist() but not sorted.
+int      dirlist_iter_open(dirlist_iter_t *iter, const char *directory, const char *pattern, u32 flags);
+FILINFO *dirlist_iter_next(dirlist_iter_t *iter);
+void     dirlist_iter_close(dirlist_iter_t *iter);
+
 #endif
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2025 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -239,6 +239,31 @@ u32 crc32_calc(u32 crc, const u8 *buf, u32 len)
 	return ~crc;
 }
 
+bool mem_is_zero(const void *buf, u32 size)
+{
+	const u32 *p = (const u32 *)buf;
+	const u32 *end = p + (size >> 2);
+
+	// Scan 32 bytes per iteration and stop at the first set word.
+	while ((end - p) >= 8)
+	{
+		if (p[0] | p[1] | p[2] | p[3] | p[4] | p[5] | p[6] | p[7])
+			return false;
+		p += 8;
+	}
+
+	while (p < end)
+		if (*p++)
+			return false;
+
+	// Unaligned tail.
+	for (const u8 *b = (const u8 *)end; b < (const u8 *)buf + size; b++)
+		if (*b)
+			return false;
+
+	return true;
+}
+
 int qsort_compare_int(const void *a, const void *b)
 {
 	return (*(int *)a - *(int *)b);
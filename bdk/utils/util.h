@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 naehrwert
- * Copyright (c) 2018-2025 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -46,6 +46,7 @@ int  atoi(const char *nptr);
 
 void reg_write_array(vu32 *base, const reg_cfg_t *cfg, u32 num_cfg);
 u32  crc32_calc(u32 crc, const u8 *buf, u32 len);
+bool mem_is_zero(const void *buf, u32 size); // buf must be 4-byte aligned.
 
 int qsort_compare_int(const void *a, const void *b);
 int qsort_compare_char(const void *a, const void *b);
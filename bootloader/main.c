@@ -250,7 +250,7 @@ static void _launch_payloads()
 
 		while (true)
 		{
-			if (i > max_entries || !filelist->name[i])
+			if (i >= max_entries || !filelist->name[i])
 				break;
 			ments[i + 2].type    = INI_CHOICE;
 			ments[i + 2].caption = filelist->name[i];
@@ -579,8 +579,9 @@ out:
 
 static void _nyx_load_run()
 {
-	u8 *nyx = sd_file_read("bootloader/sys/nyx.bin", NULL);
-	if (!nyx)
+	// Read it straight to its link address, so it doesn't need to relocate itself.
+	u8 *nyx = (u8 *)NYX_LOAD_ADDR;
+	if (!sd_file_read_into("bootloader/sys/nyx.bin", nyx, NYX_SZ_MAX))
 		return;
 
 	sd_end();
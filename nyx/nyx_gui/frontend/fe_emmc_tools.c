@@ -27,6 +27,7 @@
 #include "fe_emmc_tools.h"
 #include "fe_emummc_tools.h"
 #include "../config.h"
+#include <libs/compr/lz4.h>
 #include <libs/fatfs/ff.h>
 
 #define VERIF_STATUS_OK    0
@@ -141,7 +142,140 @@ static void _update_filename(char *outFilename, u32 sdPathLen, u32 currPartIdx)
 		itoa(currPartIdx, &outFilename[sdPathLen], 10);
 }
 
-static int _emmc_sd_copy_verify(emmc_tool_gui_t *gui, sdmmc_storage_t *storage, u32 lba_curr, const char *outFilename, const emmc_part_t *part)
+/*
+ * Copy pipeline. eMMC (SDMMC4) and SD (SDMMC1) are independent controllers,
+ * so the eMMC side runs in the background on one buffer, while the caller
+ * does the SD side on the other one.
+ */
+void emmc_pipe_init(emmc_pipe_t *pipe, sdmmc_storage_t *storage)
+{
+	memset(pipe, 0, sizeof(emmc_pipe_t));
+	pipe->storage = storage;
+
+	// Rotate 4MB slices of the mixed buffer.
+	for (u32 i = 0; i < ARRAY_SIZE(pipe->buf); i++)
+		pipe->buf[i] = (u8 *)MIXD_BUF_ALIGNED + i * NUM_SECTORS_PER_ITER * EMMC_BLOCKSIZE;
+
+	// SD can't overlap with itself.
+	pipe->async = storage != &sd_storage;
+}
+
+u8 *emmc_pipe_buf(emmc_pipe_t *pipe)
+{
+	return pipe->buf[pipe->idx];
+}
+
+int emmc_pipe_flush(emmc_pipe_t *pipe)
+{
+	int res = pipe->res;
+	pipe->res = 0;
+
+	if (pipe->pending)
+	{
+		pipe->pending = false;
+		res = sdmmc_storage_async_end(pipe->storage);
+
+		// Redo a failed background write with the normal retry path.
+		if (res && pipe->is_write)
+			res = sdmmc_storage_write(pipe->storage, pipe->lba, pipe->num, pipe->xbuf);
+	}
+
+	return res;
+}
+
+int emmc_pipe_read(emmc_pipe_t *pipe, u32 lba, u32 num, u32 num_next)
+{
+	int res = 1;
+
+	// Use prefetched data if it's the requested chunk.
+	if (pipe->pending)
+	{
+		bool match = !pipe->is_write && pipe->lba == lba && pipe->num == num;
+		res = emmc_pipe_flush(pipe) || !match;
+		if (!res)
+			pipe->idx ^= 1;
+	}
+
+	if (res)
+		res = sdmmc_storage_read(pipe->storage, lba, num, pipe->buf[pipe->idx]);
+
+	if (res)
+		return res;
+
+	// Prefetch next chunk while the caller consumes this one.
+	if (num_next)
+		emmc_pipe_prefetch(pipe, lba + num, num_next);
+
+	return 0;
+}
+
+// Starts reading any chunk in the background. Used by emmc_pipe_read() if it's the one requested.
+int emmc_pipe_prefetch(emmc_pipe_t *pipe, u32 lba, u32 num)
+{
+	if (!pipe->async || pipe->pending)
+		return 1;
+
+	u8 *buf = pipe->buf[pipe->idx ^ 1];
+	if (sdmmc_storage_read_async(pipe->storage, lba, num, buf))
+		return 1;
+
+	pipe->pending  = true;
+	pipe->is_write = false;
+	pipe->lba  = lba;
+	pipe->num  = num;
+	pipe->xbuf = buf;
+
+	return 0;
+}
+
+int emmc_pipe_write(emmc_pipe_t *pipe, u32 lba, u32 num)
+{
+	// Report previous write first. Caller can redo it with emmc_pipe_retry().
+	int res = emmc_pipe_flush(pipe);
+	if (res)
+		return res;
+
+	pipe->is_write = true;
+	pipe->lba  = lba;
+	pipe->num  = num;
+	pipe->xbuf = pipe->buf[pipe->idx];
+	pipe->idx ^= 1;
+
+	// Write in the background while the caller fills the other buffer.
+	if (pipe->async && !sdmmc_storage_write_async(pipe->storage, lba, num, pipe->xbuf))
+		pipe->pending = true;
+	else
+		pipe->res = sdmmc_storage_write(pipe->storage, lba, num, pipe->xbuf);
+
+	return 0;
+}
+
+int emmc_pipe_retry(emmc_pipe_t *pipe)
+{
+	return sdmmc_storage_write(pipe->storage, pipe->lba, pipe->num, pipe->xbuf);
+}
+
+static void _emmc_sd_hash_str(char *str, const u8 *hash)
+{
+	static const char hexa[] = "0123456789abcdef";
+
+	// Transform computed hash to readable hexadecimal.
+	for (int i = 0; i < SE_SHA_256_SIZE; i++)
+	{
+		*(str++) = hexa[hash[i] >> 4];
+		*(str++) = hexa[hash[i] & 0x0F];
+	}
+	*str = '\0';
+}
+
+/*
+ * Verification pipeline. The eMMC side prefetches the next checked chunk in the
+ * background. The SD side reads each chunk in two halves and the SE hashes the
+ * previous SD chunk and the current eMMC chunk behind them. So it takes about
+ * one pass over the SD card.
+ * If run_hash is set, the manifest chain must also match it.
+ */
+static int _emmc_sd_copy_verify(emmc_tool_gui_t *gui, sdmmc_storage_t *storage, u32 lba_curr, const char *outFilename, const emmc_part_t *part, const u8 *run_hash)
 {
 	FIL fp;
 	FIL hashFp;
@@ -149,200 +283,1179 @@ static int _emmc_sd_copy_verify(emmc_tool_gui_t *gui, sdmmc_storage_t *storage,
 	u32 prevPct = 200;
 	u32 sdFileSector = 0;
 	int res = 0;
-	static const char hexa[] = "0123456789abcdef";
+	int status = VERIF_STATUS_OK;
 	DWORD *clmt = NULL;
+	emmc_pipe_t pipe;
+	char hashFilename[HASH_FILENAME_SZ];
+	char hashStr[SE_SHA_256_SIZE * 2 + 1];
+
+	bool hashFile = n_cfg.verification >= 3;
+	bool manifest = n_cfg.verification == 4;
+
+	u8 hashEm[SE_SHA_256_SIZE];
+	u8 hashSd[SE_SHA_256_SIZE];
+	u8 chain[SE_SHA_256_SIZE * 2]; // Running hash of the file and last chunk hash.
+
+	if (f_open(&fp, outFilename, FA_READ) != FR_OK)
+	{
+		strcpy(gui->txt_buf, "\n#FFDD00 File not found or could not be loaded!#\n#FFDD00 Verification failed..#\n");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		return VERIF_STATUS_ERROR;
+	}
+
+	if (hashFile)
+	{
+		strncpy(hashFilename, outFilename, OUT_FILENAME_SZ - 1);
+		hashFilename[OUT_FILENAME_SZ - 1] = '\0';
+		strcat(hashFilename, manifest ? ".manifest" : ".sha256sums");
+
+		res = f_open(&hashFp, hashFilename, FA_CREATE_ALWAYS | FA_WRITE);
+		if (res)
+		{
+			f_close(&fp);
+
+			s_printf(gui->txt_buf,
+					"\n#FF0000 Hash file could not be written (error %d)!#\n"
+					"#FF0000 Aborting..#\n", res);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			return VERIF_STATUS_ERROR;
+		}
+
+		char chunkSizeAscii[10];
+		itoa(NUM_SECTORS_PER_ITER * EMMC_BLOCKSIZE, chunkSizeAscii, 10);
+		chunkSizeAscii[9] = '\0';
+
+		f_puts("# chunksize: ", &hashFp);
+		f_puts(chunkSizeAscii, &hashFp);
+		f_puts("\n", &hashFp);
+
+		// Chunks are hashed from the start of the file. Check with tools/nxcz manifest.
+		if (manifest)
+			f_puts("# hash: chain = SHA256(chain || SHA256(chunk)), starting from 32 zero bytes\n", &hashFp);
+	}
+
+	u32 totalSectorsVer = (u32)((u64)f_size(&fp) >> (u64)9);
+	u32 totalSectorsFile = totalSectorsVer;
+
+	// Rotate SD buffers, so the previous chunk can be hashed while reading the next.
+	u8 *bufSd[2] = { (u8 *)SDXC_BUF_ALIGNED, (u8 *)SDXC_BUF_ALIGNED + NUM_SECTORS_PER_ITER * EMMC_BLOCKSIZE };
+	u32 sdIdx = 0;
+	u32 pendNum = 0; // SD chunk waiting for its hash.
+	u32 pendLba = 0;
+
+	emmc_pipe_init(&pipe, storage);
+	memset(chain, 0, sizeof(chain));
+
+	u32 pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
+	lv_bar_set_value(gui->bar, pct);
+	lv_bar_set_style(gui->bar, LV_BAR_STYLE_BG, gui->bar_teal_bg);
+	lv_bar_set_style(gui->bar, LV_BAR_STYLE_INDIC, gui->bar_teal_ind);
+	s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+	lv_label_set_text(gui->label_pct, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	clmt = f_expand_cltbl(&fp, SZ_4M, 0);
+
+	u32 num = 0;
+	while (totalSectorsVer > 0 || pendNum)
+	{
+		num = MIN(totalSectorsVer, NUM_SECTORS_PER_ITER);
+
+		// Check every time or every 4.
+		// Every 4 protects from fake sd, sector corruption and frequent I/O corruption.
+		// Full provides all that, plus protection from extremely rare I/O corruption.
+		bool check = num && ((n_cfg.verification >= 2) || !(sparseShouldVerify % 4));
+
+		if (check)
+		{
+			// Read chunk and prefetch the next checked one.
+			u32 nextOff = num + ((n_cfg.verification >= 2) ? 0 : 3 * NUM_SECTORS_PER_ITER);
+			u32 numNext = totalSectorsVer > nextOff ? MIN(totalSectorsVer - nextOff, NUM_SECTORS_PER_ITER) : 0;
+
+			if (emmc_pipe_read(&pipe, lba_curr, num, 0))
+			{
+				s_printf(gui->txt_buf,
+					"\n#FF0000 Failed to read %d blocks (@LBA %08X),#\n"
+					"#FF0000 from eMMC! Verification failed..#\n",
+					num, lba_curr);
+				status = VERIF_STATUS_ERROR;
+				break;
+			}
+			if (numNext)
+				emmc_pipe_prefetch(&pipe, lba_curr + nextOff, numNext);
+
+			f_lseek(&fp, (u64)sdFileSector << (u64)9);
+		}
+
+		// Split SD read at a cluster boundary.
+		u32 half = check ? ALIGN_DOWN(num >> 1, sd_fs.csize) : 0;
+
+		// Hash previous SD chunk while reading the first half.
+		if (pendNum)
+			se_sha_hash_256_async(hashSd, bufSd[sdIdx ^ 1], pendNum << 9);
+		res = check ? f_read_fast(&fp, bufSd[sdIdx], half << 9) : 0;
+		if (pendNum)
+		{
+			se_sha_hash_256_finalize(hashSd);
+
+			if (memcmp(hashEm, hashSd, SE_SHA_256_SIZE / 2))
+			{
+				s_printf(gui->txt_buf,
+					"\n#FF0000 SD & eMMC data (@LBA %08X) do not match!#\n"
+					"\n#FF0000 Verification failed..#\n",
+					pendLba);
+				status = VERIF_STATUS_ERROR;
+				break;
+			}
+
+			if (hashFile && !manifest)
+			{
+				_emmc_sd_hash_str(hashStr, hashSd);
+				f_puts(hashStr, &hashFp);
+				f_puts("\n", &hashFp);
+			}
+
+			// Chain = SHA256(chain || chunk hash).
+			if (manifest)
+			{
+				memcpy(chain + SE_SHA_256_SIZE, hashSd, SE_SHA_256_SIZE);
+				se_sha_hash_256_oneshot(chain, chain, sizeof(chain));
+			}
+
+			pendNum = 0;
+		}
+
+		if (check)
+		{
+			// Hash eMMC chunk while reading the rest.
+			u8 *bufEm = emmc_pipe_buf(&pipe);
+			se_sha_hash_256_async(hashEm, bufEm, num << 9);
+			if (!res)
+				res = f_read_fast(&fp, bufSd[sdIdx] + (half << 9), (num - half) << 9);
+			se_sha_hash_256_finalize(hashEm);
+
+			if (res)
+			{
+				s_printf(gui->txt_buf,
+					"\n#FF0000 Failed to read %d blocks (@LBA %08X),#\n"
+					"#FF0000 from SD card! Verification failed..#\n",
+					num, lba_curr);
+				status = VERIF_STATUS_ERROR;
+				break;
+			}
+
+			pendNum = num;
+			pendLba = lba_curr;
+			sdIdx ^= 1;
+		}
+
+		if (!num)
+			continue;
+
+		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
+		if (pct != prevPct)
+		{
+			lv_bar_set_value(gui->bar, pct);
+			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+			lv_label_set_text(gui->label_pct, gui->txt_buf);
+			manual_system_maintenance(true);
+			prevPct = pct;
+		}
+
+		manual_system_maintenance(false);
+
+		lba_curr += num;
+		totalSectorsVer -= num;
+		sdFileSector += num;
+		sparseShouldVerify++;
+
+		// Check for cancellation combo.
+		if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
+		{
+			strcpy(gui->txt_buf, "#FFDD00 Verification was cancelled!#\n");
+			status = VERIF_STATUS_ABORT;
+			break;
+		}
+	}
+
+	emmc_pipe_flush(&pipe);
+	free(clmt);
+	f_close(&fp);
+
+	// The running hash kept by the backup journal must match the file.
+	if (status == VERIF_STATUS_OK && manifest && run_hash && memcmp(chain, run_hash, SE_SHA_256_SIZE))
+	{
+		strcpy(gui->txt_buf, "\n#FF0000 Running hash of the backup does not match!#\n#FF0000 Verification failed..#\n");
+		status = VERIF_STATUS_ERROR;
+	}
+
+	if (status != VERIF_STATUS_OK)
+	{
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		// Don't leave an incomplete manifest.
+		if (hashFile)
+		{
+			f_close(&hashFp);
+			if (manifest)
+				f_unlink(hashFilename);
+		}
+
+		if (status == VERIF_STATUS_ABORT)
+			msleep(1000);
+
+		return status;
+	}
+
+	if (manifest)
+	{
+		s_printf(gui->txt_buf, "# sectors: %d\n# chain: ", totalSectorsFile);
+		f_puts(gui->txt_buf, &hashFp);
+		_emmc_sd_hash_str(hashStr, chain);
+		f_puts(hashStr, &hashFp);
+		f_puts("\n", &hashFp);
+	}
+	if (hashFile)
+		f_close(&hashFp);
+
+	lv_bar_set_value(gui->bar, pct);
+	s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+	lv_label_set_text(gui->label_pct, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	return VERIF_STATUS_OK;
+}
+
+/*
+ * Compressed backup container. See nx_emmc_cz.h for the layout.
+ */
+#define CZ_BUF_ALIGNED (MIXD_BUF_ALIGNED + SZ_8M) // After the pipe buffers.
+#define CZ_STORE_PATH_SZ 96
+
+typedef struct _emmc_cz_t
+{
+	nx_emmc_cz_hdr_t hdr;
+	nx_emmc_cz_chunk_t *idx;
+	struct _emmc_cz_t *parent; // Previous incremental level.
+	FIL fp;
+	int part; // Opened data file.
+	u8 *cbuf; // Stored chunk data.
+	u32 path_len;
+	char path[OUT_FILENAME_SZ + 12];
+} emmc_cz_t;
+
+static void _emmc_cz_init(emmc_cz_t *cz, const char *sd_path, u32 level)
+{
+	memset(cz, 0, sizeof(emmc_cz_t));
+	if (!level)
+		s_printf(cz->path, "%s"NX_EMMC_CZ_EXT".", sd_path);
+	else
+		s_printf(cz->path, "%s.d%02d"NX_EMMC_CZ_EXT".", sd_path, level);
+	cz->path_len = strlen(cz->path);
+	cz->part = -1;
+	cz->cbuf = (u8 *)CZ_BUF_ALIGNED;
+}
+
+static char *_emmc_cz_path(emmc_cz_t *cz, int part)
+{
+	// Index file if part is negative.
+	if (part < 0)
+		cz->path[cz->path_len - 1] = 0;
+	else
+	{
+		cz->path[cz->path_len - 1] = '.';
+		_update_filename(cz->path, cz->path_len, part);
+	}
+
+	return cz->path;
+}
+
+static int _emmc_cz_close_part(emmc_cz_t *cz)
+{
+	int res = FR_OK;
+
+	if (cz->part >= 0)
+		res = f_close(&cz->fp);
+	cz->part = -1;
+
+	return res;
+}
+
+static int _emmc_cz_open_part(emmc_cz_t *cz, int part, BYTE mode)
+{
+	if (cz->part == part)
+		return FR_OK;
+
+	_emmc_cz_close_part(cz);
+
+	int res = f_open(&cz->fp, _emmc_cz_path(cz, part), mode);
+	if (!res)
+		cz->part = part;
+
+	return res;
+}
+
+static void _emmc_cz_close(emmc_cz_t *cz)
+{
+	_emmc_cz_close_part(cz);
+	free(cz->idx);
+	cz->idx = NULL;
+
+	if (cz->parent)
+	{
+		_emmc_cz_close(cz->parent);
+		free(cz->parent);
+		cz->parent = NULL;
+	}
+}
+
+static void _emmc_cz_unlink(emmc_cz_t *cz, u32 part_cnt)
+{
+	_emmc_cz_close_part(cz);
+
+	f_unlink(_emmc_cz_path(cz, -1));
+	for (u32 i = 0; i < part_cnt; i++)
+		f_unlink(_emmc_cz_path(cz, i));
+}
+
+// Removes all levels from level on. Their data files are removed up to the first missing one.
+static void _emmc_cz_unlink_levels(const char *sd_path, u32 level)
+{
+	emmc_cz_t *cz = (emmc_cz_t *)malloc(sizeof(emmc_cz_t));
+
+	for (u32 i = level; i <= NX_EMMC_CZ_LEVEL_MAX; i++)
+	{
+		_emmc_cz_init(cz, sd_path, i);
+		f_unlink(_emmc_cz_path(cz, -1));
+		for (u32 j = 0; !f_unlink(_emmc_cz_path(cz, j)); j++)
+			;
+	}
+	free(cz);
+}
+
+static u32 _emmc_cz_chunk_len(emmc_cz_t *cz, u32 chunk)
+{
+	u64 offset = (u64)chunk * cz->hdr.chunk_size;
+
+	return MIN(cz->hdr.chunk_size, cz->hdr.image_size - offset);
+}
+
+// Leaves the file at the index. Version 1 has no chain id.
+static int _emmc_cz_load_hdr(FIL *fp, nx_emmc_cz_hdr_t *hdr)
+{
+	UINT br;
+
+	int res = f_read(fp, hdr, sizeof(nx_emmc_cz_hdr_t), &br);
+	if (res || br != sizeof(nx_emmc_cz_hdr_t) || hdr->magic != NX_EMMC_CZ_MAGIC)
+		return res ? res : FR_INT_ERR;
+
+	if (hdr->version == 1)
+	{
+		memset((u8 *)hdr + NX_EMMC_CZ_HDR_V1_SIZE, 0, sizeof(nx_emmc_cz_hdr_t) - NX_EMMC_CZ_HDR_V1_SIZE);
+		return f_lseek(fp, NX_EMMC_CZ_HDR_V1_SIZE);
+	}
+
+	return hdr->version == NX_EMMC_CZ_VERSION ? FR_OK : FR_INT_ERR;
+}
+
+static int _emmc_cz_load(emmc_cz_t *cz)
+{
+	FIL fp;
+	UINT br;
+	u8 hash[SE_SHA_256_SIZE];
+
+	int res = f_open(&fp, _emmc_cz_path(cz, -1), FA_READ);
+	if (res)
+		return res;
+
+	res = _emmc_cz_load_hdr(&fp, &cz->hdr);
+	if (res)
+		goto out;
+
+	// Only 4MB chunks are supported.
+	nx_emmc_cz_hdr_t *hdr = &cz->hdr;
+	u64 chunk_cnt = (hdr->image_size + NX_EMMC_CZ_CHUNK_SIZE - 1) / NX_EMMC_CZ_CHUNK_SIZE;
+	if (hdr->chunk_size != NX_EMMC_CZ_CHUNK_SIZE || (hdr->image_size % EMMC_BLOCKSIZE) ||
+		!hdr->chunk_cnt || hdr->chunk_cnt != chunk_cnt || hdr->level > NX_EMMC_CZ_LEVEL_MAX)
+		goto out;
+
+	u32 idx_size = hdr->chunk_cnt * sizeof(nx_emmc_cz_chunk_t);
+	cz->idx = (nx_emmc_cz_chunk_t *)malloc(idx_size);
+	res = f_read(&fp, cz->idx, idx_size, &br);
+	if (res || br != idx_size)
+		goto out;
+
+	se_sha_hash_256_oneshot(hash, cz->idx, idx_size);
+	if (memcmp(hash, hdr->idx_hash, SE_SHA_256_SIZE))
+		goto out;
+
+	f_close(&fp);
+
+	return FR_OK;
+
+out:
+	f_close(&fp);
+	free(cz->idx);
+	cz->idx = NULL;
+
+	return res ? res : FR_INT_ERR;
+}
+
+// Loads an incremental level and all the previous ones it depends on.
+static int _emmc_cz_load_chain(emmc_cz_t *cz, const char *sd_path, u32 level)
+{
+	_emmc_cz_init(cz, sd_path, level);
+
+	int res = _emmc_cz_load(cz);
+	if (!res && cz->hdr.level != level)
+		res = FR_INT_ERR;
+
+	emmc_cz_t *child = cz;
+	while (!res && child->hdr.level)
+	{
+		emmc_cz_t *parent = (emmc_cz_t *)malloc(sizeof(emmc_cz_t));
+		_emmc_cz_init(parent, sd_path, child->hdr.level - 1);
+		child->parent = parent;
+
+		res = _emmc_cz_load(parent);
+		if (res)
+			break;
+
+		// Must be the exact backup the level was made from.
+		if (parent->hdr.level != child->hdr.level - 1 || parent->hdr.image_size != child->hdr.image_size ||
+			parent->hdr.chain_id != child->hdr.chain_id ||
+			memcmp(parent->hdr.idx_hash, child->hdr.parent_hash, SE_SHA_256_SIZE))
+			res = FR_INT_ERR;
+
+		child = parent;
+	}
+
+	if (res)
+		_emmc_cz_close(cz);
+
+	return res;
+}
+
+/*
+ * Returns the last incremental level of the full backup or -1 if there's no backup.
+ * Levels left from an older full backup have another chain id and are counted as stale.
+ */
+static int _emmc_cz_find_last(const char *sd_path, u32 *stale)
+{
+	FIL fp;
+	nx_emmc_cz_hdr_t hdr;
+	int level = -1;
+	u32 chain_id = 0;
+	emmc_cz_t *cz = (emmc_cz_t *)malloc(sizeof(emmc_cz_t));
+
+	*stale = 0;
+	for (u32 i = 0; i <= NX_EMMC_CZ_LEVEL_MAX; i++)
+	{
+		_emmc_cz_init(cz, sd_path, i);
+		if (f_open(&fp, _emmc_cz_path(cz, -1), FA_READ))
+			break;
+
+		// Unreadable levels are kept in the chain, so that loading reports them.
+		if (_emmc_cz_load_hdr(&fp, &hdr))
+			hdr.chain_id = chain_id;
+		f_close(&fp);
+
+		if (!i)
+			chain_id = hdr.chain_id;
+
+		if (*stale || hdr.chain_id != chain_id)
+			(*stale)++;
+		else
+			level = i;
+	}
+	free(cz);
+
+	return level;
+}
+
+static void _emmc_cz_log_stale(emmc_tool_gui_t *gui, u32 stale)
+{
+	if (!stale)
+		return;
+
+	s_printf(gui->txt_buf, "\n#FFDD00 Ignored %d stale incremental level(s)#\n#FFDD00 of an older full backup.#\n", stale);
+	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+	manual_system_maintenance(true);
+}
+
+// Follows unchanged chunks to the level that stores them.
+static emmc_cz_t *_emmc_cz_resolve(emmc_cz_t *cz, u32 chunk)
+{
+	while (cz && cz->idx[chunk].type == NX_EMMC_CZ_CHUNK_PARENT)
+		cz = cz->parent;
+
+	return cz;
+}
+
+static u32 _emmc_cz_chunk_type(emmc_cz_t *cz, u32 chunk)
+{
+	cz = _emmc_cz_resolve(cz, chunk);
+
+	return cz ? cz->idx[chunk].type : NX_EMMC_CZ_CHUNK_PARENT;
+}
+
+static int _emmc_cz_save(emmc_cz_t *cz)
+{
+	FIL fp;
+	UINT bw;
+	u32 idx_size = cz->hdr.chunk_cnt * sizeof(nx_emmc_cz_chunk_t);
+
+	se_sha_hash_256_oneshot(cz->hdr.idx_hash, cz->idx, idx_size);
+
+	int res = f_open(&fp, _emmc_cz_path(cz, -1), FA_CREATE_ALWAYS | FA_WRITE);
+	if (res)
+		return res;
+
+	res = f_write(&fp, &cz->hdr, sizeof(nx_emmc_cz_hdr_t), &bw);
+	if (!res)
+		res = f_write(&fp, cz->idx, idx_size, &bw);
+	if (!res && bw != idx_size)
+		res = FR_DENIED;
+
+	int res_close = f_close(&fp);
+
+	return res ? res : res_close;
+}
+
+static void _emmc_cz_store_path(char *path, const u8 *hash)
+{
+	char hash_str[SE_SHA_256_SIZE * 2 + 1];
+
+	_emmc_sd_hash_str(hash_str, hash);
+	s_printf(path, NX_EMMC_CZ_STORE_DIR"/%c%c/%s", hash_str[0], hash_str[1], hash_str);
+}
+
+// Returns the stored size of a chunk in the store or 0 if not there.
+static u32 _emmc_cz_store_find(const u8 *hash, u32 len)
+{
+	FILINFO fno;
+	char path[CZ_STORE_PATH_SZ];
+
+	_emmc_cz_store_path(path, hash);
+	if (f_stat(path, &fno) || fno.fsize > len)
+		return 0;
+
+	return fno.fsize;
+}
+
+static int _emmc_cz_store_write(const u8 *hash, const void *data, u32 size)
+{
+	FIL fp;
+	UINT bw = 0;
+	char path[CZ_STORE_PATH_SZ];
+	char tmp_path[CZ_STORE_PATH_SZ + 4];
+
+	_emmc_cz_store_path(path, hash);
+	s_printf(tmp_path, "%s.tmp", path);
+
+	int res = f_open(&fp, tmp_path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res == FR_NO_PATH)
+	{
+		// Create store and object folder.
+		f_mkdir(NX_EMMC_CZ_STORE_DIR);
+		tmp_path[strlen(NX_EMMC_CZ_STORE_DIR) + 3] = 0;
+		f_mkdir(tmp_path);
+		tmp_path[strlen(NX_EMMC_CZ_STORE_DIR) + 3] = '/';
+
+		res = f_open(&fp, tmp_path, FA_CREATE_ALWAYS | FA_WRITE);
+	}
+	if (res)
+		return res;
+
+	res = f_write(&fp, data, size, &bw);
+	if (!res && bw != size)
+		res = FR_DENIED; // SD card full.
+
+	int res_close = f_close(&fp);
+	if (!res)
+		res = res_close;
+
+	// Only complete objects get their final name. Replace a bad one if any.
+	if (!res)
+	{
+		f_unlink(path);
+		res = f_rename(tmp_path, path);
+	}
+	if (res)
+		f_unlink(tmp_path);
+
+	return res;
+}
+
+// Shared chunks are always checked, since a bad one affects every backup using it.
+static int _emmc_cz_store_read(emmc_cz_t *cz, nx_emmc_cz_chunk_t *entry, u32 len, u8 *buf)
+{
+	FIL fp;
+	UINT br;
+	char path[CZ_STORE_PATH_SZ];
+	u8 hash[SE_SHA_256_SIZE];
+
+	if (!entry->size || entry->size > len)
+		return FR_INT_ERR;
+
+	// Raw objects are read directly to the destination.
+	u8 *src = entry->size == len ? buf : cz->cbuf;
+
+	_emmc_cz_store_path(path, entry->hash);
+	int res = f_open(&fp, path, FA_READ);
+	if (res)
+		return res;
+
+	if (f_size(&fp) != entry->size)
+		res = FR_INT_ERR;
+	if (!res)
+		res = f_read(&fp, src, entry->size, &br);
+	if (!res && br != entry->size)
+		res = FR_INT_ERR;
+	f_close(&fp);
+	if (res)
+		return res;
+
+	if (src != buf && LZ4_decompress_safe((const char *)src, (char *)buf, entry->size, len) != (int)len)
+		return FR_INT_ERR;
+
+	se_sha_hash_256_oneshot(hash, buf, len);
+	if (memcmp(hash, entry->hash, SE_SHA_256_SIZE))
+		return FR_INT_ERR;
+
+	return FR_OK;
+}
+
+static int _emmc_cz_read_chunk(emmc_cz_t *cz, u32 chunk, u8 *buf)
+{
+	UINT br;
+
+	cz = _emmc_cz_resolve(cz, chunk);
+	if (!cz)
+		return FR_INT_ERR;
+
+	nx_emmc_cz_chunk_t *entry = &cz->idx[chunk];
+	u32 len = _emmc_cz_chunk_len(cz, chunk);
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_ZERO)
+	{
+		memset(buf, 0, len);
+		return FR_OK;
+	}
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_STORE)
+		return _emmc_cz_store_read(cz, entry, len, buf);
+
+	// Raw chunks are read directly to the destination.
+	u8 *src = buf;
+	if (entry->type == NX_EMMC_CZ_CHUNK_LZ4)
+	{
+		if (entry->size > (u32)LZ4_COMPRESSBOUND(len))
+			return FR_INT_ERR;
+		src = cz->cbuf;
+	}
+	else if (entry->type != NX_EMMC_CZ_CHUNK_RAW || entry->size != len)
+		return FR_INT_ERR;
+
+	int res = _emmc_cz_open_part(cz, entry->part, FA_READ);
+	if (!res)
+		res = f_lseek(&cz->fp, entry->offset);
+	if (!res)
+		res = f_read(&cz->fp, src, entry->size, &br);
+	if (!res && br != entry->size)
+		res = FR_INT_ERR;
+	if (res)
+		return res;
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_LZ4 &&
+		LZ4_decompress_safe((const char *)src, (char *)buf, entry->size, len) != (int)len)
+		return FR_INT_ERR;
+
+	return FR_OK;
+}
+
+static int _emmc_cz_verify(emmc_tool_gui_t *gui, emmc_cz_t *cz, sdmmc_storage_t *storage, u32 lba_off, const emmc_part_t *part)
+{
+	u8 hash[SE_SHA_256_SIZE];
+	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
+	u32 lba_curr = part->lba_start;
+	u32 lba_end = part->lba_start + (u32)(cz->hdr.image_size >> 9) - 1;
+	u32 prevPct = 200;
+	u32 pct = 0;
+
+	lv_bar_set_value(gui->bar, 0);
+	lv_bar_set_style(gui->bar, LV_BAR_STYLE_BG, gui->bar_teal_bg);
+	lv_bar_set_style(gui->bar, LV_BAR_STYLE_INDIC, gui->bar_teal_ind);
+	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 0%");
+	manual_system_maintenance(true);
+
+	for (u32 i = 0; i < cz->hdr.chunk_cnt; i++)
+	{
+		u32 len = _emmc_cz_chunk_len(cz, i);
+		u32 num = len >> 9;
+
+		// Check every time or every 4. Unchanged chunks were checked with the previous level.
+		bool parent = !storage && cz->idx[i].type == NX_EMMC_CZ_CHUNK_PARENT;
+		if (!parent && ((n_cfg.verification >= 2) || !(i % 4)))
+		{
+			// Check eMMC contents if restored, or SD data if backed up.
+			int res;
+			if (storage)
+				res = sdmmc_storage_read(storage, lba_curr + lba_off, num, buf);
+			else
+				res = _emmc_cz_read_chunk(cz, i, buf);
+
+			if (res)
+			{
+				s_printf(gui->txt_buf,
+					"\n#FF0000 Failed to read %d blocks (@LBA %08X),#\n"
+					"#FF0000 from %s! Verification failed..#\n",
+					num, lba_curr, storage ? "eMMC" : "SD card");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				return VERIF_STATUS_ERROR;
+			}
+			manual_system_maintenance(false);
+
+			se_sha_hash_256_oneshot(hash, buf, len);
+			if (memcmp(hash, cz->idx[i].hash, SE_SHA_256_SIZE))
+			{
+				s_printf(gui->txt_buf,
+					"\n#FF0000 SD & eMMC data (@LBA %08X) do not match!#\n"
+					"\n#FF0000 Verification failed..#\n",
+					lba_curr);
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				return VERIF_STATUS_ERROR;
+			}
+		}
+
+		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(lba_end - part->lba_start);
+		if (pct != prevPct)
+		{
+			lv_bar_set_value(gui->bar, pct);
+			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+			lv_label_set_text(gui->label_pct, gui->txt_buf);
+			manual_system_maintenance(true);
+			prevPct = pct;
+		}
+
+		lba_curr += num;
+
+		// Check for cancellation combo.
+		if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
+		{
+			strcpy(gui->txt_buf, "#FFDD00 Verification was cancelled!#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			msleep(1000);
+
+			return VERIF_STATUS_ABORT;
+		}
+	}
+
+	lv_bar_set_value(gui->bar, 100);
+	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
+	manual_system_maintenance(true);
+
+	return VERIF_STATUS_OK;
+}
+
+static int _dump_emmc_part_cz(emmc_tool_gui_t *gui, char *sd_path, sdmmc_storage_t *storage, emmc_part_t *part, u32 totalSectors, u32 sd_sector_off)
+{
+	static const u32 FAT32_FILESIZE_LIMIT = 0xFFFFFFFF;
+
+	int res = 0;
+	u32 lba_curr = part->lba_start;
+	u32 lba_end = part->lba_start + totalSectors - 1;
+	u32 prevPct = 200;
+	u32 pct = 0;
+	int retryCount = 0;
+	u64 partSize = 0;
+	u64 storedSize = 0;
+	u64 sparseSize = 0;
+	u64 sameSize = 0;
+	u64 sharedSize = 0;
+	bool store = gui->chunk_store;
+
+	// Chunks must not cross the FAT32 file size limit.
+	u64 partSizeMax = sd_fs.fs_type != FS_EXFAT ? FAT32_FILESIZE_LIMIT : ~0ULL;
+
+	// Continue the chain of the last backup if incremental.
+	u32 level = 0;
+	u32 stale = 0;
+	emmc_cz_t *parent = NULL;
+	int last = gui->incremental ? _emmc_cz_find_last(sd_path, &stale) : -1;
+	_emmc_cz_log_stale(gui, stale);
+	if (last >= 0)
+	{
+		level = last + 1;
+		parent = (emmc_cz_t *)malloc(sizeof(emmc_cz_t));
+		res = _emmc_cz_load_chain(parent, sd_path, last);
+		if (res || level > NX_EMMC_CZ_LEVEL_MAX || parent->hdr.image_size != ((u64)totalSectors << 9))
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Previous backup (level %d) is corrupted,#\n"
+				"#FF0000 does not match or the chain is full!#\n", last);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			_emmc_cz_close(parent);
+			free(parent);
+
+			return 1;
+		}
+	}
+
+	emmc_cz_t cz;
+	_emmc_cz_init(&cz, sd_path, level);
+	cz.parent = parent;
+
+	FIL fp;
+	if (!f_open(&fp, _emmc_cz_path(&cz, -1), FA_READ))
+	{
+		f_close(&fp);
+
+		lv_obj_t *warn_mbox_bg = create_mbox_text(
+			"#FFDD00 An existing backup has been detected!#\n\n"
+			"Press #FF8000 POWER# to Continue.\nPress #FF8000 VOL# to abort.", false);
+		manual_system_maintenance(true);
+
+		if (!(btn_wait() & BTN_POWER))
+		{
+			lv_obj_del(warn_mbox_bg);
+			_emmc_cz_close(&cz);
+
+			return 1;
+		}
+		lv_obj_del(warn_mbox_bg);
+	}
 
-	u8 hashEm[SE_SHA_256_SIZE];
-	u8 hashSd[SE_SHA_256_SIZE];
+	s_printf(gui->txt_buf, "#96FF00 Filepath:#\n%s\n#96FF00 Filename:# #FF8000 %s#",
+		gui->base_path, cz.path + strlen(gui->base_path));
+	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	cz.hdr.magic      = NX_EMMC_CZ_MAGIC;
+	cz.hdr.version    = NX_EMMC_CZ_VERSION;
+	cz.hdr.chunk_size = NX_EMMC_CZ_CHUNK_SIZE;
+	cz.hdr.chunk_cnt  = (totalSectors + NUM_SECTORS_PER_ITER - 1) / NUM_SECTORS_PER_ITER;
+	cz.hdr.image_size = (u64)totalSectors << 9;
+	cz.hdr.level      = level;
+	cz.idx = (nx_emmc_cz_chunk_t *)zalloc(cz.hdr.chunk_cnt * sizeof(nx_emmc_cz_chunk_t));
 
-	if (f_open(&fp, outFilename, FA_READ) == FR_OK)
+	// A full backup starts a new chain.
+	if (!parent)
 	{
-		if (n_cfg.verification == 3)
-		{
-			char hashFilename[HASH_FILENAME_SZ];
-			strncpy(hashFilename, outFilename, OUT_FILENAME_SZ - 1);
-			strcat(hashFilename, ".sha256sums");
+		se_rng_pseudo(&cz.hdr.chain_id, sizeof(u32));
+		if (!cz.hdr.chain_id)
+			cz.hdr.chain_id = 1;
+	}
+	else
+	{
+		cz.hdr.chain_id = parent->hdr.chain_id;
+		memcpy(cz.hdr.parent_hash, parent->hdr.idx_hash, SE_SHA_256_SIZE);
 
-			res = f_open(&hashFp, hashFilename, FA_CREATE_ALWAYS | FA_WRITE);
-			if (res)
-			{
-				f_close(&fp);
+		s_printf(gui->txt_buf, "\nIncremental backup, level %d.\n", level);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+	}
 
-				s_printf(gui->txt_buf,
-						"\n#FF0000 Hash file could not be written (error %d)!#\n"
-						"#FF0000 Aborting..#\n", res);
-				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-				manual_system_maintenance(true);
+	if (store)
+	{
+		s_printf(gui->txt_buf, "\nChunks go to #C7EA46 %s#.\n", NX_EMMC_CZ_STORE_DIR);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+	}
 
-				return VERIF_STATUS_ERROR;
-			}
+	void *lz4_state = malloc(LZ4_sizeofState());
+
+	emmc_pipe_t pipe;
+	emmc_pipe_init(&pipe, !gui->raw_emummc ? storage : &sd_storage);
 
-			char chunkSizeAscii[10];
-			itoa(NUM_SECTORS_PER_ITER * EMMC_BLOCKSIZE, chunkSizeAscii, 10);
-			chunkSizeAscii[9] = '\0';
+	// Chunk store backups have no data files.
+	if (!store)
+	{
+		res = _emmc_cz_open_part(&cz, 0, FA_CREATE_ALWAYS | FA_WRITE);
+		if (res)
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while creating#\n#FFDD00 %s#\n", res, cz.path);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
 
-			f_puts("# chunksize: ", &hashFp);
-			f_puts(chunkSizeAscii, &hashFp);
-			f_puts("\n", &hashFp);
+			goto out;
 		}
+		cz.hdr.part_cnt = 1;
+	}
 
-		u32 totalSectorsVer = (u32)((u64)f_size(&fp) >> (u64)9);
+	lv_obj_set_opa_scale(gui->bar, LV_OPA_COVER);
+	lv_obj_set_opa_scale(gui->label_pct, LV_OPA_COVER);
+	for (u32 i = 0; i < cz.hdr.chunk_cnt; i++)
+	{
+		retryCount = 0;
+		u32 num = MIN(totalSectors, NUM_SECTORS_PER_ITER);
+		u32 num_next = MIN(totalSectors - num, NUM_SECTORS_PER_ITER);
 
-		u8 *bufEm = (u8 *)EMMC_BUF_ALIGNED;
-		u8 *bufSd = (u8 *)SDXC_BUF_ALIGNED;
+		// Read chunk and start reading the next one in the background.
+		while (emmc_pipe_read(&pipe, lba_curr + sd_sector_off, num, num_next))
+		{
+			s_printf(gui->txt_buf,
+				"\n#FFDD00 Error reading %d blocks @ LBA %08X,#\n"
+				"#FFDD00 from %s (try %d). #",
+				num, lba_curr, !gui->raw_emummc ? "eMMC" : "emuMMC", ++retryCount);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
 
-		u32 pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
-		lv_bar_set_value(gui->bar, pct);
-		lv_bar_set_style(gui->bar, LV_BAR_STYLE_BG, gui->bar_teal_bg);
-		lv_bar_set_style(gui->bar, LV_BAR_STYLE_INDIC, gui->bar_teal_ind);
-		s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
-		lv_label_set_text(gui->label_pct, gui->txt_buf);
-		manual_system_maintenance(true);
+			msleep(150);
+			if (retryCount >= 3)
+			{
+				strcpy(gui->txt_buf, "#FF0000 Aborting...#\nPlease try again...\n");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				goto out;
+			}
+			else
+			{
+				strcpy(gui->txt_buf, "#FFDD00 Retrying...#\n");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+			}
+		}
 
-		clmt = f_expand_cltbl(&fp, SZ_4M, 0);
+		u8 *buf = emmc_pipe_buf(&pipe);
+		u32 size = num << 9;
+		nx_emmc_cz_chunk_t *entry = &cz.idx[i];
 
-		u32 num = 0;
-		while (totalSectorsVer > 0)
+		int csize = 0;
+		bool zero;
+		if (parent || store)
 		{
-			num = MIN(totalSectorsVer, NUM_SECTORS_PER_ITER);
+			// Hash first. Unchanged chunks and ones already in the store are only referenced.
+			se_sha_hash_256_oneshot(entry->hash, buf, size);
+			if (parent && !memcmp(entry->hash, parent->idx[i].hash, SE_SHA_256_SIZE))
+			{
+				entry->type = NX_EMMC_CZ_CHUNK_PARENT;
+				sameSize += size;
+				goto next;
+			}
 
-			// Check every time or every 4.
-			// Every 4 protects from fake sd, sector corruption and frequent I/O corruption.
-			// Full provides all that, plus protection from extremely rare I/O corruption.
-			if ((n_cfg.verification >= 2) || !(sparseShouldVerify % 4))
+			zero = mem_is_zero(buf, size);
+			if (!zero && store)
 			{
-				if (sdmmc_storage_read(storage, lba_curr, num, bufEm))
+				entry->size = _emmc_cz_store_find(entry->hash, size);
+				if (entry->size)
 				{
-					s_printf(gui->txt_buf,
-						"\n#FF0000 Failed to read %d blocks (@LBA %08X),#\n"
-						"#FF0000 from eMMC! Verification failed..#\n",
-						num, lba_curr);
-					lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-					manual_system_maintenance(true);
-
-					free(clmt);
-					f_close(&fp);
-					if (n_cfg.verification == 3)
-						f_close(&hashFp);
-
-					return VERIF_STATUS_ERROR;
+					entry->type = NX_EMMC_CZ_CHUNK_STORE;
+					sharedSize += size;
+					goto next;
 				}
-				manual_system_maintenance(false);
+			}
 
-				se_sha_hash_256_async(hashEm, bufEm, num << 9);
+			if (!zero)
+				csize = LZ4_compress_fast_extState(lz4_state, (const char *)buf, (char *)cz.cbuf, size, LZ4_COMPRESSBOUND(size), 1);
+		}
+		else
+		{
+			// Hash on SE while the CPU compresses.
+			se_sha_hash_256_async(entry->hash, buf, size);
+			zero = mem_is_zero(buf, size);
+			if (!zero)
+				csize = LZ4_compress_fast_extState(lz4_state, (const char *)buf, (char *)cz.cbuf, size, LZ4_COMPRESSBOUND(size), 1);
+			se_sha_hash_256_finalize(entry->hash);
+		}
 
-				f_lseek(&fp, (u64)sdFileSector << (u64)9);
-				if (f_read_fast(&fp, bufSd, num << 9))
-				{
-					s_printf(gui->txt_buf,
-						"\n#FF0000 Failed to read %d blocks (@LBA %08X),#\n"
-						"#FF0000 from SD card! Verification failed..#\n",
-						num, lba_curr);
-					lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-					manual_system_maintenance(true);
+		// Skip empty chunks.
+		if (zero)
+		{
+			entry->type = NX_EMMC_CZ_CHUNK_ZERO;
+			sparseSize += size;
+			goto next;
+		}
 
-					free(clmt);
-					f_close(&fp);
-					if (n_cfg.verification == 3)
-						f_close(&hashFp);
+		// Store raw if it does not compress well.
+		u8 *data = cz.cbuf;
+		entry->type = NX_EMMC_CZ_CHUNK_LZ4;
+		if (csize <= 0 || (u32)csize > (size - (size >> 5)))
+		{
+			data = buf;
+			csize = size;
+			entry->type = NX_EMMC_CZ_CHUNK_RAW;
+		}
 
-					return VERIF_STATUS_ERROR;
-				}
-				manual_system_maintenance(false);
-				se_sha_hash_256_finalize(hashEm);
-				se_sha_hash_256_oneshot(hashSd, bufSd, num << 9);
-				res = memcmp(hashEm, hashSd, SE_SHA_256_SIZE / 2);
+		UINT bw = 0;
+		if (store)
+			res = _emmc_cz_store_write(entry->hash, data, csize);
+		else
+		{
+			// Start next data file if needed.
+			if ((partSize + csize) > partSizeMax)
+			{
+				res = _emmc_cz_open_part(&cz, cz.hdr.part_cnt, FA_CREATE_ALWAYS | FA_WRITE);
+				if (!res)
+					cz.hdr.part_cnt++;
+				partSize = 0;
+			}
 
-				if (res)
-				{
-					s_printf(gui->txt_buf,
-						"\n#FF0000 SD & eMMC data (@LBA %08X) do not match!#\n"
-						"\n#FF0000 Verification failed..#\n",
-						lba_curr);
-					lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-					manual_system_maintenance(true);
+			if (!res)
+				res = f_write(&cz.fp, data, csize, &bw);
+			if (!res && bw != (u32)csize)
+				res = FR_DENIED; // SD card full.
+		}
 
-					free(clmt);
-					f_close(&fp);
-					if (n_cfg.verification == 3)
-						f_close(&hashFp);
+		if (res)
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Fatal error (%d) when writing to SD Card#\nPlease try again...\n", res);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
 
-					return VERIF_STATUS_ERROR;
-				}
+			goto out;
+		}
 
-				if (n_cfg.verification == 3)
-				{
-					// Transform computed hash to readable hexadecimal
-					char hashStr[SE_SHA_256_SIZE * 2 + 1];
-					char *hashStrPtr = hashStr;
-					for (int i = 0; i < SE_SHA_256_SIZE; i++)
-					{
-						*(hashStrPtr++) = hexa[hashSd[i] >> 4];
-						*(hashStrPtr++) = hexa[hashSd[i] & 0x0F];
-					}
-					hashStr[SE_SHA_256_SIZE * 2] = '\0';
-
-					f_puts(hashStr, &hashFp);
-					f_puts("\n", &hashFp);
-				}
-			}
+		entry->size = csize;
+		storedSize += csize;
+		if (store)
+		{
+			entry->type = NX_EMMC_CZ_CHUNK_STORE;
+			goto next;
+		}
 
-			pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
-			if (pct != prevPct)
-			{
-				lv_bar_set_value(gui->bar, pct);
-				s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
-				lv_label_set_text(gui->label_pct, gui->txt_buf);
-				manual_system_maintenance(true);
-				prevPct = pct;
-			}
+		entry->part   = cz.part;
+		entry->offset = partSize;
+		partSize     += csize;
 
-			manual_system_maintenance(false);
+next:
+		manual_system_maintenance(false);
 
-			lba_curr += num;
-			totalSectorsVer -= num;
-			sdFileSector += num;
-			sparseShouldVerify++;
+		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(lba_end - part->lba_start);
+		if (pct != prevPct)
+		{
+			lv_bar_set_value(gui->bar, pct);
+			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+			lv_label_set_text(gui->label_pct, gui->txt_buf);
+			manual_system_maintenance(true);
+			prevPct = pct;
+		}
 
-			// Check for cancellation combo.
-			if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
-			{
-				strcpy(gui->txt_buf, "#FFDD00 Verification was cancelled!#\n");
-				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-				manual_system_maintenance(true);
+		lba_curr += num;
+		totalSectors -= num;
 
-				msleep(1000);
+		// Check for cancellation combo.
+		if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
+		{
+			strcpy(gui->txt_buf, "\n#FFDD00 The backup was cancelled!#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
 
-				free(clmt);
-				f_close(&fp);
-				f_close(&hashFp);
+			msleep(1500);
 
-				return VERIF_STATUS_ABORT;
-			}
+			goto out;
 		}
-		free(clmt);
-		f_close(&fp);
-		f_close(&hashFp);
+	}
+	lv_bar_set_value(gui->bar, 100);
+	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
+	manual_system_maintenance(true);
 
-		lv_bar_set_value(gui->bar, pct);
-		s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
-		lv_label_set_text(gui->label_pct, gui->txt_buf);
+	// Finish data and write the index.
+	res = _emmc_cz_close_part(&cz);
+	if (!res)
+		res = _emmc_cz_save(&cz);
+	if (res)
+	{
+		s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while writing the backup index!#\n", res);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 		manual_system_maintenance(true);
 
-		return VERIF_STATUS_OK;
+		goto out;
 	}
-	else
+	free(lz4_state);
+
+	// Levels above this one were made on top of an older backup.
+	_emmc_cz_unlink_levels(sd_path, level + 1);
+
+	s_printf(gui->txt_buf, "\nCompressed to %d MiB (%d%%), %d MiB empty.\n",
+		(u32)(storedSize >> 20), (u32)(storedSize * 100 / cz.hdr.image_size), (u32)(sparseSize >> 20));
+	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+	if (parent)
 	{
-		strcpy(gui->txt_buf, "\n#FFDD00 File not found or could not be loaded!#\n#FFDD00 Verification failed..#\n");
+		s_printf(gui->txt_buf, "%d MiB unchanged since level %d.\n", (u32)(sameSize >> 20), last);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+	}
+	if (store)
+	{
+		s_printf(gui->txt_buf, "%d MiB already in the chunk store.\n", (u32)(sharedSize >> 20));
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+	}
+	manual_system_maintenance(true);
+
+	// Verify the stored data against the hashes of the eMMC data.
+	if (n_cfg.verification && _emmc_cz_verify(gui, &cz, NULL, 0, part) == VERIF_STATUS_ERROR)
+	{
+		strcpy(gui->txt_buf, "\n#FFDD00 Please try again...#\n");
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 		manual_system_maintenance(true);
 
-		return VERIF_STATUS_ERROR;
+		res = 1;
 	}
+
+	_emmc_cz_close(&cz);
+
+	return res;
+
+out:
+	emmc_pipe_flush(&pipe);
+	free(lz4_state);
+
+	// Remove incomplete backup.
+	_emmc_cz_unlink(&cz, cz.hdr.part_cnt);
+	_emmc_cz_close(&cz);
+
+	return 1;
 }
 
 bool partial_sd_full_unmount = false;
 
+// Partial Backups of older versions only kept the next part in partial.idx. Converts it to a journal.
+static void _dump_emmc_partial_idx_convert(const char *jrnl_path, u32 lba_start, u32 sct_total)
+{
+	FIL fp;
+	FILINFO fno;
+	nx_emmc_jrnl_t jrnl;
+	u32 part_idx = 0;
+
+	if (sct_total <= (0xFFFFFFFF / EMMC_BLOCKSIZE) || !f_stat(jrnl_path, &fno) || f_open(&fp, "partial.idx", FA_READ))
+		return;
+
+	f_read(&fp, &part_idx, sizeof(u32), NULL);
+	f_close(&fp);
+
+	// Part size is chosen the same way.
+	u32 split_size = (1u << 31);
+	if ((sd_storage.csd.capacity >> (20 - sd_storage.csd.read_blkbits)) <= 8192)
+		split_size = (1u << 30);
+
+	u32 sct_done = part_idx * (split_size / EMMC_BLOCKSIZE);
+	if (!part_idx || sct_done >= sct_total)
+		return;
+
+	if (nx_emmc_jrnl_create(&jrnl, jrnl_path, lba_start, sct_total, split_size, NX_EMMC_JRNL_PARTIAL) ||
+		nx_emmc_jrnl_commit(&jrnl, NULL, sct_done, part_idx, 0))
+	{
+		nx_emmc_jrnl_remove(&jrnl);
+		return;
+	}
+
+	nx_emmc_jrnl_close(&jrnl);
+	f_unlink("partial.idx");
+}
+
 static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part, sdmmc_storage_t *storage, emmc_part_t *part)
 {
 	static const u32 FAT32_FILESIZE_LIMIT = 0xFFFFFFFF;
@@ -358,7 +1471,8 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 	u32 numSplitParts = 0;
 	u32 maxSplitParts = 0;
 	bool isSmallSdCard = false;
-	bool partialDumpInProgress = false;
+	bool resume = false;
+	bool split = false;
 	int res = 0;
 	char *outFilename = sd_path;
 	u32 sdPathLen = strlen(sd_path);
@@ -367,9 +1481,9 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 	u32 sector_size = totalSectors;
 	u32 sd_sector_off = 0;
 
-	FIL partialIdxFp;
-	char partialIdxFilename[12];
-	strcpy(partialIdxFilename, "partial.idx");
+	nx_emmc_jrnl_t jrnl;
+	char jrnlFilename[OUT_FILENAME_SZ + 4];
+	u8 chunkHash[SE_SHA_256_SIZE] __attribute__((aligned(4)));
 
 	if (gui->raw_emummc)
 	{
@@ -403,77 +1517,103 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 	lv_bar_set_style(gui->bar, LV_BAR_STYLE_INDIC, gui->bar_white_ind);
 	manual_system_maintenance(true);
 
-	// 1GB parts for sd cards 8GB and less.
-	if ((sd_storage.csd.capacity >> (20 - sd_storage.csd.read_blkbits)) <= 8192)
-		multipartSplitSize = (1u << 30);
-	// Maximum parts fitting the free space available.
-	maxSplitParts = (sd_fs.free_clst * sd_fs.csize) / (multipartSplitSize / EMMC_BLOCKSIZE);
-
-	// Check if the USER partition or the RAW eMMC fits the sd card free space.
-	if (totalSectors > (sd_fs.free_clst * sd_fs.csize))
+	// Compressed size is not known beforehand, so no Partial Backup.
+	if (gui->compress)
 	{
-		isSmallSdCard = true;
-
-		strcpy(gui->txt_buf, "\n#FFBA00 Free space is smaller than backup size.#\n");
-		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-		manual_system_maintenance(true);
-
-		if (!maxSplitParts)
+		if (totalSectors > (sd_fs.free_clst * sd_fs.csize))
 		{
-			strcpy(gui->txt_buf, "#FFDD00 Not enough free space for Partial Backup!#\n");
+			strcpy(gui->txt_buf, "\n#FFBA00 Free space is smaller than backup size.#\n#FFBA00 Compressed backup might not fit!#\n");
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
-
-			return 1;
 		}
+
+		return _dump_emmc_part_cz(gui, sd_path, storage, part, totalSectors, sd_sector_off);
 	}
-	// Check if we are continuing a previous raw eMMC or USER partition backup in progress.
-	if (f_open(&partialIdxFp, partialIdxFilename, FA_READ) == FR_OK && totalSectors > (FAT32_FILESIZE_LIMIT / EMMC_BLOCKSIZE))
+
+	// Check if we are continuing an interrupted backup. Its journal keeps the original layout.
+	s_printf(jrnlFilename, "%s"NX_EMMC_JRNL_EXT, sd_path);
+	_dump_emmc_partial_idx_convert(jrnlFilename, part->lba_start, totalSectors);
+	if (!nx_emmc_jrnl_load(&jrnl, jrnlFilename, part->lba_start, totalSectors))
 	{
-		strcpy(gui->txt_buf, "\n#AEFD14 Partial Backup in progress. Continuing...#\n");
+		resume = true;
+		split = !!jrnl.rec.split_size;
+		isSmallSdCard = !!(jrnl.rec.flags & NX_EMMC_JRNL_PARTIAL);
+		currPartIdx = jrnl.rec.part_idx;
+		if (split)
+			multipartSplitSize = jrnl.rec.split_size;
+
+		s_printf(gui->txt_buf, "\n#AEFD14 Interrupted backup found. Continuing from %d MiB...#\n",
+			jrnl.rec.sct_done >> SECTORS_TO_MIB_COEFF);
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 		manual_system_maintenance(true);
 
-		partialDumpInProgress = true;
-		// Force partial dumping, even if the card is larger.
-		isSmallSdCard = true;
+		if (isSmallSdCard)
+		{
+			// Maximum parts fitting the free space available.
+			maxSplitParts = (sd_fs.free_clst * sd_fs.csize) / (multipartSplitSize / EMMC_BLOCKSIZE);
+			if (!maxSplitParts)
+			{
+				strcpy(gui->txt_buf, "\n#FFDD00 Not enough free space for Partial Backup!#\n");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				nx_emmc_jrnl_close(&jrnl);
 
-		f_read(&partialIdxFp, &currPartIdx, 4, NULL);
-		f_close(&partialIdxFp);
+				return 1;
+			}
 
-		if (!maxSplitParts)
+			// Increase maxSplitParts to accommodate previously backed up parts.
+			maxSplitParts += currPartIdx;
+		}
+	}
+	else
+	{
+		// 1GB parts for sd cards 8GB and less.
+		if ((sd_storage.csd.capacity >> (20 - sd_storage.csd.read_blkbits)) <= 8192)
+			multipartSplitSize = (1u << 30);
+		// Maximum parts fitting the free space available.
+		maxSplitParts = (sd_fs.free_clst * sd_fs.csize) / (multipartSplitSize / EMMC_BLOCKSIZE);
+
+		// Check if the USER partition or the RAW eMMC fits the sd card free space.
+		if (totalSectors > (sd_fs.free_clst * sd_fs.csize))
 		{
-			strcpy(gui->txt_buf, "\n#FFDD00 Not enough free space for Partial Backup!#\n");
+			isSmallSdCard = true;
+
+			strcpy(gui->txt_buf, "\n#FFBA00 Free space is smaller than backup size.#\n");
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
-			return 1;
+			if (!maxSplitParts)
+			{
+				strcpy(gui->txt_buf, "#FFDD00 Not enough free space for Partial Backup!#\n");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				return 1;
+			}
+
+			s_printf(gui->txt_buf, "\n#FFBA00 Partial Backup enabled (%d MiB parts)...#\n", multipartSplitSize >> 20);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
 		}
 
-		// Increase maxSplitParts to accommodate previously backed up parts.
-		maxSplitParts += currPartIdx;
-	}
-	else if (isSmallSdCard)
-	{
-		s_printf(gui->txt_buf, "\n#FFBA00 Partial Backup enabled (%d MiB parts)...#\n", multipartSplitSize >> 20);
-		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-		manual_system_maintenance(true);
+		// Check if filesystem is FAT32 or the free space is smaller and backup in parts.
+		split = ((sd_fs.fs_type != FS_EXFAT) && totalSectors > (FAT32_FILESIZE_LIMIT / EMMC_BLOCKSIZE)) || isSmallSdCard;
 	}
 
-	// Check if filesystem is FAT32 or the free space is smaller and backup in parts.
-	if (((sd_fs.fs_type != FS_EXFAT) && totalSectors > (FAT32_FILESIZE_LIMIT / EMMC_BLOCKSIZE)) || isSmallSdCard)
+	if (split)
 	{
 		u32 multipartSplitSectors = multipartSplitSize / EMMC_BLOCKSIZE;
 		numSplitParts = (totalSectors + multipartSplitSectors - 1) / multipartSplitSectors;
 
 		outFilename[sdPathLen++] = '.';
 
-		// Continue from where we left, if Partial Backup in progress.
-		_update_filename(outFilename, sdPathLen, partialDumpInProgress ? currPartIdx : 0);
+		// Continue from where we left, if resuming.
+		_update_filename(outFilename, sdPathLen, currPartIdx);
 	}
 
 	FIL fp;
-	if (!f_open(&fp, outFilename, FA_READ))
+	if (!resume && !f_open(&fp, outFilename, FA_READ))
 	{
 		f_close(&fp);
 
@@ -495,37 +1635,82 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
 	manual_system_maintenance(true);
 
-	res = f_open(&fp, outFilename, FA_CREATE_ALWAYS | FA_WRITE);
+	// Create the journal before any data is written.
+	if (!resume)
+	{
+		res = nx_emmc_jrnl_create(&jrnl, jrnlFilename, part->lba_start, totalSectors,
+			split ? multipartSplitSize : 0, isSmallSdCard ? NX_EMMC_JRNL_PARTIAL : 0);
+		if (res)
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while creating#\n#FFDD00 %s#\n", res, jrnlFilename);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			nx_emmc_jrnl_remove(&jrnl);
+
+			return 1;
+		}
+	}
+
+	// A part in progress is kept and continued.
+	if (resume && jrnl.rec.part_off)
+		res = f_open(&fp, outFilename, FA_OPEN_EXISTING | FA_READ | FA_WRITE);
+	else
+		res = f_open(&fp, outFilename, FA_CREATE_ALWAYS | FA_WRITE);
 	if (res)
 	{
 		s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while creating#\n#FFDD00 %s#\n", res, outFilename);
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 		manual_system_maintenance(true);
 
+		nx_emmc_jrnl_remove(&jrnl);
+
 		return 1;
 	}
 
-	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
+	// Check that the last recorded chunk made it to the SD card.
+	if (resume && nx_emmc_jrnl_check(&jrnl, &fp, (u8 *)MIXD_BUF_ALIGNED, NUM_SECTORS_PER_ITER * EMMC_BLOCKSIZE))
+	{
+		strcpy(gui->txt_buf, "\n#FFDD00 Interrupted backup is corrupted!#\n#FFDD00 Please try again...#\n");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		f_close(&fp);
+		nx_emmc_jrnl_remove(&jrnl);
+
+		return 1;
+	}
+
+	// Checked against the manifest. Journals of older versions have none.
+	const u8 *runHash = (jrnl.rec.flags & NX_EMMC_JRNL_RUN_HASH) ? jrnl.rec.run_hash : NULL;
+
+	emmc_pipe_t pipe;
+	emmc_pipe_init(&pipe, !gui->raw_emummc ? storage : &sd_storage);
 
 	u32 lba_curr = part->lba_start;
 	u32 lbaStartPart = part->lba_start;
-	u32 bytesWritten = 0;
+	u64 bytesWritten = 0;
 	u32 prevPct = 200;
 	int retryCount = 0;
 	DWORD *clmt = NULL;
 
-	// Continue from where we left, if Partial Backup in progress.
-	if (partialDumpInProgress)
+	// Continue from the last durable chunk, if resuming.
+	if (resume)
 	{
-		lba_curr += currPartIdx * (multipartSplitSize / EMMC_BLOCKSIZE);
-		totalSectors -= currPartIdx * (multipartSplitSize / EMMC_BLOCKSIZE);
-		lbaStartPart = lba_curr; // Update the start LBA for verification.
+		lba_curr += jrnl.rec.sct_done;
+		totalSectors -= jrnl.rec.sct_done;
+		bytesWritten = jrnl.rec.part_off;
+		lbaStartPart = lba_curr - (u32)(bytesWritten >> 9); // Update the start LBA for verification.
 	}
-	u64 totalSize = (u64)((u64)totalSectors << 9);
-	if (!isSmallSdCard && (sd_fs.fs_type == FS_EXFAT || totalSize <= FAT32_FILESIZE_LIMIT))
+	u32 lbaJrnl = lba_curr;
+
+	u64 totalSize = bytesWritten + ((u64)totalSectors << 9);
+	if (!split)
 		clmt = f_expand_cltbl(&fp, SZ_4M, totalSize);
 	else
 		clmt = f_expand_cltbl(&fp, SZ_4M, MIN(totalSize, multipartSplitSize));
+	if (bytesWritten)
+		f_lseek(&fp, bytesWritten);
 
 	u32 num = 0;
 	u32 pct = 0;
@@ -543,8 +1728,11 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 
 			if (verification && !gui->raw_emummc)
 			{
+				// Drop prefetched data. Verification uses the same buffers.
+				emmc_pipe_flush(&pipe);
+
 				// Verify part.
-				res = _emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part);
+				res = _emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part, runHash);
 				switch (res)
 				{
 				case VERIF_STATUS_OK:
@@ -553,6 +1741,9 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 					strcpy(gui->txt_buf, "\n#FFDD00 Please try again...#\n");
 					lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 					manual_system_maintenance(true);
+
+					nx_emmc_jrnl_remove(&jrnl);
+
 					return 1;
 				case VERIF_STATUS_ABORT:
 					verification = 0;
@@ -565,39 +1756,38 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 
 			_update_filename(outFilename, sdPathLen, currPartIdx);
 
-			// Always create partial.idx before next part, in case a fatal error occurs.
-			if (isSmallSdCard)
+			// Always record the next part before creating it, in case a fatal error occurs.
+			res = nx_emmc_jrnl_commit(&jrnl, NULL, lba_curr - part->lba_start, currPartIdx, 0);
+			if (res)
 			{
-				// Create partial backup index file.
-				if (f_open(&partialIdxFp, partialIdxFilename, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK)
-				{
-					f_write(&partialIdxFp, &currPartIdx, 4, NULL);
-					f_close(&partialIdxFp);
-				}
-				else
-				{
-					strcpy(gui->txt_buf, "\n#FF0000 Error creating partial.idx file!#\n");
-					lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-					manual_system_maintenance(true);
+				s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while writing#\n#FFDD00 %s#\n", res, jrnlFilename);
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
 
-					return 1;
-				}
+				emmc_pipe_flush(&pipe);
+				nx_emmc_jrnl_close(&jrnl);
 
-				// More parts to backup that do not currently fit the sd card free space or fatal error.
-				if (currPartIdx >= maxSplitParts)
-				{
-					create_mbox_text(
-						"#96FF00 Partial Backup in progress!#\n\n"
-						"#96FF00 1.# Press OK to unmount SD Card.\n"
-						"#96FF00 2.# Remove SD Card and move files to free space.\n"
-						"#FFDD00 Don\'t move the partial.idx file!#\n"
-						"#96FF00 3.# Re-insert SD Card.\n"
-						"#96FF00 4.# Select the SAME option again to continue.", true);
+				return 1;
+			}
+			lbaJrnl = lba_curr;
+
+			// More parts to backup that do not currently fit the sd card free space or fatal error.
+			if (isSmallSdCard && currPartIdx >= maxSplitParts)
+			{
+				emmc_pipe_flush(&pipe);
+				nx_emmc_jrnl_close(&jrnl);
 
-					partial_sd_full_unmount = true;
+				create_mbox_text(
+					"#96FF00 Partial Backup in progress!#\n\n"
+					"#96FF00 1.# Press OK to unmount SD Card.\n"
+					"#96FF00 2.# Remove SD Card and move files to free space.\n"
+					"#FFDD00 Don\'t move the .jnl file!#\n"
+					"#96FF00 3.# Re-insert SD Card.\n"
+					"#96FF00 4.# Select the SAME option again to continue.", true);
 
-					return 0;
-				}
+				partial_sd_full_unmount = true;
+
+				return 0;
 			}
 
 			// Create next part.
@@ -615,6 +1805,9 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
+				emmc_pipe_flush(&pipe);
+				nx_emmc_jrnl_close(&jrnl);
+
 				return 1;
 			}
 
@@ -626,12 +1819,10 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 
 		retryCount = 0;
 		num = MIN(totalSectors, NUM_SECTORS_PER_ITER);
+		u32 num_next = MIN(totalSectors - num, NUM_SECTORS_PER_ITER);
 
-		int res_read;
-		if (!gui->raw_emummc)
-			res_read = sdmmc_storage_read(storage, lba_curr, num, buf);
-		else
-			res_read = sdmmc_storage_read(&sd_storage, lba_curr + sd_sector_off, num, buf);
+		// Read chunk and start reading the next one in the background.
+		int res_read = emmc_pipe_read(&pipe, lba_curr + sd_sector_off, num, num_next);
 
 		while (res_read)
 		{
@@ -655,13 +1846,14 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 			msleep(150);
 			if (retryCount >= 3)
 			{
-				strcpy(gui->txt_buf, "#FF0000 Aborting...#\nPlease try again...\n");
+				// Keep the backup and its journal, so it can be continued.
+				strcpy(gui->txt_buf, "#FF0000 Aborting...#\nSelect the same option again to continue...\n");
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
 				f_close(&fp);
 				free(clmt);
-				f_unlink(outFilename);
+				nx_emmc_jrnl_close(&jrnl);
 
 				return 1;
 			}
@@ -672,28 +1864,33 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 				manual_system_maintenance(true);
 			}
 
-			if (!gui->raw_emummc)
-				res_read = sdmmc_storage_read(storage, lba_curr, num, buf);
-			else
-				res_read = sdmmc_storage_read(&sd_storage, lba_curr + sd_sector_off, num, buf);
+			res_read = emmc_pipe_read(&pipe, lba_curr + sd_sector_off, num, num_next);
 			manual_system_maintenance(false);
 		}
 
+		// Hash chunk while it's written.
+		u8 *buf = emmc_pipe_buf(&pipe);
+		se_sha_hash_256_async(chunkHash, buf, num << 9);
 		res = f_write_fast(&fp, buf, EMMC_BLOCKSIZE * num);
+		se_sha_hash_256_finalize(chunkHash);
 
 		if (res)
 		{
-			s_printf(gui->txt_buf, "\n#FF0000 Fatal error (%d) when writing to SD Card#\nPlease try again...\n", res);
+			// Keep the backup and its journal, so it can be continued.
+			s_printf(gui->txt_buf, "\n#FF0000 Fatal error (%d) when writing to SD Card#\nSelect the same option again to continue...\n", res);
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
+			emmc_pipe_flush(&pipe);
 			f_close(&fp);
 			free(clmt);
-			f_unlink(outFilename);
+			nx_emmc_jrnl_close(&jrnl);
 
 			return 1;
 		}
 
+		nx_emmc_jrnl_chunk(&jrnl, chunkHash);
+
 		manual_system_maintenance(false);
 
 		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(lba_end - part->lba_start);
@@ -710,11 +1907,25 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 		totalSectors -= num;
 		bytesWritten += num * EMMC_BLOCKSIZE;
 
-		// Force a flush after a lot of data if not splitting.
-		if (numSplitParts == 0 && bytesWritten >= multipartSplitSize)
+		// Flush data and record progress. Part ends are recorded when the next part is created.
+		bool partEnd = numSplitParts != 0 && bytesWritten >= multipartSplitSize;
+		if (totalSectors && !partEnd && (lba_curr - lbaJrnl) >= (NX_EMMC_JRNL_INTERVAL / EMMC_BLOCKSIZE))
 		{
-			f_sync(&fp);
-			bytesWritten = 0;
+			res = nx_emmc_jrnl_commit(&jrnl, &fp, lba_curr - part->lba_start, currPartIdx, bytesWritten);
+			if (res)
+			{
+				s_printf(gui->txt_buf, "\n#FF0000 Fatal error (%d) when writing to SD Card#\nSelect the same option again to continue...\n", res);
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+
+				emmc_pipe_flush(&pipe);
+				f_close(&fp);
+				free(clmt);
+				nx_emmc_jrnl_close(&jrnl);
+
+				return 1;
+			}
+			lbaJrnl = lba_curr;
 		}
 
 		// Check for cancellation combo.
@@ -724,11 +1935,14 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
+			emmc_pipe_flush(&pipe);
+
 			msleep(1500);
 
 			f_close(&fp);
 			free(clmt);
 			f_unlink(outFilename);
+			nx_emmc_jrnl_remove(&jrnl);
 
 			return 1;
 		}
@@ -744,12 +1958,14 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 	if (verification && !gui->raw_emummc)
 	{
 		// Verify last part or single file backup.
-		if (_emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part) == VERIF_STATUS_ERROR)
+		if (_emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part, runHash) == VERIF_STATUS_ERROR)
 		{
 			strcpy(gui->txt_buf, "\n#FFDD00 Please try again...#\n");
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
+			nx_emmc_jrnl_remove(&jrnl);
+
 			return 1;
 		}
 		lv_bar_set_value(gui->bar, 100);
@@ -757,11 +1973,11 @@ static int _dump_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part,
 		manual_system_maintenance(true);
 	}
 
-	// Remove partial backup index file if no fatal errors occurred.
+	// Remove journal if no fatal errors occurred.
+	nx_emmc_jrnl_remove(&jrnl);
+
 	if (isSmallSdCard)
 	{
-		f_unlink(partialIdxFilename);
-
 		create_mbox_text(
 			"#96FF00 Partial Backup done!#\n\n"
 			"You can now join the files if needed\nand get the complete eMMC RAW GPP backup.", true);
@@ -967,6 +2183,299 @@ out:
 	}
 }
 
+// Queues a chunk write, or finishes the last one if num is 0. Failed writes are retried in place.
+static int _restore_pipe_write(emmc_tool_gui_t *gui, emmc_pipe_t *pipe, u32 lba, u32 num, u32 lba_off)
+{
+	int retryCount = 0;
+	int res = num ? emmc_pipe_write(pipe, lba, num) : emmc_pipe_flush(pipe);
+
+	while (res)
+	{
+		s_printf(gui->txt_buf,
+			"\n#FFDD00 Error writing %d blocks @ LBA %08X,#\n"
+			"#FFDD00 from eMMC (try %d). #",
+			pipe->num, pipe->lba - lba_off, ++retryCount);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		msleep(150);
+		if (retryCount >= 3)
+		{
+			strcpy(gui->txt_buf, "#FF0000 Aborting...#\n"
+				"#FF0000 This device may be in an inoperative state!#\n"
+				"#FFDD00 Please try again now!#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			return 1;
+		}
+		else
+		{
+			strcpy(gui->txt_buf, "#FFDD00 Retrying...#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+		}
+
+		// Redo the failed chunk and queue the new one.
+		res = emmc_pipe_retry(pipe);
+		if (!res && num)
+			res = emmc_pipe_write(pipe, lba, num);
+		manual_system_maintenance(false);
+	}
+
+	return 0;
+}
+
+// Trims an all-zero chunk instead of writing it. Returns 0 if trimmed, 1 if not supported and -1 on error.
+static int _restore_pipe_discard(emmc_tool_gui_t *gui, emmc_pipe_t *pipe, u32 lba, u32 num, u32 lba_off)
+{
+	// Card must be idle.
+	if (_restore_pipe_write(gui, pipe, 0, 0, lba_off))
+		return -1;
+
+	return sdmmc_storage_discard(pipe->storage, lba, num);
+}
+
+static void _restore_emummc_raw_cfg(u32 part_idx, u32 sector_start)
+{
+	char sdPath[OUT_FILENAME_SZ];
+	// Create Restore folders, if they do not exist.
+	f_mkdir("emuMMC");
+	s_printf(sdPath, "emuMMC/RAW%d", part_idx);
+	f_mkdir(sdPath);
+	strcat(sdPath, "/raw_based");
+	FIL fp_raw;
+	f_open(&fp_raw, sdPath, FA_CREATE_ALWAYS | FA_WRITE);
+	f_write(&fp_raw, &sector_start, 4, NULL);
+	f_close(&fp_raw);
+
+	s_printf(sdPath, "emuMMC/RAW%d", part_idx);
+	save_emummc_cfg(part_idx, sector_start, sdPath);
+}
+
+static int _restore_emmc_part_cz(emmc_tool_gui_t *gui, char *sd_path, int active_part, sdmmc_storage_t *storage, emmc_part_t *part)
+{
+	static const u32 SECTORS_TO_MIB_COEFF = 11;
+
+	u32 verification = n_cfg.verification;
+	u32 totalSectors = part->lba_end - part->lba_start + 1;
+	u32 lba_curr = part->lba_start;
+	u32 prevPct = 200;
+	u32 pct = 0;
+
+	// Restore the last incremental level found.
+	emmc_cz_t cz;
+	u32 stale;
+	u32 level = MAX(_emmc_cz_find_last(sd_path, &stale), 0);
+	_emmc_cz_init(&cz, sd_path, level);
+	_emmc_cz_path(&cz, -1);
+
+	s_printf(gui->txt_buf, "#96FF00 Filepath:#\n%s\n#96FF00 Filename:# #FF8000 %s#",
+		gui->base_path, cz.path + strlen(gui->base_path));
+	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	_emmc_cz_log_stale(gui, stale);
+
+	int res = _emmc_cz_load_chain(&cz, sd_path, level);
+	if (res)
+	{
+		s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while loading the backup index!#\n", res);
+		if (level)
+			strcat(gui->txt_buf, "#FF0000 An incremental level is missing or does not match!#\n");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		return 1;
+	}
+
+	if (level)
+	{
+		s_printf(gui->txt_buf, "\nRestoring incremental backup, level %d.\n", level);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+	}
+
+	// Check total restore size vs emmc size.
+	u32 imageSectors = (u32)(cz.hdr.image_size >> 9);
+	if (imageSectors > totalSectors)
+	{
+		strcpy(gui->txt_buf, "\n#FF8000 Size of SD Card backup exceeds#\n#FF8000 eMMC's selected part size!#\n#FFDD00 Aborting...#");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		_emmc_cz_close(&cz);
+
+		return 1;
+	}
+	else if (imageSectors != totalSectors && !gui->raw_emummc)
+	{
+		lv_obj_t *warn_mbox_bg = create_mbox_text(
+			"#FF8000 Size of the SD Card backup does not match#\n#FF8000 eMMC's selected part size!#\n\n"
+			"#FFDD00 The backup might be corrupted!#\n#FFDD00 Aborting is suggested!#\n\n"
+			"Press #FF8000 POWER# to Continue.\nPress #FF8000 VOL# to abort.", false);
+		manual_system_maintenance(true);
+
+		if (!(btn_wait() & BTN_POWER))
+		{
+			lv_obj_del(warn_mbox_bg);
+			strcpy(gui->txt_buf, "\n#FF0000 Size of the SD Card backup does not match#\n#FF0000 eMMC's selected part size.#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			_emmc_cz_close(&cz);
+
+			return 1;
+		}
+		lv_obj_del(warn_mbox_bg);
+	}
+	totalSectors = imageSectors;
+	u32 lba_end = totalSectors + part->lba_start - 1;
+
+	s_printf(gui->txt_buf, "\nTotal restore size: %d MiB.\n", totalSectors >> SECTORS_TO_MIB_COEFF);
+	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	u32 sector_start = 0, part_idx = 0;
+	u32 sector_size = totalSectors;
+	u32 sd_sector_off = 0;
+
+	if (gui->raw_emummc)
+	{
+		_get_valid_partition(&sector_start, &sector_size, &part_idx, false);
+		if (!part_idx || !sector_size)
+		{
+			strcpy(gui->txt_buf, "\n#FFDD00 Failed to find a partition...#\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			_emmc_cz_close(&cz);
+
+			return 1;
+		}
+		sd_sector_off = sector_start + (0x2000 * active_part);
+	}
+
+	emmc_pipe_t pipe;
+	emmc_pipe_init(&pipe, !gui->raw_emummc ? storage : &sd_storage);
+	bool discard = !gui->raw_emummc;
+
+	lv_obj_set_opa_scale(gui->bar, LV_OPA_COVER);
+	lv_obj_set_opa_scale(gui->label_pct, LV_OPA_COVER);
+	for (u32 i = 0; i < cz.hdr.chunk_cnt; i++)
+	{
+		u8 hash[SE_SHA_256_SIZE];
+		u32 len = _emmc_cz_chunk_len(&cz, i);
+		u32 num = len >> 9;
+
+		// Trim runs of empty chunks (up to 1GB) if possible.
+		if (discard && _emmc_cz_chunk_type(&cz, i) == NX_EMMC_CZ_CHUNK_ZERO)
+		{
+			u32 run = 1;
+			u32 run_num = num;
+			while ((i + run) < cz.hdr.chunk_cnt && run < 256 && _emmc_cz_chunk_type(&cz, i + run) == NX_EMMC_CZ_CHUNK_ZERO)
+				run_num += _emmc_cz_chunk_len(&cz, i + run++) >> 9;
+
+			res = _restore_pipe_discard(gui, &pipe, lba_curr + sd_sector_off, run_num, sd_sector_off);
+			if (res < 0)
+			{
+				_emmc_cz_close(&cz);
+
+				return 1;
+			}
+
+			discard = !res;
+			if (discard)
+			{
+				num = run_num;
+				i += run - 1;
+				goto next;
+			}
+		}
+
+		// Previous chunk is still being written from the other buffer.
+		u8 *buf = emmc_pipe_buf(&pipe);
+		res = _emmc_cz_read_chunk(&cz, i, buf);
+		manual_system_maintenance(false);
+
+		// Never write corrupted data.
+		if (!res && verification)
+		{
+			se_sha_hash_256_oneshot(hash, buf, len);
+			if (memcmp(hash, cz.idx[i].hash, SE_SHA_256_SIZE))
+				res = FR_INT_ERR;
+		}
+
+		if (res)
+		{
+			s_printf(gui->txt_buf,
+				"\n#FF0000 Fatal error (%d) when reading from SD!#\n"
+				"#FF0000 This device may be in an inoperative state!#\n"
+				"#FFDD00 Please try again now!#\n", res);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			emmc_pipe_flush(&pipe);
+			_emmc_cz_close(&cz);
+
+			return 1;
+		}
+
+		if (_restore_pipe_write(gui, &pipe, lba_curr + sd_sector_off, num, sd_sector_off))
+		{
+			_emmc_cz_close(&cz);
+
+			return 1;
+		}
+
+next:
+		manual_system_maintenance(false);
+
+		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(lba_end - part->lba_start);
+		if (pct != prevPct)
+		{
+			lv_bar_set_value(gui->bar, pct);
+			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+			lv_label_set_text(gui->label_pct, gui->txt_buf);
+			manual_system_maintenance(true);
+			prevPct = pct;
+		}
+
+		lba_curr += num;
+	}
+
+	// Finish last write.
+	if (_restore_pipe_write(gui, &pipe, 0, 0, sd_sector_off))
+	{
+		_emmc_cz_close(&cz);
+
+		return 1;
+	}
+
+	lv_bar_set_value(gui->bar, 100);
+	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
+	manual_system_maintenance(true);
+
+	// Verify restored data against the stored hashes.
+	if (verification && !gui->raw_emummc && _emmc_cz_verify(gui, &cz, storage, 0, part) == VERIF_STATUS_ERROR)
+	{
+		strcpy(gui->txt_buf, "\n#FFDD00 Please try again...#\n");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		_emmc_cz_close(&cz);
+
+		return 1;
+	}
+
+	_emmc_cz_close(&cz);
+
+	if (gui->raw_emummc)
+		_restore_emummc_raw_cfg(part_idx, sector_start);
+
+	return 0;
+}
+
 static int _restore_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_part, sdmmc_storage_t *storage, emmc_part_t *part, bool allow_multi_part)
 {
 	static const u32 SECTORS_TO_MIB_COEFF = 11;
@@ -992,6 +2501,11 @@ static int _restore_emmc_part(emmc_tool_gui_t *gui, char *sd_path, int active_pa
 	lv_bar_set_style(gui->bar, LV_BAR_STYLE_INDIC, gui->bar_orange_ind);
 	manual_system_maintenance(true);
 
+	// Use compressed backup if found.
+	s_printf(gui->txt_buf, "%s"NX_EMMC_CZ_EXT, outFilename);
+	if (!f_stat(gui->txt_buf, &fno))
+		return _restore_emmc_part_cz(gui, sd_path, active_part, storage, part);
+
 	bool use_multipart = false;
 	bool check_4MB_aligned = true;
 
@@ -1196,12 +2710,11 @@ multipart_not_allowed:
 		manual_system_maintenance(true);
 	}
 
-	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
+	emmc_pipe_t pipe;
 
 	u32 lba_curr = part->lba_start;
 	u32 bytesWritten = 0;
 	u32 prevPct = 200;
-	int retryCount = 0;
 
 	u32 num = 0;
 	u32 pct = 0;
@@ -1226,6 +2739,9 @@ multipart_not_allowed:
 		sd_sector_off = sector_start + (0x2000 * active_part);
 	}
 
+	emmc_pipe_init(&pipe, !gui->raw_emummc ? storage : &sd_storage);
+	bool discard = !gui->raw_emummc;
+
 	lv_obj_set_opa_scale(gui->bar, LV_OPA_COVER);
 	lv_obj_set_opa_scale(gui->label_pct, LV_OPA_COVER);
 	while (totalSectors > 0)
@@ -1241,8 +2757,12 @@ multipart_not_allowed:
 
 			if (verification && !gui->raw_emummc)
 			{
+				// Finish last write. Verification uses the same buffers.
+				if (_restore_pipe_write(gui, &pipe, 0, 0, sd_sector_off))
+					return 1;
+
 				// Verify part.
-				res = _emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part);
+				res = _emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part, NULL);
 				switch (res)
 				{
 				case VERIF_STATUS_OK:
@@ -1280,6 +2800,8 @@ multipart_not_allowed:
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
+				emmc_pipe_flush(&pipe);
+
 				return 1;
 			}
 			fileSize = (u64)f_size(&fp);
@@ -1287,10 +2809,10 @@ multipart_not_allowed:
 			clmt = f_expand_cltbl(&fp, SZ_4M, 0);
 		}
 
-		retryCount = 0;
 		num = MIN(totalSectors, NUM_SECTORS_PER_ITER);
 
-		res = f_read_fast(&fp, buf, num << 9);
+		// Previous chunk is still being written from the other buffer.
+		res = f_read_fast(&fp, emmc_pipe_buf(&pipe), num << 9);
 		manual_system_maintenance(false);
 
 		if (res)
@@ -1302,51 +2824,34 @@ multipart_not_allowed:
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
+			emmc_pipe_flush(&pipe);
 			f_close(&fp);
 			free(clmt);
 			return 1;
 		}
-		if (!gui->raw_emummc)
-			res = sdmmc_storage_write(storage, lba_curr, num, buf);
-		else
-			res = sdmmc_storage_write(&sd_storage, lba_curr + sd_sector_off, num, buf);
-
-		manual_system_maintenance(false);
 
-		while (res)
+		// Trim empty chunks if possible, otherwise write them.
+		res = 1;
+		if (discard && mem_is_zero(emmc_pipe_buf(&pipe), num << 9))
 		{
-			s_printf(gui->txt_buf,
-				"\n#FFDD00 Error writing %d blocks @ LBA %08X,#\n"
-				"#FFDD00 from eMMC (try %d). #",
-				num, lba_curr, ++retryCount);
-			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-			manual_system_maintenance(true);
-
-			msleep(150);
-			if (retryCount >= 3)
+			res = _restore_pipe_discard(gui, &pipe, lba_curr + sd_sector_off, num, sd_sector_off);
+			if (res < 0)
 			{
-				strcpy(gui->txt_buf, "#FF0000 Aborting...#\n"
-					"#FF0000 This device may be in an inoperative state!#\n"
-					"#FFDD00 Please try again now!#\n");
-				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-				manual_system_maintenance(true);
-
 				f_close(&fp);
 				free(clmt);
 				return 1;
 			}
-			else
-			{
-				strcpy(gui->txt_buf, "#FFDD00 Retrying...#\n");
-				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-				manual_system_maintenance(true);
-			}
-			if (!gui->raw_emummc)
-				res = sdmmc_storage_write(storage, lba_curr, num, buf);
-			else
-				res = sdmmc_storage_write(&sd_storage, lba_curr + sd_sector_off, num, buf);
-			manual_system_maintenance(false);
+			discard = !res;
+		}
+
+		if (res && _restore_pipe_write(gui, &pipe, lba_curr + sd_sector_off, num, sd_sector_off))
+		{
+			f_close(&fp);
+			free(clmt);
+			return 1;
 		}
+		manual_system_maintenance(false);
+
 		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(lba_end - part->lba_start);
 		if (pct != prevPct)
 		{
@@ -1361,6 +2866,15 @@ multipart_not_allowed:
 		totalSectors -= num;
 		bytesWritten += num * EMMC_BLOCKSIZE;
 	}
+
+	// Finish last write.
+	if (_restore_pipe_write(gui, &pipe, 0, 0, sd_sector_off))
+	{
+		f_close(&fp);
+		free(clmt);
+		return 1;
+	}
+
 	lv_bar_set_value(gui->bar, 100);
 	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
 	manual_system_maintenance(true);
@@ -1372,7 +2886,7 @@ multipart_not_allowed:
 	if (verification && !gui->raw_emummc)
 	{
 		// Verify restored data.
-		if (_emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part) == VERIF_STATUS_ERROR)
+		if (_emmc_sd_copy_verify(gui, storage, lbaStartPart, outFilename, part, NULL) == VERIF_STATUS_ERROR)
 		{
 			strcpy(gui->txt_buf, "\n#FFDD00 Please try again...#\n");
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
@@ -1386,21 +2900,7 @@ multipart_not_allowed:
 	}
 
 	if (gui->raw_emummc)
-	{
-		char sdPath[OUT_FILENAME_SZ];
-		// Create Restore folders, if they do not exist.
-		f_mkdir("emuMMC");
-		s_printf(sdPath, "emuMMC/RAW%d", part_idx);
-		f_mkdir(sdPath);
-		strcat(sdPath, "/raw_based");
-		FIL fp_raw;
-		f_open(&fp_raw, sdPath, FA_CREATE_ALWAYS | FA_WRITE);
-		f_write(&fp_raw, &sector_start, 4, NULL);
-		f_close(&fp_raw);
-
-		s_printf(sdPath, "emuMMC/RAW%d", part_idx);
-		save_emummc_cfg(part_idx, sector_start, sdPath);
-	}
+		_restore_emummc_raw_cfg(part_idx, sector_start);
 
 	return 0;
 }
@@ -1,6 +1,6 @@
 /*
  * Copyright (c) 2018 Rajko Stojadinovic
- * Copyright (c) 2018 CTCaer
+ * Copyright (c) 2018-2026 CTCaer
  *
  * This program is free software; you can redistribute it and/or modify it
  * under the terms and conditions of the GNU General Public License,
@@ -29,6 +29,28 @@ typedef enum
 	PART_GP_ALL = BIT(7)
 } emmcPartType_t;
 
+typedef struct _emmc_pipe_t
+{
+	sdmmc_storage_t *storage;
+	u8  *buf[2];
+	u32  idx;      // Buffer owned by the caller.
+	bool async;    // Background transfers allowed.
+	bool pending;  // Transfer in flight.
+	bool is_write;
+	int  res;      // Result of a foreground write, reported on next flush.
+	u32  lba;      // Last issued transfer.
+	u32  num;
+	u8  *xbuf;
+} emmc_pipe_t;
+
+void emmc_pipe_init(emmc_pipe_t *pipe, sdmmc_storage_t *storage);
+u8  *emmc_pipe_buf(emmc_pipe_t *pipe);
+int  emmc_pipe_read(emmc_pipe_t *pipe, u32 lba, u32 num, u32 num_next);
+int  emmc_pipe_prefetch(emmc_pipe_t *pipe, u32 lba, u32 num);
+int  emmc_pipe_write(emmc_pipe_t *pipe, u32 lba, u32 num);
+int  emmc_pipe_retry(emmc_pipe_t *pipe);
+int  emmc_pipe_flush(emmc_pipe_t *pipe);
+
 void dump_emmc_selected(emmcPartType_t dumpType, emmc_tool_gui_t *gui);
 void restore_emmc_selected(emmcPartType_t restoreType, emmc_tool_gui_t *gui);
 
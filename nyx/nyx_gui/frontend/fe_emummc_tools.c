@@ -24,6 +24,7 @@
 #include <bdk.h>
 
 #include "gui.h"
+#include "fe_emmc_tools.h"
 #include "fe_emummc_tools.h"
 #include "../config.h"
 #include "../hos/hos.h"
@@ -140,31 +141,50 @@ void update_emummc_base_folder(char *outFilename, u32 sdPathLen, u32 currPartIdx
 		itoa(currPartIdx, &outFilename[sdPathLen], 10);
 }
 
-static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_storage_t *storage, const emmc_part_t *part)
+static void _emummc_file_remove(const char *emmc_path, u32 files)
+{
+	char path[OUT_FILENAME_SZ];
+
+	for (u32 i = 0; i < files; i++)
+	{
+		nx_emmc_layout_file_path(path, emmc_path, i);
+		f_unlink(path);
+	}
+}
+
+/*
+ * Creates all files up front, contiguous if possible, and records their SD sector runs.
+ * Data is then written directly to these sectors, the same way as raw emuMMC.
+ */
+static int _emummc_file_prealloc(emmc_tool_gui_t *gui, nx_emmc_layout_t *lt, const char *emmc_path, u32 gpp_sectors)
 {
-	static const u32 FAT32_FILESIZE_LIMIT = 0xFFFFFFFF;
 	static const u32 SECTORS_TO_MIB_COEFF = 11;
+	static const u32 BOOT_PART_SECTORS = 0x2000; // Force 4 MiB.
 
-	u32 multipartSplitSize = 0xFE000000;
-	u32 totalSectors = part->lba_end - part->lba_start + 1;
-	u32 currPartIdx = 0;
-	u32 numSplitParts = 0;
-	int res = 0;
-	char *outFilename = sd_path;
-	u32 sdPathLen = strlen(sd_path);
-
-	s_printf(gui->txt_buf, "#96FF00 SD Card free space:# %d MiB\n#96FF00 Total size:# %d MiB\n\n",
-		(u32)(sd_fs.free_clst * sd_fs.csize >> SECTORS_TO_MIB_COEFF),
-		totalSectors >> SECTORS_TO_MIB_COEFF);
-	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
-	manual_system_maintenance(true);
+	FIL fp;
+	char path[OUT_FILENAME_SZ];
+	u32 part_sectors = lt->hdr.part_sectors;
+	u32 files = 2 + (gpp_sectors + part_sectors - 1) / part_sectors;
+	u32 total_sectors = BOOT_PART_SECTORS * 2 + gpp_sectors;
+	u32 free_sectors = sd_fs.free_clst * sd_fs.csize;
+
+	// Existing files are truncated when created, so their space is also usable.
+	for (u32 i = 0; i < files; i++)
+	{
+		FILINFO fno;
+		nx_emmc_layout_file_path(path, emmc_path, i);
+		if (!f_stat(path, &fno))
+			free_sectors += ALIGN((u32)((fno.fsize + EMMC_BLOCKSIZE - 1) >> 9), sd_fs.csize);
+	}
 
-	lv_bar_set_value(gui->bar, 0);
-	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 0%");
+	s_printf(gui->txt_buf, "#96FF00 SD Card free space:# %d MiB\n#96FF00 Total size:# %d MiB\n",
+		free_sectors >> SECTORS_TO_MIB_COEFF, total_sectors >> SECTORS_TO_MIB_COEFF);
+	lv_label_set_text(gui->label_info, gui->txt_buf);
+	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, "Allocating files... ");
 	manual_system_maintenance(true);
 
-	// Check if the USER partition or the RAW eMMC fits the sd card free space.
-	if (totalSectors > (sd_fs.free_clst * sd_fs.csize))
+	// Check if the eMMC fits the sd card free space.
+	if (total_sectors > free_sectors)
 	{
 		s_printf(gui->txt_buf, "\n#FFDD00 Not enough free space for file based emuMMC!#\n");
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
@@ -173,84 +193,95 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 		return 1;
 	}
 
-	// Check if filesystem is FAT32 or the free space is smaller and dump in parts.
-	if (totalSectors > (FAT32_FILESIZE_LIMIT / EMMC_BLOCKSIZE))
+	for (u32 i = 0; i < files; i++)
 	{
-		u32 multipartSplitSectors = multipartSplitSize / EMMC_BLOCKSIZE;
-		numSplitParts = (totalSectors + multipartSplitSectors - 1) / multipartSplitSectors;
+		u32 sectors = BOOT_PART_SECTORS;
+		if (i >= 2)
+			sectors = MIN(gpp_sectors - (i - 2) * part_sectors, part_sectors);
+
+		nx_emmc_layout_file_path(path, emmc_path, i);
+
+		int res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+		if (!res)
+		{
+			DWORD *clmt = f_alloc_cltbl(&fp, SZ_4M, (u64)sectors << 9);
+			res = clmt ? nx_emmc_layout_add(lt, &fp) : FR_DENIED;
+
+			int res_close = f_close(&fp);
+			if (!res)
+				res = res_close;
+			free(clmt);
+		}
+
+		if (res)
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while allocating#\n#FFDD00 %s#\n", res, path);
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			_emummc_file_remove(emmc_path, i + 1);
+
+			return 1;
+		}
 
-		// Get first part filename.
-		update_emummc_base_folder(outFilename, sdPathLen, 0);
+		manual_system_maintenance(false);
 	}
 
-	FIL fp;
-	s_printf(gui->txt_buf, "#96FF00 Filepath:#\n%s\n#96FF00 Filename:# #FF8000 %s#",
-		gui->base_path, outFilename + strlen(gui->base_path));
-	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
+	s_printf(gui->txt_buf, "Done! (%d fragments)\n", lt->hdr.run_cnt);
+	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 	manual_system_maintenance(true);
 
-	res = f_open(&fp, outFilename, FA_CREATE_ALWAYS | FA_WRITE);
-	if (res)
+	return 0;
+}
+
+static int _emummc_file_write(nx_emmc_layout_t *lt, u32 mmc_part, u32 sector, u32 num, u8 *buf)
+{
+	while (num)
 	{
-		s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while creating#\n#FFDD00 %s#\n", res, outFilename);
-		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-		manual_system_maintenance(true);
+		u32 sd_sector;
+		u32 cnt = nx_emmc_layout_map(lt, mmc_part, sector, &sd_sector);
+		if (!cnt)
+			return 1;
 
-		return 1;
+		cnt = MIN(cnt, num);
+		if (sdmmc_storage_write(&sd_storage, sd_sector, cnt, buf))
+			return 1;
+
+		sector += cnt;
+		num -= cnt;
+		buf += cnt * EMMC_BLOCKSIZE;
 	}
 
-	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
+	return 0;
+}
+
+static int _dump_emummc_file_part(emmc_tool_gui_t *gui, nx_emmc_layout_t *lt, u32 mmc_part, sdmmc_storage_t *storage, const emmc_part_t *part)
+{
+	static const u32 SECTORS_TO_MIB_COEFF = 11;
 
+	u32 totalSectors = part->lba_end - part->lba_start + 1;
 	u32 lba_curr = part->lba_start;
-	u32 bytesWritten = 0;
 	u32 prevPct = 200;
 	int retryCount = 0;
-	DWORD *clmt = NULL;
-
-	u64 totalSize = (u64)((u64)totalSectors << 9);
-	if (totalSize <= FAT32_FILESIZE_LIMIT)
-		clmt = f_expand_cltbl(&fp, SZ_4M, totalSize);
-	else
-		clmt = f_expand_cltbl(&fp, SZ_4M, MIN(totalSize, multipartSplitSize));
-
 	u32 num = 0;
 	u32 pct = 0;
 
+	s_printf(gui->txt_buf, "#96FF00 Total size:# %d MiB\n#96FF00 Filepath:#\n%s\n#96FF00 Fragments:# #FF8000 %d#",
+		totalSectors >> SECTORS_TO_MIB_COEFF, gui->base_path, lt->hdr.run_cnt);
+	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
+	manual_system_maintenance(true);
+
+	lv_bar_set_value(gui->bar, 0);
+	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 0%");
+	manual_system_maintenance(true);
+
+	emmc_pipe_t pipe;
+	emmc_pipe_init(&pipe, storage);
+
 	lv_obj_set_opa_scale(gui->bar, LV_OPA_COVER);
 	lv_obj_set_opa_scale(gui->label_pct, LV_OPA_COVER);
 	while (totalSectors > 0)
 	{
-		if (numSplitParts != 0 && bytesWritten >= multipartSplitSize)
-		{
-			f_close(&fp);
-			free(clmt);
-			memset(&fp, 0, sizeof(fp));
-			currPartIdx++;
-
-			update_emummc_base_folder(outFilename, sdPathLen, currPartIdx);
-
-			// Create next part.
-			s_printf(gui->txt_buf, "%s#", outFilename + strlen(gui->base_path));
-			lv_label_cut_text(gui->label_info, strlen(lv_label_get_text(gui->label_info)) - 3, 3);
-			lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
-			manual_system_maintenance(true);
-
-			res = f_open(&fp, outFilename, FA_CREATE_ALWAYS | FA_WRITE);
-			if (res)
-			{
-				s_printf(gui->txt_buf, "\n#FF0000 Error (%d) while creating#\n#FFDD00 %s#\n", res, outFilename);
-				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
-				manual_system_maintenance(true);
-
-				return 1;
-			}
-
-			bytesWritten = 0;
-
-			totalSize = (u64)((u64)totalSectors << 9);
-			clmt = f_expand_cltbl(&fp, SZ_4M, MIN(totalSize, multipartSplitSize));
-		}
-
 		// Check for cancellation combo.
 		if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
 		{
@@ -258,9 +289,7 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
-			f_close(&fp);
-			free(clmt);
-			f_unlink(outFilename);
+			emmc_pipe_flush(&pipe);
 
 			msleep(1000);
 
@@ -269,8 +298,10 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 
 		retryCount = 0;
 		num = MIN(totalSectors, NUM_SECTORS_PER_ITER);
+		u32 num_next = MIN(totalSectors - num, NUM_SECTORS_PER_ITER);
 
-		while (sdmmc_storage_read(storage, lba_curr, num, buf))
+		// Read chunk and start reading the next one in the background.
+		while (emmc_pipe_read(&pipe, lba_curr, num, num_next))
 		{
 			s_printf(gui->txt_buf,
 				"\n#FFDD00 Error reading %d blocks @ LBA %08X,#\n"
@@ -286,9 +317,7 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
-				f_close(&fp);
-				free(clmt);
-				f_unlink(outFilename);
+				emmc_pipe_flush(&pipe);
 
 				return 1;
 			}
@@ -302,22 +331,38 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 
 		manual_system_maintenance(false);
 
-		res = f_write_fast(&fp, buf, EMMC_BLOCKSIZE * num);
-
-		manual_system_maintenance(false);
-
-		if (res)
+		// Write data directly to the SD sectors of the files.
+		retryCount = 0;
+		while (_emummc_file_write(lt, mmc_part, lba_curr, num, emmc_pipe_buf(&pipe)))
 		{
-			s_printf(gui->txt_buf, "\n#FF0000 Fatal error (%d) when writing to SD Card#\nPlease try again...\n", res);
+			s_printf(gui->txt_buf,
+				"\n#FFDD00 Error writing %d blocks @ LBA %08X,#\n"
+				"#FFDD00 to SD (try %d). #",
+				num, lba_curr, ++retryCount);
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
-			f_close(&fp);
-			free(clmt);
-			f_unlink(outFilename);
+			msleep(150);
+			if (retryCount >= 3)
+			{
+				s_printf(gui->txt_buf, "#FF0000 Aborting...#\nPlease try again...\n");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
 
-			return 1;
+				emmc_pipe_flush(&pipe);
+
+				return 1;
+			}
+			else
+			{
+				s_printf(gui->txt_buf, "#FFDD00 Retrying...#");
+				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+				manual_system_maintenance(true);
+			}
 		}
+
+		manual_system_maintenance(false);
+
 		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
 		if (pct != prevPct)
 		{
@@ -331,14 +376,6 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 
 		lba_curr += num;
 		totalSectors -= num;
-		bytesWritten += num * EMMC_BLOCKSIZE;
-
-		// Force a flush after a lot of data if not splitting.
-		if (numSplitParts == 0 && bytesWritten >= multipartSplitSize)
-		{
-			f_sync(&fp);
-			bytesWritten = 0;
-		}
 
 		manual_system_maintenance(false);
 	}
@@ -346,10 +383,6 @@ static int _dump_emummc_file_part(emmc_tool_gui_t *gui, char *sd_path, sdmmc_sto
 	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
 	manual_system_maintenance(true);
 
-	// Operation ended successfully.
-	f_close(&fp);
-	free(clmt);
-
 	return 0;
 }
 
@@ -358,6 +391,8 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 	int res = 1;
 	int base_len = 0;
 	u32 timer = 0;
+	u32 multipartSplitSize = 0xFE000000;
+	nx_emmc_layout_t *layout = NULL;
 
 	char *txt_buf = (char *)malloc(SZ_16K);
 	gui->base_path = (char *)malloc(OUT_FILENAME_SZ);
@@ -388,6 +423,7 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 
 	int i = 0;
 	char sdPath[OUT_FILENAME_SZ];
+	char emmcPath[OUT_FILENAME_SZ];
 	// Create Restore folders, if they do not exist.
 	f_mkdir("emuMMC");
 	strcpy(sdPath, "emuMMC/SD");
@@ -403,12 +439,27 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 	f_mkdir(sdPath);
 	strcat(sdPath, "/eMMC");
 	f_mkdir(sdPath);
+	strcpy(emmcPath, sdPath);
 	strcat(sdPath, "/");
 	strcpy(gui->base_path, sdPath);
 
 	timer = get_tmr_s();
 	const u32 BOOT_PART_SECTORS = 0x2000; // Force 4 MiB.
 
+	// Get GP partition size dynamically.
+	const u32 RAW_AREA_NUM_SECTORS = emmc_storage.sec_cnt;
+
+	// Allocate all files and get their SD sectors.
+	layout = (nx_emmc_layout_t *)malloc(sizeof(nx_emmc_layout_t));
+	nx_emmc_layout_init(layout, multipartSplitSize / EMMC_BLOCKSIZE);
+	res = _emummc_file_prealloc(gui, layout, emmcPath, RAW_AREA_NUM_SECTORS);
+	if (res)
+	{
+		// Already removed.
+		layout->hdr.file_cnt = 0;
+		goto out_failed;
+	}
+
 	emmc_part_t bootPart;
 	memset(&bootPart, 0, sizeof(bootPart));
 	bootPart.lba_start = 0;
@@ -429,8 +480,7 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 
 		emmc_set_partition(i + 1);
 
-		strcat(sdPath, bootPart.name);
-		res = _dump_emummc_file_part(gui, sdPath, &emmc_storage, &bootPart);
+		res = _dump_emummc_file_part(gui, layout, i + 1, &emmc_storage, &bootPart);
 
 		if (res)
 		{
@@ -442,16 +492,10 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, txt_buf);
 		manual_system_maintenance(true);
-
-		strcpy(sdPath, gui->base_path);
 	}
 
-	// Get GP partition size dynamically.
 	emmc_set_partition(EMMC_GPP);
 
-	// Get GP partition size dynamically.
-	const u32 RAW_AREA_NUM_SECTORS = emmc_storage.sec_cnt;
-
 	emmc_part_t rawPart;
 	memset(&rawPart, 0, sizeof(rawPart));
 	rawPart.lba_start = 0;
@@ -465,7 +509,7 @@ void dump_emummc_file(emmc_tool_gui_t *gui)
 	lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, txt_buf);
 	manual_system_maintenance(true);
 
-	res = _dump_emummc_file_part(gui, sdPath, &emmc_storage, &rawPart);
+	res = _dump_emummc_file_part(gui, layout, EMMC_GPP, &emmc_storage, &rawPart);
 
 	if (res)
 		s_printf(txt_buf, "#FFDD00 Failed!#\n");
@@ -489,21 +533,143 @@ out_failed:
 		f_open(&fp, sdPath, FA_CREATE_ALWAYS | FA_WRITE);
 		f_close(&fp);
 
+		// Save file layout for raw access.
+		strcpy(sdPath, gui->base_path);
+		strcat(sdPath, NX_EMMC_LAYOUT_NAME);
+		nx_emmc_layout_save(layout, sdPath);
+
 		gui->base_path[strlen(gui->base_path) - 1] = 0;
 		save_emummc_cfg(0, 0, gui->base_path);
 	}
 	else
+	{
+		// Remove partially written files.
+		_emummc_file_remove(emmcPath, layout->hdr.file_cnt);
+
 		s_printf(txt_buf, "Time taken: %dm %ds.", timer / 60, timer % 60);
+	}
 
 	lv_label_set_text(gui->label_finish, txt_buf);
 
 out:
+	free(layout);
 	free(txt_buf);
 	free(gui->base_path);
 	sd_unmount();
 }
 
-static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part_idx, u32 sd_part_off, emmc_part_t *part, u32 resized_count)
+/*
+ * Fast creation. USER is parsed via BIS and only 4MB chunks that have allocated
+ * clusters or FAT metadata are copied. Returns a bitmap of the chunks to copy.
+ * Chunk 0 starts at base_lba, which must cover all of USER.
+ */
+static u8 *_emummc_raw_user_map(emmc_part_t *user_part, u32 base_lba, u32 chunks)
+{
+	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
+	u32 *fat = (u32 *)buf;
+	u8 *map = NULL;
+
+	if (user_part->lba_start < base_lba || (user_part->lba_end - base_lba) >= chunks * NUM_SECTORS_PER_ITER)
+		return NULL;
+
+	nx_emmc_bis_init(user_part, false, 0);
+
+	// Parse FAT32 boot sector.
+	if (nx_emmc_bis_read(0, 1, buf))
+		goto out;
+
+	u32 bps   = buf[0x0B] | (buf[0x0C] << 8);
+	u32 spc   = buf[0x0D];
+	u32 rsvd  = buf[0x0E] | (buf[0x0F] << 8);
+	u32 nfats = buf[0x10];
+	u32 fatsz = *(u32 *)&buf[0x24];
+	u32 user_sectors = user_part->lba_end - user_part->lba_start + 1;
+
+	if (bps != EMMC_BLOCKSIZE || !spc || (spc & (spc - 1)) || !rsvd || !nfats || !fatsz ||
+		buf[0x1FE] != 0x55 || buf[0x1FF] != 0xAA || (rsvd + nfats * fatsz) >= user_sectors)
+		goto out;
+
+	// Relative to base_lba.
+	u32 data_lba = user_part->lba_start - base_lba + rsvd + nfats * fatsz;
+	u32 clusters = MIN((user_sectors - rsvd - nfats * fatsz) / spc, fatsz * (EMMC_BLOCKSIZE / sizeof(u32)) - 2);
+	u32 data_end = data_lba + clusters * spc;
+
+	map = malloc(ALIGN(chunks, 8) / 8);
+	memset(map, 0xFF, ALIGN(chunks, 8) / 8);
+
+	// Clear chunks that are fully in the data area.
+	for (u32 c = (data_lba + NUM_SECTORS_PER_ITER - 1) / NUM_SECTORS_PER_ITER; (c + 1) * NUM_SECTORS_PER_ITER <= data_end; c++)
+		map[c >> 3] &= ~BIT(c & 7);
+
+	// Mark chunks with allocated clusters. FAT is read in 4MB windows.
+	const u32 win_entries = SZ_4M / sizeof(u32);
+	for (u32 i = 0; i < clusters + 2; i++)
+	{
+		if (!(i % win_entries))
+		{
+			u32 sct = i / (EMMC_BLOCKSIZE / sizeof(u32));
+			if (nx_emmc_bis_read(rsvd + sct, MIN(SZ_4M / EMMC_BLOCKSIZE, fatsz - sct), buf))
+			{
+				free(map);
+				map = NULL;
+				goto out;
+			}
+			manual_system_maintenance(false);
+		}
+
+		if (i < 2 || !(fat[i % win_entries] & 0x0FFFFFFF))
+			continue;
+
+		u32 lba = data_lba + (i - 2) * spc;
+		u32 c0 = lba / NUM_SECTORS_PER_ITER;
+		u32 c1 = (lba + spc - 1) / NUM_SECTORS_PER_ITER;
+		map[c0 >> 3] |= BIT(c0 & 7);
+		map[c1 >> 3] |= BIT(c1 & 7);
+	}
+
+out:
+	nx_emmc_bis_end();
+
+	return map;
+}
+
+#define DISCARD_MAX_SCT (SZ_256M / EMMC_BLOCKSIZE)
+
+/*
+ * Discards a range of skipped sectors in pieces that end on 256MB boundaries.
+ * These are also AU boundaries, so each erase stays bounded.
+ * A failed erase can leave the SD busy, so the caller must not write to it after.
+ */
+static int _emummc_raw_discard(u32 sector, u32 *count, bool *discard)
+{
+	u32 left = *count;
+	*count = 0;
+
+	if (!left || !*discard)
+		return 0;
+
+	// Not supported. Sectors are only skipped.
+	if (!sdmmc_storage_can_discard(&sd_storage))
+	{
+		*discard = false;
+		return 0;
+	}
+
+	while (left)
+	{
+		u32 num = MIN(left, DISCARD_MAX_SCT - (sector % DISCARD_MAX_SCT));
+		if (sdmmc_storage_discard(&sd_storage, sector, num))
+			return 1;
+
+		sector += num;
+		left   -= num;
+		manual_system_maintenance(true);
+	}
+
+	return 0;
+}
+
+static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part_idx, u32 sd_part_off, emmc_part_t *part, u32 resized_count, bool fast)
 {
 	u32 num = 0;
 	u32 pct = 0;
@@ -513,6 +679,9 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 	u32 lba_curr = part->lba_start;
 	u8 *buf = (u8 *)MIXD_BUF_ALIGNED;
 
+	emmc_pipe_t pipe;
+	emmc_pipe_init(&pipe, &emmc_storage);
+
 	s_printf(gui->txt_buf, "\n\n\n");
 	lv_label_ins_text(gui->label_info, LV_LABEL_POS_LAST, gui->txt_buf);
 	manual_system_maintenance(true);
@@ -552,6 +721,30 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 	}
 
 	u32 totalSectors = part->lba_end - part->lba_start + 1;
+
+	// Find used USER space for fast creation.
+	u8 *user_map = NULL;
+	u32 skipped = 0;
+	bool discard = true;
+	u32 discard_sct = 0;
+	u32 discard_cnt = 0;
+	if (fast && !resized_count)
+	{
+		LIST_INIT(gpt_parsed);
+		emmc_gpt_parse(&gpt_parsed);
+		emmc_part_t *user_part = emmc_part_find(&gpt_parsed, "USER");
+		if (user_part)
+			user_map = _emummc_raw_user_map(user_part, part->lba_start, (totalSectors + NUM_SECTORS_PER_ITER - 1) / NUM_SECTORS_PER_ITER);
+		emmc_gpt_free(&gpt_parsed);
+
+		if (!user_map)
+		{
+			s_printf(gui->txt_buf, "\n#FFDD00 Failed to parse USER. Copying all...# ");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+		}
+	}
+
 	while (totalSectors > 0)
 	{
 		// Check for cancellation combo.
@@ -561,16 +754,63 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 			manual_system_maintenance(true);
 
+			emmc_pipe_flush(&pipe);
+			free(user_map);
+
 			msleep(1000);
 
 			return 1;
 		}
 
+		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
+		if (pct != prevPct)
+		{
+			lv_bar_set_value(gui->bar, pct);
+			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
+			lv_label_set_text(gui->label_pct, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			prevPct = pct;
+		}
+
 		retryCount = 0;
 		num = MIN(totalSectors, NUM_SECTORS_PER_ITER);
+		u32 num_next = MIN(totalSectors - num, NUM_SECTORS_PER_ITER);
+
+		// Skip unused USER space. Its contents are never read, so discard it if supported.
+		// Contiguous skipped chunks are discarded as one range.
+		u32 chunk = (lba_curr - part->lba_start) / NUM_SECTORS_PER_ITER;
+		if (user_map && !(user_map[chunk >> 3] & BIT(chunk & 7)))
+		{
+			if (!discard_cnt)
+				discard_sct = sd_sector_off + lba_curr;
+			discard_cnt += num;
+
+			skipped += num;
+			lba_curr += num;
+			totalSectors -= num;
+			continue;
+		}
+
+		if (_emummc_raw_discard(discard_sct, &discard_cnt, &discard))
+		{
+			s_printf(gui->txt_buf, "\n#FF0000 Failed to erase unused space on SD!#\nPlease try again...\n");
+			lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+			manual_system_maintenance(true);
+
+			emmc_pipe_flush(&pipe);
+			free(user_map);
+
+			return 1;
+		}
 
-		// Read data from eMMC.
-		while (sdmmc_storage_read(&emmc_storage, lba_curr, num, buf))
+		// Don't prefetch skipped chunks.
+		chunk++;
+		if (user_map && !(user_map[chunk >> 3] & BIT(chunk & 7)))
+			num_next = 0;
+
+		// Read data from eMMC and start reading the next chunk in the background.
+		while (emmc_pipe_read(&pipe, lba_curr, num, num_next))
 		{
 			s_printf(gui->txt_buf,
 				"\n#FFDD00 Error reading %d blocks @LBA %08X,#\n"
@@ -586,6 +826,9 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
+				emmc_pipe_flush(&pipe);
+				free(user_map);
+
 				return 1;
 			}
 			else
@@ -600,7 +843,7 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 
 		// Write data to SD card.
 		retryCount = 0;
-		while (sdmmc_storage_write(&sd_storage, sd_sector_off + lba_curr, num, buf))
+		while (sdmmc_storage_write(&sd_storage, sd_sector_off + lba_curr, num, emmc_pipe_buf(&pipe)))
 		{
 			s_printf(gui->txt_buf,
 				"\n#FFDD00 Error writing %d blocks @LBA %08X,#\n"
@@ -616,6 +859,9 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 				lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 				manual_system_maintenance(true);
 
+				emmc_pipe_flush(&pipe);
+				free(user_map);
+
 				return 1;
 			}
 			else
@@ -628,24 +874,34 @@ static int _dump_emummc_raw_part(emmc_tool_gui_t *gui, int active_part, int part
 
 		manual_system_maintenance(false);
 
-		pct = (u64)((u64)(lba_curr - part->lba_start) * 100u) / (u64)(part->lba_end - part->lba_start);
-		if (pct != prevPct)
-		{
-			lv_bar_set_value(gui->bar, pct);
-			s_printf(gui->txt_buf, " "SYMBOL_DOT" %d%%", pct);
-			lv_label_set_text(gui->label_pct, gui->txt_buf);
-			manual_system_maintenance(true);
-
-			prevPct = pct;
-		}
-
 		lba_curr += num;
 		totalSectors -= num;
 	}
+	if (_emummc_raw_discard(discard_sct, &discard_cnt, &discard))
+	{
+		s_printf(gui->txt_buf, "\n#FF0000 Failed to erase unused space on SD!#\nPlease try again...\n");
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		emmc_pipe_flush(&pipe);
+		free(user_map);
+
+		return 1;
+	}
+
 	lv_bar_set_value(gui->bar, 100);
 	lv_label_set_text(gui->label_pct, " "SYMBOL_DOT" 100%");
 	manual_system_maintenance(true);
 
+	if (user_map)
+	{
+		s_printf(gui->txt_buf, "%d MiB unused... ", skipped >> 11);
+		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
+		manual_system_maintenance(true);
+
+		free(user_map);
+	}
+
 	// Set partition type to emuMMC (0xE0).
 	if (active_part == 2)
 	{
@@ -823,7 +1079,7 @@ error:
 	return 1;
 }
 
-void dump_emummc_raw(emmc_tool_gui_t *gui, int part_idx, u32 sector_start, u32 resized_count)
+void dump_emummc_raw(emmc_tool_gui_t *gui, int part_idx, u32 sector_start, u32 resized_count, bool fast)
 {
 	int res = 1;
 	u32 timer = 0;
@@ -849,9 +1105,12 @@ void dump_emummc_raw(emmc_tool_gui_t *gui, int part_idx, u32 sector_start, u32 r
 		goto out;
 	}
 
-	if (resized_count && !emummc_raw_derive_bis_keys())
+	if ((resized_count || fast) && !emummc_raw_derive_bis_keys())
 	{
-		s_printf(gui->txt_buf, "#FFDD00 For formatting USER partition,#\n#FFDD00 BIS keys are needed!#\n");
+		if (resized_count)
+			s_printf(gui->txt_buf, "#FFDD00 For formatting USER partition,#\n#FFDD00 BIS keys are needed!#\n");
+		else
+			s_printf(gui->txt_buf, "#FFDD00 For fast creation,#\n#FFDD00 BIS keys are needed!#\n");
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, gui->txt_buf);
 		emmc_end();
 		goto out;
@@ -894,7 +1153,7 @@ void dump_emummc_raw(emmc_tool_gui_t *gui, int part_idx, u32 sector_start, u32 r
 		emmc_set_partition(i + 1);
 
 		strcat(sdPath, bootPart.name);
-		res = _dump_emummc_raw_part(gui, i, part_idx, sector_start, &bootPart, 0);
+		res = _dump_emummc_raw_part(gui, i, part_idx, sector_start, &bootPart, 0, false);
 
 		if (res)
 		{
@@ -928,7 +1187,7 @@ void dump_emummc_raw(emmc_tool_gui_t *gui, int part_idx, u32 sector_start, u32 r
 		lv_label_ins_text(gui->label_log, LV_LABEL_POS_LAST, txt_buf);
 		manual_system_maintenance(true);
 
-		res = _dump_emummc_raw_part(gui, 2, part_idx, sector_start, &rawPart, resized_count);
+		res = _dump_emummc_raw_part(gui, 2, part_idx, sector_start, &rawPart, resized_count, fast);
 
 		if (res)
 			s_printf(txt_buf, "#FFDD00 Failed!#\n");
@@ -943,6 +1202,10 @@ out_failed:
 	timer = get_tmr_s() - timer;
 	emmc_end();
 
+	// Clear BIS keys used for fast creation.
+	if (fast && !resized_count)
+		hos_bis_keys_clear();
+
 	if (!res)
 	{
 		s_printf(txt_buf, "Time taken: %dm %ds.\nFinished!", timer / 60, timer % 60);
@@ -37,6 +37,9 @@ typedef struct _emmc_backup_buttons_t
 	lv_obj_t *emmc_sys;
 	lv_obj_t *emmc_usr;
 	bool raw_emummc;
+	bool compress;
+	bool incremental;
+	bool chunk_store;
 	bool restore;
 } emmc_backup_buttons_t;
 
@@ -46,7 +49,10 @@ static void _create_window_backup_restore(emmcPartType_t type, const char* win_l
 {
 	emmc_tool_gui_t emmc_tool_gui_ctxt;
 
-	emmc_tool_gui_ctxt.raw_emummc = emmc_btn_ctxt.raw_emummc;
+	emmc_tool_gui_ctxt.raw_emummc  = emmc_btn_ctxt.raw_emummc;
+	emmc_tool_gui_ctxt.compress    = emmc_btn_ctxt.compress || emmc_btn_ctxt.incremental || emmc_btn_ctxt.chunk_store;
+	emmc_tool_gui_ctxt.incremental = emmc_btn_ctxt.incremental;
+	emmc_tool_gui_ctxt.chunk_store = emmc_btn_ctxt.chunk_store;
 
 	char win_label_full[80];
 
@@ -274,6 +280,33 @@ static lv_res_t _emmc_backup_buttons_raw_toggle(lv_obj_t *btn)
 	return LV_RES_OK;
 }
 
+static lv_res_t _emmc_backup_buttons_compress_toggle(lv_obj_t *btn)
+{
+	nyx_generic_onoff_toggle(btn);
+
+	emmc_btn_ctxt.compress = !!(lv_btn_get_state(btn) & LV_BTN_STATE_TGL_REL);
+
+	return LV_RES_OK;
+}
+
+static lv_res_t _emmc_backup_buttons_incremental_toggle(lv_obj_t *btn)
+{
+	nyx_generic_onoff_toggle(btn);
+
+	emmc_btn_ctxt.incremental = !!(lv_btn_get_state(btn) & LV_BTN_STATE_TGL_REL);
+
+	return LV_RES_OK;
+}
+
+static lv_res_t _emmc_backup_buttons_chunk_store_toggle(lv_obj_t *btn)
+{
+	nyx_generic_onoff_toggle(btn);
+
+	emmc_btn_ctxt.chunk_store = !!(lv_btn_get_state(btn) & LV_BTN_STATE_TGL_REL);
+
+	return LV_RES_OK;
+}
+
 lv_res_t create_window_backup_restore_tool(lv_obj_t *btn)
 {
 	lv_obj_t *win;
@@ -465,5 +498,29 @@ lv_res_t create_window_backup_restore_tool(lv_obj_t *btn)
 		sd_emummc_raw, SYMBOL_SD" SD emuMMC Raw Partition", _emmc_backup_buttons_raw_toggle, false);
 	emmc_btn_ctxt.raw_emummc = false;
 
+	// Create Compress On/Off button. Restore detects compressed backups.
+	if (!emmc_btn_ctxt.restore)
+	{
+		lv_obj_t *btn_compress = lv_btn_create(h3, NULL);
+		nyx_create_onoff_button(lv_theme_get_current(), h3,
+			btn_compress, SYMBOL_SAVE" Compressed Backup (LZ4)", _emmc_backup_buttons_compress_toggle, false);
+		lv_obj_align(btn_compress, sd_emummc_raw, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 0);
+
+		// Create Incremental On/Off button. Implies compressed.
+		lv_obj_t *btn_incremental = lv_btn_create(h3, NULL);
+		nyx_create_onoff_button(lv_theme_get_current(), h3,
+			btn_incremental, SYMBOL_REFRESH" Incremental Backup", _emmc_backup_buttons_incremental_toggle, false);
+		lv_obj_align(btn_incremental, btn_compress, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 0);
+
+		// Create Chunk Store On/Off button. Implies compressed.
+		lv_obj_t *btn_chunk_store = lv_btn_create(h3, NULL);
+		nyx_create_onoff_button(lv_theme_get_current(), h3,
+			btn_chunk_store, SYMBOL_COPY" Shared Chunk Store", _emmc_backup_buttons_chunk_store_toggle, false);
+		lv_obj_align(btn_chunk_store, btn_incremental, LV_ALIGN_OUT_BOTTOM_LEFT, 0, 0);
+	}
+	emmc_btn_ctxt.compress = false;
+	emmc_btn_ctxt.incremental = false;
+	emmc_btn_ctxt.chunk_store = false;
+
 	return LV_RES_OK;
 }
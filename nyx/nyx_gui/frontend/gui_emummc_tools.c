@@ -33,6 +33,7 @@ typedef struct _mbr_ctxt_t
 
 	int part_idx;
 	u32 sector_start;
+	bool fast;
 } mbr_ctxt_t;
 
 static bool emummc_backup;
@@ -134,7 +135,7 @@ static void _create_window_emummc()
 	if (!mbr_ctx.part_idx)
 		dump_emummc_file(&emmc_tool_gui_ctxt);
 	else
-		dump_emummc_raw(&emmc_tool_gui_ctxt, mbr_ctx.part_idx, mbr_ctx.sector_start, mbr_ctx.resized_cnt[mbr_ctx.part_idx - 1]);
+		dump_emummc_raw(&emmc_tool_gui_ctxt, mbr_ctx.part_idx, mbr_ctx.sector_start, mbr_ctx.resized_cnt[mbr_ctx.part_idx - 1], mbr_ctx.fast);
 
 	nyx_window_toggle_buttons(win, false);
 }
@@ -156,6 +157,50 @@ static lv_res_t _create_emummc_raw_format(lv_obj_t * btns, const char * txt)
 	return LV_RES_INV;
 }
 
+static lv_res_t _create_emummc_raw_mode_action(lv_obj_t * btns, const char * txt)
+{
+	int btn_idx = lv_btnm_get_pressed(btns);
+	lv_obj_t *bg = lv_obj_get_parent(lv_obj_get_parent(btns));
+
+	if (btn_idx < 2)
+	{
+		mbr_ctx.fast = btn_idx == 1;
+		lv_obj_set_style(bg, &lv_style_transp);
+		_create_window_emummc();
+	}
+
+	mbr_ctx.part_idx = 0;
+	mbr_ctx.sector_start = 0;
+	mbr_ctx.fast = false;
+
+	nyx_mbox_action(btns, txt);
+
+	return LV_RES_INV;
+}
+
+static void _create_mbox_emummc_raw_mode()
+{
+	lv_obj_t *dark_bg = lv_obj_create(lv_scr_act(), NULL);
+	lv_obj_set_style(dark_bg, &mbox_darken);
+	lv_obj_set_size(dark_bg, LV_HOR_RES, LV_VER_RES);
+
+	static const char *mbox_btn_map[] = { "\222Full", "\222Fast", "\222Cancel", "" };
+	lv_obj_t * mbox = lv_mbox_create(dark_bg, NULL);
+	lv_mbox_set_recolor_text(mbox, true);
+	lv_obj_set_width(mbox, LV_HOR_RES / 9 * 5);
+
+	lv_mbox_set_text(mbox,
+		"#C7EA46 Choose how USER partition is copied:#\n\n"
+		"#FF8000 Full:# Copies everything.\n"
+		"#FF8000 Fast:# Copies only the used space.\n"
+		"Needs BIS keys. Unused space is not written.");
+
+	lv_mbox_add_btns(mbox, mbox_btn_map, _create_emummc_raw_mode_action);
+
+	lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
+	lv_obj_set_top(mbox, true);
+}
+
 static lv_res_t _create_emummc_raw_action(lv_obj_t * btns, const char * txt)
 {
 	int btn_idx = lv_btnm_get_pressed(btns);
@@ -183,6 +228,15 @@ static lv_res_t _create_emummc_raw_action(lv_obj_t * btns, const char * txt)
 
 	if (btn_idx < 3)
 	{
+		// USER partition is copied as is. Choose how.
+		if (!mbr_ctx.resized_cnt[mbr_ctx.part_idx - 1])
+		{
+			_create_mbox_emummc_raw_mode();
+			nyx_mbox_action(btns, txt);
+
+			return LV_RES_INV;
+		}
+
 		lv_obj_set_style(bg, &lv_style_transp);
 		_create_window_emummc();
 	}
@@ -909,8 +963,7 @@ static lv_res_t _create_change_emummc_window(lv_obj_t *btn_caller)
 
 		if (!f_stat(path, NULL))
 		{
-			char *tmp = emummc_img->dirlist->name[emummc_idx];
-			memcpy(emummc_img->dirlist->name[file_based_idx], tmp, strlen(tmp) + 1);
+			emummc_img->dirlist->name[file_based_idx] = emummc_img->dirlist->name[emummc_idx];
 			file_based_idx++;
 		}
 		emummc_idx++;
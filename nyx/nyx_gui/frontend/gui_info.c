@@ -1630,6 +1630,87 @@ out:
 
 static lv_obj_t *bench_sd_err_label = NULL;
 
+#define BENCH_SCRATCH_PATH "bootloader/bench.tmp"
+
+typedef struct _bench_ui_t
+{
+	lv_obj_t *bar;
+	u32 test;
+	u32 tests;
+	u32 render_timer;
+} bench_ui_t;
+
+static int _bench_progress(void *data, u32 pct)
+{
+	bench_ui_t *ui = (bench_ui_t *)data;
+
+	if (ui->render_timer > get_tmr_ms())
+		return 0;
+
+	lv_bar_set_value(ui->bar, (ui->test * 100 + pct) / ui->tests);
+	manual_system_maintenance(true);
+	ui->render_timer = get_tmr_ms() + 66;
+
+	return btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN);
+}
+
+// Uses the largest contiguous part of a temporary file as a writable region.
+static int _bench_sd_scratch(u32 *sector, u32 *count)
+{
+	FIL fp;
+	DWORD free_clst;
+	FATFS *fs;
+
+	if (f_getfree("", &free_clst, &fs))
+		return 1;
+
+	u64 size = MIN((u64)free_clst * fs->csize * SDMMC_DAT_BLOCKSIZE / 2, SZ_1G);
+	size = ALIGN_DOWN(size, SZ_4M);
+	if (size < SZ_128M)
+		return 1;
+
+	if (f_open(&fp, BENCH_SCRATCH_PATH, FA_CREATE_ALWAYS | FA_WRITE))
+		return 1;
+
+	DWORD *clmt = f_alloc_cltbl(&fp, SZ_4M, size);
+	if (!clmt)
+	{
+		f_close(&fp);
+		f_unlink(BENCH_SCRATCH_PATH);
+
+		return 1;
+	}
+
+	DWORD clst = 0;
+	DWORD nclst = 0;
+	for (DWORD *tbl = clmt + 1; tbl[0]; tbl += 2)
+	{
+		if (tbl[0] > nclst)
+		{
+			nclst = tbl[0];
+			clst  = tbl[1];
+		}
+	}
+
+	// Align to 4MB, so that it starts at an allocation unit.
+	u32 start = f_clst2sect(&fp, clst);
+	u32 end = start + MIN((u64)nclst * fs->csize, size / SDMMC_DAT_BLOCKSIZE);
+	*sector = ALIGN(start, SDMMC_BENCH_BLK_MAX);
+	*count = end > *sector ? end - *sector : 0;
+
+	f_close(&fp);
+	free(clmt);
+
+	if (*count < SDMMC_BENCH_BLK_MAX)
+	{
+		f_unlink(BENCH_SCRATCH_PATH);
+
+		return 1;
+	}
+
+	return 0;
+}
+
 static lv_res_t _create_mbox_benchmark(bool sd_bench)
 {
 	sdmmc_storage_t *storage;
@@ -1641,14 +1722,17 @@ static lv_res_t _create_mbox_benchmark(bool sd_bench)
 	static const char * mbox_btn_map[] = { "\251", "\222OK", "\251", "" };
 	lv_obj_t * mbox = lv_mbox_create(dark_bg, NULL);
 	lv_mbox_set_recolor_text(mbox, true);
-	lv_obj_set_width(mbox, LV_HOR_RES * 3 / 7);
+	lv_obj_set_width(mbox, LV_HOR_RES * 4 / 7);
 
 	char *txt_buf = (char *)malloc(SZ_16K);
+	char *csv_buf = (char *)malloc(SZ_16K);
+	bool scratch = false;
 
-	s_printf(txt_buf, "#FF8000 %s Benchmark#\n[Raw Reads] Abort: VOL- & VOL+", sd_bench ? "SD Card" : "eMMC");
+	s_printf(txt_buf, "#FF8000 %s Benchmark#\n[Raw] Abort: VOL- & VOL+", sd_bench ? "SD Card" : "eMMC");
 
 	lv_mbox_set_text(mbox, txt_buf);
 	txt_buf[0] = 0;
+	csv_buf[0] = 0;
 
 	lv_obj_t *h1 = lv_cont_create(mbox, NULL);
 	lv_cont_set_fit(h1, false, true);
@@ -1694,237 +1778,101 @@ static lv_res_t _create_mbox_benchmark(bool sd_bench)
 		goto out;
 	}
 
-	// Set benchmark parameters.
-	const u32 sct_blk_seq = 0x8000;   // 16MB.  A2 spec denotes 4MB, but using older big AU.
-	const u32 sct_blk_4kb = 8;        // 4KB.
-	const u32 sct_rem_seq = 0x200000; // 1GB.   A2 spec.
-	const u32 sct_rem_4kb = 0x80000;  // 256MB. A2 spec.
-	const u32 sct_num_1mb = 0x800;    // 1MB.
-	const u32 size_bytes_seq = sct_rem_seq * SDMMC_DAT_BLOCKSIZE;
-	const u32 size_bytes_4kb = sct_rem_4kb * SDMMC_DAT_BLOCKSIZE;
+	sdmmc_bench_t bench = {0};
+	bench_ui_t ui = {0};
+	char device[32];
+	char name[SDMMC_BENCH_NAME_SZ];
+	char prod_name[8] = {0};
 
-	// Set calculation divider. 1000 or 1024. (Does not affect IOPS).
-	u32 mb_div = 1000; // Unfortunately most software uses fake MB.
+	memcpy(prod_name, storage->cid.prod_name, sd_bench ? 5 : 6);
+	s_printf(device, "%s %02X %s %08X", sd_bench ? "SD" : "eMMC", storage->cid.manfid, prod_name, storage->cid.serial);
 
-	char *mbs_text;
-	switch (mb_div)
+	// Writes are only done on SD, inside a temporary file. Reads only for eMMC.
+	if (sd_bench && !_bench_sd_scratch(&bench.sector, &bench.count))
 	{
-	case 1000:
-		mbs_text = "MB/s";
-		break;
-	case 1024:
-		mbs_text = "MiB/s";
-		break;
+		scratch = true;
+		bench.writable = true;
+	}
+	else
+	{
+		bench.sector = ALIGN_DOWN(storage->sec_cnt / 3, SDMMC_BENCH_BLK_MAX);
+		bench.count  = MIN(storage->sec_cnt - bench.sector, SZ_1G / SDMMC_DAT_BLOCKSIZE);
 	}
 
-	// Set actual div in MB/MiB.
-	mb_div *= mb_div;
-
-	int error = 0;
-	u32 iters = 3;
-	u32 offset_chunk_start = ALIGN_DOWN(storage->sec_cnt / 3, sct_blk_seq); // Align to block.
-	if (storage->sec_cnt < 0xC00000)
-		iters -= 2; // 4GB card.
-
-	u32  rnd_off_cnt    = sct_rem_4kb / sct_blk_4kb;
-	u32 *random_offsets = malloc(rnd_off_cnt * sizeof(u32));
-	u32 *times_taken_4k = malloc(rnd_off_cnt * sizeof(u32));
-
-	for (u32 iter_curr = 0; iter_curr < iters; iter_curr++)
-	{
-		u32 pct = 0;
-		u32 prevPct = 200;
-		u32 timer = 0;
-		u32 lba_curr = 0;
-		u32 sector_off = offset_chunk_start * iter_curr;
-		u32 sector_num = sct_blk_seq;
-		u32 data_remaining = sct_rem_seq;
-
-		s_printf(txt_buf + strlen(txt_buf), "#C7EA46 %d/3# - Sector Offset #C7EA46 %08X#:\n", iter_curr + 1, sector_off);
-
-		u32 render_min_ms = 66;
-		u32 render_timer  = get_tmr_ms() + render_min_ms;
-		while (data_remaining)
-		{
-			u32 time_taken = get_tmr_us();
-			error = sdmmc_storage_read(storage, sector_off + lba_curr, sector_num, (u8 *)MIXD_BUF_ALIGNED);
-			time_taken = get_tmr_us() - time_taken;
-			timer += time_taken;
-
-			manual_system_maintenance(false);
-			data_remaining -= sector_num;
-			lba_curr += sector_num;
-
-			pct = (lba_curr * 100) / sct_rem_seq;
-			if (pct != prevPct && render_timer < get_tmr_ms())
-			{
-				lv_bar_set_value(bar, pct);
-				manual_system_maintenance(true);
-				render_timer = get_tmr_ms() + render_min_ms;
-
-				prevPct = pct;
-
-				if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
-					error = -1;
-			}
-
-			if (error)
-				goto error;
-		}
-		lv_bar_set_value(bar, 100);
-
-		// Calculate rate for transfer.
-		u32 rate_1k = (u64)size_bytes_seq * 1000 * 1000 * 1000 / mb_div / timer;
-		s_printf(txt_buf + strlen(txt_buf), " SEQ 16MB - Rate: #C7EA46 %3d.%02d %s#",
-			rate_1k / 1000, (rate_1k % 1000) / 10, mbs_text);
-		lv_label_set_text(lbl_status, txt_buf);
-		lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
-		lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
-		manual_system_maintenance(true);
-
-		pct = 0;
-		prevPct = 200;
-		timer = 0;
-		lba_curr = 0;
-		sector_num = sct_blk_4kb;
-		data_remaining = sct_rem_4kb;
-
-		u32 loop_idx = 0;
-		render_timer = get_tmr_ms() + render_min_ms;
-		while (data_remaining)
-		{
-			u32 time_taken = get_tmr_us();
-			error = sdmmc_storage_read(storage, sector_off + lba_curr, sector_num, (u8 *)MIXD_BUF_ALIGNED);
-			time_taken = get_tmr_us() - time_taken;
+	bench.storage  = storage;
+	bench.buf      = (u8 *)MIXD_BUF_ALIGNED;
+	bench.lat      = (u32 *)malloc(SDMMC_BENCH_OPS_MAX * sizeof(u32));
+	bench.progress = _bench_progress;
+	bench.data     = &ui;
+
+	ui.bar = bar;
+	for (u32 i = 0; i < sdmmc_bench_suite_cnt; i++)
+		if (bench.writable || !sdmmc_bench_suite[i].write_pct)
+			ui.tests++;
+
+	s_printf(txt_buf, "Region #C7EA46 %08X# - #C7EA46 %d MiB#%s\n\n", bench.sector, bench.count >> 11,
+		bench.writable ? "" : " (Read only)");
+	s_printf(txt_buf + strlen(txt_buf), " Test                      Rate   IOPS    #C7EA46 p50#    #FFDD00 p99#    #FF3C28 max#\n");
+	lv_label_set_text(lbl_status, txt_buf);
+	lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
+	lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
+	manual_system_maintenance(true);
 
-			timer += time_taken;
-			times_taken_4k[loop_idx++] = time_taken;
+	strcpy(csv_buf, SDMMC_BENCH_CSV_HDR);
 
-			manual_system_maintenance(false);
-			data_remaining -= sector_num;
-			lba_curr += sector_num;
+	int error = 0;
+	for (u32 i = 0; i < sdmmc_bench_suite_cnt; i++)
+	{
+		const sdmmc_bench_test_t *test = &sdmmc_bench_suite[i];
+		sdmmc_bench_res_t result;
 
-			pct = (lba_curr * 100) / sct_rem_4kb;
-			if (pct != prevPct && render_timer < get_tmr_ms())
-			{
-				lv_bar_set_value(bar, pct);
-				manual_system_maintenance(true);
-				render_timer = get_tmr_ms() + render_min_ms;
+		if (!bench.writable && test->write_pct)
+			continue;
 
-				prevPct = pct;
+		error = sdmmc_bench_run(&bench, test, &result);
+		if (error)
+			break;
+		ui.test++;
 
-				if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
-					error = -1;
-			}
+		sdmmc_bench_name(name, test);
+		s_printf(txt_buf + strlen(txt_buf), " %.17s #C7EA46 %4d.%02d MB/s# %6d #C7EA46 %6d# #FFDD00 %6d# #FF3C28 %6d#\n",
+			name, result.rate_kbs / 1000, (result.rate_kbs % 1000) / 10, result.iops,
+			result.lat_p50, result.lat_p99, result.lat_max);
+		sdmmc_bench_csv(csv_buf + strlen(csv_buf), device, test, &result);
 
-			if (error)
-				goto error;
-		}
-		lv_bar_set_value(bar, 100);
-
-		qsort(times_taken_4k, loop_idx, sizeof(u32), qsort_compare_int); // Use int for faster compare. Value can't exceed 2s.
-
-		u32 pct95 = 0;
-		for (u32 i = 0; i < loop_idx * 95 / 100; i++)
-			pct95 += times_taken_4k[i];
-		pct95 /= loop_idx * 95 / 100;
-
-		u32 pct05 = 0;
-		for (u32 i = 0; i < loop_idx * 5 / 100; i++)
-			pct05 += times_taken_4k[loop_idx - 1 - i];
-		pct05 /= loop_idx * 5 / 100;
-
-		// Calculate rate and IOPS for transfer.
-		rate_1k = (u64)size_bytes_4kb * 1000 * 1000 * 1000 / mb_div / timer;
-		u32 iops = ((u64)(sct_rem_4kb / sct_num_1mb) * 1024 * 1000 * 1000 * 1000) / (4096 / 1024) / timer / 1000;
-		s_printf(txt_buf + strlen(txt_buf), "        AVG #C7EA46 95th#  #FF3C28 5th#\n");
-		s_printf(txt_buf + strlen(txt_buf), " SEQ  4KB - Rate: #C7EA46 %3d.%02d %s# IOPS: #C7EA46 %4d# %4d %4d \n",
-			rate_1k / 1000, (rate_1k % 1000) / 10, mbs_text, iops, 1000000 / pct95, 1000000 / pct05);
 		lv_label_set_text(lbl_status, txt_buf);
 		lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
 		lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
 		manual_system_maintenance(true);
+	}
+	lv_bar_set_value(bar, 100);
 
-		u32 lba_idx = 0;
-		u32 random_numbers[4];
-		for (u32 i = 0; i < rnd_off_cnt; i += 4)
-		{
-			// Generate new random numbers.
-			while (se_rng_pseudo(random_numbers, SE_RNG_BLOCK_SIZE))
-				;
-			// Clamp offsets to 256MB range.
-			random_offsets[i + 0] = random_numbers[0] % sct_rem_4kb;
-			random_offsets[i + 1] = random_numbers[1] % sct_rem_4kb;
-			random_offsets[i + 2] = random_numbers[2] % sct_rem_4kb;
-			random_offsets[i + 3] = random_numbers[3] % sct_rem_4kb;
-		}
-
-		pct = 0;
-		prevPct = 200;
-		timer = 0;
-		data_remaining = sct_rem_4kb;
-
-		loop_idx = 0;
-		render_timer = get_tmr_ms() + render_min_ms;
-		while (data_remaining)
-		{
-			u32 time_taken = get_tmr_us();
-			error = sdmmc_storage_read(storage, sector_off + random_offsets[lba_idx], sector_num, (u8 *)MIXD_BUF_ALIGNED);
-			time_taken = get_tmr_us() - time_taken;
-
-			timer += time_taken;
-			times_taken_4k[loop_idx++] = time_taken;
-
-			manual_system_maintenance(false);
-			data_remaining -= sector_num;
-			lba_idx++;
-
-			pct = (lba_idx * 100) / rnd_off_cnt;
-			if (pct != prevPct && render_timer < get_tmr_ms())
-			{
-				lv_bar_set_value(bar, pct);
-				manual_system_maintenance(true);
-				render_timer = get_tmr_ms() + render_min_ms;
+	free(bench.lat);
 
-				prevPct = pct;
+	if (scratch)
+		f_unlink(BENCH_SCRATCH_PATH);
 
-				if (btn_read_vol() == (BTN_VOL_UP | BTN_VOL_DOWN))
-					error = -1;
-			}
+	// Export results.
+	if (ui.test)
+	{
+		char path[128];
+		char csv_name[32];
 
-			if (error)
-				goto error;
-		}
-		lv_bar_set_value(bar, 100);
-
-		qsort(times_taken_4k, loop_idx, sizeof(u32), qsort_compare_int); // Use int for faster compare. Value can't exceed 2s.
-
-		pct95 = 0;
-		for (u32 i = 0; i < loop_idx * 95 / 100; i++)
-			pct95 += times_taken_4k[i];
-		pct95 /= loop_idx * 95 / 100;
-
-		pct05 = 0;
-		for (u32 i = 0; i < loop_idx * 5 / 100; i++)
-			pct05 += times_taken_4k[loop_idx - 1 - i];
-		pct05 /= loop_idx * 5 / 100;
-
-		// Calculate rate and IOPS for transfer.
-		rate_1k = (u64)size_bytes_4kb * 1000 * 1000 * 1000 / mb_div / timer;
-		iops = ((u64)(sct_rem_4kb / sct_num_1mb) * 1024 * 1000 * 1000 * 1000) / (4096 / 1024) / timer / 1000;
-		s_printf(txt_buf + strlen(txt_buf), " RND  4KB - Rate: #C7EA46 %3d.%02d %s# IOPS: #C7EA46 %4d# %4d %4d \n",
-			rate_1k / 1000, (rate_1k % 1000) / 10, mbs_text, iops, 1000000 / pct95, 1000000 / pct05);
-		if (iter_curr == iters - 1)
-			txt_buf[strlen(txt_buf) - 1] = 0; // Cut off last new line.
-		lv_label_set_text(lbl_status, txt_buf);
-		lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
-		lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
-		manual_system_maintenance(true);
+		if (sd_bench)
+			s_printf(csv_name, "bench_sd_%08X.csv", storage->cid.serial);
+		else
+			strcpy(csv_name, "bench_emmc.csv");
+
+		if (!sd_bench)
+			sd_mount();
+		emmcsn_path_impl(path, "/dumps", csv_name, NULL);
+		if (!sd_save_to_file(csv_buf, strlen(csv_buf), path))
+			s_printf(txt_buf + strlen(txt_buf), "\nSaved to: #C7EA46 %s#", path);
+		if (!sd_bench)
+			sd_unmount();
 	}
-
-error:
-	free(random_offsets);
-	free(times_taken_4k);
+	else
+		txt_buf[strlen(txt_buf) - 1] = 0; // Cut off last new line.
 
 	if (error)
 	{
@@ -1932,15 +1880,13 @@ error:
 			s_printf(txt_buf + strlen(txt_buf), "\n#FFDD00                      Aborted!                     #");
 		else
 			s_printf(txt_buf + strlen(txt_buf), "\n#FFDD00                 IO Error occurred!                #");
-
-		lv_label_set_text(lbl_status, txt_buf);
-		lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
 	}
 
+	lv_label_set_text(lbl_status, txt_buf);
+	lv_obj_align(lbl_status, NULL, LV_ALIGN_CENTER, 0, 0);
+
 	lv_obj_del(bar);
 
-	if (sd_bench && error && error != -1)
-		sd_end();
 	if (sd_bench)
 	{
 		if (error && error != -1)
@@ -1952,7 +1898,7 @@ error:
 		emmc_end();
 
 out:
-	s_printf(txt_buf, "#FF8000 %s Benchmark#\n[Raw Reads]", sd_bench ? "SD Card" : "eMMC");
+	s_printf(txt_buf, "#FF8000 %s Benchmark#\n[Raw]", sd_bench ? "SD Card" : "eMMC");
 	lv_mbox_set_text(mbox, txt_buf);
 
 	// Update SDMMC error info in case it changed.
@@ -1967,6 +1913,7 @@ out:
 	}
 
 	free(txt_buf);
+	free(csv_buf);
 
 	lv_mbox_add_btns(mbox, mbox_btn_map, nyx_mbox_action); // Important. After set_text.
 	lv_obj_align(mbox, NULL, LV_ALIGN_CENTER, 0, 0);
@@ -3122,7 +3069,7 @@ void create_tab_info(lv_theme_t *th, lv_obj_t *parent)
 	lv_label_set_recolor(label_txt5, true);
 	lv_label_set_static_text(label_txt5,
 		"View info about the eMMC or microSD and their partition list.\n"
-		"Additionally you can benchmark read speeds.");
+		"Additionally you can benchmark their speeds.");
 	lv_obj_set_style(label_txt5, &hint_small_style);
 	lv_obj_align(label_txt5, btn5, LV_ALIGN_OUT_BOTTOM_LEFT, 0, LV_DPI / 3);
 
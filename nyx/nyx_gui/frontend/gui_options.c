@@ -1620,7 +1620,8 @@ lv_res_t create_win_nyx_options(lv_obj_t *parrent_btn)
 		"Off (Fastest)\n"
 		"Sparse (Fast)    \n"
 		"Full (Slow)\n"
-		"Full (Hashes)");
+		"Full (Hashes)\n"
+		"Full (Manifest)");
 	lv_ddlist_set_selected(ddlist2, n_cfg.verification);
 	lv_obj_align(ddlist2, label_txt, LV_ALIGN_OUT_RIGHT_MID, LV_DPI * 3 / 8, 0);
 	lv_ddlist_set_action(ddlist2, _data_verification_action);
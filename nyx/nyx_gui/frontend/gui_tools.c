@@ -200,7 +200,9 @@ static lv_res_t _create_mbox_hid(usb_ctxt_t *usbs)
 
 	lv_obj_t *lbl_tip = lv_label_create(mbox, NULL);
 	lv_label_set_recolor(lbl_tip, true);
-	lv_label_set_static_text(lbl_tip, "Note: To end it, press #C7EA46 L3# + #C7EA46 HOME# or remove the cable.");
+	lv_label_set_static_text(lbl_tip,
+		"Note: To end it, press #C7EA46 L3# + #C7EA46 HOME# or remove the cable.\n"
+		"Press #C7EA46 CAPTURE# to toggle report rate and latency.");
 	lv_obj_set_style(lbl_tip, &hint_small_style);
 
 	lv_mbox_add_btns(mbox, mbox_btn_map_dis, nyx_mbox_action);
@@ -215,6 +217,118 @@ static lv_res_t _create_mbox_hid(usb_ctxt_t *usbs)
 	return LV_RES_OK;
 }
 
+typedef struct _ums_stats_gui_t
+{
+	lv_obj_t *chart;
+	lv_chart_series_t *ser_rd;
+	lv_chart_series_t *ser_wr;
+	lv_obj_t *label;
+	char txt_buf[256];
+	u32 range;
+
+	// Totals at the previous update.
+	u32 time_ms;
+	u32 cmds;
+	u64 rd_bytes;
+	u64 wr_bytes;
+	u64 wait_us[USB_UMS_WAIT_MAX];
+} ums_stats_gui_t;
+
+static ums_stats_gui_t *ums_stats_gui;
+
+static void _ums_stats_update(usb_ums_stats_t *stats)
+{
+	ums_stats_gui_t *gui = ums_stats_gui;
+
+	u32 ms = stats->time_ms - gui->time_ms;
+	if (!ms)
+		return;
+
+	// Bytes per ms are KB/s.
+	u32 rd_kbs = (stats->rd_bytes - gui->rd_bytes) / ms;
+	u32 wr_kbs = (stats->wr_bytes - gui->wr_bytes) / ms;
+	u32 iops   = (stats->cmds - gui->cmds) * 1000 / ms;
+
+	// Share of the time spent waiting on each side.
+	u32 pct[USB_UMS_WAIT_MAX];
+	for (u32 i = 0; i < USB_UMS_WAIT_MAX; i++)
+	{
+		pct[i] = (stats->wait_us[i] - gui->wait_us[i]) / (ms * 10);
+		pct[i] = MIN(pct[i], 100);
+		gui->wait_us[i] = stats->wait_us[i];
+	}
+
+	gui->time_ms  = stats->time_ms;
+	gui->cmds     = stats->cmds;
+	gui->rd_bytes = stats->rd_bytes;
+	gui->wr_bytes = stats->wr_bytes;
+
+	// Grow the range to fit the peak.
+	u32 peak = MAX(rd_kbs, wr_kbs) / 1000;
+	if (peak >= gui->range)
+	{
+		gui->range = ALIGN(peak + 1, 25);
+		lv_chart_set_range(gui->chart, 0, gui->range);
+	}
+
+	lv_chart_set_next(gui->chart, gui->ser_rd, rd_kbs / 1000);
+	lv_chart_set_next(gui->chart, gui->ser_wr, wr_kbs / 1000);
+
+	s_printf(gui->txt_buf,
+		"#C7EA46 Read:# %d.%02d MB/s  #FF8000 Write:# %d.%02d MB/s  #C7EA46 IOPS:# %d\n"
+		"#C7EA46 Wait:# Host %d%%, USB %d%%, Storage %d%%  #C7EA46 Max latency:# %d ms",
+		rd_kbs / 1000, (rd_kbs % 1000) / 10, wr_kbs / 1000, (wr_kbs % 1000) / 10, iops,
+		pct[USB_UMS_WAIT_HOST], pct[USB_UMS_WAIT_USB], pct[USB_UMS_WAIT_SDMMC], stats->lat_max_us / 1000);
+	lv_label_set_text(gui->label, gui->txt_buf);
+
+	manual_system_maintenance(true);
+}
+
+// Long format CSV. Session totals, then per SCSI opcode and the latency histogram.
+static void _ums_stats_export(usb_ums_stats_t *stats, char *path)
+{
+	static const char *wait_names[USB_UMS_WAIT_MAX] = { "host", "usb", "sdmmc" };
+
+	char *csv_buf = (char *)malloc(SZ_16K);
+
+	strcpy(csv_buf, "metric,key,value\n");
+	s_printf(csv_buf + strlen(csv_buf), "session,time_ms,%d\nsession,cmds,%d\n", stats->time_ms, stats->cmds);
+	s_printf(csv_buf + strlen(csv_buf), "session,rd_kb,%d\nsession,wr_kb,%d\n",
+		(u32)(stats->rd_bytes / SZ_1K), (u32)(stats->wr_bytes / SZ_1K));
+	s_printf(csv_buf + strlen(csv_buf), "session,lat_max_us,%d\n", stats->lat_max_us);
+	for (u32 i = 0; i < USB_UMS_WAIT_MAX; i++)
+		s_printf(csv_buf + strlen(csv_buf), "wait_ms,%s,%d\n", wait_names[i], (u32)(stats->wait_us[i] / 1000));
+
+	for (u32 i = 0; i < 256; i++)
+	{
+		if (!stats->op_cmds[i])
+			continue;
+
+		s_printf(csv_buf + strlen(csv_buf), "op_cmds,%02X,%d\nop_kb,%02X,%d\n",
+			i, stats->op_cmds[i], i, (u32)(stats->op_bytes[i] / SZ_1K));
+	}
+
+	// Keyed by the upper bound. The last bucket has none.
+	for (u32 i = 0; i < USB_UMS_LAT_BUCKETS; i++)
+	{
+		if (i < USB_UMS_LAT_BUCKETS - 1)
+			s_printf(csv_buf + strlen(csv_buf), "lat_us,%d,%d\n", 64 << i, stats->lat_hist[i]);
+		else
+			s_printf(csv_buf + strlen(csv_buf), "lat_us,max,%d\n", stats->lat_hist[i]);
+	}
+
+	path[0] = 0;
+	if (!sd_mount())
+	{
+		emmcsn_path_impl(path, "/dumps", "ums_stats.csv", NULL);
+		if (sd_save_to_file(csv_buf, strlen(csv_buf), path))
+			path[0] = 0;
+		sd_unmount();
+	}
+
+	free(csv_buf);
+}
+
 static lv_res_t _create_mbox_ums(usb_ctxt_t *usbs)
 {
 	lv_obj_t *dark_bg = lv_obj_create(lv_scr_act(), NULL);
@@ -230,37 +344,61 @@ static lv_res_t _create_mbox_ums(usb_ctxt_t *usbs)
 
 	s_printf(txt_buf, "#FF8000 USB Mass Storage#\n\n#C7EA46 Device:# ");
 
-	if (usbs->type == MMC_SD)
+	bool sd_rw = false;
+	bool emmc_rw = false;
+	for (u32 i = 0; i < usbs->lun_cnt; i++)
 	{
-		switch (usbs->partition)
+		usb_ums_lun_t *lun = &usbs->lun[i];
+
+		if (i)
+			strcat(txt_buf, ", ");
+
+		if (lun->bis)
 		{
-		case 0:
-			strcat(txt_buf, "SD Card");
-			break;
-		case EMMC_GPP + 1:
-			strcat(txt_buf, "emuMMC GPP");
-			break;
-		case EMMC_BOOT0 + 1:
-			strcat(txt_buf, "emuMMC BOOT0");
-			break;
-		case EMMC_BOOT1 + 1:
-			strcat(txt_buf, "emuMMC BOOT1");
-			break;
+			strcat(txt_buf, lun->type == MMC_SD ? "emuMMC " : "eMMC ");
+			strcat(txt_buf, nx_emmc_bis_part_name(lun->bis));
+
+			if (lun->type == MMC_SD)
+				sd_rw |= !lun->ro;
+			else
+				emmc_rw |= !lun->ro;
 		}
-	}
-	else
-	{
-		switch (usbs->partition)
+		else if (lun->type == MMC_SD)
 		{
-		case EMMC_GPP + 1:
-			strcat(txt_buf, "eMMC GPP");
-			break;
-		case EMMC_BOOT0 + 1:
-			strcat(txt_buf, "eMMC BOOT0");
-			break;
-		case EMMC_BOOT1 + 1:
-			strcat(txt_buf, "eMMC BOOT1");
-			break;
+			switch (lun->partition)
+			{
+			case 0:
+				strcat(txt_buf, "SD Card");
+				break;
+			case EMMC_GPP + 1:
+				strcat(txt_buf, "emuMMC GPP");
+				break;
+			case EMMC_BOOT0 + 1:
+				strcat(txt_buf, "emuMMC BOOT0");
+				break;
+			case EMMC_BOOT1 + 1:
+				strcat(txt_buf, "emuMMC BOOT1");
+				break;
+			}
+
+			sd_rw |= !lun->ro;
+		}
+		else
+		{
+			switch (lun->partition)
+			{
+			case EMMC_GPP + 1:
+				strcat(txt_buf, "eMMC GPP");
+				break;
+			case EMMC_BOOT0 + 1:
+				strcat(txt_buf, "eMMC BOOT0");
+				break;
+			case EMMC_BOOT1 + 1:
+				strcat(txt_buf, "eMMC BOOT1");
+				break;
+			}
+
+			emmc_rw |= !lun->ro;
 		}
 	}
 
@@ -272,11 +410,36 @@ static lv_res_t _create_mbox_ums(usb_ctxt_t *usbs)
 	lv_label_set_text(lbl_status, " ");
 	usbs->label = (void *)lbl_status;
 
+	// Live throughput of the last minute.
+	ums_stats_gui = (ums_stats_gui_t *)zalloc(sizeof(ums_stats_gui_t));
+	usbs->stats = (usb_ums_stats_t *)zalloc(sizeof(usb_ums_stats_t));
+	usbs->stats_update = _ums_stats_update;
+
+	lv_obj_t *chart = lv_chart_create(mbox, NULL);
+	lv_obj_set_size(chart, LV_HOR_RES / 9 * 4, LV_DPI * 3 / 2);
+	lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+	lv_chart_set_point_count(chart, 60);
+	lv_chart_set_div_line_count(chart, 3, 0);
+	lv_chart_set_series_width(chart, 2);
+	ums_stats_gui->range  = 25;
+	lv_chart_set_range(chart, 0, ums_stats_gui->range);
+	ums_stats_gui->chart  = chart;
+	ums_stats_gui->ser_rd = lv_chart_add_series(chart, LV_COLOR_HEX(0xC7EA46));
+	ums_stats_gui->ser_wr = lv_chart_add_series(chart, LV_COLOR_HEX(0xFF8000));
+	lv_chart_init_points(chart, ums_stats_gui->ser_rd, 0);
+	lv_chart_init_points(chart, ums_stats_gui->ser_wr, 0);
+
+	lv_obj_t *lbl_stats = lv_label_create(mbox, NULL);
+	lv_label_set_recolor(lbl_stats, true);
+	lv_label_set_text(lbl_stats, " ");
+	lv_obj_set_style(lbl_stats, &hint_small_style);
+	ums_stats_gui->label = lbl_stats;
+
 	lv_obj_t *lbl_tip = lv_label_create(mbox, NULL);
 	lv_label_set_recolor(lbl_tip, true);
-	if (!usbs->ro)
+	if (sd_rw || emmc_rw)
 	{
-		if (usbs->type == MMC_SD)
+		if (sd_rw)
 		{
 			lv_label_set_static_text(lbl_tip,
 				"Note: To end it, #C7EA46 safely eject# from inside the OS.\n"
@@ -310,6 +473,24 @@ static lv_res_t _create_mbox_ums(usb_ctxt_t *usbs)
 	// Restore backlight.
 	display_backlight_brightness(h_cfg.backlight - 20, 1000);
 
+	// Export the telemetry of the session.
+	if (usbs->stats->cmds)
+	{
+		char path[128];
+		_ums_stats_export(usbs->stats, path);
+		if (path[0])
+		{
+			s_printf(ums_stats_gui->txt_buf + strlen(ums_stats_gui->txt_buf), "\nStats saved to: #C7EA46 %s#", path);
+			lv_label_set_text(lbl_stats, ums_stats_gui->txt_buf);
+		}
+	}
+
+	free(usbs->stats);
+	free(ums_stats_gui);
+	usbs->stats = NULL;
+	usbs->stats_update = NULL;
+	ums_stats_gui = NULL;
+
 	lv_mbox_add_btns(mbox, mbox_btn_map, nyx_mbox_action);
 
 	ums_mbox = dark_bg;
@@ -338,6 +519,18 @@ static lv_res_t _create_mbox_ums_error(int error)
 	case 3:
 		lv_mbox_set_text(mbox, "#FF8000 USB Mass Storage#\n\n#FFFF00 Active emuMMC is not partition based!#");
 		break;
+	case 4:
+		lv_mbox_set_text(mbox, "#FF8000 USB Mass Storage#\n\n#FFFF00 BIS keys validation failed!#");
+		break;
+	case 5:
+		lv_mbox_set_text(mbox, "#FF8000 USB Mass Storage#\n\n#FFFF00 No HOS partitions found!#");
+		break;
+	case 6:
+		lv_mbox_set_text(mbox, "#FF8000 USB Mass Storage#\n\n#FFFF00 Failed to init eMMC!#");
+		break;
+	case 7:
+		lv_mbox_set_text(mbox, "#FF8000 USB Mass Storage#\n\n#FFFF00 Failed to map emuMMC files!#");
+		break;
 	}
 
 	lv_mbox_add_btns(mbox, mbox_btn_map, nyx_mbox_action);
@@ -364,6 +557,7 @@ static lv_res_t _action_hid_jc(lv_obj_t *btn)
 
 	usb_ctxt_t usbs;
 	usbs.type = USB_HID_GAMEPAD;
+	usbs.latency = 0;
 	usbs.system_maintenance = &manual_system_maintenance;
 	usbs.set_text = &usb_gadget_set_text;
 
@@ -388,6 +582,7 @@ static lv_res_t _action_hid_touch(lv_obj_t *btn)
 
 	usb_ctxt_t usbs;
 	usbs.type = USB_HID_TOUCHPAD;
+	usbs.latency = 0;
 	usbs.system_maintenance = &manual_system_maintenance;
 	usbs.set_text = &usb_gadget_set_text;
 
@@ -403,85 +598,81 @@ static lv_res_t _action_hid_touch(lv_obj_t *btn)
 */
 
 static bool usb_msc_emmc_read_only;
-lv_res_t action_ums_sd(lv_obj_t *btn)
-{
-	usb_ctxt_t usbs;
-	usbs.type = MMC_SD;
-	usbs.partition = 0;
-	usbs.offset = 0;
-	usbs.sectors = 0;
-	usbs.ro = 0;
-	usbs.system_maintenance = &manual_system_maintenance;
-	usbs.set_text = &usb_gadget_set_text;
-
-	_create_mbox_ums(&usbs);
+static nx_emmc_layout_t *ums_emu_layout;
 
-	return LV_RES_OK;
+static void _ums_ctxt_init(usb_ctxt_t *usbs)
+{
+	usbs->lun_cnt = 0;
+	usbs->stats = NULL;
+	usbs->stats_update = NULL;
+	usbs->system_maintenance = &manual_system_maintenance;
+	usbs->set_text = &usb_gadget_set_text;
 }
 
-static lv_res_t _action_ums_emmc_boot0(lv_obj_t *btn)
+static void _ums_lun_add(usb_ctxt_t *usbs, u32 type, u32 partition, u32 ro)
 {
-	if (!nyx_emmc_check_battery_enough())
-		return LV_RES_OK;
-
-	usb_ctxt_t usbs;
-	usbs.type = MMC_EMMC;
-	usbs.partition = EMMC_BOOT0 + 1;
-	usbs.offset = 0;
-	usbs.sectors = 0;
-	usbs.ro = usb_msc_emmc_read_only;
-	usbs.system_maintenance = &manual_system_maintenance;
-	usbs.set_text = &usb_gadget_set_text;
-
-	_create_mbox_ums(&usbs);
+	usb_ums_lun_t *lun = &usbs->lun[usbs->lun_cnt++];
+
+	lun->type = type;
+	lun->partition = partition;
+	lun->offset = 0;
+	lun->sectors = 0;
+	lun->ro = ro;
+	lun->bis = 0;
+	lun->layout = NULL;
+}
 
-	return LV_RES_OK;
+static void _ums_emummc_layout_free()
+{
+	free(ums_emu_layout);
+	ums_emu_layout = NULL;
 }
 
-static lv_res_t _action_ums_emmc_boot1(lv_obj_t *btn)
+// File based emuMMC. Its files are mapped to SD sectors through their cluster tables.
+static int _ums_emummc_file_setup(usb_ums_lun_t *lun, const char *emu_path, u32 partition)
 {
-	if (!nyx_emmc_check_battery_enough())
-		return LV_RES_OK;
+	char emmc_path[NX_EMMC_LAYOUT_PATH_SZ];
+	char layout_path[NX_EMMC_LAYOUT_PATH_SZ];
 
-	usb_ctxt_t usbs;
-	usbs.type = MMC_EMMC;
-	usbs.partition = EMMC_BOOT1 + 1;
-	usbs.offset = 0;
-	usbs.sectors = 0;
-	usbs.ro = usb_msc_emmc_read_only;
-	usbs.system_maintenance = &manual_system_maintenance;
-	usbs.set_text = &usb_gadget_set_text;
+	if (!ums_emu_layout)
+	{
+		ums_emu_layout = (nx_emmc_layout_t *)malloc(sizeof(nx_emmc_layout_t));
 
-	_create_mbox_ums(&usbs);
+		s_printf(emmc_path, "%s/eMMC", emu_path);
+		s_printf(layout_path, "%s/"NX_EMMC_LAYOUT_NAME, emu_path);
 
-	return LV_RES_OK;
-}
+		// Use the saved layout only if the FAT chain of every file still matches it. Otherwise build it.
+		if (nx_emmc_layout_load(ums_emu_layout, layout_path, emmc_path) &&
+			nx_emmc_layout_build(ums_emu_layout, emmc_path))
+		{
+			_ums_emummc_layout_free();
 
-static lv_res_t _action_ums_emmc_gpp(lv_obj_t *btn)
-{
-	if (!nyx_emmc_check_battery_enough())
-		return LV_RES_OK;
+			return 7;
+		}
+	}
 
-	usb_ctxt_t usbs;
-	usbs.type = MMC_EMMC;
-	usbs.partition = EMMC_GPP + 1;
-	usbs.offset = 0;
-	usbs.sectors = 0;
-	usbs.ro = usb_msc_emmc_read_only;
-	usbs.system_maintenance = &manual_system_maintenance;
-	usbs.set_text = &usb_gadget_set_text;
+	nx_emmc_layout_t *lt = ums_emu_layout;
+	lun->offset = 0;
+	lun->layout = lt;
 
-	_create_mbox_ums(&usbs);
+	// Files are BOOT0, BOOT1 and then the GPP parts.
+	if (partition == EMMC_GPP)
+	{
+		lun->sectors = 0;
+		for (u32 i = 2; i < lt->hdr.file_cnt; i++)
+			lun->sectors += lt->files[i].sectors;
+	}
+	else
+		lun->sectors = lt->files[partition - EMMC_BOOT0].sectors;
 
-	return LV_RES_OK;
+	return 0;
 }
 
-static lv_res_t _action_ums_emuemmc_boot0(lv_obj_t *btn)
+// Adds the emuMMC partition as a LUN. File based only if allowed. Returns 0 or the UMS error.
+static int _ums_emummc_lun_add(usb_ctxt_t *usbs, u32 partition, bool file_based)
 {
-	if (!nyx_emmc_check_battery_enough())
-		return LV_RES_OK;
-
-	usb_ctxt_t usbs;
+	usb_ums_lun_t *lun = &usbs->lun[usbs->lun_cnt];
+	lun->layout = NULL;
 
 	int error = sd_mount();
 	if (!error)
@@ -496,8 +687,35 @@ static lv_res_t _action_ums_emuemmc_boot0(lv_obj_t *btn)
 			if (emu_info.sector)
 			{
 				error = 0;
-				usbs.offset = emu_info.sector;
+				switch (partition)
+				{
+				case EMMC_BOOT0:
+					lun->offset = emu_info.sector;
+					lun->sectors = 0x2000; // Forced 4MB.
+					break;
+				case EMMC_BOOT1:
+					lun->offset = emu_info.sector + 0x2000;
+					lun->sectors = 0x2000; // Forced 4MB.
+					break;
+				case EMMC_GPP:
+					error = 1;
+					lun->offset = emu_info.sector + 0x4000;
+
+					u8 *gpt = malloc(SD_BLOCKSIZE);
+					if (!sdmmc_storage_read(&sd_storage, lun->offset + 1, 1, gpt))
+					{
+						if (!memcmp(gpt, "EFI PART", 8))
+						{
+							error = 0;
+							lun->sectors = *(u32 *)(gpt + 0x20) + 1; // Backup LBA + 1.
+						}
+					}
+					free(gpt);
+					break;
+				}
 			}
+			else if (emu_info.path && file_based)
+				error = _ums_emummc_file_setup(lun, emu_info.path, partition);
 		}
 
 		if (emu_info.path)
@@ -507,122 +725,237 @@ static lv_res_t _action_ums_emuemmc_boot0(lv_obj_t *btn)
 	}
 	sd_unmount();
 
-	if (error)
-		_create_mbox_ums_error(error);
-	else
+	if (!error)
 	{
-		usbs.type = MMC_SD;
-		usbs.partition = EMMC_BOOT0 + 1;
-		usbs.sectors = 0x2000; // Forced 4MB.
-		usbs.ro = usb_msc_emmc_read_only;
-		usbs.system_maintenance = &manual_system_maintenance;
-		usbs.set_text = &usb_gadget_set_text;
-		_create_mbox_ums(&usbs);
+		lun->type = MMC_SD;
+		lun->partition = partition + 1;
+		lun->ro = usb_msc_emmc_read_only;
+		lun->bis = 0;
+		usbs->lun_cnt++;
 	}
 
-	return LV_RES_OK;
+	return error;
 }
 
-static lv_res_t _action_ums_emuemmc_boot1(lv_obj_t *btn)
+// Reads GPP sectors, through the file layout if emuMMC is file based.
+static int _ums_gpp_read(sdmmc_storage_t *storage, nx_emmc_layout_t *lt, u32 sector, u32 num_sectors, void *buf)
 {
-	if (!nyx_emmc_check_battery_enough())
-		return LV_RES_OK;
+	u8 *bbuf = (u8 *)buf;
 
-	usb_ctxt_t usbs;
+	if (!lt)
+		return sdmmc_storage_read(storage, sector, num_sectors, buf);
 
-	int error = sd_mount();
-	if (!error)
+	while (num_sectors)
 	{
-		emummc_cfg_t emu_info;
-		load_emummc_cfg(&emu_info);
+		u32 sd_sector;
+		u32 cnt = nx_emmc_layout_map(lt, EMMC_GPP, sector, &sd_sector);
+		if (!cnt)
+			return 1;
+
+		cnt = MIN(cnt, num_sectors);
+		if (sdmmc_storage_read(storage, sd_sector, cnt, bbuf))
+			return 1;
+
+		sector += cnt;
+		num_sectors -= cnt;
+		bbuf += cnt * EMMC_BLOCKSIZE;
+	}
 
-		error = 2;
-		if (emu_info.enabled)
+	return 0;
+}
+
+/*
+ * Adds the BIS partitions in the GPT at gpp_offset as decrypted LUNs.
+ * BIS keys must be in place. They are checked against PRODINFO.
+ * Returns 0 or the UMS error.
+ */
+static int _ums_bis_luns_add(usb_ctxt_t *usbs, u32 type, u32 gpp_offset, nx_emmc_layout_t *layout)
+{
+	sdmmc_storage_t *storage = type == MMC_SD ? &sd_storage : &emmc_storage;
+	gpt_t *gpt = (gpt_t *)zalloc(GPT_NUM_BLOCKS * EMMC_BLOCKSIZE);
+	u8 *buf = (u8 *)malloc(EMMC_BLOCKSIZE);
+	char name[37];
+	int error = 5;
+
+	if (_ums_gpp_read(storage, layout, gpp_offset + GPT_FIRST_LBA, GPT_NUM_BLOCKS, gpt) ||
+		memcmp(&gpt->header.signature, "EFI PART", 8) || gpt->header.num_part_ents > 128)
+		goto out;
+
+	for (u32 i = 0; i < gpt->header.num_part_ents && usbs->lun_cnt < USB_UMS_LUN_MAX; i++)
+	{
+		gpt_entry_t *ent = &gpt->entries[i];
+
+		// ASCII conversion. Copy only the LSByte of the UTF-16LE name.
+		for (u32 j = 0; j < 36; j++)
+			name[j] = ent->name[j];
+		name[36] = 0;
+
+		u32 bis = nx_emmc_bis_part_id(name);
+		if (!bis || ent->lba_end < ent->lba_start)
+			continue;
+
+		usb_ums_lun_t *lun = &usbs->lun[usbs->lun_cnt];
+		lun->type      = type;
+		lun->partition = EMMC_GPP + 1;
+		lun->offset    = gpp_offset + ent->lba_start;
+		lun->sectors   = ent->lba_end - ent->lba_start + 1;
+		lun->ro        = usb_msc_emmc_read_only;
+		lun->bis       = bis;
+		lun->layout    = layout;
+
+		// Wrong keys would expose garbage and corrupt it on writes.
+		if (bis == NX_BIS_PRODINFO)
 		{
-			error = 3;
-			if (emu_info.sector)
+			if (_ums_gpp_read(storage, layout, lun->offset, 1, buf) ||
+				nx_emmc_bis_crypt(bis, DECRYPT, 0, 1, buf, buf) || memcmp(buf, "CAL0", 4))
 			{
-				error = 0;
-				usbs.offset = emu_info.sector + 0x2000;
+				error = 4;
+				goto out;
 			}
 		}
 
-		if (emu_info.path)
-			free(emu_info.path);
-		if (emu_info.nintendo_path)
-			free(emu_info.nintendo_path);
+		usbs->lun_cnt++;
+		error = 0;
 	}
-	sd_unmount();
 
+out:
+	free(buf);
+	free(gpt);
+
+	return error;
+}
+
+lv_res_t action_ums_sd(lv_obj_t *btn)
+{
+	usb_ctxt_t usbs;
+	_ums_ctxt_init(&usbs);
+	_ums_lun_add(&usbs, MMC_SD, 0, 0);
+
+	_create_mbox_ums(&usbs);
+
+	return LV_RES_OK;
+}
+
+static lv_res_t _action_ums_emmc(u32 partition)
+{
+	if (!nyx_emmc_check_battery_enough())
+		return LV_RES_OK;
+
+	usb_ctxt_t usbs;
+	_ums_ctxt_init(&usbs);
+	_ums_lun_add(&usbs, MMC_EMMC, partition + 1, usb_msc_emmc_read_only);
+
+	_create_mbox_ums(&usbs);
+
+	return LV_RES_OK;
+}
+
+static lv_res_t _action_ums_emmc_boot0(lv_obj_t *btn) { return _action_ums_emmc(EMMC_BOOT0); }
+static lv_res_t _action_ums_emmc_boot1(lv_obj_t *btn) { return _action_ums_emmc(EMMC_BOOT1); }
+static lv_res_t _action_ums_emmc_gpp(lv_obj_t *btn)   { return _action_ums_emmc(EMMC_GPP); }
+
+static lv_res_t _action_ums_emuemmc(u32 partition)
+{
+	if (!nyx_emmc_check_battery_enough())
+		return LV_RES_OK;
+
+	usb_ctxt_t usbs;
+	_ums_ctxt_init(&usbs);
+
+	int error = _ums_emummc_lun_add(&usbs, partition, true);
 	if (error)
 		_create_mbox_ums_error(error);
 	else
-	{
-		usbs.type = MMC_SD;
-		usbs.partition = EMMC_BOOT1 + 1;
-		usbs.sectors = 0x2000; // Forced 4MB.
-		usbs.ro = usb_msc_emmc_read_only;
-		usbs.system_maintenance = &manual_system_maintenance;
-		usbs.set_text = &usb_gadget_set_text;
 		_create_mbox_ums(&usbs);
-	}
+
+	_ums_emummc_layout_free();
 
 	return LV_RES_OK;
 }
 
-static lv_res_t _action_ums_emuemmc_gpp(lv_obj_t *btn)
+static lv_res_t _action_ums_emuemmc_boot0(lv_obj_t *btn) { return _action_ums_emuemmc(EMMC_BOOT0); }
+static lv_res_t _action_ums_emuemmc_boot1(lv_obj_t *btn) { return _action_ums_emuemmc(EMMC_BOOT1); }
+static lv_res_t _action_ums_emuemmc_gpp(lv_obj_t *btn)   { return _action_ums_emuemmc(EMMC_GPP); }
+
+// Decrypted HOS partitions of eMMC or emuMMC.
+static lv_res_t _action_ums_bis(u32 type)
 {
 	if (!nyx_emmc_check_battery_enough())
 		return LV_RES_OK;
 
 	usb_ctxt_t usbs;
+	_ums_ctxt_init(&usbs);
 
-	int error = sd_mount();
-	if (!error)
-	{
-		emummc_cfg_t emu_info;
-		load_emummc_cfg(&emu_info);
+	int error = 4;
+	if (hos_bis_keygen())
+		goto out;
 
-		error = 2;
-		if (emu_info.enabled)
+	if (type == MMC_EMMC)
+	{
+		error = 6;
+		if (!emmc_initialize(false))
 		{
-			error = 3;
-			if (emu_info.sector)
-			{
-				error = 1;
-				usbs.offset = emu_info.sector + 0x4000;
-
-				u8 *gpt = malloc(SD_BLOCKSIZE);
-				if (!sdmmc_storage_read(&sd_storage, usbs.offset + 1, 1, gpt))
-				{
-					if (!memcmp(gpt, "EFI PART", 8))
-					{
-						error = 0;
-						usbs.sectors = *(u32 *)(gpt + 0x20) + 1; // Backup LBA + 1.
-					}
-				}
-			}
+			emmc_set_partition(EMMC_GPP);
+			error = _ums_bis_luns_add(&usbs, MMC_EMMC, 0, NULL);
+			emmc_end();
 		}
+	}
+	else
+	{
+		// Its GPP LUN is replaced by the BIS partitions.
+		error = _ums_emummc_lun_add(&usbs, EMMC_GPP, true);
+		if (!error)
+		{
+			u32 gpp_offset = usbs.lun[0].offset;
+			usbs.lun_cnt = 0;
 
-		if (emu_info.path)
-			free(emu_info.path);
-		if (emu_info.nintendo_path)
-			free(emu_info.nintendo_path);
+			error = 1;
+			if (!sd_mount())
+				error = _ums_bis_luns_add(&usbs, MMC_SD, gpp_offset, ums_emu_layout);
+			sd_unmount();
+		}
 	}
-	sd_unmount();
 
+out:
 	if (error)
 		_create_mbox_ums_error(error);
 	else
-	{
-		usbs.type = MMC_SD;
-		usbs.partition = EMMC_GPP + 1;
-		usbs.ro = usb_msc_emmc_read_only;
-		usbs.system_maintenance = &manual_system_maintenance;
-		usbs.set_text = &usb_gadget_set_text;
 		_create_mbox_ums(&usbs);
+
+	// Clear BIS keys slots.
+	hos_bis_keys_clear();
+
+	_ums_emummc_layout_free();
+
+	return LV_RES_OK;
+}
+
+static lv_res_t _action_ums_emmc_bis(lv_obj_t *btn)    { return _action_ums_bis(MMC_EMMC); }
+static lv_res_t _action_ums_emuemmc_bis(lv_obj_t *btn) { return _action_ums_bis(MMC_SD); }
+
+// SD, eMMC and raw emuMMC (if active) in one session.
+static lv_res_t _action_ums_all(lv_obj_t *btn)
+{
+	if (!nyx_emmc_check_battery_enough())
+		return LV_RES_OK;
+
+	usb_ctxt_t usbs;
+	_ums_ctxt_init(&usbs);
+
+	_ums_lun_add(&usbs, MMC_SD, 0, 0);
+	_ums_lun_add(&usbs, MMC_EMMC, EMMC_GPP + 1, usb_msc_emmc_read_only);
+	_ums_lun_add(&usbs, MMC_EMMC, EMMC_BOOT0 + 1, usb_msc_emmc_read_only);
+	_ums_lun_add(&usbs, MMC_EMMC, EMMC_BOOT1 + 1, usb_msc_emmc_read_only);
+
+	// Missing emuMMC is not an error here. File based is skipped, since its files are on the exposed SD.
+	if (!_ums_emummc_lun_add(&usbs, EMMC_GPP, false))
+	{
+		_ums_emummc_lun_add(&usbs, EMMC_BOOT0, false);
+		_ums_emummc_lun_add(&usbs, EMMC_BOOT1, false);
 	}
 
+	_create_mbox_ums(&usbs);
+
 	return LV_RES_OK;
 }
 
@@ -712,10 +1045,17 @@ static lv_res_t _create_window_usb_tools(lv_obj_t *parent)
 	lv_obj_align(btn1, line_sep, LV_ALIGN_OUT_BOTTOM_LEFT, LV_DPI / 4, LV_DPI / 4);
 	lv_btn_set_action(btn1, LV_BTN_ACTION_CLICK, action_ums_sd);
 
+	// Create all drives button.
+	lv_obj_t *btn_all = lv_btn_create(h1, btn1);
+	label_btn = lv_label_create(btn_all, NULL);
+	lv_label_set_static_text(label_btn, SYMBOL_LIST"  All Drives");
+	lv_obj_align(btn_all, btn1, LV_ALIGN_OUT_RIGHT_MID, LV_DPI / 10, 0);
+	lv_btn_set_action(btn_all, LV_BTN_ACTION_CLICK, _action_ums_all);
+
 	lv_obj_t *label_txt2 = lv_label_create(h1, NULL);
 	lv_label_set_recolor(label_txt2, true);
 	lv_label_set_static_text(label_txt2,
-		"Allows you to mount the SD Card to a PC/Phone.\n"
+		"Allows you to mount the SD Card or all drives at once to a PC/Phone.\n"
 		"#C7EA46 All operating systems are supported. Access is# #FF8000 Read/Write.#");
 
 	lv_obj_set_style(label_txt2, &hint_small_style);
@@ -742,6 +1082,13 @@ static lv_res_t _create_window_usb_tools(lv_obj_t *parent)
 	lv_obj_align(btn_boot1, btn_boot0, LV_ALIGN_OUT_RIGHT_MID, LV_DPI / 10, 0);
 	lv_btn_set_action(btn_boot1, LV_BTN_ACTION_CLICK, _action_ums_emmc_boot1);
 
+	// Create decrypted BIS button.
+	lv_obj_t *btn_bis = lv_btn_create(h1, btn1);
+	label_btn = lv_label_create(btn_bis, NULL);
+	lv_label_set_static_text(label_btn, SYMBOL_KEY" BIS");
+	lv_obj_align(btn_bis, btn_boot1, LV_ALIGN_OUT_RIGHT_MID, LV_DPI / 10, 0);
+	lv_btn_set_action(btn_bis, LV_BTN_ACTION_CLICK, _action_ums_emmc_bis);
+
 	// Create emuMMC RAW GPP button.
 	lv_obj_t *btn_emu_gpp = lv_btn_create(h1, btn1);
 	label_btn = lv_label_create(btn_emu_gpp, NULL);
@@ -763,10 +1110,18 @@ static lv_res_t _create_window_usb_tools(lv_obj_t *parent)
 	lv_obj_align(btn_emu_boot1, btn_boot1, LV_ALIGN_OUT_BOTTOM_LEFT, 0, LV_DPI / 2);
 	lv_btn_set_action(btn_emu_boot1, LV_BTN_ACTION_CLICK, _action_ums_emuemmc_boot1);
 
+	// Create emuMMC decrypted BIS button.
+	lv_obj_t *btn_emu_bis = lv_btn_create(h1, btn1);
+	label_btn = lv_label_create(btn_emu_bis, NULL);
+	lv_label_set_static_text(label_btn, SYMBOL_KEY" BIS");
+	lv_obj_align(btn_emu_bis, btn_bis, LV_ALIGN_OUT_BOTTOM_LEFT, 0, LV_DPI / 2);
+	lv_btn_set_action(btn_emu_bis, LV_BTN_ACTION_CLICK, _action_ums_emuemmc_bis);
+
 	label_txt2 = lv_label_create(h1, NULL);
 	lv_label_set_recolor(label_txt2, true);
 	lv_label_set_static_text(label_txt2,
 		"Allows you to mount the eMMC/emuMMC.\n"
+		"#C7EA46 BIS mounts the HOS partitions decrypted.#\n"
 		"#C7EA46 Default access is# #FF8000 read-only.#");
 	lv_obj_set_style(label_txt2, &hint_small_style);
 	lv_obj_align(label_txt2, btn_emu_gpp, LV_ALIGN_OUT_BOTTOM_LEFT, 0, LV_DPI / 3);
@@ -844,12 +1199,15 @@ static lv_res_t _create_window_usb_tools(lv_obj_t *parent)
 	return LV_RES_OK;
 }
 
+#define FIX_ATTR_BATCH_ENTRIES 16
+
 static int _fix_attributes(lv_obj_t *lb_val, char *path, u32 *total)
 {
 	FRESULT res;
 	DIR dir;
+	DIRENT *ents;
+	UINT cnt;
 	u32 dirLength = 0;
-	static FILINFO fno;
 
 	// Open directory.
 	res = f_opendir(&dir, path);
@@ -865,34 +1223,36 @@ static int _fix_attributes(lv_obj_t *lb_val, char *path, u32 *total)
 		goto out;
 	}
 
+	ents = (DIRENT *)malloc(sizeof(DIRENT) * FIX_ATTR_BATCH_ENTRIES);
+
 	for (;;)
 	{
-		// Clear file or folder path.
-		path[dirLength] = 0;
-
-		// Read a directory item.
-		res = f_readdir(&dir, &fno);
+		// Read a batch of directory items.
+		res = f_readdir_batch(&dir, ents, FIX_ATTR_BATCH_ENTRIES, &cnt);
 
 		// Break on error or end of dir.
-		if (res != FR_OK || fno.fname[0] == 0)
+		if (res != FR_OK || !cnt)
 			break;
 
-		// Set new directory or file.
-		memcpy(&path[dirLength], "/", 1);
-		strcpy(&path[dirLength + 1], fno.fname);
-
-		// Is it a directory?
-		if (fno.fattrib & AM_DIR)
+		for (u32 i = 0; i < cnt; i++)
 		{
-			// Check if it's a HOS single file folder.
+			// Only directories are checked.
+			if (!(ents[i].fattrib & AM_DIR))
+				continue;
+
+			// Set new directory.
+			path[dirLength] = '/';
+			strcpy(&path[dirLength + 1], ents[i].fname);
+
+			// Check if it's a HOS single file folder. Search relative to the open directory.
 			strcat(path, "/00");
-			bool is_hos_special = !f_stat(path, NULL);
+			bool is_hos_special = !f_stat_at(&dir, &path[dirLength + 1], NULL);
 			path[strlen(path) - 3] = 0;
 
 			// Set archive bit to HOS single file folders.
 			if (is_hos_special)
 			{
-				if (!(fno.fattrib & AM_ARC))
+				if (!(ents[i].fattrib & AM_ARC))
 				{
 					if (!f_chmod(path, AM_ARC, AM_ARC))
 						total[0]++;
@@ -900,7 +1260,7 @@ static int _fix_attributes(lv_obj_t *lb_val, char *path, u32 *total)
 						total[3]++;
 				}
 			}
-			else if (fno.fattrib & AM_ARC) // If not, clear the archive bit.
+			else if (ents[i].fattrib & AM_ARC) // If not, clear the archive bit.
 			{
 				if (!f_chmod(path, 0, AM_ARC))
 					total[1]++;
@@ -916,8 +1276,16 @@ static int _fix_attributes(lv_obj_t *lb_val, char *path, u32 *total)
 			if (res != FR_OK)
 				break;
 		}
+
+		if (res != FR_OK)
+			break;
 	}
 
+	// Clear file or folder path.
+	path[dirLength] = 0;
+
+	free(ents);
+
 out:
 	f_closedir(&dir);
 
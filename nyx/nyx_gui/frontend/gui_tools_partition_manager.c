@@ -1186,6 +1186,41 @@ static lv_res_t _action_reboot_recovery(lv_obj_t * btns, const char * txt)
 	return LV_RES_INV;
 }
 
+typedef struct _android_flash_ctxt_t
+{
+	u32 offset_sct;
+} android_flash_ctxt_t;
+
+static int _android_flash_chunk(void *buf, u32 size, u32 offset, void *priv)
+{
+	android_flash_ctxt_t *ctxt = (android_flash_ctxt_t *)priv;
+
+	// Pad last chunk to block size.
+	u32 size_aligned = ALIGN(size, SD_BLOCKSIZE);
+	memset((u8 *)buf + size, 0, size_aligned - size);
+
+	return sdmmc_storage_write(part_info.storage, ctxt->offset_sct + (offset >> 9), size_aligned >> 9, buf);
+}
+
+static int _android_flash_image(const char *path, u32 offset_sct, u32 size_sct)
+{
+	FILINFO fno;
+	android_flash_ctxt_t ctxt = { offset_sct };
+
+	if (f_stat(path, &fno))
+		return 2;
+
+	if ((ALIGN(fno.fsize, SD_BLOCKSIZE) >> 9) > size_sct)
+		return 1;
+
+	// Stream image to eMMC instead of loading it whole.
+	u8 *buf = malloc(SZ_4M);
+	int res = sd_file_read_chunked(path, buf, SZ_4M, _android_flash_chunk, &ctxt);
+	free(buf);
+
+	return res ? 2 : 0;
+}
+
 static lv_res_t _action_flash_android_data(lv_obj_t * btns, const char * txt)
 {
 	int btn_idx = lv_btnm_get_pressed(btns);
@@ -1263,29 +1298,16 @@ static lv_res_t _action_flash_android_data(lv_obj_t * btns, const char * txt)
 	// Flash Kernel.
 	if (offset_sct && size_sct)
 	{
-		u32 file_size = 0;
-		u8 *buf = sd_file_read(path, &file_size);
-
-		if (file_size % 0x200)
-		{
-			file_size = ALIGN(file_size, 0x200);
-			u8 *buf_tmp = zalloc(file_size);
-			memcpy(buf_tmp, buf, file_size);
-			free(buf);
-			buf = buf_tmp;
-		}
-
-		if ((file_size >> 9) > size_sct)
+		int res = _android_flash_image(path, offset_sct, size_sct);
+		if (res == 1)
 			s_printf(txt_buf, "#FF8000 Warning:# Kernel image too big!\n");
+		else if (res)
+			s_printf(txt_buf, "#FFDD00 Error:# Failed to flash Kernel image!\n");
 		else
 		{
-			sdmmc_storage_write(part_info.storage, offset_sct, file_size >> 9, buf);
-
 			s_printf(txt_buf, "#C7EA46 Success:# Kernel image flashed!\n");
 			f_unlink(path);
 		}
-
-		free(buf);
 	}
 	else
 		s_printf(txt_buf, "#FF8000 Warning:# Kernel partition not found!\n");
@@ -1325,28 +1347,16 @@ boot_img_not_found:
 	// Flash Recovery.
 	if (offset_sct && size_sct)
 	{
-		u32 file_size = 0;
-		u8 *buf = sd_file_read(path, &file_size);
-
-		if (file_size % 0x200)
-		{
-			file_size = ALIGN(file_size, 0x200);
-			u8 *buf_tmp = zalloc(file_size);
-			memcpy(buf_tmp, buf, file_size);
-			free(buf);
-			buf = buf_tmp;
-		}
-
-		if ((file_size >> 9) > size_sct)
+		int res = _android_flash_image(path, offset_sct, size_sct);
+		if (res == 1)
 			strcat(txt_buf, "#FF8000 Warning:# Recovery image too big!\n");
+		else if (res)
+			strcat(txt_buf, "#FFDD00 Error:# Failed to flash Recovery image!\n");
 		else
 		{
-			sdmmc_storage_write(part_info.storage, offset_sct, file_size >> 9, buf);
 			strcat(txt_buf, "#C7EA46 Success:# Recovery image flashed!\n");
 			f_unlink(path);
 		}
-
-		free(buf);
 	}
 	else
 		strcat(txt_buf, "#FF8000 Warning:# Recovery partition not found!\n");
@@ -1385,28 +1395,16 @@ recovery_not_found:
 	// Flash Device Tree.
 	if (offset_sct && size_sct)
 	{
-		u32 file_size = 0;
-		u8 *buf = sd_file_read(path, &file_size);
-
-		if (file_size % 0x200)
-		{
-			file_size = ALIGN(file_size, 0x200);
-			u8 *buf_tmp = zalloc(file_size);
-			memcpy(buf_tmp, buf, file_size);
-			free(buf);
-			buf = buf_tmp;
-		}
-
-		if ((file_size >> 9) > size_sct)
+		int res = _android_flash_image(path, offset_sct, size_sct);
+		if (res == 1)
 			strcat(txt_buf, "#FF8000 Warning:# DTB image too big!");
+		else if (res)
+			strcat(txt_buf, "#FFDD00 Error:# Failed to flash DTB image!");
 		else
 		{
-			sdmmc_storage_write(part_info.storage, offset_sct, file_size >> 9, buf);
 			strcat(txt_buf, "#C7EA46 Success:# DTB image flashed!");
 			f_unlink(path);
 		}
-
-		free(buf);
 	}
 	else
 		strcat(txt_buf, "#FF8000 Warning:# DTB partition not found!");
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <libs/fatfs/ff.h>
+#include <libs/fatfs/diskio.h>
+
+#include "ffbench.h"
+
+#define SECTOR_SIZE 512
+
+static int disk_fd = -1;
+static u32 disk_sectors = 0;
+
+// Defaults loosely match a UHS-I SD card: ~90MB/s reads, ~60MB/s writes.
+static ffb_latency_t disk_lat = { 100, 5700, 250, 8500 };
+static ffb_disk_stats_t disk_stats;
+
+// Simulated power loss. Writes past the budget are cut and fail.
+static bool disk_cut_armed = false;
+static u64 disk_cut_scts = 0;
+
+int ffb_disk_open(const char *path, u32 create_mb)
+{
+	struct stat st;
+
+	disk_fd = open(path, O_RDWR | (create_mb ? (O_CREAT | O_TRUNC) : 0), 0644);
+	if (disk_fd < 0)
+		return 1;
+
+	// Images are created sparse.
+	if (create_mb && ftruncate(disk_fd, (off_t)create_mb << 20))
+		return 1;
+
+	if (fstat(disk_fd, &st))
+		return 1;
+
+	disk_sectors = st.st_size / SECTOR_SIZE;
+
+	return 0;
+}
+
+void ffb_disk_close()
+{
+	if (disk_fd >= 0)
+		close(disk_fd);
+	disk_fd = -1;
+}
+
+u32 ffb_disk_sectors()
+{
+	return disk_sectors;
+}
+
+void ffb_disk_set_latency(const ffb_latency_t *lat)
+{
+	disk_lat = *lat;
+}
+
+void ffb_disk_set_cut(u64 sectors)
+{
+	disk_cut_armed = !!sectors;
+	disk_cut_scts  = sectors;
+}
+
+bool ffb_disk_cut_hit()
+{
+	return disk_cut_armed && !disk_cut_scts;
+}
+
+void ffb_disk_stats_reset()
+{
+	memset(&disk_stats, 0, sizeof(disk_stats));
+}
+
+void ffb_disk_stats_get(ffb_disk_stats_t *stats)
+{
+	*stats = disk_stats;
+}
+
+static u32 _hist_bucket(u32 count)
+{
+	u32 bucket = 0;
+	while ((count >>= 1) && bucket < (FFB_HIST_BUCKETS - 1))
+		bucket++;
+
+	return bucket;
+}
+
+DSTATUS disk_status (
+	BYTE pdrv		/* Physical drive nmuber to identify the drive */
+)
+{
+	return (pdrv == DRIVE_SD && disk_fd >= 0) ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize (
+	BYTE pdrv				/* Physical drive nmuber to identify the drive */
+)
+{
+	return disk_status(pdrv);
+}
+
+DRESULT disk_read (
+	BYTE pdrv,		/* Physical drive nmuber to identify the drive */
+	BYTE *buff,		/* Data buffer to store read data */
+	DWORD sector,	/* Start sector in LBA */
+	UINT count		/* Number of sectors to read */
+)
+{
+	if (pdrv != DRIVE_SD || disk_fd < 0 || (u64)sector + count > disk_sectors)
+		return RES_PARERR;
+
+	disk_stats.rd_cmds++;
+	disk_stats.rd_scts += count;
+	disk_stats.rd_hist[_hist_bucket(count)]++;
+	disk_stats.time_ns += disk_lat.rd_cmd_us * 1000ull + (u64)disk_lat.rd_sct_ns * count;
+
+	ssize_t bytes = (ssize_t)count * SECTOR_SIZE;
+	if (pread(disk_fd, buff, bytes, (off_t)sector * SECTOR_SIZE) != bytes)
+		return RES_ERROR;
+
+	return RES_OK;
+}
+
+DRESULT disk_write (
+	BYTE pdrv,			/* Physical drive nmuber to identify the drive */
+	const BYTE *buff,	/* Data to be written */
+	DWORD sector,		/* Start sector in LBA */
+	UINT count			/* Number of sectors to write */
+)
+{
+	if (pdrv != DRIVE_SD || disk_fd < 0 || (u64)sector + count > disk_sectors)
+		return RES_PARERR;
+
+	disk_stats.wr_cmds++;
+	disk_stats.wr_scts += count;
+	disk_stats.wr_hist[_hist_bucket(count)]++;
+	disk_stats.time_ns += disk_lat.wr_cmd_us * 1000ull + (u64)disk_lat.wr_sct_ns * count;
+
+	// Only the sectors within budget reach the image.
+	bool cut = false;
+	if (disk_cut_armed && count > disk_cut_scts)
+	{
+		count = disk_cut_scts;
+		cut = true;
+	}
+	disk_cut_scts -= disk_cut_armed ? count : 0;
+
+	ssize_t bytes = (ssize_t)count * SECTOR_SIZE;
+	if (pwrite(disk_fd, buff, bytes, (off_t)sector * SECTOR_SIZE) != bytes)
+		return RES_ERROR;
+
+	return cut ? RES_ERROR : RES_OK;
+}
+
+DRESULT disk_ioctl (
+	BYTE pdrv,		/* Physical drive nmuber (0..) */
+	BYTE cmd,		/* Control code */
+	void *buff		/* Buffer to send/receive control data */
+)
+{
+	DWORD *buf = (DWORD *)buff;
+
+	if (pdrv != DRIVE_SD)
+		return RES_PARERR;
+
+	switch (cmd)
+	{
+	case CTRL_SYNC:
+		disk_stats.syncs++;
+		if (ffb_disk_cut_hit())
+			return RES_ERROR;
+		break;
+	case GET_SECTOR_COUNT:
+		*buf = disk_sectors;
+		break;
+	case GET_BLOCK_SIZE:
+		*buf = 32768; // Align to 16MB.
+		break;
+	}
+
+	return RES_OK;
+}
+
+DRESULT disk_set_info (
+	BYTE pdrv,		/* Physical drive nmuber (0..) */
+	BYTE cmd,		/* Control code */
+	void *buff		/* Buffer to send/receive control data */
+)
+{
+	return RES_OK;
+}
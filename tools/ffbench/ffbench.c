@@ -0,0 +1,1085 @@
+/*
+ * FatFs host harness
+ *
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Runs bdk FatFs against a disk image with the bootloader or Nyx ffconf.h.
+ * Every workload reports sector I/O counts, I/O size histograms and the time
+ * a device with the configured per command latency would take.
+ * Returns non zero on any FatFs error or data mismatch.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libs/fatfs/ff.h>
+#include <libs/fatfs/diskio.h>
+#include <storage/nx_emmc_jrnl.h>
+#include <storage/nx_emmc_layout.h>
+#include <storage/sdmmc_bench.h>
+
+#include "ffbench.h"
+#include "../nxcz/sha256.h"
+
+#define BUF_SIZE SZ_4M // Same as Nyx tools cache.
+#define FAT32_FILESIZE_LIMIT 0xFFFFFFFFull
+#define EMUMMC_SPLIT_SIZE    0xFE000000ull
+#define BACKUP_SPLIT_SIZE    (1ull << 31)
+
+#ifndef FF_FASTFS
+#define FF_FASTFS 0
+#endif
+
+static FATFS sd_fs;
+static u8 *buf;
+static const char *ffb_image;
+static const char *ffb_variant = "";
+
+static const char *phase_name;
+static struct timespec phase_start;
+
+void gfx_printf(const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	while (*fmt)
+	{
+		if (fmt[0] == '%' && fmt[1] == 'k')
+		{
+			va_arg(ap, u32); // Drop colors.
+			fmt += 2;
+			continue;
+		}
+		putchar(*fmt++);
+	}
+	va_end(ap);
+}
+
+static void _phase_begin(const char *name)
+{
+	phase_name = name;
+	ffb_disk_stats_reset();
+	clock_gettime(CLOCK_MONOTONIC, &phase_start);
+}
+
+static void _print_hist(const char *type, const u64 *hist)
+{
+	static const char *units[] = { "", "K", "M" };
+
+	printf("  %s sizes:", type);
+	for (u32 i = 0; i < FFB_HIST_BUCKETS; i++)
+	{
+		if (!hist[i])
+			continue;
+
+		u32 bytes = 512u << i;
+		u32 unit = 0;
+		while (bytes >= 1024 && unit < 2)
+		{
+			bytes >>= 10;
+			unit++;
+		}
+		printf(" %d%s:%llu", bytes, units[unit], hist[i]);
+	}
+	printf("\n");
+}
+
+static void _phase_end(u64 bytes)
+{
+	struct timespec now;
+	ffb_disk_stats_t st;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ffb_disk_stats_get(&st);
+
+	double wall = (now.tv_sec - phase_start.tv_sec) + (now.tv_nsec - phase_start.tv_nsec) / 1e9;
+	double sim  = st.time_ns / 1e9;
+
+	printf("[%s%s] %llu KiB\n", ffb_variant, phase_name, bytes >> 10);
+	printf("  rd: %llu cmds, %llu sectors | wr: %llu cmds, %llu sectors | syncs: %llu\n",
+		st.rd_cmds, st.rd_scts, st.wr_cmds, st.wr_scts, st.syncs);
+	if (st.rd_cmds)
+		_print_hist("rd", st.rd_hist);
+	if (st.wr_cmds)
+		_print_hist("wr", st.wr_hist);
+	printf("  sim: %.3f s (%.1f MB/s) | wall: %.3f s\n",
+		sim, sim > 0 ? bytes / sim / 1e6 : 0.0, wall);
+}
+
+static void _fill_pattern(u8 *dst, u64 offset, u32 size, u32 seed)
+{
+	u32 *words = (u32 *)dst;
+	for (u32 i = 0; i < size / 4; i++)
+		words[i] = (u32)((offset >> 2) + i) ^ seed;
+}
+
+static int _check_pattern(const u8 *src, u64 offset, u32 size, u32 seed)
+{
+	const u32 *words = (const u32 *)src;
+	for (u32 i = 0; i < size / 4; i++)
+	{
+		if (words[i] != ((u32)((offset >> 2) + i) ^ seed))
+		{
+			printf("Data mismatch @ %llx\n", offset + i * 4);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int _write_file(const char *path, u64 base, u64 size, u32 seed)
+{
+	FIL fp;
+	int res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (res)
+	{
+		printf("Error (%d) while creating %s\n", res, path);
+		return 1;
+	}
+
+#if FF_FASTFS
+	DWORD *clmt = f_expand_cltbl(&fp, SZ_4M, size);
+	if (!clmt)
+	{
+		f_close(&fp);
+		printf("Error expanding %s\n", path);
+		return 1;
+	}
+#endif
+
+	for (u64 pos = 0; pos < size; pos += BUF_SIZE)
+	{
+		u32 num = MIN(size - pos, BUF_SIZE);
+		_fill_pattern(buf, base + pos, num, seed);
+
+#if FF_FASTFS
+		res = f_write_fast(&fp, buf, num);
+#else
+		UINT bw;
+		res = f_write(&fp, buf, num, &bw);
+#endif
+		if (res)
+		{
+			printf("Error (%d) when writing %s @ %llx\n", res, path, pos);
+			break;
+		}
+	}
+
+	res |= f_close(&fp);
+#if FF_FASTFS
+	free(clmt);
+#endif
+
+	return !!res;
+}
+
+static int _read_file(const char *path, u64 base, u64 size, u32 seed)
+{
+	FIL fp;
+	int res = f_open(&fp, path, FA_READ);
+	if (res)
+	{
+		printf("Error (%d) while opening %s\n", res, path);
+		return 1;
+	}
+
+	if (f_size(&fp) != size)
+	{
+		printf("Size mismatch on %s\n", path);
+		f_close(&fp);
+		return 1;
+	}
+
+#if FF_FASTFS
+	DWORD *clmt = f_expand_cltbl(&fp, SZ_4M, 0);
+#endif
+
+	for (u64 pos = 0; pos < size; pos += BUF_SIZE)
+	{
+		u32 num = MIN(size - pos, BUF_SIZE);
+
+#if FF_FASTFS
+		res = f_read_fast(&fp, buf, num);
+#else
+		UINT br;
+		res = f_read(&fp, buf, num, &br);
+#endif
+		if (res || _check_pattern(buf, base + pos, num, seed))
+		{
+			printf("Error (%d) when reading %s @ %llx\n", res, path, pos);
+			res = 1;
+			break;
+		}
+	}
+
+	f_close(&fp);
+#if FF_FASTFS
+	free(clmt);
+#endif
+
+	return !!res;
+}
+
+typedef int (*ffb_file_op_t)(const char *path, u64 base, u64 size, u32 seed);
+
+static int _multipart_op(ffb_file_op_t op, const char *base_path, bool emummc_naming, u64 total, u64 split, u32 seed)
+{
+	char path[256];
+	u32 parts = split ? (total + split - 1) / split : 1;
+
+	for (u32 i = 0; i < parts; i++)
+	{
+		u64 base = i * split;
+		u64 size = split ? MIN(total - base, split) : total;
+
+		if (parts == 1 && !emummc_naming)
+			strcpy(path, base_path);
+		else if (emummc_naming)
+			sprintf(path, "%s/%02d", base_path, i);
+		else
+			sprintf(path, "%s.%02d", base_path, i);
+
+		if (op(path, base, size, seed))
+			return 1;
+	}
+
+	return 0;
+}
+
+#if FF_USE_MKFS
+static int _wl_mkfs(int argc, char **argv)
+{
+	u32 size_mb = argc > 0 ? atoi(argv[0]) : 0;
+	BYTE fmt = (argc > 1 && !strcmp(argv[1], "exfat")) ? FM_EXFAT : FM_FAT32;
+	u32 au = argc > 2 ? atoi(argv[2]) << 10 : SZ_32K;
+
+	if (!size_mb)
+		return 1;
+
+	// Recreate image.
+	if (ffb_disk_open(ffb_image, size_mb))
+		return 1;
+
+	_phase_begin("mkfs");
+	int res = f_mkfs("", fmt, au, buf, BUF_SIZE);
+	_phase_end(0);
+
+	if (res)
+		printf("Error (%d) while formatting\n", res);
+
+	return res;
+}
+#endif
+
+static int _wl_emummc(int argc, char **argv)
+{
+	u64 gpp_size = (u64)(argc > 0 ? atoi(argv[0]) : 4352) << 20;
+	u64 split = gpp_size > FAT32_FILESIZE_LIMIT ? EMUMMC_SPLIT_SIZE : 0;
+	if (argc > 1)
+		split = (u64)atoi(argv[1]) << 20;
+	int res = 0;
+
+	f_mkdir("emuMMC");
+	f_mkdir("emuMMC/SD00");
+	f_mkdir("emuMMC/SD00/eMMC");
+
+	_phase_begin("emummc create");
+	res |= _write_file("emuMMC/SD00/file_based", 0, 512, 0);
+	res |= _write_file("emuMMC/SD00/eMMC/BOOT0", 0, SZ_4M, 0xB0);
+	res |= _write_file("emuMMC/SD00/eMMC/BOOT1", 0, SZ_4M, 0xB1);
+	res |= _multipart_op(_write_file, "emuMMC/SD00/eMMC", true, gpp_size, split, 0x99);
+	_phase_end(gpp_size + SZ_8M);
+	if (res)
+		return res;
+
+	_phase_begin("emummc verify");
+	res |= _read_file("emuMMC/SD00/eMMC/BOOT0", 0, SZ_4M, 0xB0);
+	res |= _read_file("emuMMC/SD00/eMMC/BOOT1", 0, SZ_4M, 0xB1);
+	res |= _multipart_op(_read_file, "emuMMC/SD00/eMMC", true, gpp_size, split, 0x99);
+	_phase_end(gpp_size + SZ_8M);
+
+	return res;
+}
+
+static int _wl_dump(int argc, char **argv)
+{
+	u64 size = (u64)(argc > 0 ? atoi(argv[0]) : 4096) << 20;
+	u64 split = (sd_fs.fs_type != FS_EXFAT && size > FAT32_FILESIZE_LIMIT) ? BACKUP_SPLIT_SIZE : 0;
+	if (argc > 1)
+		split = (u64)atoi(argv[1]) << 20;
+	int res = 0;
+
+	f_mkdir("backup");
+	f_mkdir("backup/00000000");
+	f_mkdir("backup/00000000/restore");
+
+	_phase_begin("dump write");
+	res = _multipart_op(_write_file, "backup/00000000/rawnand.bin", false, size, split, 0xDA);
+	_phase_end(size);
+	if (res)
+		return res;
+
+	_phase_begin("dump verify");
+	res = _multipart_op(_read_file, "backup/00000000/rawnand.bin", false, size, split, 0xDA);
+	_phase_end(size);
+
+	return res;
+}
+
+static void _jdump_path(char *path, const char *base_path, u64 split, u32 part)
+{
+	if (split)
+		sprintf(path, "%s.%02d", base_path, part);
+	else
+		strcpy(path, base_path);
+}
+
+// Running hash of a part in a single pass. Must match the one the journal carried. Returns 2 if not.
+static int _jdump_run_hash_check(nx_emmc_jrnl_t *jrnl, u64 start, u64 size)
+{
+	u8 hash[SHA256_SIZE * 2];
+
+	memset(hash, 0, SHA256_SIZE);
+	for (u64 pos = 0; pos < size; pos += BUF_SIZE)
+	{
+		u32 num = MIN(size - pos, BUF_SIZE);
+		_fill_pattern(buf, start + pos, num, 0x4A);
+		sha256(hash + SHA256_SIZE, buf, num);
+		sha256(hash, hash, sizeof(hash));
+	}
+
+	if (memcmp(hash, jrnl->rec.run_hash, SHA256_SIZE))
+	{
+		printf("Running hash mismatch @ %llu MiB\n", start >> 20);
+		return 2;
+	}
+
+	return 0;
+}
+
+// Journaled backup, same as Nyx. Continues from the journal if there is one.
+static int _jdump_run(const char *base_path, u64 size, u64 split)
+{
+	nx_emmc_jrnl_t jrnl;
+	char jrnl_path[256];
+	char path[256];
+	u8 hash[SHA256_SIZE];
+	FIL fp;
+	UINT bw;
+	int res;
+
+	sprintf(jrnl_path, "%s"NX_EMMC_JRNL_EXT, base_path);
+	bool resume = !nx_emmc_jrnl_load(&jrnl, jrnl_path, 0, size >> 9);
+	if (!resume && nx_emmc_jrnl_create(&jrnl, jrnl_path, 0, size >> 9, split, 0))
+		return 1;
+
+	u32 part = jrnl.rec.part_idx;
+	u64 off  = jrnl.rec.part_off;
+	u64 pos  = (u64)jrnl.rec.sct_done << 9;
+	u64 last = pos;
+	if (resume)
+		printf("  resume @ %llu MiB (part %d @ %llu MiB)\n", pos >> 20, part, off >> 20);
+
+	_jdump_path(path, base_path, split, part);
+	res = f_open(&fp, path, off ? (FA_OPEN_EXISTING | FA_READ | FA_WRITE) : (FA_CREATE_ALWAYS | FA_WRITE));
+	if (!res)
+		res = nx_emmc_jrnl_check(&jrnl, &fp, buf, BUF_SIZE);
+	if (!res)
+		res = f_lseek(&fp, off);
+	if (res && !ffb_disk_cut_hit())
+		printf("Error (%d) while continuing %s\n", res, path);
+
+	while (!res && pos < size)
+	{
+		// Record the next part before creating it.
+		if (split && off >= split)
+		{
+			if (_jdump_run_hash_check(&jrnl, pos - off, off))
+				return 2;
+
+			part++;
+			off  = 0;
+			last = pos;
+			_jdump_path(path, base_path, split, part);
+
+			res = f_close(&fp);
+			if (!res)
+				res = nx_emmc_jrnl_commit(&jrnl, NULL, pos >> 9, part, 0);
+			if (!res)
+				res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+			if (res)
+				break;
+		}
+
+		u32 num = MIN(size - pos, BUF_SIZE);
+		_fill_pattern(buf, pos, num, 0x4A);
+		sha256(hash, buf, num);
+
+		res = f_write(&fp, buf, num, &bw);
+		if (res)
+			break;
+
+		nx_emmc_jrnl_chunk(&jrnl, hash);
+		pos += num;
+		off += num;
+
+		if (pos < size && !(split && off >= split) && (pos - last) >= NX_EMMC_JRNL_INTERVAL)
+		{
+			res = nx_emmc_jrnl_commit(&jrnl, &fp, pos >> 9, part, off);
+			last = pos;
+		}
+	}
+
+	// Power is lost. Objects are dropped on remount.
+	if (res)
+		return 1;
+
+	res = f_close(&fp);
+	if (!res)
+		res = _jdump_run_hash_check(&jrnl, pos - off, off);
+	nx_emmc_jrnl_remove(&jrnl);
+
+	return res;
+}
+
+static int _wl_jdump(int argc, char **argv)
+{
+	static const char *path = "backup/00000000/jrnl.bin";
+	u64 size  = (u64)(argc > 0 ? atoi(argv[0]) : 512) << 20;
+	u64 split = (u64)(argc > 1 ? atoi(argv[1]) : 0) << 20;
+	FILINFO fno;
+	int res;
+
+	f_mkdir("backup");
+	f_mkdir("backup/00000000");
+
+	// Lose power after the given amount of writes, then remount and continue.
+	for (int i = 2; i < argc; i++)
+	{
+		_phase_begin("jdump cut");
+		ffb_disk_set_cut((u64)atoi(argv[i]) << 11);
+		res = _jdump_run(path, size, split);
+		ffb_disk_set_cut(0);
+		_phase_end(0);
+
+		if (!res)
+		{
+			printf("Backup finished before power loss at %s MiB\n", argv[i]);
+			return 1;
+		}
+		else if (res == 2)
+			return 1;
+
+		f_mount(NULL, "", 0);
+		res = f_mount(&sd_fs, "", 1);
+		if (res)
+		{
+			printf("Failed to remount %s (%d)\n", ffb_image, res);
+			return 1;
+		}
+	}
+
+	_phase_begin("jdump finish");
+	res = _jdump_run(path, size, split);
+	_phase_end(size);
+	if (res)
+		return res;
+
+	// Journal is removed when done.
+	char jrnl_path[256];
+	sprintf(jrnl_path, "%s"NX_EMMC_JRNL_EXT, path);
+	if (f_stat(jrnl_path, &fno) != FR_NO_FILE)
+	{
+		printf("Journal was not removed\n");
+		return 1;
+	}
+
+	_phase_begin("jdump verify");
+	res = _multipart_op(_read_file, path, false, size, split, 0x4A);
+	_phase_end(size);
+
+	return res;
+}
+
+#if FF_FASTFS
+// Leaves free space only in 1 MiB holes, so contiguous allocation fails.
+static int _emulayout_fragment(bool remove_all)
+{
+	static const u32 FILL_SIZE = SZ_1M;
+	char path[64];
+	DWORD free_clst;
+	FATFS *fs;
+	FIL fp;
+	UINT bw;
+	int res = 0;
+
+	if (remove_all)
+	{
+		for (u32 i = 1; ; i += 2)
+		{
+			sprintf(path, "fill/%05d", i);
+			if (f_unlink(path))
+				break;
+		}
+
+		return f_unlink("fill");
+	}
+
+	f_mkdir("fill");
+	f_getfree("", &free_clst, &fs);
+	u32 files = ((u64)free_clst * fs->csize * 512) / FILL_SIZE;
+
+	memset(buf, 0, FILL_SIZE);
+	for (u32 i = 0; i < files && !res; i++)
+	{
+		sprintf(path, "fill/%05d", i);
+		res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+		if (res)
+			break;
+		res = f_write(&fp, buf, FILL_SIZE, &bw);
+		f_close(&fp);
+
+		// Disk is full.
+		if (res || bw != FILL_SIZE)
+		{
+			f_unlink(path);
+			res = 0;
+			break;
+		}
+	}
+
+	for (u32 i = 0; i < files && !res; i += 2)
+	{
+		sprintf(path, "fill/%05d", i);
+		f_unlink(path);
+	}
+
+	return res;
+}
+
+static int _emulayout_write(nx_emmc_layout_t *lt, u32 mmc_part, u32 sectors, u32 seed)
+{
+	for (u32 sector = 0; sector < sectors; )
+	{
+		u32 num = MIN(sectors - sector, BUF_SIZE >> 9);
+		_fill_pattern(buf, (u64)sector << 9, num << 9, seed);
+
+		// Same as Nyx. Chunks are written straight to the SD sectors of the files.
+		for (u32 done = 0; done < num; )
+		{
+			u32 sd_sector;
+			u32 cnt = nx_emmc_layout_map(lt, mmc_part, sector + done, &sd_sector);
+			if (!cnt)
+			{
+				printf("Unmapped sector %x of part %d\n", sector + done, mmc_part);
+				return 1;
+			}
+
+			cnt = MIN(cnt, num - done);
+			if (disk_write(DRIVE_SD, buf + (done << 9), sd_sector, cnt))
+				return 1;
+			done += cnt;
+		}
+
+		sector += num;
+	}
+
+	return 0;
+}
+
+// File based emuMMC with preallocated files and direct sector writes, same as Nyx.
+static int _wl_emulayout(int argc, char **argv)
+{
+	u32 gpp_sectors = (argc > 0 ? atoi(argv[0]) : 1100) << 11;
+	u32 part_sectors = (argc > 1 ? atoi(argv[1]) : 256) << 11;
+	bool frag = argc > 2 && !strcmp(argv[2], "frag");
+	const char *base = frag ? "emuMMC/SD02" : "emuMMC/SD01";
+	char emmc_path[64];
+	char layout_path[64];
+	char path[64];
+	FIL fp;
+	int res = 0;
+
+	nx_emmc_layout_t *lt = malloc(sizeof(nx_emmc_layout_t));
+	nx_emmc_layout_init(lt, part_sectors);
+
+	if (frag && _emulayout_fragment(false))
+		goto out;
+
+	sprintf(emmc_path, "%s/eMMC", base);
+	f_mkdir("emuMMC");
+	f_mkdir(base);
+	f_mkdir(emmc_path);
+
+	_phase_begin("emulayout alloc");
+	u32 files = 2 + (gpp_sectors + part_sectors - 1) / part_sectors;
+	for (u32 i = 0; i < files && !res; i++)
+	{
+		u32 sectors = i < 2 ? (SZ_4M >> 9) : MIN(gpp_sectors - (i - 2) * part_sectors, part_sectors);
+		nx_emmc_layout_file_path(path, emmc_path, i);
+
+		res = f_open(&fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+		if (res)
+			break;
+
+		DWORD *clmt = f_alloc_cltbl(&fp, SZ_4M, (u64)sectors << 9);
+		res = clmt ? nx_emmc_layout_add(lt, &fp) : FR_DENIED;
+		res |= f_close(&fp);
+		free(clmt);
+	}
+	_phase_end(0);
+
+	printf("  %d files, %d fragments\n", lt->hdr.file_cnt, lt->hdr.run_cnt);
+	if (res)
+	{
+		printf("Error (%d) while allocating %s\n", res, path);
+		goto out;
+	}
+
+	// Contiguous allocation must be used when there is space for it.
+	if (!frag && lt->hdr.run_cnt > files)
+	{
+		printf("Files are fragmented\n");
+		res = 1;
+		goto out;
+	}
+
+	_phase_begin("emulayout write");
+	res |= _emulayout_write(lt, 1, SZ_4M >> 9, 0xB0);
+	res |= _emulayout_write(lt, 2, SZ_4M >> 9, 0xB1);
+	res |= _emulayout_write(lt, 0, gpp_sectors, 0x99);
+	_phase_end(((u64)gpp_sectors << 9) + SZ_8M);
+	if (res)
+		goto out;
+
+	sprintf(layout_path, "%s/"NX_EMMC_LAYOUT_NAME, base);
+	res = nx_emmc_layout_save(lt, layout_path);
+	if (!res)
+		res = nx_emmc_layout_load(lt, layout_path, emmc_path);
+	if (res)
+	{
+		printf("Error (%d) while saving or loading layout\n", res);
+		goto out;
+	}
+
+	// Files must read back through FatFs.
+	_phase_begin("emulayout verify");
+	nx_emmc_layout_file_path(path, emmc_path, 0);
+	res |= _read_file(path, 0, SZ_4M, 0xB0);
+	nx_emmc_layout_file_path(path, emmc_path, 1);
+	res |= _read_file(path, 0, SZ_4M, 0xB1);
+	res |= _multipart_op(_read_file, emmc_path, true, (u64)gpp_sectors << 9, (u64)part_sectors << 9, 0x99);
+	_phase_end(((u64)gpp_sectors << 9) + SZ_8M);
+	if (res)
+		goto out;
+
+	// Layout built from the cluster tables of the files must match the saved one.
+	nx_emmc_layout_t *built = malloc(sizeof(nx_emmc_layout_t));
+	res = nx_emmc_layout_build(built, emmc_path);
+	if (!res && (memcmp(&built->hdr, &lt->hdr, sizeof(built->hdr)) || memcmp(built->files, lt->files, lt->hdr.file_cnt * sizeof(nx_emmc_layout_file_t)) ||
+		memcmp(built->runs, lt->runs, lt->hdr.run_cnt * sizeof(nx_emmc_layout_run_t))))
+		res = 1;
+	if (res)
+	{
+		free(built);
+		printf("Error (%d) while building layout\n", res);
+		goto out;
+	}
+
+	// Layout is rejected if a run does not follow the FAT chain, even with the same start cluster and size.
+	nx_emmc_layout_file_t *gpp = &built->files[2];
+	built->runs[gpp->run_idx + gpp->run_cnt - 1].sector += 1;
+	res = nx_emmc_layout_save(built, layout_path);
+	if (!res && !nx_emmc_layout_load(built, layout_path, emmc_path))
+	{
+		printf("Moved run was accepted\n");
+		res = 1;
+	}
+	free(built);
+	res |= nx_emmc_layout_save(lt, layout_path);
+	if (res)
+		goto out;
+
+	// Layout is rejected if a file is not the described one.
+	char moved[sizeof(path) + 4];
+	nx_emmc_layout_file_path(path, emmc_path, 2);
+	sprintf(moved, "%s.bak", path);
+	f_rename(path, moved);
+	if (!nx_emmc_layout_load(lt, layout_path, emmc_path))
+	{
+		printf("Stale layout was accepted\n");
+		res = 1;
+	}
+	f_rename(moved, path);
+
+	if (frag)
+		res |= _emulayout_fragment(true);
+
+out:
+	free(lt);
+
+	return !!res;
+}
+#endif
+
+#if FF_FASTFS
+static int _bench_abort(void *data, u32 pct)
+{
+	return pct >= *(u32 *)data;
+}
+
+static int _bench_check(const sdmmc_bench_test_t *test, const sdmmc_bench_res_t *res)
+{
+	u32 ops = MIN(test->size_sct / test->blk_sct, SDMMC_BENCH_OPS_MAX);
+
+	return res->ops != ops || !res->time_us || !res->rate_kbs || !res->iops ||
+		res->lat_p50 > res->lat_p99 || res->lat_p99 > res->lat_max || res->lat_max > res->time_us;
+}
+
+// Storage benchmark suite on a temporary file, same as Nyx.
+static int _wl_bench(int argc, char **argv)
+{
+	u64 size = (u64)(argc > 0 ? atoi(argv[0]) : 256) << 20;
+	const char *csv_path = argc > 1 ? argv[1] : NULL;
+	char name[SDMMC_BENCH_NAME_SZ];
+	char *csv = malloc(SZ_16K);
+	sdmmc_storage_t storage = {0};
+	sdmmc_bench_t bench = {0};
+	sdmmc_bench_res_t res0, res1;
+	FIL fp;
+	int res = 0;
+
+	res = f_open(&fp, "bench.tmp", FA_CREATE_ALWAYS | FA_WRITE);
+	if (res)
+		goto out;
+
+	DWORD *clmt = f_alloc_cltbl(&fp, SZ_4M, size);
+	if (!clmt)
+	{
+		f_close(&fp);
+		res = FR_DENIED;
+		goto out;
+	}
+
+	// Largest fragment, aligned to 4MB.
+	DWORD clst = 0, nclst = 0;
+	for (DWORD *tbl = clmt + 1; tbl[0]; tbl += 2)
+	{
+		if (tbl[0] > nclst)
+		{
+			nclst = tbl[0];
+			clst  = tbl[1];
+		}
+	}
+	u32 start = f_clst2sect(&fp, clst);
+	u32 end = start + MIN((u64)nclst * sd_fs.csize, size >> 9);
+	bench.sector = ALIGN(start, SDMMC_BENCH_BLK_MAX);
+	bench.count  = end > bench.sector ? end - bench.sector : 0;
+	f_close(&fp);
+	free(clmt);
+
+	bench.storage  = &storage;
+	bench.writable = true;
+	bench.buf      = aligned_alloc(SZ_4K, SDMMC_BENCH_BUF_SIZE);
+	bench.lat      = malloc(SDMMC_BENCH_OPS_MAX * sizeof(u32));
+	sdmmc_host_set_region(bench.sector, bench.count);
+
+	printf("[%sbench] region %x, %d MiB\n", ffb_variant, bench.sector, bench.count >> 11);
+	strcpy(csv, SDMMC_BENCH_CSV_HDR);
+
+	for (u32 i = 0; i < sdmmc_bench_suite_cnt && !res; i++)
+	{
+		const sdmmc_bench_test_t *test = &sdmmc_bench_suite[i];
+
+		res = sdmmc_bench_run(&bench, test, &res0);
+		sdmmc_bench_name(name, test);
+		if (!res && _bench_check(test, &res0))
+		{
+			printf("Bad result for %s\n", name);
+			res = 1;
+		}
+		if (res)
+			break;
+
+		printf("  %-17s %5d.%02d MB/s %6d IOPS | p50 %6d us, p99 %6d us, max %6d us\n", name,
+			res0.rate_kbs / 1000, (res0.rate_kbs % 1000) / 10, res0.iops, res0.lat_p50, res0.lat_p99, res0.lat_max);
+		sdmmc_bench_csv(csv + strlen(csv), "host", test, &res0);
+	}
+	if (res)
+	{
+		printf("Error (%d) while running benchmark\n", res);
+		goto out_free;
+	}
+
+	// Same seed must give the same results.
+	const sdmmc_bench_test_t *mixed = &sdmmc_bench_suite[sdmmc_bench_suite_cnt - 1];
+	res = sdmmc_bench_run(&bench, mixed, &res0) || sdmmc_bench_run(&bench, mixed, &res1) ||
+		memcmp(&res0, &res1, sizeof(sdmmc_bench_res_t));
+	if (res)
+	{
+		printf("Results are not repeatable\n");
+		goto out_free;
+	}
+
+	// Abort must not leave a command in flight.
+	u32 abort_pct = 50;
+	bench.progress = _bench_abort;
+	bench.data = &abort_pct;
+	if (sdmmc_bench_run(&bench, mixed, &res0) != -1)
+	{
+		printf("Abort was ignored\n");
+		res = 1;
+		goto out_free;
+	}
+	bench.progress = NULL;
+
+	// Writes are refused on read only regions.
+	bench.writable = false;
+	if (sdmmc_bench_run(&bench, mixed, &res0) != 1 || sdmmc_bench_run(&bench, &sdmmc_bench_suite[0], &res0))
+	{
+		printf("Read only region was not respected\n");
+		res = 1;
+		goto out_free;
+	}
+
+	if (csv_path)
+	{
+		FILE *f = fopen(csv_path, "w");
+		if (!f || fwrite(csv, 1, strlen(csv), f) != strlen(csv))
+			res = 1;
+		if (f)
+			fclose(f);
+	}
+
+out_free:
+	sdmmc_host_set_region(0, 0);
+	free(bench.buf);
+	free(bench.lat);
+	res |= f_unlink("bench.tmp");
+
+out:
+	free(csv);
+
+	return !!res;
+}
+#endif
+
+static int _tree_create(char *path, u32 depth, u32 fanout, u32 files, u32 *entries)
+{
+	u32 len = strlen(path);
+	int res = 0;
+
+	for (u32 i = 0; i < files && !res; i++)
+	{
+		sprintf(path + len, "/file_%04d.bin", i);
+		res = _write_file(path, 0, 1024, i);
+		(*entries)++;
+	}
+
+	for (u32 i = 0; i < fanout && depth && !res; i++)
+	{
+		sprintf(path + len, "/directory_%04d", i);
+		res = f_mkdir(path);
+		if (res == FR_EXIST)
+			res = FR_OK;
+		(*entries)++;
+		if (!res)
+			res = _tree_create(path, depth - 1, fanout, files, entries);
+	}
+	path[len] = 0;
+
+	return res;
+}
+
+// Same access pattern as the archive bit fixer in Nyx.
+static int _tree_walk(char *path, u32 *entries)
+{
+	DIR dir;
+	DIRENT ents[16];
+	UINT cnt;
+	int res = f_opendir(&dir, path);
+	if (res)
+		return res;
+
+	u32 len = strlen(path);
+	for (;;)
+	{
+		res = f_readdir_batch(&dir, ents, ARRAY_SIZE(ents), &cnt);
+		if (res || !cnt)
+			break;
+
+		for (u32 i = 0; i < cnt && !res; i++)
+		{
+			(*entries)++;
+			if (!(ents[i].fattrib & AM_DIR))
+				continue;
+
+			path[len] = '/';
+			strcpy(&path[len + 1], ents[i].fname);
+
+			strcat(path, "/00");
+			f_stat_at(&dir, &path[len + 1], NULL);
+			path[strlen(path) - 3] = 0;
+
+			res = _tree_walk(path, entries);
+		}
+		if (res)
+			break;
+	}
+	path[len] = 0;
+	f_closedir(&dir);
+
+	return res;
+}
+
+static int _wl_tree(int argc, char **argv)
+{
+	u32 depth  = argc > 0 ? atoi(argv[0]) : 4;
+	u32 fanout = argc > 1 ? atoi(argv[1]) : 4;
+	u32 files  = argc > 2 ? atoi(argv[2]) : 8;
+	u32 created = 0;
+	u32 walked = 0;
+	char path[1024] = "tree";
+
+	f_mkdir(path);
+
+	_phase_begin("tree create");
+	int res = _tree_create(path, depth, fanout, files, &created);
+	_phase_end(0);
+	if (res)
+	{
+		printf("Error (%d) while creating %s\n", res, path);
+		return res;
+	}
+
+	_phase_begin("tree walk");
+	res = _tree_walk(path, &walked);
+	_phase_end(0);
+
+	printf("  entries: %d created, %d walked\n", created, walked);
+	if (!res && created != walked)
+		res = 1;
+
+	return res;
+}
+
+typedef struct _ffb_workload_t
+{
+	const char *name;
+	int (*run)(int argc, char **argv);
+	bool needs_mount; // Otherwise the workload opens the image itself.
+	const char *usage;
+} ffb_workload_t;
+
+static const ffb_workload_t workloads[] = {
+#if FF_USE_MKFS
+	{ "mkfs",   _wl_mkfs,   false, "<size MiB> [fat32|exfat] [cluster KiB]" },
+#endif
+	{ "emummc", _wl_emummc, true,  "[GPP MiB] [split MiB]" },
+	{ "dump",   _wl_dump,   true,  "[MiB] [split MiB]" },
+	{ "jdump",  _wl_jdump,  true,  "[MiB] [split MiB] [power loss after MiB...]" },
+#if FF_FASTFS
+	{ "emulayout", _wl_emulayout, true, "[GPP MiB] [split MiB] [frag]" },
+	{ "bench",  _wl_bench,  true,  "[region MiB] [csv path]" },
+#endif
+	{ "tree",   _wl_tree,   true,  "[depth] [fanout] [files]" },
+};
+
+static void _usage(const char *prog)
+{
+	printf("Usage: %s [-l rd_cmd_us,rd_sct_ns,wr_cmd_us,wr_sct_ns] <image> <workload> [args]\n", prog);
+	for (u32 i = 0; i < ARRAY_SIZE(workloads); i++)
+		printf("  %-8s %s\n", workloads[i].name, workloads[i].usage);
+}
+
+int main(int argc, char **argv)
+{
+	const char *prog = argv[0];
+	int res = 1;
+
+	if (argc > 2 && !strcmp(argv[1], "-l"))
+	{
+		ffb_latency_t lat;
+		if (sscanf(argv[2], "%u,%u,%u,%u", &lat.rd_cmd_us, &lat.rd_sct_ns, &lat.wr_cmd_us, &lat.wr_sct_ns) != 4)
+		{
+			_usage(prog);
+			return 1;
+		}
+		ffb_disk_set_latency(&lat);
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 3)
+	{
+		_usage(prog);
+		return 1;
+	}
+
+	ffb_image = argv[1];
+
+#ifdef FFB_VARIANT
+	ffb_variant = FFB_VARIANT " ";
+#endif
+
+	const ffb_workload_t *wl = NULL;
+	for (u32 i = 0; i < ARRAY_SIZE(workloads); i++)
+		if (!strcmp(argv[2], workloads[i].name))
+			wl = &workloads[i];
+
+	if (!wl)
+	{
+		_usage(prog);
+		return 1;
+	}
+
+	buf = aligned_alloc(SZ_4K, BUF_SIZE);
+
+	if (wl->needs_mount)
+	{
+		if (ffb_disk_open(ffb_image, 0))
+		{
+			printf("Failed to open %s\n", ffb_image);
+			goto out;
+		}
+
+		res = f_mount(&sd_fs, "", 1);
+		if (res)
+		{
+			printf("Failed to mount %s (%d)\n", ffb_image, res);
+			goto out;
+		}
+	}
+
+	res = wl->run(argc - 3, argv + 3);
+
+	if (wl->needs_mount)
+		f_mount(NULL, "", 0);
+
+out:
+	ffb_disk_close();
+	free(buf);
+
+	return !!res;
+}
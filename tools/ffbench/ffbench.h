@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FFBENCH_H_
+#define _FFBENCH_H_
+
+#include <utils/types.h>
+
+#define FFB_HIST_BUCKETS 18 // 1 sector to 64MB, in powers of 2.
+
+typedef struct _ffb_latency_t
+{
+	u32 rd_cmd_us;  // Per command overhead.
+	u32 rd_sct_ns;  // Per sector transfer.
+	u32 wr_cmd_us;
+	u32 wr_sct_ns;
+} ffb_latency_t;
+
+typedef struct _ffb_disk_stats_t
+{
+	u64 rd_cmds;
+	u64 wr_cmds;
+	u64 rd_scts;
+	u64 wr_scts;
+	u64 syncs;
+	u64 rd_hist[FFB_HIST_BUCKETS];
+	u64 wr_hist[FFB_HIST_BUCKETS];
+	u64 time_ns;    // Simulated device time.
+} ffb_disk_stats_t;
+
+int  ffb_disk_open(const char *path, u32 create_mb);
+void ffb_disk_close();
+u32  ffb_disk_sectors();
+void ffb_disk_set_latency(const ffb_latency_t *lat);
+void ffb_disk_set_cut(u64 sectors); // Power loss after that many sectors are written. 0 disables.
+bool ffb_disk_cut_hit();
+void ffb_disk_stats_reset();
+void ffb_disk_stats_get(ffb_disk_stats_t *stats);
+
+void sdmmc_host_set_region(u32 sector, u32 count); // Accesses outside of it fail.
+
+#endif
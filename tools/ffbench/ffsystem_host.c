@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <libs/fatfs/ff.h>
+
+#if FF_USE_LFN == 3	/* Dynamic memory allocation */
+
+void *ff_memalloc(UINT msize)
+{
+	// Ensure size is aligned to SDMMC block size.
+	return malloc(ALIGN(msize, 512));
+}
+
+void ff_memfree(void *mblock)
+{
+	free(mblock);
+}
+
+#endif
+
+#if FF_FS_NORTC == 0
+
+DWORD get_fattime()
+{
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+
+	return (((DWORD)(tm->tm_year - 80) << 25) | ((DWORD)(tm->tm_mon + 1) << 21) | ((DWORD)tm->tm_mday << 16) |
+		((DWORD)tm->tm_hour << 11) | ((DWORD)tm->tm_min << 5) | (tm->tm_sec >> 1));
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libs/fatfs/diskio.h>
+#include <soc/timer.h>
+#include <storage/sdmmc.h>
+
+#include "ffbench.h"
+
+/*
+ * SDMMC storage on the disk image.
+ * Time is the simulated device time, so results are the same on every run.
+ * It only advances on I/O, so pipelined tests match their QD1 ones.
+ * Only one asynchronous command can be in flight, same as the controller.
+ */
+
+static u64 host_ns = 0;
+static u64 busy_ns = 0;
+static bool pending = false;
+static int pending_res = 0;
+static u32 region_start = 0;
+static u32 region_count = 0;
+
+void sdmmc_host_set_region(u32 sector, u32 count)
+{
+	region_start = sector;
+	region_count = count;
+}
+
+u32 get_tmr_us()
+{
+	return host_ns / 1000;
+}
+
+u32 get_tmr_ms()
+{
+	return host_ns / 1000000;
+}
+
+static int _host_rw(u32 sector, u32 num_sectors, void *buf, bool is_write, u64 *cost_ns)
+{
+	ffb_disk_stats_t before, after;
+
+	if (!num_sectors || sector < region_start || (u64)sector + num_sectors > (u64)region_start + region_count)
+		return 1;
+
+	ffb_disk_stats_get(&before);
+	int res = is_write ? disk_write(DRIVE_SD, buf, sector, num_sectors) : disk_read(DRIVE_SD, buf, sector, num_sectors);
+	ffb_disk_stats_get(&after);
+
+	// Whole us, same as the timer. Otherwise results depend on the start time.
+	*cost_ns = (after.time_ns - before.time_ns + 999) / 1000 * 1000;
+
+	return res;
+}
+
+static int _host_sync(u32 sector, u32 num_sectors, void *buf, bool is_write)
+{
+	u64 cost_ns;
+
+	if (pending)
+		return 1;
+
+	int res = _host_rw(sector, num_sectors, buf, is_write, &cost_ns);
+	host_ns = MAX(host_ns, busy_ns) + cost_ns;
+
+	return res;
+}
+
+static int _host_async(u32 sector, u32 num_sectors, void *buf, bool is_write)
+{
+	u64 cost_ns;
+
+	if (pending)
+		return 1;
+
+	// Data is transferred right away. Completion time is kept for async end.
+	pending_res = _host_rw(sector, num_sectors, buf, is_write, &cost_ns);
+	busy_ns = MAX(host_ns, busy_ns) + cost_ns;
+	pending = true;
+
+	return 0;
+}
+
+int sdmmc_storage_read(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _host_sync(sector, num_sectors, buf, false);
+}
+
+int sdmmc_storage_write(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _host_sync(sector, num_sectors, buf, true);
+}
+
+int sdmmc_storage_read_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _host_async(sector, num_sectors, buf, false);
+}
+
+int sdmmc_storage_write_async(sdmmc_storage_t *storage, u32 sector, u32 num_sectors, void *buf)
+{
+	return _host_async(sector, num_sectors, buf, true);
+}
+
+int sdmmc_storage_async_end(sdmmc_storage_t *storage)
+{
+	if (!pending)
+		return 1;
+
+	pending = false;
+	host_ns = MAX(host_ns, busy_ns);
+
+	return pending_res;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sec/se.h>
+
+#include "../nxcz/sha256.h"
+
+// Software SHA-256 in place of the Security Engine.
+int se_sha_hash_256_oneshot(void *hash, const void *src, u32 size)
+{
+	sha256(hash, src, size);
+
+	return 0;
+}
@@ -0,0 +1,1162 @@
+/*
+ * Compressed eMMC backup tool
+ *
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Inspects, verifies, unpacks and packs the compressed backups made by Nyx.
+ * Also verifies and garbage collects the shared chunk store.
+ * See bdk/storage/nx_emmc_cz.h for the container layout.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <libs/compr/lz4.h>
+#include <storage/nx_emmc_cz.h>
+
+#include "sha256.h"
+
+#define CHUNK_BOUND LZ4_COMPRESSBOUND(NX_EMMC_CZ_CHUNK_SIZE)
+#define PATH_SZ     4096
+#define OBJ_PATH_SZ (PATH_SZ + SHA256_SIZE * 2 + 8) // Store object.
+
+typedef struct _cz_t
+{
+	nx_emmc_cz_hdr_t hdr;
+	nx_emmc_cz_chunk_t *idx;
+	struct _cz_t *parent; // Previous incremental level.
+	char path[PATH_SZ];   // Index file.
+	FILE *fp;             // Opened data file.
+	int part;
+	u8 *buf;              // Uncompressed chunk.
+	u8 *cbuf;             // Stored chunk.
+} cz_t;
+
+// Chunk store. Found next to the backup folders if not set.
+static char store_dir[PATH_SZ];
+static bool store_set = false;
+
+static bool mem_is_zero(const void *buf, u32 size)
+{
+	const u8 *p = buf;
+
+	return !size || (!p[0] && !memcmp(p, p + 1, size - 1));
+}
+
+// lz4.c allocates through the bdk heap API.
+void *zalloc(u32 size)
+{
+	return calloc(1, size);
+}
+
+static FILE *_cz_fopen(const char *path, int part, const char *mode)
+{
+	char name[PATH_SZ + 4];
+
+	snprintf(name, sizeof(name), "%s.%02d", path, part);
+
+	return fopen(name, mode);
+}
+
+static int _cz_open_part(cz_t *cz, int part, const char *mode)
+{
+	if (cz->part == part)
+		return 0;
+
+	if (cz->fp)
+		fclose(cz->fp);
+	cz->part = -1;
+
+	cz->fp = _cz_fopen(cz->path, part, mode);
+	if (!cz->fp)
+	{
+		printf("Failed to open data file %02d of %s\n", part, cz->path);
+		return 1;
+	}
+	cz->part = part;
+
+	return 0;
+}
+
+static void _cz_init(cz_t *cz, const char *path, bool bufs)
+{
+	memset(cz, 0, sizeof(cz_t));
+	snprintf(cz->path, sizeof(cz->path), "%s", path);
+	cz->part = -1;
+
+	// Parents read through the buffers of the last level.
+	if (bufs)
+	{
+		cz->buf  = malloc(NX_EMMC_CZ_CHUNK_SIZE);
+		cz->cbuf = malloc(CHUNK_BOUND);
+	}
+}
+
+static void _cz_free(cz_t *cz)
+{
+	if (cz->fp)
+		fclose(cz->fp);
+	free(cz->idx);
+	free(cz->buf);
+	free(cz->cbuf);
+
+	if (cz->parent)
+	{
+		_cz_free(cz->parent);
+		free(cz->parent);
+	}
+}
+
+// Parses the level from <name>.dNN.nxcz. Returns 0 for <name>.nxcz.
+static u32 _cz_path_level(const char *path, u32 *base_len)
+{
+	u32 len = strlen(path);
+	u32 ext_len = strlen(NX_EMMC_CZ_EXT);
+
+	if (len >= ext_len && !strcmp(path + len - ext_len, NX_EMMC_CZ_EXT))
+		len -= ext_len;
+
+	*base_len = len;
+	if (len < 4)
+		return 0;
+
+	const char *lvl = path + len - 4;
+	if (lvl[0] != '.' || lvl[1] != 'd' || !isdigit((u8)lvl[2]) || !isdigit((u8)lvl[3]))
+		return 0;
+
+	*base_len = len - 4;
+
+	return (lvl[2] - '0') * 10 + (lvl[3] - '0');
+}
+
+static void _cz_level_path(char *out, const char *path, u32 level)
+{
+	u32 base_len;
+	_cz_path_level(path, &base_len);
+
+	if (!level)
+		snprintf(out, PATH_SZ, "%.*s"NX_EMMC_CZ_EXT, base_len, path);
+	else
+		snprintf(out, PATH_SZ, "%.*s.d%02u"NX_EMMC_CZ_EXT, base_len, path, level);
+}
+
+static void _cz_hash_str(char *str, const u8 *hash)
+{
+	for (u32 i = 0; i < SHA256_SIZE; i++)
+		sprintf(str + i * 2, "%02x", hash[i]);
+}
+
+static void _cz_store_path(char *out, const u8 *hash)
+{
+	char hash_str[SHA256_SIZE * 2 + 1];
+
+	_cz_hash_str(hash_str, hash);
+	snprintf(out, OBJ_PATH_SZ, "%s/%.2s/%s", store_dir, hash_str, hash_str);
+}
+
+// Looks for <dir>/store in every parent folder of the index, like backup/store on SD.
+static int _cz_store_find(const char *path)
+{
+	char dir[PATH_SZ - 8];
+	struct stat st;
+
+	if (store_set)
+		return 0;
+
+	snprintf(dir, sizeof(dir), "%s", path);
+	char *slash;
+	while ((slash = strrchr(dir, '/')))
+	{
+		*slash = 0;
+		snprintf(store_dir, sizeof(store_dir), "%s/store", dir[0] ? dir : "");
+		if (!stat(store_dir, &st) && S_ISDIR(st.st_mode))
+		{
+			store_set = true;
+			return 0;
+		}
+	}
+
+	if (!stat("store", &st) && S_ISDIR(st.st_mode))
+	{
+		strcpy(store_dir, "store");
+		store_set = true;
+		return 0;
+	}
+
+	printf("Chunk store not found. Set it with -s\n");
+
+	return 1;
+}
+
+// Returns 0 on success, 1 on I/O error and 2 on bad size.
+static int _cz_store_read(const u8 *hash, u8 *dst, u32 *size)
+{
+	char path[OBJ_PATH_SZ];
+
+	_cz_store_path(path, hash);
+	FILE *fp = fopen(path, "rb");
+	if (!fp)
+		return 1;
+
+	size_t br = fread(dst, 1, NX_EMMC_CZ_CHUNK_SIZE + 1, fp);
+	fclose(fp);
+	if (br > NX_EMMC_CZ_CHUNK_SIZE)
+		return 2;
+	*size = br;
+
+	return 0;
+}
+
+// Same as Nyx. Objects only get their final name when complete.
+static int _cz_store_write(const u8 *hash, const void *data, u32 size)
+{
+	char path[OBJ_PATH_SZ];
+	char tmp_path[OBJ_PATH_SZ + 4];
+
+	_cz_store_path(path, hash);
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+	// Create object folder.
+	char *slash = strrchr(tmp_path, '/');
+	*slash = 0;
+	mkdir(store_dir, 0755);
+	mkdir(tmp_path, 0755);
+	*slash = '/';
+
+	FILE *fp = fopen(tmp_path, "wb");
+	if (!fp)
+		return 1;
+
+	int res = fwrite(data, size, 1, fp) != 1;
+	if (fclose(fp))
+		res = 1;
+	if (!res)
+		res = rename(tmp_path, path);
+	if (res)
+	{
+		remove(tmp_path);
+		printf("Failed to write %s\n", path);
+	}
+
+	return res;
+}
+
+static u32 _cz_chunk_len(cz_t *cz, u32 chunk)
+{
+	u64 offset = (u64)chunk * cz->hdr.chunk_size;
+
+	return MIN(cz->hdr.chunk_size, cz->hdr.image_size - offset);
+}
+
+static int _cz_load(cz_t *cz)
+{
+	u8 hash[SHA256_SIZE];
+	nx_emmc_cz_hdr_t *hdr = &cz->hdr;
+	int res = 1;
+
+	FILE *fp = fopen(cz->path, "rb");
+	if (!fp)
+	{
+		printf("Failed to open %s\n", cz->path);
+		return 1;
+	}
+
+	if (fread(hdr, sizeof(nx_emmc_cz_hdr_t), 1, fp) != 1 || hdr->magic != NX_EMMC_CZ_MAGIC)
+	{
+		printf("Not a compressed backup index\n");
+		goto out;
+	}
+
+	// Version 1 has no chain id.
+	if (hdr->version == 1)
+	{
+		memset((u8 *)hdr + NX_EMMC_CZ_HDR_V1_SIZE, 0, sizeof(nx_emmc_cz_hdr_t) - NX_EMMC_CZ_HDR_V1_SIZE);
+		fseeko(fp, NX_EMMC_CZ_HDR_V1_SIZE, SEEK_SET);
+	}
+
+	u64 chunk_cnt = hdr->chunk_size ? (hdr->image_size + hdr->chunk_size - 1) / hdr->chunk_size : 0;
+	if ((hdr->version != 1 && hdr->version != NX_EMMC_CZ_VERSION) || hdr->chunk_size != NX_EMMC_CZ_CHUNK_SIZE ||
+		!hdr->chunk_cnt || hdr->chunk_cnt != chunk_cnt)
+	{
+		printf("Unsupported index (version %u, chunk size %u)\n", hdr->version, hdr->chunk_size);
+		goto out;
+	}
+
+	u32 idx_size = hdr->chunk_cnt * sizeof(nx_emmc_cz_chunk_t);
+	cz->idx = malloc(idx_size);
+	if (fread(cz->idx, idx_size, 1, fp) != 1)
+	{
+		printf("Index is truncated\n");
+		goto out;
+	}
+
+	sha256(hash, cz->idx, idx_size);
+	if (memcmp(hash, hdr->idx_hash, SHA256_SIZE))
+	{
+		printf("Index hash mismatch\n");
+		goto out;
+	}
+
+	// Load the previous levels of an incremental backup.
+	if (hdr->level)
+	{
+		char path[PATH_SZ];
+		_cz_level_path(path, cz->path, hdr->level - 1);
+
+		cz->parent = malloc(sizeof(cz_t));
+		_cz_init(cz->parent, path, false);
+		if (_cz_load(cz->parent))
+			goto out;
+
+		nx_emmc_cz_hdr_t *phdr = &cz->parent->hdr;
+		if (phdr->chain_id != hdr->chain_id)
+		{
+			printf("%s is stale. It belongs to an older full backup\n", cz->path);
+			goto out;
+		}
+
+		if (phdr->level != hdr->level - 1 || phdr->image_size != hdr->image_size ||
+			memcmp(phdr->idx_hash, hdr->parent_hash, SHA256_SIZE))
+		{
+			printf("%s is not the parent of %s\n", path, cz->path);
+			goto out;
+		}
+	}
+
+	res = 0;
+
+out:
+	fclose(fp);
+
+	return res;
+}
+
+// Returns 0 on success, 1 on I/O error and 2 on corrupted data.
+static int _cz_read_chunk(cz_t *cz, u32 chunk)
+{
+	u8 hash[SHA256_SIZE];
+	u32 len = _cz_chunk_len(cz, chunk);
+
+	// Follow unchanged chunks to the level that stores them.
+	cz_t *level = cz;
+	while (level && level->idx[chunk].type == NX_EMMC_CZ_CHUNK_PARENT)
+		level = level->parent;
+	if (!level)
+		return 2;
+
+	nx_emmc_cz_chunk_t *entry = &level->idx[chunk];
+	u8 *src = entry->type == NX_EMMC_CZ_CHUNK_RAW ? cz->buf : cz->cbuf;
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_ZERO)
+	{
+		memset(cz->buf, 0, len);
+		goto hash;
+	}
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_STORE)
+	{
+		// Raw if it has the chunk length, otherwise LZ4.
+		u32 size;
+		if (_cz_store_find(cz->path))
+			return 1;
+
+		int res = _cz_store_read(entry->hash, cz->cbuf, &size);
+		if (res)
+			return res;
+		if (size != entry->size || size > len)
+			return 2;
+
+		if (size == len)
+			memcpy(cz->buf, cz->cbuf, len);
+		else if (LZ4_decompress_safe((const char *)cz->cbuf, (char *)cz->buf, size, len) != (int)len)
+			return 2;
+
+		goto hash;
+	}
+
+	if ((entry->type == NX_EMMC_CZ_CHUNK_RAW && entry->size != len) ||
+		(entry->type == NX_EMMC_CZ_CHUNK_LZ4 && entry->size > (u32)LZ4_COMPRESSBOUND(len)) ||
+		entry->type > NX_EMMC_CZ_CHUNK_ZERO)
+		return 2;
+
+	if (_cz_open_part(level, entry->part, "rb"))
+		return 1;
+
+	if (fseeko(level->fp, entry->offset, SEEK_SET) || fread(src, 1, entry->size, level->fp) != entry->size)
+		return 1;
+
+	if (entry->type == NX_EMMC_CZ_CHUNK_LZ4 &&
+		LZ4_decompress_safe((const char *)src, (char *)cz->buf, entry->size, len) != (int)len)
+		return 2;
+
+hash:
+	sha256(hash, cz->buf, len);
+	if (memcmp(hash, entry->hash, SHA256_SIZE))
+		return 2;
+
+	return 0;
+}
+
+static int _cmd_info(cz_t *cz, int argc, char **argv)
+{
+	u64 stored = 0;
+	u32 types[5] = { 0 };
+
+	if (_cz_load(cz))
+		return 1;
+
+	for (u32 i = 0; i < cz->hdr.chunk_cnt; i++)
+	{
+		stored += cz->idx[i].size;
+		if (cz->idx[i].type < ARRAY_SIZE(types))
+			types[cz->idx[i].type]++;
+	}
+
+	printf("Image size:  %llu bytes (%llu sectors)\n", cz->hdr.image_size, cz->hdr.image_size >> 9);
+	printf("Level:       %u\n", cz->hdr.level);
+	printf("Chain id:    %08X\n", cz->hdr.chain_id);
+	printf("Chunks:      %u x %u KiB (%u LZ4, %u raw, %u empty, %u unchanged, %u in store)\n",
+		cz->hdr.chunk_cnt, cz->hdr.chunk_size >> 10, types[NX_EMMC_CZ_CHUNK_LZ4],
+		types[NX_EMMC_CZ_CHUNK_RAW], types[NX_EMMC_CZ_CHUNK_ZERO], types[NX_EMMC_CZ_CHUNK_PARENT],
+		types[NX_EMMC_CZ_CHUNK_STORE]);
+	printf("Data files:  %u\n", cz->hdr.part_cnt);
+	printf("Stored size: %llu bytes (%llu%%)\n", stored, stored * 100 / cz->hdr.image_size);
+
+	return 0;
+}
+
+static int _cmd_verify(cz_t *cz, int argc, char **argv)
+{
+	u32 bad = 0;
+
+	if (_cz_load(cz))
+		return 1;
+
+	for (u32 i = 0; i < cz->hdr.chunk_cnt; i++)
+	{
+		int res = _cz_read_chunk(cz, i);
+		if (res)
+		{
+			printf("Chunk %u (LBA %08X): %s\n", i, i * (cz->hdr.chunk_size >> 9), res == 1 ? "read error" : "corrupted");
+			bad++;
+		}
+	}
+
+	if (bad)
+	{
+		printf("Verification failed: %u of %u chunks\n", bad, cz->hdr.chunk_cnt);
+		return 1;
+	}
+
+	printf("Verified %u chunks\n", cz->hdr.chunk_cnt);
+
+	return 0;
+}
+
+static int _cmd_unpack(cz_t *cz, int argc, char **argv)
+{
+	int res = 1;
+
+	if (argc < 1)
+		return -1;
+
+	if (_cz_load(cz))
+		return 1;
+
+	// Optional sector range. Only the chunks covering it are read.
+	u64 sct_cnt = cz->hdr.image_size >> 9;
+	u64 lba = argc > 1 ? strtoull(argv[1], NULL, 0) : 0;
+	u64 num = argc > 2 ? strtoull(argv[2], NULL, 0) : sct_cnt - MIN(lba, sct_cnt);
+	if (lba + num > sct_cnt)
+	{
+		printf("Range is out of image bounds\n");
+		return 1;
+	}
+
+	FILE *out = fopen(argv[0], "wb");
+	if (!out)
+	{
+		printf("Failed to create %s\n", argv[0]);
+		return 1;
+	}
+
+	u32 chunk_scts = cz->hdr.chunk_size >> 9;
+	while (num)
+	{
+		u32 chunk = lba / chunk_scts;
+		u32 off = lba % chunk_scts;
+		u32 cnt = MIN(num, (_cz_chunk_len(cz, chunk) >> 9) - off);
+
+		int err = _cz_read_chunk(cz, chunk);
+		if (err)
+		{
+			printf("Chunk %u: %s\n", chunk, err == 1 ? "read error" : "corrupted");
+			goto out;
+		}
+
+		if (fwrite(cz->buf + ((u64)off << 9), (u64)cnt << 9, 1, out) != 1)
+		{
+			printf("Failed to write %s\n", argv[0]);
+			goto out;
+		}
+
+		lba += cnt;
+		num -= cnt;
+	}
+
+	res = 0;
+
+out:
+	if (fclose(out))
+		res = 1;
+
+	return res;
+}
+
+static int _cmd_pack(cz_t *cz, int argc, char **argv)
+{
+	int res = 1;
+	u64 part_size = 0;
+	u64 part_size_max = NX_EMMC_CZ_PART_SIZE_MAX;
+
+	if (argc < 1)
+		return -1;
+
+	if (argc > 1)
+		part_size_max = strtoull(argv[1], NULL, 0) << 20;
+
+	FILE *in = fopen(argv[0], "rb");
+	if (!in)
+	{
+		printf("Failed to open %s\n", argv[0]);
+		return 1;
+	}
+
+	fseeko(in, 0, SEEK_END);
+	u64 image_size = ftello(in);
+	fseeko(in, 0, SEEK_SET);
+
+	if (!image_size || (image_size % 512) || part_size_max < CHUNK_BOUND)
+	{
+		printf("Image must be a multiple of 512 bytes and data files at least %u bytes\n", CHUNK_BOUND);
+		fclose(in);
+		return 1;
+	}
+
+	cz->hdr.magic      = NX_EMMC_CZ_MAGIC;
+	cz->hdr.version    = NX_EMMC_CZ_VERSION;
+	cz->hdr.chunk_size = NX_EMMC_CZ_CHUNK_SIZE;
+	cz->hdr.chunk_cnt  = (image_size + NX_EMMC_CZ_CHUNK_SIZE - 1) / NX_EMMC_CZ_CHUNK_SIZE;
+	cz->hdr.image_size = image_size;
+	cz->idx = calloc(cz->hdr.chunk_cnt, sizeof(nx_emmc_cz_chunk_t));
+
+	// A <name>.dNN.nxcz output is an incremental level on top of the previous one.
+	u32 base_len;
+	cz->hdr.level = _cz_path_level(cz->path, &base_len);
+	if (cz->hdr.level)
+	{
+		char path[PATH_SZ];
+		_cz_level_path(path, cz->path, cz->hdr.level - 1);
+
+		cz->parent = malloc(sizeof(cz_t));
+		_cz_init(cz->parent, path, false);
+		if (_cz_load(cz->parent))
+			goto out;
+
+		if (cz->parent->hdr.image_size != image_size)
+		{
+			printf("Image size does not match %s\n", path);
+			goto out;
+		}
+		memcpy(cz->hdr.parent_hash, cz->parent->hdr.idx_hash, SHA256_SIZE);
+		cz->hdr.chain_id = cz->parent->hdr.chain_id;
+	}
+	else
+	{
+		// A full backup starts a new chain.
+		FILE *rng = fopen("/dev/urandom", "rb");
+		if (!rng || fread(&cz->hdr.chain_id, sizeof(u32), 1, rng) != 1)
+			cz->hdr.chain_id = time(NULL);
+		if (rng)
+			fclose(rng);
+		if (!cz->hdr.chain_id)
+			cz->hdr.chain_id = 1;
+	}
+
+	// Chunk store backups have no data files.
+	bool store = store_set;
+	if (!store)
+	{
+		if (_cz_open_part(cz, 0, "wb"))
+			goto out;
+		cz->hdr.part_cnt = 1;
+	}
+
+	for (u32 i = 0; i < cz->hdr.chunk_cnt; i++)
+	{
+		nx_emmc_cz_chunk_t *entry = &cz->idx[i];
+		u32 len = _cz_chunk_len(cz, i);
+
+		if (fread(cz->buf, len, 1, in) != 1)
+		{
+			printf("Failed to read %s\n", argv[0]);
+			goto out;
+		}
+
+		sha256(entry->hash, cz->buf, len);
+
+		// Unchanged chunks are only referenced.
+		if (cz->parent && !memcmp(entry->hash, cz->parent->idx[i].hash, SHA256_SIZE))
+		{
+			entry->type = NX_EMMC_CZ_CHUNK_PARENT;
+			continue;
+		}
+
+		// Empty chunks are not stored.
+		if (mem_is_zero(cz->buf, len))
+		{
+			entry->type = NX_EMMC_CZ_CHUNK_ZERO;
+			continue;
+		}
+
+		// Chunks already in the store are only referenced.
+		struct stat st;
+		char path[OBJ_PATH_SZ];
+		if (store)
+		{
+			_cz_store_path(path, entry->hash);
+			if (!stat(path, &st) && st.st_size && st.st_size <= len)
+			{
+				entry->type = NX_EMMC_CZ_CHUNK_STORE;
+				entry->size = st.st_size;
+				continue;
+			}
+		}
+
+		// Same policy as Nyx. Store raw if it does not compress well.
+		u8 *data = cz->cbuf;
+		int size = LZ4_compress_default((const char *)cz->buf, (char *)cz->cbuf, len, CHUNK_BOUND);
+		entry->type = NX_EMMC_CZ_CHUNK_LZ4;
+		if (size <= 0 || (u32)size > (len - (len >> 5)))
+		{
+			data = cz->buf;
+			size = len;
+			entry->type = NX_EMMC_CZ_CHUNK_RAW;
+		}
+
+		if (store)
+		{
+			if (_cz_store_write(entry->hash, data, size))
+				goto out;
+
+			entry->type = NX_EMMC_CZ_CHUNK_STORE;
+			entry->size = size;
+			continue;
+		}
+
+		if (part_size + size > part_size_max)
+		{
+			if (_cz_open_part(cz, cz->hdr.part_cnt, "wb"))
+				goto out;
+			cz->hdr.part_cnt++;
+			part_size = 0;
+		}
+
+		if (fwrite(data, size, 1, cz->fp) != 1)
+		{
+			printf("Failed to write data file %02d\n", cz->part);
+			goto out;
+		}
+
+		entry->part   = cz->part;
+		entry->size   = size;
+		entry->offset = part_size;
+		part_size += size;
+	}
+
+	if (cz->fp && fclose(cz->fp))
+	{
+		cz->fp = NULL;
+		goto out;
+	}
+	cz->fp = NULL;
+
+	u32 idx_size = cz->hdr.chunk_cnt * sizeof(nx_emmc_cz_chunk_t);
+	sha256(cz->hdr.idx_hash, cz->idx, idx_size);
+
+	FILE *fp = fopen(cz->path, "wb");
+	if (!fp)
+	{
+		printf("Failed to create %s\n", cz->path);
+		goto out;
+	}
+	res = fwrite(&cz->hdr, sizeof(nx_emmc_cz_hdr_t), 1, fp) != 1 || fwrite(cz->idx, idx_size, 1, fp) != 1;
+	if (fclose(fp))
+		res = 1;
+
+	// Same as Nyx. Levels above this one were made on top of an older backup.
+	if (!res)
+	{
+		for (u32 i = cz->hdr.level + 1; i <= NX_EMMC_CZ_LEVEL_MAX; i++)
+		{
+			char path[PATH_SZ];
+			char name[PATH_SZ + 4];
+
+			_cz_level_path(path, cz->path, i);
+			remove(path);
+			for (u32 j = 0; ; j++)
+			{
+				snprintf(name, sizeof(name), "%s.%02d", path, j);
+				if (remove(name))
+					break;
+			}
+		}
+	}
+
+out:
+	fclose(in);
+
+	return res;
+}
+
+/*
+ * Checks a raw backup file against the .manifest written by Nyx verification.
+ * The file is hashed in chunks of chunksize from its start, the last one being
+ * shorter, and only whole sectors count:
+ * chain = SHA256(chain || SHA256(chunk)), starting from 32 zero bytes.
+ */
+static int _cmd_manifest(cz_t *cz, int argc, char **argv)
+{
+	char path[PATH_SZ + 16];
+	char line[256];
+	char chain_str[SHA256_SIZE * 2 + 1];
+	char hash_str[SHA256_SIZE * 2 + 1] = {0};
+	u8 chain[SHA256_SIZE * 2];
+	u32 chunk_size = 0;
+	u64 sct_cnt = 0;
+	int res = 1;
+
+	if (argc > 0)
+		snprintf(path, sizeof(path), "%s", argv[0]);
+	else
+		snprintf(path, sizeof(path), "%s.manifest", cz->path);
+
+	FILE *mf = fopen(path, "r");
+	if (!mf)
+	{
+		printf("Failed to open %s\n", path);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), mf))
+	{
+		if (!strncmp(line, "# chunksize: ", 13))
+			chunk_size = strtoul(line + 13, NULL, 10);
+		else if (!strncmp(line, "# sectors: ", 11))
+			sct_cnt = strtoull(line + 11, NULL, 10);
+		else if (!strncmp(line, "# chain: ", 9))
+			sscanf(line + 9, "%64s", hash_str);
+	}
+	fclose(mf);
+
+	if (!chunk_size || (chunk_size & 511) || chunk_size > SZ_64M || strlen(hash_str) != SHA256_SIZE * 2)
+	{
+		printf("Incomplete or invalid manifest %s\n", path);
+		return 1;
+	}
+
+	FILE *fp = fopen(cz->path, "rb");
+	if (!fp)
+	{
+		printf("Failed to open %s\n", cz->path);
+		return 1;
+	}
+
+	fseeko(fp, 0, SEEK_END);
+	u64 size = ftello(fp);
+	fseeko(fp, 0, SEEK_SET);
+
+	if ((size >> 9) != sct_cnt)
+	{
+		printf("Size mismatch: %llu sectors, manifest has %llu\n", size >> 9, sct_cnt);
+		fclose(fp);
+		return 1;
+	}
+
+	u8 *buf = malloc(chunk_size);
+	memset(chain, 0, SHA256_SIZE);
+
+	u64 left = sct_cnt << 9;
+	while (left)
+	{
+		u32 len = MIN(left, chunk_size);
+		if (fread(buf, len, 1, fp) != 1)
+		{
+			printf("Failed to read %s\n", cz->path);
+			goto out;
+		}
+
+		sha256(chain + SHA256_SIZE, buf, len);
+		sha256(chain, chain, sizeof(chain));
+		left -= len;
+	}
+
+	_cz_hash_str(chain_str, chain);
+	for (u32 i = 0; hash_str[i]; i++)
+		hash_str[i] = tolower((unsigned char)hash_str[i]);
+
+	if (strcmp(chain_str, hash_str))
+	{
+		printf("Manifest mismatch: chain %s, expected %s\n", chain_str, hash_str);
+		goto out;
+	}
+
+	printf("Manifest matches: %llu sectors\n", sct_cnt);
+	res = 0;
+
+out:
+	free(buf);
+	fclose(fp);
+
+	return res;
+}
+
+typedef int (*walk_cb_t)(const char *path, void *data);
+
+// Calls cb for every file under dir. Stops on the first error.
+static int _walk(const char *dir, const char *skip, walk_cb_t cb, void *data)
+{
+	char path[PATH_SZ];
+	struct dirent *de;
+	struct stat st;
+	int res = 0;
+
+	DIR *d = opendir(dir);
+	if (!d)
+	{
+		printf("Failed to open %s\n", dir);
+		return 1;
+	}
+
+	while (!res && (de = readdir(d)))
+	{
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		if (stat(path, &st))
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+		{
+			if (!skip || strcmp(path, skip))
+				res = _walk(path, skip, cb, data);
+		}
+		else if (S_ISREG(st.st_mode))
+			res = cb(path, data);
+	}
+	closedir(d);
+
+	return res;
+}
+
+typedef struct _store_verify_t
+{
+	cz_t *cz;
+	u32 objects;
+	u32 bad;
+} store_verify_t;
+
+// Checks that a store object is named after the hash of its data.
+static int _store_verify_obj(const char *path, void *data)
+{
+	store_verify_t *sv = (store_verify_t *)data;
+	cz_t *cz = sv->cz;
+	u8 hash[SHA256_SIZE];
+	char hash_str[SHA256_SIZE * 2 + 1];
+	const char *name = strrchr(path, '/') + 1;
+	u32 size;
+
+	u32 len = strlen(name);
+	if (len > 4 && !strcmp(name + len - 4, ".tmp"))
+	{
+		printf("Incomplete object %s\n", path);
+		return 0;
+	}
+
+	// Parse the hash from the name.
+	u8 name_hash[SHA256_SIZE];
+	bool named = len == SHA256_SIZE * 2;
+	for (u32 i = 0; named && i < SHA256_SIZE; i++)
+		named = sscanf(name + i * 2, "%2hhx", &name_hash[i]) == 1;
+	if (named)
+	{
+		_cz_hash_str(hash_str, name_hash);
+		named = !strcmp(hash_str, name) && !strncmp(name, name - 3, 2);
+	}
+	if (!named)
+	{
+		printf("Unknown file %s\n", path);
+		sv->bad++;
+		return 0;
+	}
+
+	int res = _cz_store_read(name_hash, cz->cbuf, &size);
+	if (!res)
+	{
+		// Raw objects hash as they are. Otherwise it must be an LZ4 chunk.
+		sha256(hash, cz->cbuf, size);
+		if (memcmp(hash, name_hash, SHA256_SIZE))
+		{
+			int dlen = LZ4_decompress_safe((const char *)cz->cbuf, (char *)cz->buf, size, NX_EMMC_CZ_CHUNK_SIZE);
+			res = 2;
+			if (dlen > 0 && (u32)dlen > size)
+			{
+				sha256(hash, cz->buf, dlen);
+				if (!memcmp(hash, name_hash, SHA256_SIZE))
+					res = 0;
+			}
+		}
+	}
+
+	if (res)
+	{
+		printf("Object %s: %s\n", path, res == 1 ? "read error" : "corrupted");
+		sv->bad++;
+	}
+	sv->objects++;
+
+	return 0;
+}
+
+static int _cmd_store_verify(cz_t *cz, int argc, char **argv)
+{
+	store_verify_t sv = { cz, 0, 0 };
+
+	// The path is the store.
+	strcpy(store_dir, cz->path);
+	if (_walk(store_dir, NULL, _store_verify_obj, &sv))
+		return 1;
+
+	if (sv.bad)
+	{
+		printf("Verification failed: %u of %u objects\n", sv.bad, sv.objects);
+		return 1;
+	}
+
+	printf("Verified %u objects\n", sv.objects);
+
+	return 0;
+}
+
+typedef struct _store_refs_t
+{
+	u8 (*hashes)[SHA256_SIZE];
+	u32 cnt;
+	u32 max;
+	u32 indexes;
+	u32 removed;
+	u32 kept;
+	u64 removed_size;
+	bool dry_run;
+} store_refs_t;
+
+static int _hash_cmp(const void *a, const void *b)
+{
+	return memcmp(a, b, SHA256_SIZE);
+}
+
+// Adds the store chunks of a backup index.
+static int _store_gc_ref(const char *path, void *data)
+{
+	store_refs_t *refs = (store_refs_t *)data;
+	u32 len = strlen(path);
+	u32 ext_len = strlen(NX_EMMC_CZ_EXT);
+
+	if (len < ext_len || strcmp(path + len - ext_len, NX_EMMC_CZ_EXT))
+		return 0;
+
+	cz_t cz;
+	_cz_init(&cz, path, false);
+	int res = _cz_load(&cz);
+	if (res)
+		printf("Failed to load %s. Nothing was removed\n", path);
+
+	for (u32 i = 0; !res && i < cz.hdr.chunk_cnt; i++)
+	{
+		if (cz.idx[i].type != NX_EMMC_CZ_CHUNK_STORE)
+			continue;
+
+		if (refs->cnt == refs->max)
+		{
+			refs->max = refs->max ? refs->max * 2 : 4096;
+			refs->hashes = realloc(refs->hashes, refs->max * SHA256_SIZE);
+		}
+		memcpy(refs->hashes[refs->cnt++], cz.idx[i].hash, SHA256_SIZE);
+	}
+	refs->indexes++;
+	_cz_free(&cz);
+
+	return res;
+}
+
+static int _store_gc_obj(const char *path, void *data)
+{
+	store_refs_t *refs = (store_refs_t *)data;
+	const char *name = strrchr(path, '/') + 1;
+	u8 hash[SHA256_SIZE];
+	struct stat st;
+
+	// Unknown files are left alone. Incomplete objects are always removed.
+	u32 len = strlen(name);
+	bool tmp = len == SHA256_SIZE * 2 + 4 && !strcmp(name + len - 4, ".tmp");
+	if (len != SHA256_SIZE * 2 && !tmp)
+		return 0;
+
+	for (u32 i = 0; i < SHA256_SIZE; i++)
+		if (sscanf(name + i * 2, "%2hhx", &hash[i]) != 1)
+			return 0;
+
+	if (!tmp && bsearch(hash, refs->hashes, refs->cnt, SHA256_SIZE, _hash_cmp))
+	{
+		refs->kept++;
+		return 0;
+	}
+
+	if (stat(path, &st))
+		return 0;
+
+	if (!refs->dry_run && remove(path))
+	{
+		printf("Failed to remove %s\n", path);
+		return 1;
+	}
+	refs->removed++;
+	refs->removed_size += st.st_size;
+
+	return 0;
+}
+
+static int _cmd_store_gc(cz_t *cz, int argc, char **argv)
+{
+	store_refs_t refs = { 0 };
+
+	if (argc && !strcmp(argv[0], "-n"))
+	{
+		refs.dry_run = true;
+		argc--;
+		argv++;
+	}
+
+	if (argc < 1)
+		return -1;
+
+	// All backups must be loaded, or nothing is removed.
+	strcpy(store_dir, cz->path);
+	int res = 0;
+	for (int i = 0; i < argc && !res; i++)
+		res = _walk(argv[i], store_dir, _store_gc_ref, &refs);
+	if (res)
+		goto out;
+
+	qsort(refs.hashes, refs.cnt, SHA256_SIZE, _hash_cmp);
+	res = _walk(store_dir, NULL, _store_gc_obj, &refs);
+
+	printf("Backups: %u, chunk references: %u. %s %u objects (%llu MiB), kept %u\n",
+		refs.indexes, refs.cnt, refs.dry_run ? "Would remove" : "Removed",
+		refs.removed, refs.removed_size >> 20, refs.kept);
+
+out:
+	free(refs.hashes);
+
+	return res;
+}
+
+typedef struct _cz_cmd_t
+{
+	const char *name;
+	int (*run)(cz_t *cz, int argc, char **argv);
+	const char *usage;
+} cz_cmd_t;
+
+static const cz_cmd_t cmds[] = {
+	{ "info",   _cmd_info,   "" },
+	{ "verify", _cmd_verify, "" },
+	{ "unpack", _cmd_unpack, "<out.bin> [lba] [sectors]" },
+	{ "pack",   _cmd_pack,   "<in.bin> [data file MiB]" },
+	{ "manifest",     _cmd_manifest,     "[file.manifest] (path is the raw backup file)" },
+	{ "store-verify", _cmd_store_verify, "(path is the store)" },
+	{ "store-gc",     _cmd_store_gc,     "[-n] <backup folder>... (path is the store)" },
+};
+
+static void _usage(const char *prog)
+{
+	printf("Usage: %s [-s store] <command> <backup.nxcz> [args]\n", prog);
+	for (u32 i = 0; i < ARRAY_SIZE(cmds); i++)
+		printf("  %-12s %s\n", cmds[i].name, cmds[i].usage);
+	printf("With -s, pack writes the chunks to the store.\n");
+}
+
+int main(int argc, char **argv)
+{
+	cz_t cz;
+	const char *prog = argv[0];
+
+	if (argc > 2 && !strcmp(argv[1], "-s"))
+	{
+		snprintf(store_dir, sizeof(store_dir), "%s", argv[2]);
+		store_set = true;
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 3)
+	{
+		_usage(prog);
+		return 1;
+	}
+
+	const cz_cmd_t *cmd = NULL;
+	for (u32 i = 0; i < ARRAY_SIZE(cmds); i++)
+		if (!strcmp(argv[1], cmds[i].name))
+			cmd = &cmds[i];
+
+	if (!cmd)
+	{
+		_usage(prog);
+		return 1;
+	}
+
+	_cz_init(&cz, argv[2], true);
+	int res = cmd->run(&cz, argc - 3, argv + 3);
+	_cz_free(&cz);
+
+	if (res < 0)
+	{
+		_usage(prog);
+		return 1;
+	}
+
+	return res;
+}
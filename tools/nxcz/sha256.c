@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Plain FIPS 180-4 SHA-256. Matches the SE hashes stored by Nyx.
+
+#include <string.h>
+
+#include "sha256.h"
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const u32 k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static void _sha256_block(sha256_ctx_t *ctx, const u8 *p)
+{
+	u32 w[64];
+	u32 s[8];
+
+	for (u32 i = 0; i < 16; i++)
+		w[i] = (p[i * 4] << 24) | (p[i * 4 + 1] << 16) | (p[i * 4 + 2] << 8) | p[i * 4 + 3];
+	for (u32 i = 16; i < 64; i++)
+	{
+		u32 s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		u32 s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	memcpy(s, ctx->state, sizeof(s));
+	for (u32 i = 0; i < 64; i++)
+	{
+		u32 t1 = s[7] + (ROR(s[4], 6) ^ ROR(s[4], 11) ^ ROR(s[4], 25)) + ((s[4] & s[5]) ^ (~s[4] & s[6])) + k[i] + w[i];
+		u32 t2 = (ROR(s[0], 2) ^ ROR(s[0], 13) ^ ROR(s[0], 22)) + ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+		memmove(&s[1], &s[0], 7 * sizeof(u32));
+		s[4] += t1;
+		s[0] = t1 + t2;
+	}
+
+	for (u32 i = 0; i < 8; i++)
+		ctx->state[i] += s[i];
+}
+
+void sha256_init(sha256_ctx_t *ctx)
+{
+	static const u32 iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memcpy(ctx->state, iv, sizeof(iv));
+	ctx->len  = 0;
+	ctx->used = 0;
+}
+
+void sha256_update(sha256_ctx_t *ctx, const void *src, u32 size)
+{
+	const u8 *p = (const u8 *)src;
+
+	ctx->len += size;
+	while (size)
+	{
+		// Hash full blocks directly.
+		if (!ctx->used && size >= 64)
+		{
+			_sha256_block(ctx, p);
+			p += 64;
+			size -= 64;
+			continue;
+		}
+
+		u32 len = MIN(size, 64 - ctx->used);
+		memcpy(ctx->block + ctx->used, p, len);
+		ctx->used += len;
+		p += len;
+		size -= len;
+
+		if (ctx->used == 64)
+		{
+			_sha256_block(ctx, ctx->block);
+			ctx->used = 0;
+		}
+	}
+}
+
+void sha256_final(sha256_ctx_t *ctx, u8 *hash)
+{
+	u64 bits = ctx->len * 8;
+
+	ctx->block[ctx->used++] = 0x80;
+	if (ctx->used > 56)
+	{
+		memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+		_sha256_block(ctx, ctx->block);
+		ctx->used = 0;
+	}
+	memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+	for (u32 i = 0; i < 8; i++)
+		ctx->block[56 + i] = bits >> (56 - i * 8);
+	_sha256_block(ctx, ctx->block);
+
+	for (u32 i = 0; i < 8; i++)
+	{
+		hash[i * 4]     = ctx->state[i] >> 24;
+		hash[i * 4 + 1] = ctx->state[i] >> 16;
+		hash[i * 4 + 2] = ctx->state[i] >> 8;
+		hash[i * 4 + 3] = ctx->state[i];
+	}
+}
+
+void sha256(u8 *hash, const void *src, u32 size)
+{
+	sha256_ctx_t ctx;
+
+	sha256_init(&ctx);
+	sha256_update(&ctx, src, size);
+	sha256_final(&ctx, hash);
+}
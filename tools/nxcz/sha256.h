@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2026 CTCaer
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <utils/types.h>
+
+#define SHA256_SIZE 32
+
+typedef struct _sha256_ctx_t
+{
+	u32 state[8];
+	u64 len;
+	u32 used;
+	u8  block[64];
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *src, u32 size);
+void sha256_final(sha256_ctx_t *ctx, u8 *hash);
+void sha256(u8 *hash, const void *src, u32 size);
+
+#endif